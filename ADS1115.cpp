@@ -2,7 +2,7 @@
  *  @brief Functions related with the ADS1115 I2C 16bits ADC.
  */
 #include "ADS1115.h"
-#include <Wire.h>
+#include "TwiMaster.h"
 
 /*******************************************************************************
    config
@@ -18,20 +18,15 @@ void ADS1115::config(ADS1115_config_t *config)
     /* Prepara buffer de envio */
     uint8_t i2c_buffer[3];
     i2c_buffer[0] = REG_CONFIG;
-    i2c_buffer[1] = config->status | config->mux | config->gain | config->mode;
-    i2c_buffer[2] = config->rate | config->comp_mode | config->comp_polarity | config->comp_latching | config->comp_queue;
+    i2c_buffer[1] = configHigh(config->status, config->mux, config->gain, config->mode);
+    i2c_buffer[2] = configLow(config->rate, config->comp_mode, config->comp_polarity, config->comp_latching, config->comp_queue);
 
-    /* Configuração */
-    Wire.beginTransmission(config->i2c_addr);
-    Wire.write(i2c_buffer[0]); /* POINTER REGISTER */
-    Wire.write(i2c_buffer[1]); /* FIRST CONFIG BYTE */
-    Wire.write(i2c_buffer[2]); /* SECOND CONFIG BYTE */
-    Wire.endTransmission();
+    /* Configuração: POINTER REGISTER, FIRST CONFIG BYTE, SECOND CONFIG BYTE */
+    TwiMaster::write(config->i2c_addr, i2c_buffer, 3);
 
     /* Indica registrador leitura */
-    Wire.beginTransmission(config->i2c_addr);
-    Wire.write(REG_CONVERSION); /* POINTER REGISTER */
-    Wire.endTransmission();
+    i2c_buffer[0] = REG_CONVERSION; /* POINTER REGISTER */
+    TwiMaster::write(config->i2c_addr, i2c_buffer, 1);
 }
 
 /*******************************************************************************
@@ -49,24 +44,262 @@ void ADS1115::readData(ADS1115_data_t *data)
     if ((data->data_size) > ADS1115_max_buffer_size)
         return;
 
-    /* Contador para timeout */
-    uint16_t counter = UINT16_MAX;
-
     /* Recebe dados do ADC */
     /* Converte uint8_t em int16_t */
     for (uint16_t i = 0; i < data->data_size; i++)
     {
         /* Recepção */
-        /* Req. Leitura de 2 Bytes */
+        /* Req. Leitura de 2 Bytes; timeout no driver */
         uint8_t dataRaw[2] = {0, 0};
-        Wire.requestFrom(data->i2c_addr, 2);
-        while (!Wire.available())
-        {
-            if (0 == counter--)
-                return;
-        };
-        dataRaw[0] = Wire.read();
-        dataRaw[1] = Wire.read();
+        if (TwiMaster::read(data->i2c_addr, dataRaw, 2) != 2)
+            return;
         data->data_byte[i] = (dataRaw[0] << 8) | (dataRaw[1]);
     }
 }
+
+/*******************************************************************************
+   startContinuous
+****************************************************************************/
+/**
+ * @brief Starts interrupt-driven continuous conversions.
+ *
+ * The comparator is configured as a conversion-ready signal (Hi_thresh MSB = 1,
+ * Lo_thresh MSB = 0): ALERT/RDY pulses low for ~8us at the end of each
+ * conversion. Up to ADS1115_MAX_DEVICES devices convert in parallel; the
+ * ALERT/RDY of the first one started is wired to ADS1115_RDY_PIN and paces
+ * them all: on each pulse every device is read, round-robin, into its own
+ * ring buffer. Use read() to drain it.
+ * @param config ADC configuration. Mode and comparator fields are overridden.
+ * @return true if the device was added to the acquisition.\n
+           false if ADS1115_MAX_DEVICES are already running.
+*******************************************************************************/
+bool ADS1115::startContinuous(ADS1115_config_t *config)
+{
+    /* Para a aquisição anterior deste dispositivo, caso haja */
+    this->stop();
+    if (rdyDeviceCount >= ADS1115_MAX_DEVICES)
+        return false;
+
+    /* Suspende a ISR enquanto o barramento é usado */
+    rdyMask(false);
+
+    /* Limpa amostras antigas */
+    this->samples.clear();
+    this->i2c_addr = config->i2c_addr;
+
+    /* Comparador como sinal de conversão pronta */
+    uint8_t i2c_buffer[3];
+    i2c_buffer[0] = REG_HI_THRESH; /* POINTER REGISTER */
+    i2c_buffer[1] = 0x80;          /* Hi_thresh = 0x8000 */
+    i2c_buffer[2] = 0x00;
+    TwiMaster::write(config->i2c_addr, i2c_buffer, 3);
+
+    i2c_buffer[0] = REG_LO_THRESH; /* POINTER REGISTER */
+    i2c_buffer[1] = 0x00;          /* Lo_thresh = 0x0000 */
+    TwiMaster::write(config->i2c_addr, i2c_buffer, 3);
+
+    /* Conversão contínua, RDY ativo em nível baixo após cada conversão */
+    config->mode = MODE_CONT;
+    config->comp_mode = COMP_MODE_TRADITIONAL;
+    config->comp_polarity = COMP_POL_ACTIVE_LOW;
+    config->comp_latching = COMP_LATCH_OFF;
+    config->comp_queue = COMP_QUE_ONE_CONV;
+    this->config(config);
+
+    /* Insere na lista lida pela ISR */
+    noInterrupts();
+    rdyDevices[rdyDeviceCount++] = this;
+    interrupts();
+
+    /* Habilita interrupção por mudança de nível no pino ALERT/RDY */
+    pinMode(ADS1115_RDY_PIN, INPUT_PULLUP);
+    *digitalPinToPCICR(ADS1115_RDY_PIN) |= _BV(digitalPinToPCICRbit(ADS1115_RDY_PIN));
+    rdyMask(true);
+
+    return true;
+}
+
+/*******************************************************************************
+   selectMux
+****************************************************************************/
+/**
+ * @brief Switches the input mux of a running continuous acquisition.
+ *
+ * The RDY interrupt is held off while the config register is rewritten and
+ * the samples still queued from the previous input are dropped.
+ * @param config ADC configuration in use. Its mux field is updated.
+ * @param mux New input mux.
+ * @return void
+*******************************************************************************/
+void ADS1115::selectMux(ADS1115_config_t *config, ADS1115_mux_config_t mux)
+{
+    /* Suspende a ISR enquanto o barramento é usado */
+    rdyMask(false);
+
+    config->mux = mux;
+    this->config(config);
+
+    /* Descarta amostras da entrada anterior */
+    this->samples.clear();
+
+    rdyMask(rdyDeviceCount != 0);
+}
+
+/*******************************************************************************
+   stop
+****************************************************************************/
+/**
+ * @brief Stops the interrupt-driven acquisition of this device.
+ *
+ * The ADC keeps converting, but no more samples are queued. Samples already in
+ * the ring buffer can still be read. A transfer started by the ISR always
+ * completes before this runs, since it runs from the interrupted context.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ADS1115::stop(void)
+{
+    /* Remove da lista lida pela ISR */
+    noInterrupts();
+    for (uint8_t i = 0; i < rdyDeviceCount; i++)
+    {
+        if (rdyDevices[i] != this)
+            continue;
+
+        for (uint8_t j = i + 1; j < rdyDeviceCount; j++)
+            rdyDevices[j - 1] = rdyDevices[j];
+        rdyDeviceCount--;
+        break;
+    }
+    interrupts();
+
+    /* Nenhum dispositivo: desabilita a interrupção do pino ALERT/RDY */
+    if (rdyDeviceCount == 0)
+        rdyMask(false);
+}
+
+/*******************************************************************************
+   getConversionStamp
+****************************************************************************/
+/**
+ * @brief Gets the conversion counter and the time of the last conversion.
+ *
+ * Two stamps give the true conversion rate, which may differ from the nominal
+ * data rate by up to 10% (internal oscillator). The count goes up at each
+ * pulse of ADS1115_RDY_PIN: only for the first device started is it the rate
+ * of its own conversions; the others are sampled at that rate.
+ * @param[out] count Conversions signalled by ALERT/RDY.
+ * @param[out] micros Time of the last one, in microseconds.
+ * @return void
+*******************************************************************************/
+void ADS1115::getConversionStamp(uint16_t *count, uint32_t *micros)
+{
+    noInterrupts();
+    *count = this->conversionCount;
+    *micros = this->conversionMicros;
+    interrupts();
+}
+
+/*******************************************************************************
+   getOverrunCount
+****************************************************************************/
+/**
+ * @brief Gets the conversions lost because the ring buffer was full.
+ * @param void
+ * @return Conversions dropped by the RDY interrupt.
+*******************************************************************************/
+uint16_t ADS1115::getOverrunCount(void)
+{
+    /* 16 bits: lidos sem a ISR no meio */
+    noInterrupts();
+    uint16_t overruns = this->overrunCount;
+    interrupts();
+    return overruns;
+}
+
+/*******************************************************************************
+   rdyMask
+****************************************************************************/
+/**
+ * @brief Enables or disables the ALERT/RDY pin-change interrupt.
+ * @param enable true to enable. Pending edges are discarded.
+ * @return void
+*******************************************************************************/
+void ADS1115::rdyMask(bool enable)
+{
+    noInterrupts();
+    if (enable)
+    {
+        PCIFR = _BV(digitalPinToPCICRbit(ADS1115_RDY_PIN));
+        *digitalPinToPCMSK(ADS1115_RDY_PIN) |= _BV(digitalPinToPCMSKbit(ADS1115_RDY_PIN));
+    }
+    else
+    {
+        *digitalPinToPCMSK(ADS1115_RDY_PIN) &= ~_BV(digitalPinToPCMSKbit(ADS1115_RDY_PIN));
+    }
+    interrupts();
+}
+
+/*******************************************************************************
+   rdyHandler
+****************************************************************************/
+/**
+ * @brief Reads every running device, round-robin. Runs in interrupt context.
+ *
+ * The TWI is polled, but interrupts are re-enabled during the transfers so
+ * that the USART keeps receiving. The rising edge of the ~8us RDY pulse
+ * always lands inside them and is discarded by the 'rdyBusy' flag. Devices other than the pacing one
+ * are read at its RDY instants: their result is at most one conversion old.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ADS1115::rdyHandler(void)
+{
+    /* Ignora a borda de subida do pulso RDY */
+    if (rdyBusy)
+        return;
+    rdyBusy = true;
+
+    /* Habilita interrupções aninhadas: a USART não espera as leituras */
+    interrupts();
+    for (uint8_t i = 0; i < rdyDeviceCount; i++)
+        rdyDevices[i]->onReady();
+    noInterrupts();
+
+    rdyBusy = false;
+}
+
+/*******************************************************************************
+   onReady
+****************************************************************************/
+/**
+ * @brief Fetches one conversion into the ring buffer. Runs in interrupt context.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ADS1115::onReady(void)
+{
+    /* Marca de tempo da conversão, para medir a taxa real do oscilador interno */
+    this->conversionCount++;
+    this->conversionMicros = micros();
+
+    uint8_t dataRaw[2] = {0, 0};
+    uint8_t received = TwiMaster::read(this->i2c_addr, dataRaw, 2);
+    int16_t sample = (dataRaw[0] << 8) | dataRaw[1];
+
+    /* Fila cheia: o consumidor não drenou a tempo */
+    if (received != 2 || !this->samples.push(sample))
+        this->overrunCount++;
+}
+
+/*******************************************************************************
+   ISR
+****************************************************************************/
+ADS1115 *ADS1115::rdyDevices[ADS1115_MAX_DEVICES];
+volatile uint8_t ADS1115::rdyDeviceCount = 0;
+volatile bool ADS1115::rdyBusy = false;
+
+ISR(ADS1115_RDY_vect)
+{
+    ADS1115::rdyHandler();
+}
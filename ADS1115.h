@@ -9,17 +9,29 @@
 * Includes
 *************************************************************************************/
 #include "Arduino.h"
+#include "RingBuffer.h"
 
 /*************************************************************************************
 * Public macros
 *************************************************************************************/
 #define ADS1115_max_buffer_size (10u)
 
+/* Aquisição por interrupção */
+#define ADS1115_RDY_PIN (12)			 /* ALERT/RDY do primeiro dispositivo: D12 = PB4 (PCINT4), com pull-up */
+#define ADS1115_RDY_vect PCINT0_vect	 /* Vetor de interrupção do pino ALERT/RDY */
+#define ADS1115_RING_BUFFER_SIZE (32u) /* ~37ms de amostras a 860 SPS, por dispositivo */
+#ifndef ADS1115_MAX_DEVICES
+#define ADS1115_MAX_DEVICES (1u)		 /* Um por endereço I2C, até 4; ~110 bytes de RAM cada. A tensão (ENERGY_VOLTAGE) usa o seu */
+#endif
+#define ADS1115_I2C_CLOCK (400000ul)	 /* Fast-mode: leitura de 2 bytes em ~75us */
+
 /*************************************************************************************
 * Public prototypes
 *************************************************************************************/
 class ADS1115
 {
+	static_assert(ADS1115_MAX_DEVICES >= 1 && ADS1115_MAX_DEVICES <= 4, "ADS1115: up to 4 I2C addresses");
+
 public:
 	/*************************************************************************************
 	* Public enumeration
@@ -142,16 +154,91 @@ public:
 		int16_t data_byte[ADS1115_max_buffer_size];
 	} ADS1115_data_t;
 
+	/*************************************************************************************
+	* Public constexpr
+	*************************************************************************************/
+	/* Bytes do registrador de configuração, avaliados em tempo de compilação quando constantes */
+	static constexpr uint8_t configHigh(ADS1115_status_t status, ADS1115_mux_config_t mux, ADS1115_gain_t gain, ADS1115_mode_t mode)
+	{
+		return status | mux | gain | mode;
+	}
+	static constexpr uint8_t configLow(ADS1115_rate_t rate, ADS1115_comp_mode_t comp_mode, ADS1115_comp_polarity_t comp_polarity,
+									   ADS1115_latching_comp_t comp_latching, ADS1115_comp_queue_t comp_queue)
+	{
+		return rate | comp_mode | comp_polarity | comp_latching | comp_queue;
+	}
+
+	/* Peso do LSB em mV: FS / 32768, FS = 6144mV ou 8192mV >> (gain >> 1).
+	   Em múltiplos do LSB de PGA_0256 (7.8125uV): com o ganho só conhecido em
+	   execução fica um deslocamento e uma multiplicação, sem divisão em float */
+	static constexpr float lsbMillivolts(ADS1115_gain_t gain)
+	{
+		return ((gain == PGA_6144) ? 24u : (32u >> (gain >> 1))) * 0.0078125f;
+	}
+
 	/*************************************************************************************
 	* Public prototypes
 	*************************************************************************************/
 	void config(ADS1115_config_t *config);
 	void readData(ADS1115_data_t *data);
 
+	bool startContinuous(ADS1115_config_t *config);
+	void selectMux(ADS1115_config_t *config, ADS1115_mux_config_t mux);
+	void stop(void);
+	bool read(int16_t *sample) { return this->samples.pop(sample); }
+	uint8_t getCount(void) { return this->samples.count(); }
+	uint16_t getOverrunCount(void);
+	void getConversionStamp(uint16_t *count, uint32_t *micros);
+
+	static void rdyHandler(void);
+
 private:
+	void onReady(void);
+	static void rdyMask(bool enable);
+
 	/*************************************************************************************
 	* Private variables
 	*************************************************************************************/
+	/* Dispositivos lidos a cada pulso do ALERT/RDY, em rodízio */
+	static ADS1115 *rdyDevices[ADS1115_MAX_DEVICES];
+	static volatile uint8_t rdyDeviceCount;
+	static volatile bool rdyBusy;
+
+	uint8_t i2c_addr = ADDR_GND;
+	volatile uint16_t overrunCount = 0;
+	volatile uint16_t conversionCount = 0; /* Conversões sinalizadas pelo RDY */
+	volatile uint32_t conversionMicros = 0; /* Instante da última conversão */
+	RingBuffer<int16_t, ADS1115_RING_BUFFER_SIZE> samples;
+};
+
+/*************************************************************************************
+* Compile-time channel
+*************************************************************************************/
+/**
+ * @brief Channel fixed at build time: address, mux, gain and rate as template
+ *        parameters. The config register bytes and the LSB weight are
+ *        constant expressions, so they cost neither flash tables nor cycles.
+ *        Continuous conversion, with ALERT/RDY as the conversion-ready signal.
+ */
+template <ADS1115::ADS1115_i2c_address_t ADDR, ADS1115::ADS1115_mux_config_t MUX,
+		  ADS1115::ADS1115_gain_t GAIN = ADS1115::PGA_2048, ADS1115::ADS1115_rate_t RATE = ADS1115::DR_860>
+struct ADS1115Channel
+{
+	static constexpr ADS1115::ADS1115_i2c_address_t address = ADDR;
+	static constexpr ADS1115::ADS1115_mux_config_t mux = MUX;
+	static constexpr ADS1115::ADS1115_gain_t gain = GAIN;
+	static constexpr ADS1115::ADS1115_rate_t rate = RATE;
+
+	static constexpr uint8_t configHigh = ADS1115::configHigh(ADS1115::OS_N_EFF, MUX, GAIN, ADS1115::MODE_CONT);
+	static constexpr uint8_t configLow = ADS1115::configLow(RATE, ADS1115::COMP_MODE_TRADITIONAL, ADS1115::COMP_POL_ACTIVE_LOW,
+															ADS1115::COMP_LATCH_OFF, ADS1115::COMP_QUE_ONE_CONV);
+	static constexpr float lsbMillivolts = ADS1115::lsbMillivolts(GAIN);
+
+	static constexpr ADS1115::ADS1115_config_t config()
+	{
+		return {ADDR, ADS1115::OS_N_EFF, MUX, GAIN, ADS1115::MODE_CONT, RATE, ADS1115::COMP_MODE_TRADITIONAL,
+				ADS1115::COMP_POL_ACTIVE_LOW, ADS1115::COMP_LATCH_OFF, ADS1115::COMP_QUE_ONE_CONV};
+	}
 };
 
 #endif /* _ADS1115_H_ */
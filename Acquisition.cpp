@@ -0,0 +1,423 @@
+/** @file Acquisition.cpp
+ *  @brief Persistent ADC session: owns the ADS1115 devices and schedules the channels.
+ */
+#include "Acquisition.h"
+
+/*******************************************************************************
+   Private variables
+****************************************************************************/
+/* Pino de endereço I2C, mux e PGA = conforme o dispositivo e o canal */
+/* Conversão contínua, ACQUISITION_RATE */
+/* Comparador como sinal de conversão pronta (ALERT/RDY) */
+typedef ADS1115Channel<ADS1115::ADDR_GND, ADS1115::MUX_0_1, ACQUISITION_DEFAULT_GAIN, ACQUISITION_RATE> DefaultChannel;
+static const ADS1115::ADS1115_config_t ADS1115DefaultConfig = DefaultChannel::config();
+
+/*******************************************************************************
+   addChannel
+****************************************************************************/
+/**
+ * @brief Registers a channel in the scheduler. Must be called before begin().
+ * @param input Device and mux of the channel, see ACQUISITION_INPUT(), or
+ *        internal ADC pin with ACQUISITION_INTERNAL_ADC, see
+ *        ACQUISITION_INPUT_INTERNAL().
+ * @param gain PGA of the channel; ignored by the internal ADC.
+ * @return The channel index, or ACQUISITION_MAX_CHANNELS if there is no room
+ *         or the input is invalid.
+*******************************************************************************/
+uint8_t Acquisition::addChannel(uint8_t input, ADS1115::ADS1115_gain_t gain)
+{
+    if (this->channelCount >= ACQUISITION_MAX_CHANNELS || !ACQUISITION_INPUT_VALID(input))
+        return ACQUISITION_MAX_CHANNELS;
+
+    Channel *channel = &this->channels[this->channelCount];
+    channel->input = input;
+    channel->gain = gain;
+    channel->lastReleaseMicros = 0;
+    channel->sampleRate = 0;
+
+    return this->channelCount++;
+}
+
+/*******************************************************************************
+   setVoltageInput
+****************************************************************************/
+/**
+ * @brief Registers the voltage input. Must be called after the channels and
+ *        before begin().
+ *
+ * The input needs an ADS1115 of its own: it is never switched, so it loses no
+ * settling conversions, and it is read at every RDY of the pacing device, the
+ * one of the first ADS1115 channel. Each sample of the channels of that device
+ * then comes with the voltage of the same ISR pass, at no cost to their rate.
+ * @param input Single-ended input, see ACQUISITION_INPUT_SINGLE_ENDED().
+ * @param gain PGA of the input.
+ * @return false if the input is not single-ended or its device has channels.
+*******************************************************************************/
+bool Acquisition::setVoltageInput(uint8_t input, ADS1115::ADS1115_gain_t gain)
+{
+    if (!ACQUISITION_INPUT_SINGLE_ENDED(input))
+        return false;
+
+    for (uint8_t i = 0; i < this->channelCount; i++)
+    {
+        if (this->deviceOf(i) == ACQUISITION_INPUT_DEVICE(input))
+            return false;
+    }
+
+    this->voltageInput = input;
+    this->voltageGain = gain;
+    return true;
+}
+
+/*******************************************************************************
+   begin
+****************************************************************************/
+/**
+ * @brief Configures each device in use once and starts the continuous
+ *        acquisition on its first channel.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Acquisition::begin(void)
+{
+    for (uint8_t i = 0; i < this->channelCount; i++)
+    {
+        uint8_t index = this->deviceOf(i);
+        Device *device = &this->devices[index];
+        if (device->running)
+            continue;
+
+        /* Primeiro canal do dispositivo */
+        device->activeChannel = i;
+        device->conversionRate = 0;
+
+#ifdef ACQUISITION_INTERNAL_ADC
+        /* ADC interno: free running no pino do canal */
+        if (index == ACQUISITION_INTERNAL_DEVICE)
+        {
+            this->internalAdc.start(ACQUISITION_INPUT_PIN(this->channels[i].input));
+            device->settleCount = ACQUISITION_INTERNAL_SETTLING_SAMPLES;
+            device->running = true;
+            continue;
+        }
+#endif
+
+        ADS1115::ADS1115_config_t *config = &this->config[index];
+        *config = ADS1115DefaultConfig;
+        config->i2c_addr = (ADS1115::ADS1115_i2c_address_t)(ADS1115::ADDR_GND + index);
+        config->mux = ACQUISITION_INPUT_MUX(this->channels[i].input);
+        config->gain = (ADS1115::ADS1115_gain_t)this->channels[i].gain;
+        device->settleCount = ACQUISITION_SETTLING_SAMPLES;
+        device->running = this->ads[index].startContinuous(config);
+        if (device->running && this->pacingDevice == ACQUISITION_MAX_DEVICES)
+            this->pacingDevice = index;
+        if (device->running && this->pairedDevice == ACQUISITION_MAX_DEVICES && this->voltageInput != ACQUISITION_INPUT_NONE)
+            this->pairedDevice = index;
+    }
+
+    /* Tensão: iniciada após o dispositivo pareado, é lida logo depois dele na ISR */
+    if (this->pairedDevice != ACQUISITION_MAX_DEVICES)
+    {
+        uint8_t index = ACQUISITION_INPUT_DEVICE(this->voltageInput);
+        ADS1115::ADS1115_config_t *config = &this->config[index];
+        *config = ADS1115DefaultConfig;
+        config->i2c_addr = (ADS1115::ADS1115_i2c_address_t)(ADS1115::ADDR_GND + index);
+        config->mux = ACQUISITION_INPUT_MUX(this->voltageInput);
+        config->gain = (ADS1115::ADS1115_gain_t)this->voltageGain;
+        if (!this->ads[index].startContinuous(config))
+            this->pairedDevice = ACQUISITION_MAX_DEVICES;
+    }
+}
+
+/*******************************************************************************
+   read
+****************************************************************************/
+/**
+ * @brief Gets one settled sample of the channel, if it is the scheduled one
+ *        on its device.
+ * @param channel Channel index.
+ * @param[out] sample Raw conversion.
+ * @param[out] voltage Raw voltage of the same ISR pass, see hasVoltage(); may
+ *             be NULL.
+ * @return true if a sample was returned.\n
+           false if the channel is not scheduled or no sample is buffered.
+*******************************************************************************/
+bool Acquisition::read(uint8_t channel, int16_t *sample, int16_t *voltage)
+{
+    if (channel >= this->channelCount)
+        return false;
+
+    uint8_t index = this->deviceOf(channel);
+    Device *device = &this->devices[index];
+    if (channel != device->activeChannel)
+        return false;
+
+    while (this->fetch(index, sample, voltage))
+    {
+        /* Descarta as conversões de assentamento após a troca do mux */
+        /* A marca de taxa é tomada aqui: esta conversão já foi contada após a troca */
+        if (device->settleCount)
+        {
+            device->settleCount--;
+            this->getConversionStamp(index, &device->stampCount, &device->stampMicros);
+            continue;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+   release
+****************************************************************************/
+/**
+ * @brief Ends the window of the channel and schedules the next channel of the
+ *        same device.
+ * @param channel Channel index, must be the scheduled one.
+ * @param samplesUsed Samples consumed by the window, for the rate report.
+ * @return void
+*******************************************************************************/
+void Acquisition::release(uint8_t channel, uint16_t samplesUsed)
+{
+    if (channel >= this->channelCount)
+        return;
+
+    uint8_t index = this->deviceOf(channel);
+    Device *device = &this->devices[index];
+    if (channel != device->activeChannel)
+        return;
+
+    /* Taxa efetiva: amostras úteis pelo tempo entre duas janelas do mesmo canal */
+    Channel *active = &this->channels[channel];
+    uint32_t now = micros();
+    if (active->lastReleaseMicros != 0 && now != active->lastReleaseMicros)
+        active->sampleRate = samplesUsed * 1e6f / (now - active->lastReleaseMicros);
+    active->lastReleaseMicros = now;
+
+    /* Taxa real do ADC: sem troca de mux desde a última marca, nenhuma conversão se perdeu */
+    uint16_t count;
+    uint32_t lastMicros;
+    this->getConversionStamp(index, &count, &lastMicros);
+    if (count != device->stampCount && lastMicros != device->stampMicros)
+        device->conversionRate = (uint16_t)(count - device->stampCount) * 1e6f / (lastMicros - device->stampMicros);
+
+    /* Próximo canal do dispositivo, em rodízio */
+    this->select(index, this->nextChannel(channel));
+
+    /* Sem troca de mux, a próxima medida de taxa começa já */
+    if (device->settleCount == 0)
+        this->getConversionStamp(index, &device->stampCount, &device->stampMicros);
+}
+
+/*******************************************************************************
+   getConversionRate
+****************************************************************************/
+/**
+ * @brief Gets the measured rate of the samples of the channel's device.
+ *
+ * Only the pacing ADS1115 (the first one started, on ADS1115_RDY_PIN) is read
+ * at its own conversions. The other ones run on their own oscillators, up to
+ * 10% apart, and are read at the pacing RDY: their samples are a zero-order
+ * hold of their conversions, resampled at the pacing rate. A slower device
+ * repeats a conversion, a faster one skips one, and each sample is up to one
+ * of its conversion periods old. That resampled sequence is what the channel
+ * integrates, so the rate of every ADS1115 is derived from the pacing device's
+ * stamps; the internal ADC has its own.
+ * @param channel Channel index.
+ * @return Samples per second, or 0 if not measured yet.
+*******************************************************************************/
+float Acquisition::getConversionRate(uint8_t channel)
+{
+    if (channel >= this->channelCount)
+        return 0;
+
+    return this->devices[this->deviceOf(channel)].conversionRate;
+}
+
+/*******************************************************************************
+   getLsbMillivolts
+****************************************************************************/
+/**
+ * @brief Gets the weight of one count of the converter of the channel.
+ * @param channel Channel index.
+ * @return LSB in millivolts, or 0 if the channel does not exist.
+*******************************************************************************/
+float Acquisition::getLsbMillivolts(uint8_t channel)
+{
+    if (channel >= this->channelCount)
+        return 0;
+
+#ifdef ACQUISITION_INTERNAL_ADC
+    if (this->deviceOf(channel) == ACQUISITION_INTERNAL_DEVICE)
+        return INTERNAL_ADC_LSB_MV;
+#endif
+
+    return ADS1115::lsbMillivolts((ADS1115::ADS1115_gain_t)this->channels[channel].gain);
+}
+
+/*******************************************************************************
+   getOverrunCount
+****************************************************************************/
+/**
+ * @brief Gets the conversions lost by all devices.
+ * @param void
+ * @return Conversions that could not be queued or read.
+*******************************************************************************/
+uint16_t Acquisition::getOverrunCount(void)
+{
+    uint16_t overruns = 0;
+    for (uint8_t i = 0; i < ACQUISITION_MAX_DEVICES; i++)
+    {
+        if (this->devices[i].running)
+            overruns += this->ads[i].getOverrunCount();
+    }
+
+#ifdef ACQUISITION_INTERNAL_ADC
+    if (this->devices[ACQUISITION_INTERNAL_DEVICE].running)
+        overruns += this->internalAdc.getOverrunCount();
+#endif
+
+    /* Tensão: não é marcada como 'running', é lida junto do dispositivo pareado */
+    if (this->pairedDevice != ACQUISITION_MAX_DEVICES)
+        overruns += this->ads[ACQUISITION_INPUT_DEVICE(this->voltageInput)].getOverrunCount();
+
+    return overruns;
+}
+
+/*******************************************************************************
+   nextChannel
+****************************************************************************/
+/**
+ * @brief Finds the next channel, in round-robin order, on the same device.
+ * @param channel Channel index.
+ * @return The next channel index; the same one if it is alone on the device.
+*******************************************************************************/
+uint8_t Acquisition::nextChannel(uint8_t channel)
+{
+    uint8_t device = ACQUISITION_INPUT_DEVICE(this->channels[channel].input);
+    uint8_t next = channel;
+
+    do
+    {
+        next = (next + 1) % this->channelCount;
+    } while (ACQUISITION_INPUT_DEVICE(this->channels[next].input) != device);
+
+    return next;
+}
+
+/*******************************************************************************
+   select
+****************************************************************************/
+/**
+ * @brief Points the device to the channel, without stopping the conversions.
+ * @param device Device index of the channel.
+ * @param channel Channel index.
+ * @return void
+*******************************************************************************/
+void Acquisition::select(uint8_t device, uint8_t channel)
+{
+    /* Canal único no dispositivo: não há troca de mux nem assentamento */
+    if (channel == this->devices[device].activeChannel)
+        return;
+
+    uint8_t input = this->channels[channel].input;
+#ifdef ACQUISITION_INTERNAL_ADC
+    if (device == ACQUISITION_INTERNAL_DEVICE)
+    {
+        this->internalAdc.selectPin(ACQUISITION_INPUT_PIN(input));
+        this->devices[device].settleCount = ACQUISITION_INTERNAL_SETTLING_SAMPLES;
+        this->devices[device].activeChannel = channel;
+        return;
+    }
+#endif
+    this->config[device].gain = (ADS1115::ADS1115_gain_t)this->channels[channel].gain;
+    this->ads[device].selectMux(&this->config[device], ACQUISITION_INPUT_MUX(input));
+    this->devices[device].settleCount = ACQUISITION_SETTLING_SAMPLES;
+    this->devices[device].activeChannel = channel;
+}
+
+/*******************************************************************************
+   fetch
+****************************************************************************/
+/**
+ * @brief Gets the next buffered conversion of a device; on the paired device,
+ *        the voltage conversion queued with it is consumed as well.
+ * @param device Device index.
+ * @param[out] sample Raw conversion.
+ * @param[out] voltage Raw voltage, or NULL to drop it.
+ * @return true if a conversion was returned.
+*******************************************************************************/
+bool Acquisition::fetch(uint8_t device, int16_t *sample, int16_t *voltage)
+{
+#ifdef ACQUISITION_INTERNAL_ADC
+    if (device == ACQUISITION_INTERNAL_DEVICE)
+        return this->internalAdc.read(sample);
+#endif
+
+    if (device == this->pairedDevice)
+    {
+        /* Filas de mesmo tamanho: ou as duas têm a amostra, ou nenhuma */
+        int16_t discarded;
+        this->alignVoltage();
+        this->ads[ACQUISITION_INPUT_DEVICE(this->voltageInput)].read(voltage != NULL ? voltage : &discarded);
+    }
+
+    return this->ads[device].read(sample);
+}
+
+/*******************************************************************************
+   alignVoltage
+****************************************************************************/
+/**
+ * @brief Drops the oldest conversions of the longer of the paired queues.
+ *
+ * Both are pushed in the same ISR pass, so they only differ after the mux
+ * switch of the paired device (its queue is cleared) or a failed transfer;
+ * the newest conversions are the ones taken together.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Acquisition::alignVoltage(void)
+{
+    ADS1115 *current = &this->ads[this->pairedDevice];
+    ADS1115 *voltage = &this->ads[ACQUISITION_INPUT_DEVICE(this->voltageInput)];
+
+    /* Sem uma passada da ISR entre as duas contagens */
+    noInterrupts();
+    uint8_t currentCount = current->getCount();
+    uint8_t voltageCount = voltage->getCount();
+    interrupts();
+
+    int16_t discarded;
+    for (; voltageCount > currentCount; voltageCount--)
+        voltage->read(&discarded);
+    for (; currentCount > voltageCount; currentCount--)
+        current->read(&discarded);
+}
+
+/*******************************************************************************
+   getConversionStamp
+****************************************************************************/
+/**
+ * @brief Gets the conversion counter of a device and the time of its last update.
+ *
+ * Every ADS1115 is read once per pulse of the pacing device, so the stamps of
+ * the pacing device give the sample rate of all of them, see getConversionRate().
+ * @param device Device index.
+ * @param[out] count Conversion counter.
+ * @param[out] micros Time of the last update, in microseconds.
+ * @return void
+*******************************************************************************/
+void Acquisition::getConversionStamp(uint8_t device, uint16_t *count, uint32_t *micros)
+{
+#ifdef ACQUISITION_INTERNAL_ADC
+    if (device == ACQUISITION_INTERNAL_DEVICE)
+    {
+        this->internalAdc.getConversionStamp(count, micros);
+        return;
+    }
+#endif
+    this->ads[this->pacingDevice].getConversionStamp(count, micros);
+}
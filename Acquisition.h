@@ -0,0 +1,163 @@
+/** @file Acquisition.h
+ *  @brief Header to the persistent ADC session and channel scheduler.
+ */
+
+#ifndef _ACQUISITION_H_
+#define _ACQUISITION_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+#include "ADS1115.h"
+#include "InternalADC.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+/* Limites de RAM: cada canal custa ~110 bytes (Energy, escalonador, fila de publicação) */
+/* Até 8 canais e 4 dispositivos (ADS1115_MAX_DEVICES), se couberem: test/ram_budget.sh */
+#ifndef ACQUISITION_MAX_CHANNELS
+#define ACQUISITION_MAX_CHANNELS (2u) /* Com 2 KB de RAM: 2 canais num ADS1115 */
+#endif
+#define ACQUISITION_MAX_DEVICES ADS1115_MAX_DEVICES
+#define ACQUISITION_INTERNAL_DEVICE ACQUISITION_MAX_DEVICES /* ADC interno, após os ADS1115 */
+#define ACQUISITION_DEFAULT_GAIN ADS1115::PGA_2048 /* +-2048mV, por canal */
+#define ACQUISITION_RATE ADS1115::DR_860			/* Comum a todos os ADS1115: o RDY do primeiro cadencia os demais */
+
+/* O filtro delta-sigma do ADS1115 assenta em um único ciclo: após trocar o mux
+   só a conversão que estava em andamento mistura as duas entradas. */
+#define ACQUISITION_SETTLING_SAMPLES (1u)
+
+/* Entrada de um canal: dispositivo (endereço ADDR_GND + n) e mux, em um byte */
+/* Ex.: ACQUISITION_INPUT(1, ADS1115::MUX_2_3) = A2 - A3 do ADS1115 em ADDR_VDD */
+#define ACQUISITION_INPUT(device, mux) ((uint8_t)(((device) << 3) | ((mux) >> 4)))
+#define ACQUISITION_INPUT_MUX(input) ((ADS1115::ADS1115_mux_config_t)(((input) & 0x07) << 4))
+#define ACQUISITION_INPUT_MAX ACQUISITION_INPUT(ACQUISITION_MAX_DEVICES - 1, ADS1115::MUX_3_GND)
+
+/* ADC interno do MCU como dispositivo extra; custa ~150 bytes de RAM (buffer duplo e escalonador) */
+// #define ACQUISITION_INTERNAL_ADC
+
+#ifdef ACQUISITION_INTERNAL_ADC
+#define ACQUISITION_DEVICE_COUNT (ACQUISITION_MAX_DEVICES + 1u)
+#else
+#define ACQUISITION_DEVICE_COUNT ACQUISITION_MAX_DEVICES
+#endif
+
+/* Entrada do ADC interno do MCU, em free running: bit 7 + pino analógico */
+/* Ex.: ACQUISITION_INPUT_INTERNAL(0) = A0, referência AVcc, polarizado em AVcc/2 */
+#define ACQUISITION_INPUT_INTERNAL_FLAG (0x80)
+#define ACQUISITION_INPUT_INTERNAL(pin) ((uint8_t)(ACQUISITION_INPUT_INTERNAL_FLAG | (pin)))
+#define ACQUISITION_INPUT_INTERNAL_MAX ACQUISITION_INPUT_INTERNAL(INTERNAL_ADC_MAX_PIN)
+#define ACQUISITION_INPUT_PIN(input) ((uint8_t)((input) & 0x07))
+
+#define ACQUISITION_INPUT_IS_INTERNAL(input) (((input) & ACQUISITION_INPUT_INTERNAL_FLAG) != 0)
+#define ACQUISITION_INPUT_DEVICE(input) ((uint8_t)(ACQUISITION_INPUT_IS_INTERNAL(input) ? ACQUISITION_INTERNAL_DEVICE : (input) >> 3))
+#ifdef ACQUISITION_INTERNAL_ADC
+#define ACQUISITION_INPUT_VALID(input) ((input) <= ACQUISITION_INPUT_MAX || \
+										((input) >= ACQUISITION_INPUT_INTERNAL_FLAG && (input) <= ACQUISITION_INPUT_INTERNAL_MAX))
+#else
+#define ACQUISITION_INPUT_VALID(input) ((input) <= ACQUISITION_INPUT_MAX)
+#endif
+
+/* Entrada de tensão: mux simples (MUX_0_GND...MUX_3_GND) de um ADS1115 sem canais de corrente */
+/* Ex.: ACQUISITION_INPUT(1, ADS1115::MUX_0_GND) = A0 do ADS1115 em ADDR_VDD, polarizado em ~1V */
+#define ACQUISITION_INPUT_NONE (0xFFu)
+#define ACQUISITION_INPUT_SINGLE_ENDED(input) ((input) <= ACQUISITION_INPUT_MAX && ((input) & 0x04) != 0)
+
+/* O ADC interno termina a conversão em andamento com o canal anterior, e o S/H
+   precisa de mais uma para carregar com a nova impedância de fonte */
+#define ACQUISITION_INTERNAL_SETTLING_SAMPLES (2u)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+class Acquisition
+{
+public:
+	uint8_t addChannel(uint8_t input, ADS1115::ADS1115_gain_t gain = ACQUISITION_DEFAULT_GAIN);
+
+	/* Canal definido em tempo de compilação, ver ADS1115Channel */
+	template <class CHANNEL>
+	uint8_t addChannel(void)
+	{
+		static_assert(CHANNEL::rate == ACQUISITION_RATE, "ADS1115 channels share ACQUISITION_RATE");
+		static_assert(CHANNEL::address - ADS1115::ADDR_GND < ACQUISITION_MAX_DEVICES, "ADS1115 address out of range");
+		return this->addChannel(ACQUISITION_INPUT(CHANNEL::address - ADS1115::ADDR_GND, CHANNEL::mux), CHANNEL::gain);
+	}
+	bool setVoltageInput(uint8_t input, ADS1115::ADS1115_gain_t gain = ACQUISITION_DEFAULT_GAIN);
+	void begin(void);
+
+	bool read(uint8_t channel, int16_t *sample, int16_t *voltage = NULL);
+	void release(uint8_t channel, uint16_t samplesUsed);
+
+	uint8_t getChannelCount(void) { return this->channelCount; }
+	bool isScheduled(uint8_t channel) { return channel < this->channelCount && this->devices[this->deviceOf(channel)].activeChannel == channel; }
+	uint8_t getInput(uint8_t channel) { return (channel < this->channelCount) ? this->channels[channel].input : 0; }
+	float getSampleRate(uint8_t channel) { return (channel < this->channelCount) ? this->channels[channel].sampleRate : 0; }
+	float getConversionRate(uint8_t channel);
+	float getLsbMillivolts(uint8_t channel);
+	uint16_t getOverrunCount(void);
+
+	/* Tensão: amostra da mesma passada da ISR, apenas nos canais do dispositivo pareado */
+	uint8_t getVoltageInput(void) { return this->voltageInput; }
+	bool hasVoltage(uint8_t channel) { return channel < this->channelCount && this->deviceOf(channel) == this->pairedDevice; }
+	float getVoltageLsbMillivolts(void) { return ADS1115::lsbMillivolts((ADS1115::ADS1115_gain_t)this->voltageGain); }
+
+private:
+	/*************************************************************************************
+	* Private struct
+	*************************************************************************************/
+	struct Channel
+	{
+		uint8_t input;
+		uint8_t gain; /* ADS1115_gain_t do canal, reescrito junto com o mux; enum ocupa 2 bytes no AVR */
+		uint32_t lastReleaseMicros;
+		float sampleRate; /* Amostras úteis por segundo, incluindo o tempo morto */
+	};
+
+	/* Cada dispositivo converte em paralelo e reveza apenas os seus canais */
+	/* Estado do escalonador; o conversor em si fica em 'ads' ou 'internalAdc' */
+	struct Device
+	{
+		uint8_t activeChannel = 0;
+		uint8_t settleCount = 0;
+		bool running = false;
+
+		/* Taxa real de conversão, medida entre duas marcas do RDY na mesma janela */
+		uint16_t stampCount = 0;
+		uint32_t stampMicros = 0;
+		float conversionRate = 0;
+	};
+
+	void select(uint8_t device, uint8_t channel);
+	uint8_t nextChannel(uint8_t channel);
+	uint8_t deviceOf(uint8_t channel) { return ACQUISITION_INPUT_DEVICE(this->channels[channel].input); }
+
+	/* Acesso ao conversor do dispositivo: ADS1115 ou ADC interno */
+	bool fetch(uint8_t device, int16_t *sample, int16_t *voltage);
+	void alignVoltage(void);
+	void getConversionStamp(uint8_t device, uint16_t *count, uint32_t *micros);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	Device devices[ACQUISITION_DEVICE_COUNT];
+	ADS1115 ads[ACQUISITION_MAX_DEVICES];
+	ADS1115::ADS1115_config_t config[ACQUISITION_MAX_DEVICES];
+#ifdef ACQUISITION_INTERNAL_ADC
+	InternalADC internalAdc;
+#endif
+	Channel channels[ACQUISITION_MAX_CHANNELS];
+	uint8_t channelCount = 0;
+
+	/* Entrada de tensão e o dispositivo de corrente lido junto com ela (o que cadencia o RDY) */
+	uint8_t voltageInput = ACQUISITION_INPUT_NONE;
+	uint8_t voltageGain = ACQUISITION_DEFAULT_GAIN; /* ADS1115_gain_t */
+	uint8_t pairedDevice = ACQUISITION_MAX_DEVICES; /* Nenhum */
+
+	/* ADS1115 cujo ALERT/RDY vai ao ADS1115_RDY_PIN: o único com taxa própria */
+	uint8_t pacingDevice = ACQUISITION_MAX_DEVICES; /* Nenhum */
+};
+
+#endif /* _ACQUISITION_H_ */
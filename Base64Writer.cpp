@@ -0,0 +1,76 @@
+/** @file Base64Writer.cpp
+ *  @brief Functions related with the streaming base64 encoder.
+ */
+#include "Base64Writer.h"
+
+static const char base64Table[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*******************************************************************************
+   begin
+****************************************************************************/
+/**
+ * @brief Starts a new encoded block.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Base64Writer::begin(void)
+{
+    this->groupLength = 0;
+    this->written = 0;
+}
+
+/*******************************************************************************
+   write
+****************************************************************************/
+/**
+ * @brief Adds one byte; every 3 bytes, 4 characters are written.
+ * @param data Byte.
+ * @return void
+*******************************************************************************/
+void Base64Writer::write(uint8_t data)
+{
+    this->group[this->groupLength++] = data;
+    if (this->groupLength == 3)
+        this->flush(3);
+}
+
+/*******************************************************************************
+   end
+****************************************************************************/
+/**
+ * @brief Writes the last characters, with the padding.
+ * @param void
+ * @return Characters written since begin(): BASE64_SIZE() of the bytes.
+*******************************************************************************/
+size_t Base64Writer::end(void)
+{
+    if (this->groupLength)
+    {
+        uint8_t length = this->groupLength;
+        while (this->groupLength < 3)
+            this->group[this->groupLength++] = 0;
+        this->flush(length);
+    }
+
+    return this->written;
+}
+
+/*******************************************************************************
+   flush
+****************************************************************************/
+/**
+ * @brief Writes the group of 3 bytes as 4 characters.
+ * @param length Bytes of the group in use: with less than 3, the missing
+ *        characters are written as '='.
+ * @return void
+*******************************************************************************/
+void Base64Writer::flush(uint8_t length)
+{
+    /* 1 byte: 2 caracteres + "=="; 2 bytes: 3 caracteres + "=" */
+    uint32_t bits = ((uint32_t)this->group[0] << 16) | ((uint16_t)this->group[1] << 8) | this->group[2];
+    for (uint8_t i = 0; i < 4; i++)
+        this->out.write(i <= length ? pgm_read_byte(&base64Table[(bits >> (18 - 6 * i)) & 0x3F]) : '=');
+
+    this->written += 4;
+    this->groupLength = 0;
+}
@@ -0,0 +1,43 @@
+/** @file Base64Writer.h
+ *  @brief Header to the streaming base64 encoder.
+ */
+
+#ifndef _BASE64_WRITER_H_
+#define _BASE64_WRITER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define BASE64_SIZE(size) (4u * (((size) + 2u) / 3u))
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Codifica em base64 enquanto escreve: a cada 3 bytes, 4 caracteres no 'out' */
+class Base64Writer
+{
+public:
+	Base64Writer(Print &out) : out(out) {}
+
+	void begin(void);
+	void write(uint8_t data);
+	size_t end(void);
+
+private:
+	void flush(uint8_t length);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	Print &out;
+	uint8_t group[3]; /* Bytes aguardando o grupo de 4 caracteres */
+	uint8_t groupLength = 0;
+	size_t written = 0; /* Caracteres escritos */
+};
+
+#endif /* _BASE64_WRITER_H_ */
@@ -0,0 +1,265 @@
+/** @file BufferedSerial.cpp
+ *  @brief Functions related with the USART0, with a receive buffer filled by interrupt.
+ */
+#include "BufferedSerial.h"
+
+/*******************************************************************************
+   begin
+****************************************************************************/
+/**
+ * @brief Starts the USART0 in 8N1 with the receive interrupt enabled.
+ * @param baud Baud rate.
+ * @return void
+*******************************************************************************/
+void BufferedSerial::begin(uint32_t baud)
+{
+    /* Velocidade dupla (U2X): mesmo cálculo do core do Arduino */
+    uint16_t setting = (F_CPU / 4 / baud - 1) / 2;
+
+    noInterrupts();
+    instance = this;
+    this->rx.clear();
+
+    UCSR0A = _BV(U2X0);
+    UBRR0H = setting >> 8;
+    UBRR0L = setting & 0xFF;
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+    interrupts();
+}
+
+/*******************************************************************************
+   end
+****************************************************************************/
+/**
+ * @brief Waits for the transmission and stops the USART0.
+ * @param void
+ * @return void
+*******************************************************************************/
+void BufferedSerial::end(void)
+{
+    this->flush();
+
+    noInterrupts();
+    UCSR0B = 0;
+    if (instance == this)
+        instance = NULL;
+    interrupts();
+}
+
+/*******************************************************************************
+   setFlowControl
+****************************************************************************/
+/**
+ * @brief Enables the RTS output: it asks the transmitter to pause when the
+ *        buffer is almost full, and to resume once half of it was read.
+ *
+ * The module must honor it on its CTS input (ESP8266: AT+UART_CUR, GPIO13).
+ * @param rtsPin Output pin, or BUFFERED_SERIAL_NO_PIN to disable.
+ * @return void
+*******************************************************************************/
+void BufferedSerial::setFlowControl(uint8_t rtsPin)
+{
+    noInterrupts();
+    this->rtsPin = rtsPin;
+    this->rtsStopped = false;
+    interrupts();
+
+    if (rtsPin == BUFFERED_SERIAL_NO_PIN)
+        return;
+
+    digitalWrite(rtsPin, LOW);
+    pinMode(rtsPin, OUTPUT);
+}
+
+/*******************************************************************************
+   available
+****************************************************************************/
+/**
+ * @brief Gets the number of bytes received and not read yet.
+ * @param void
+ * @return Bytes in the buffer.
+*******************************************************************************/
+int BufferedSerial::available(void)
+{
+    return this->rx.count();
+}
+
+/*******************************************************************************
+   read
+****************************************************************************/
+/**
+ * @brief Gets the next byte received.
+ * @param void
+ * @return The byte, or -1 if the buffer is empty.
+*******************************************************************************/
+int BufferedSerial::read(void)
+{
+    uint8_t data;
+    if (!this->rx.pop(&data))
+        return -1;
+
+    /* Espaço liberado: retoma a transmissão */
+    if (this->rtsStopped)
+    {
+        noInterrupts();
+        if (this->rtsStopped && this->rx.count() <= BUFFERED_SERIAL_RTS_RESUME)
+        {
+            digitalWrite(this->rtsPin, LOW);
+            this->rtsStopped = false;
+        }
+        interrupts();
+    }
+
+    return data;
+}
+
+/*******************************************************************************
+   peek
+****************************************************************************/
+/**
+ * @brief Gets the next byte received, without removing it.
+ * @param void
+ * @return The byte, or -1 if the buffer is empty.
+*******************************************************************************/
+int BufferedSerial::peek(void)
+{
+    uint8_t *data = this->rx.peek();
+    return data ? *data : -1;
+}
+
+/*******************************************************************************
+   flush
+****************************************************************************/
+/**
+ * @brief Waits until the last byte written leaves the USART.
+ * @param void
+ * @return void
+*******************************************************************************/
+void BufferedSerial::flush(void)
+{
+    if (!this->transmitting)
+        return;
+
+    while (!(UCSR0A & _BV(TXC0)))
+        ;
+    this->transmitting = false;
+}
+
+/*******************************************************************************
+   write
+****************************************************************************/
+/**
+ * @brief Writes a byte, waiting for room in the USART.
+ * @param data Byte to write.
+ * @return 1.
+*******************************************************************************/
+size_t BufferedSerial::write(uint8_t data)
+{
+    while (!(UCSR0A & _BV(UDRE0)))
+        ;
+
+    /* TXC é limpo escrevendo 1; U2X mantido */
+    UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+    UDR0 = data;
+    this->transmitting = true;
+    this->writeCount++;
+    return 1;
+}
+
+/*******************************************************************************
+   getOverflowCount
+****************************************************************************/
+/**
+ * @brief Gets the bytes lost since begin(): received with the buffer full,
+ *        or overwritten in the USART before the interrupt ran.
+ * @param void
+ * @return Lost bytes.
+*******************************************************************************/
+uint16_t BufferedSerial::getOverflowCount(void)
+{
+    noInterrupts();
+    uint16_t count = this->overflowCount;
+    interrupts();
+    return count;
+}
+
+/*******************************************************************************
+   getFramingErrorCount
+****************************************************************************/
+/**
+ * @brief Gets the bytes received without a valid stop bit: a sign that
+ *        both ends are not at the same rate.
+ * @param void
+ * @return Framing errors.
+*******************************************************************************/
+uint16_t BufferedSerial::getFramingErrorCount(void)
+{
+    noInterrupts();
+    uint16_t count = this->framingCount;
+    interrupts();
+    return count;
+}
+
+/*******************************************************************************
+   receiveHandler
+****************************************************************************/
+/**
+ * @brief Dispatches the receive interrupt to the active instance.
+ * @param void
+ * @return void
+*******************************************************************************/
+void BufferedSerial::receiveHandler(void)
+{
+    if (instance != NULL)
+        instance->onReceive();
+    else
+        (void)UDR0;
+}
+
+/*******************************************************************************
+   onReceive
+****************************************************************************/
+/**
+ * @brief Stores one received byte. Runs in interrupt context.
+ * @param void
+ * @return void
+*******************************************************************************/
+void BufferedSerial::onReceive(void)
+{
+    /* Estado do byte lido a seguir: antes do UDR0 */
+    /* Overrun: a USART perdeu um byte antes deste; quadro: sem stop bit */
+    uint8_t status = UCSR0A;
+    if (status & _BV(DOR0))
+        this->overflowCount++;
+    if (status & _BV(FE0))
+        this->framingCount++;
+
+    uint8_t data = UDR0;
+    if (!this->rx.push(data))
+    {
+        this->overflowCount++;
+        return;
+    }
+
+    uint8_t count = this->rx.count();
+    if (count > this->highWater)
+        this->highWater = count;
+
+    /* Buffer quase cheio: pede pausa ao transmissor */
+    if (count >= BUFFERED_SERIAL_RTS_STOP && this->rtsPin != BUFFERED_SERIAL_NO_PIN && !this->rtsStopped)
+    {
+        digitalWrite(this->rtsPin, HIGH);
+        this->rtsStopped = true;
+    }
+}
+
+/*******************************************************************************
+   ISR
+****************************************************************************/
+BufferedSerial *BufferedSerial::instance = NULL;
+
+ISR(USART_RX_vect)
+{
+    BufferedSerial::receiveHandler();
+}
@@ -0,0 +1,66 @@
+/** @file BufferedSerial.h
+ *  @brief Header to the USART0 driver with a receive buffer filled by interrupt.
+ */
+
+#ifndef _BUFFERED_SERIAL_H_
+#define _BUFFERED_SERIAL_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+#include "RingBuffer.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define BUFFERED_SERIAL_RX_SIZE (128u) /* Potência de 2, até 128; com RTS, para o módulo a 16 bytes do fim */
+#define BUFFERED_SERIAL_RTS_STOP (BUFFERED_SERIAL_RX_SIZE - 16u) /* Folga para o transmissor parar */
+#define BUFFERED_SERIAL_RTS_RESUME (BUFFERED_SERIAL_RX_SIZE / 2u)
+#define BUFFERED_SERIAL_NO_PIN (0xFF)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Substitui o 'Serial' do core: sem referências a ele, a ISR da USART0 é desta classe */
+class BufferedSerial : public Stream
+{
+public:
+	void begin(uint32_t baud);
+	void end(void);
+	void setFlowControl(uint8_t rtsPin);
+
+	int available(void);
+	int read(void);
+	int peek(void);
+	void flush(void);
+	size_t write(uint8_t data);
+	using Print::write;
+
+	uint16_t getOverflowCount(void);
+	uint16_t getFramingErrorCount(void);
+	uint8_t getHighWater(void) { return this->highWater; }
+	uint32_t getWriteCount(void) { return this->writeCount; }
+
+	static void receiveHandler(void);
+
+private:
+	void onReceive(void);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	static BufferedSerial *instance;
+
+	RingBuffer<uint8_t, BUFFERED_SERIAL_RX_SIZE> rx;
+	uint8_t rtsPin = BUFFERED_SERIAL_NO_PIN; /* Ativo em nível baixo: pronto para receber */
+	volatile bool rtsStopped = false;
+	bool transmitting = false;
+	uint32_t writeCount = 0; /* Bytes escritos desde o início */
+
+	volatile uint16_t overflowCount = 0; /* Bytes perdidos: buffer cheio ou overrun da USART */
+	volatile uint16_t framingCount = 0;	 /* Bytes sem stop bit: taxa diferente da do transmissor */
+	volatile uint8_t highWater = 0;		 /* Maior ocupação do buffer */
+};
+
+#endif /* _BUFFERED_SERIAL_H_ */
@@ -2,16 +2,18 @@
  *  @brief Functions related with the ESP8266 WiFi module.
  */
 #include "ESP8266.h"
+#include <avr/wdt.h>
 
 /*******************************************************************************
    ESP8266
 ****************************************************************************/
 /**
- * @brief Constructor: set enable pin.
- * @param void
+ * @brief Constructor: set enable pin and the serial port of the module.
+ * @param pin Enable pin.
+ * @param serial Serial port connected to the module.
  * @return void
 *******************************************************************************/
-ESP8266::ESP8266(int pin)
+ESP8266::ESP8266(int pin, Stream &serial) : serial(serial)
 {
     enablePin = pin;
     return;
@@ -36,9 +38,9 @@ int ESP8266::getAPList(esp_AP_list_t *apList, int apList_size)
     memset(serialBuffer, 0, sizeof(serialBuffer));
 
     /* Obt�m lista de APs dispon�veis, separando os par�metros obtidos da lista */
-    serial_flush();
-    Serial.print(F("AT+CWLAP\r\n"));
-    serial_get("\r\n", ESP_MEDIUM_DELAY, serialBuffer, sizeof(serialBuffer));
+    this->flushResponses();
+    this->serial.print(F("AT+CWLAP\r\n"));
+    serial_get(F("\r\n"), ESP_MEDIUM_DELAY, serialBuffer, sizeof(serialBuffer));
     do
     {
         char *tkn = strtok(serialBuffer, "\"");
@@ -72,7 +74,7 @@ int ESP8266::getAPList(esp_AP_list_t *apList, int apList_size)
 
         /* Obt�m pr�xima rede */
         memset(serialBuffer, 0, sizeof(serialBuffer));
-        serial_get("\r\n", ESP_SHORT_DELAY, serialBuffer, sizeof(serialBuffer));
+        serial_get(F("\r\n"), ESP_SHORT_DELAY, serialBuffer, sizeof(serialBuffer));
 
     } while (true);
 
@@ -94,7 +96,7 @@ int ESP8266::getAPList(esp_AP_list_t *apList, int apList_size)
         }
     }
 
-    serial_flush();
+    this->flushResponses();
     return n_aps;
 }
 
@@ -108,30 +110,48 @@ int ESP8266::getAPList(esp_AP_list_t *apList, int apList_size)
 *******************************************************************************/
 uint32_t ESP8266::getUnixTimestamp(void)
 {
-    union Timestamp
-    {
-        uint8_t u8[4];
-        uint32_t u32;
-    };
-    Timestamp timestamp;
-
-    /* Conecta ao servidor */
-    serial_flush();
-    Serial.print(F("AT+CIPSTART=0,\"TCP\",\"time.nist.gov\",37\r\n"));
-    if (!serial_get("+IPD,0,4:", ESP_LONG_DELAY, NULL, 0))
+    esp_future_t future;
+    if (!this->requestUnixTimestamp(&future) || !this->wait(&future))
         return 0;
 
-    /* Obtém timestamp */
-    uint8_t buffer[4];
-    if (!Serial.readBytes(buffer, sizeof(buffer)))
-        return 0;
+    return this->lastUnixTimestamp();
+}
+
+/*******************************************************************************
+   requestUnixTimestamp
+****************************************************************************/
+/**
+ * @brief Queues the request of the unix timestamp (RFC 868, time.nist.gov).
+ * @param[out] future Result; when done, read it with lastUnixTimestamp().
+ * @return true if queued.
+*******************************************************************************/
+bool ESP8266::requestUnixTimestamp(esp_future_t *future)
+{
+    if (this->getQueueFree() < 2)
+        return false;
+
+    /* Conecta ao servidor (conexão ESP_TIMESTAMP_LINK) e lê os 4 bytes do seu conteúdo */
+    /* "OK" após "<link>,CONNECT": o CONNECT pode ser de uma conexão do servidor */
+    this->enqueue(F("AT+CIPSTART=3,\"TCP\",\"time.nist.gov\",37\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_LONG_DELAY,
+                  future, NULL, 0, ESP_FAIL_DEFAULT, ESP_TIMESTAMP_LINK);
+    return this->enqueue(NULL, NULL, NULL, NULL, ESP_MEDIUM_DELAY, future, this->timestampData, sizeof(this->timestampData),
+                         ESP_FAIL_CLOSED, ESP_TIMESTAMP_LINK);
+}
 
+/*******************************************************************************
+   lastUnixTimestamp
+****************************************************************************/
+/**
+ * @brief Converts the last timestamp received by requestUnixTimestamp().
+ * @param void.
+ * @return uint32_t timestamp.
+*******************************************************************************/
+uint32_t ESP8266::lastUnixTimestamp(void)
+{
     /* Converte para segundos UNIX */
-    timestamp.u8[3] = buffer[0];
-    timestamp.u8[2] = buffer[1];
-    timestamp.u8[1] = buffer[2];
-    timestamp.u8[0] = buffer[3];
-    return (timestamp.u32 - 2208988800ul);
+    uint32_t timestamp = ((uint32_t)this->timestampData[0] << 24) | ((uint32_t)this->timestampData[1] << 16) |
+                         ((uint32_t)this->timestampData[2] << 8) | this->timestampData[3];
+    return (timestamp - 2208988800ul);
 }
 
 /*******************************************************************************
@@ -146,20 +166,14 @@ uint32_t ESP8266::getUnixTimestamp(void)
 bool ESP8266::connect_ap(const esp_AP_parameter_t &ap)
 {
     /* AT: Desconecta do AP */
-    serial_flush();
-    Serial.print(F("AT+CWQAP\r\n"));
-    serial_get("OK\r\n", 500, NULL, 0);
+    esp_future_t future;
+    this->enqueue(F("AT+CWQAP\r\n"), NULL, NULL, ESP_OK_RESPONSE, 500, &future);
+    this->wait(&future);
     delay(500);
 
     /* AT: Connectar com AP */
-    serial_flush();
-    Serial.print(F("AT+CWJAP_DEF=\""));
-    Serial.print(ap.ssid);
-    Serial.print(F("\",\""));
-    Serial.print(ap.password);
-    Serial.print(F("\"\r\n"));
-
-    return serial_get("OK\r\n", ESP_LONG_DELAY, NULL, 0); /* timeout: 15s */
+    this->enqueue(NULL, writeJoin, &ap, ESP_OK_RESPONSE, ESP_LONG_DELAY, &future); /* timeout: 15s */
+    return this->wait(&future);
 }
 
 /*******************************************************************************
@@ -174,14 +188,9 @@ bool ESP8266::connect_ap(const esp_AP_parameter_t &ap)
 bool ESP8266::set_ap(const esp_AP_parameter_t &ap)
 {
     /* Configurar modo AP */
-    Serial.print(F("AT+CWSAP_DEF=\""));
-    Serial.print(ap.ssid);
-    Serial.print(F("\",\""));
-    Serial.print(ap.password);
-    Serial.print(F("\",6,0\r\n"));
-    
-    return serial_get("OK\r\n", ESP_LONG_DELAY, NULL, 0);
-
+    esp_future_t future;
+    this->enqueue(NULL, writeSoftAp, &ap, ESP_OK_RESPONSE, ESP_LONG_DELAY, &future);
+    return this->wait(&future);
 }
 
 /*******************************************************************************
@@ -197,10 +206,6 @@ bool ESP8266::config(void)
 {
     uint32_t delayMS = 250;
 
-    /* Inicializa serial em 57600 baud/s */
-    Serial.end();
-    Serial.begin(57600);
-
     /* Reset do módulo WiFi */
     ESP_DESATIVA;
     delay(delayMS);
@@ -209,50 +214,50 @@ bool ESP8266::config(void)
     /* Delay para inicialização */
     delay(ESP_MEDIUM_DELAY);
 
-    /* Remove mensagem de eco da serial */
-    Serial.print("ATE0\r\n");
-    delay(ESP_SHORT_DELAY);
-
-    /* Teste de sanidade do módulo ESP8266 */
-    /* Valor esperado: 'OK'. Timeout: 100ms. */
-    serial_flush();
-    Serial.print(F("AT\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
+    esp_future_t future;
+    bool ok = this->configure(&future) && this->wait(&future);
+    this->flushResponses();
+    return ok;
+}
+
+/**
+ * @brief Queues the configuration of a module just out of reset, at
+ *        ESP_BAUD_RATE; the first failure cancels the rest.
+ * @param future Result of the sequence.
+ * @return false if the queue has no room for it.
+*******************************************************************************/
+bool ESP8266::configure(esp_future_t *future)
+{
+    if (this->getQueueFree() < ESP_CONFIG_COMMANDS)
         return false;
 
+    /* Remove mensagem de eco da serial; também o teste de sanidade do módulo */
+    /* Valor esperado: 'OK', após o eco do próprio comando. Timeout: 100ms. */
+    this->enqueue(F("ATE0\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
+
+#ifdef ESP_FLOW_CONTROL
+    /* Módulo respeita o RTS do Arduino no seu CTS; 57600 8N1 */
+    this->enqueue(F("AT+UART_CUR=57600,8,1,0,2\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
+#endif
+
     /* Conexoes multiplas = TRUE */
-    Serial.print(F("AT+CIPMUX=1\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
+    this->enqueue(F("AT+CIPMUX=1\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 
     /* Define modo de operação */
     /* 1 = 'client' / 2 = 'server' / 3 = 'client' & 'server' */
-    Serial.print(F("AT+CWMODE=3\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
+    this->enqueue(F("AT+CWMODE=3\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 
     /* Tamanho do buffer SSL */
-    Serial.print(F("AT+CIPSSLSIZE=6144\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
+    this->enqueue(F("AT+CIPSSLSIZE=6144\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 
     /* Atualiza o DNS */
-    Serial.print(F("AT+CIPDNS_CUR=1,\"8.8.8.8\",\"1.1.1.1\"\r\n"));
-    if(!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
+    this->enqueue(F("AT+CIPDNS_CUR=1,\"8.8.8.8\",\"1.1.1.1\"\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 
     /* Atualiza nome do host na rede */
-    Serial.print(F("AT+CWHOSTNAME=\"ESP_WIFIWAFER\"\r\n"));
-    if(!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
+    this->enqueue(F("AT+CWHOSTNAME=\"ESP_WIFIWAFER\"\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 
     /* Inicializa modo AP */
-    Serial.print(F("AT+CIPAP=\"192.168.1.1\"\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
-        return false;
-
-    serial_flush();
-    return true;
+    return this->enqueue(F("AT+CIPAP=\"192.168.1.1\"\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 }
 
 /*******************************************************************************
@@ -265,16 +270,58 @@ bool ESP8266::config(void)
 *******************************************************************************/
 bool ESP8266::checkWifi(void)
 {
-    char strBuffer[100];
+    esp_future_t future;
+    return this->checkWifi(&future) && this->wait(&future);
+}
 
-    serial_flush();
-    Serial.print(F("AT+CWJAP_DEF?\r\n"));
-    serial_get("\r\n", ESP_SHORT_DELAY, strBuffer, sizeof(strBuffer));
+bool ESP8266::checkWifi(esp_future_t *future)
+{
+    /* Valor esperado: '+CWJAP_DEF:'; sem AP a resposta é 'No AP' */
+    return this->enqueue(F("AT+CWJAP_DEF?\r\n"), NULL, NULL, F("+CWJAP_DEF:"), ESP_SHORT_DELAY, future);
+}
 
-    if (strstr(strBuffer, "+CWJAP_DEF:")) // Valor esperado: '+CWJAP_DEF:'.
-        return true;
+/*******************************************************************************
+   setUartRate
+****************************************************************************/
+/**
+ * @brief Changes the UART rate of the module until its next reset
+ *        (AT+UART_CUR, 8N1; RTS/CTS with ESP_FLOW_CONTROL).
+ *
+ * The module answers at the current rate and switches right after: the
+ * serial of the Arduino must follow before the next command.
+ * @param baud New rate.
+ * @return true if the module accepted it.
+*******************************************************************************/
+bool ESP8266::setUartRate(uint32_t baud)
+{
+    esp_future_t future;
+    return this->setUartRate(baud, &future) && this->wait(&future);
+}
 
-    return false;
+bool ESP8266::setUartRate(uint32_t baud, esp_future_t *future)
+{
+    /* Uma mudança de taxa por vez: o comando lê a taxa ao ser escrito */
+    this->uartRate = baud;
+    return this->enqueue(NULL, writeUart, &this->uartRate, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
+}
+
+/*******************************************************************************
+   probe
+****************************************************************************/
+/**
+ * @brief Round trip through the UART: a short command, and a response of
+ *        some 150 bytes (AT+GMR).
+ * @return true if the whole response arrived within 100 ms.
+*******************************************************************************/
+bool ESP8266::probe(void)
+{
+    esp_future_t future;
+    return this->probe(&future) && this->wait(&future);
+}
+
+bool ESP8266::probe(esp_future_t *future)
+{
+    return this->enqueue(F("AT+GMR\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future);
 }
 
 /*******************************************************************************
@@ -289,13 +336,35 @@ bool ESP8266::checkWifi(void)
 *******************************************************************************/
 bool ESP8266::connect(const esp_URL_parameter_t &url)
 {
-    /* Conecta ao servidor */
-    serial_flush();
-    Serial.print(F("AT+CIPSTART=0,\"SSL\",\""));
-    Serial.print(url.host);
-    Serial.print(F("\",443\r\n"));
+    esp_future_t future;
+    return this->connect(url, &future) && this->wait(&future);
+}
+
+bool ESP8266::connect(const esp_URL_parameter_t &url, esp_future_t *future)
+{
+    return this->connect(url, ESP_CLIENT_PORT, true, future);
+}
+
+/**
+ * @brief Queues the connection with a host on another port, in TCP or SSL.
+ *
+ * Only one connection of the client link is queued at a time: the
+ * destination is kept until the command runs.
+ * @param url Host; must live until the command runs.
+ * @param port The port of the connection.
+ * @param ssl SSL if true, TCP if false.
+ * @param[out] future Result.
+ * @return true if queued.
+*******************************************************************************/
+bool ESP8266::connect(const esp_URL_parameter_t &url, uint16_t port, bool ssl, esp_future_t *future)
+{
+    this->connectUrl = &url;
+    this->connectPort = port;
+    this->connectSsl = ssl;
 
-    return serial_get("CONNECT\r\n", ESP_LONG_DELAY, NULL, 0); // Valor esperado: 'CONNECT'. Timeout: 15s.
+    /* Valor esperado: 'OK', após '<link>,CONNECT'. Timeout: 15s. */
+    return this->enqueue(NULL, writeConnect, this, ESP_OK_RESPONSE, ESP_LONG_DELAY, future, NULL, 0, ESP_FAIL_DEFAULT,
+                         ESP_CLIENT_LINK);
 }
 
 /*******************************************************************************
@@ -308,17 +377,20 @@ bool ESP8266::connect(const esp_URL_parameter_t &url)
 *******************************************************************************/
 bool ESP8266::server_start()
 {
-    /* Inicializar AP */
-    Serial.print(F("AT+CIPSERVER=1,80\r\n"));
-    if (!serial_get("OK\r\n", ESP_MEDIUM_DELAY, NULL, 0))
-        return false;
+    esp_future_t future;
+    return this->server_start(&future) && this->wait(&future);
+}
 
-    /* Obtem endereço IP */
-    Serial.print(F("AT+CIFSR\r\n"));
-    if (!serial_get("OK\r\n", ESP_MEDIUM_DELAY, NULL, 0))
+bool ESP8266::server_start(esp_future_t *future)
+{
+    if (this->getQueueFree() < 2)
         return false;
 
-    return true;
+    /* Inicializar AP */
+    this->enqueue(F("AT+CIPSERVER=1,80\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_MEDIUM_DELAY, future);
+
+    /* Obtem endereço IP */
+    return this->enqueue(F("AT+CIFSR\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_MEDIUM_DELAY, future);
 }
 
 /*******************************************************************************
@@ -331,12 +403,14 @@ bool ESP8266::server_start()
 *******************************************************************************/
 bool ESP8266::server_stop()
 {
-    /* Inicializar AP */
-    Serial.print(F("AT+CIPSERVER=0\r\n"));
-    if (!serial_get("OK\r\n", ESP_MEDIUM_DELAY, NULL, 0))
-        return false;
+    esp_future_t future;
+    return this->server_stop(&future) && this->wait(&future);
+}
 
-    return true;
+bool ESP8266::server_stop(esp_future_t *future)
+{
+    /* Inicializar AP */
+    return this->enqueue(F("AT+CIPSERVER=0\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_MEDIUM_DELAY, future);
 }
 
 /*******************************************************************************
@@ -350,12 +424,80 @@ bool ESP8266::server_stop()
 *******************************************************************************/
 bool ESP8266::close(uint8_t connection)
 {
-    serial_flush();
-    Serial.print("AT+CIPCLOSE=");
-    Serial.print(connection);
-    Serial.print("\r\n");
+    esp_future_t future;
+    return this->close(connection, &future) && this->wait(&future);
+}
+
+bool ESP8266::close(uint8_t connection, esp_future_t *future)
+{
+    /* Valor esperado: 'OK', após '<link>,CLOSED'. Timeout: 100ms. */
+    return this->enqueue(NULL, writeClose, (const void *)(uintptr_t)connection, ESP_OK_RESPONSE, ESP_SHORT_DELAY, future,
+                         NULL, 0, ESP_FAIL_ERROR);
+}
+
+/*******************************************************************************
+   send
+****************************************************************************/
+/**
+ * @brief Queues the sending of data through a connection (AT+CIPSENDEX).
+ *
+ * The writer runs once the module prompts with '>'; the data is terminated
+ * with "\0" by this function.
+ * @param connection Link ID.
+ * @param writer Writes the data.
+ * @param context Argument of the writer; must live until it runs.
+ * @param expect Response awaited in the content of the connection after
+ *        "SEND OK", in flash (F()), or NULL.
+ * @param timeout Timeout of that response, in ms.
+ * @param[out] future Result of the whole sequence.
+ * @return true if queued.
+*******************************************************************************/
+bool ESP8266::send(uint8_t connection, esp_writer_t writer, const void *context, const __FlashStringHelper *expect, uint16_t timeout, esp_future_t *future)
+{
+    if (this->getQueueFree() < (expect ? 3 : 2))
+        return false;
+
+    /* "CLOSED" não é falha: com o servidor ativo, pode ser de outra conexão */
+    /* AT: Aguarda '>'; descarta o conteúdo antigo da conexão */
+    this->enqueue(NULL, writeSend, (const void *)(uintptr_t)connection, F(">"), ESP_SHORT_DELAY, future, NULL, 0,
+                  ESP_FAIL_DEFAULT, connection);
+
+    /* Conteúdo, seguido do fim do envio */
+    this->enqueue(F("\\0"), writer, context, F("SEND OK\r\n"), ESP_MEDIUM_DELAY, future);
+
+    /* Resposta do servidor, no conteúdo da conexão */
+    if (expect)
+        this->enqueue(NULL, NULL, NULL, expect, timeout, future, NULL, 0, ESP_FAIL_CLOSED, connection);
+
+    return true;
+}
+
+/**
+ * @brief Queues the sending of binary data of a known length (AT+CIPSEND).
+ *
+ * No terminator is written: the data may hold any byte, and the writer must
+ * write exactly 'length' bytes. The content already received through the
+ * connection is kept, to be read by the caller with receive(link).
+ * @param connection Link ID.
+ * @param length Bytes written by the writer, up to 2048.
+ * @param writer Writes the data.
+ * @param context Argument of the writer; must live until it runs.
+ * @param[out] future Result of the whole sequence.
+ * @return true if queued.
+*******************************************************************************/
+bool ESP8266::send(uint8_t connection, uint16_t length, esp_writer_t writer, const void *context, esp_future_t *future)
+{
+    if (length == 0 || length > 2048 || this->getQueueFree() < 2)
+        return false;
+
+    /* AT: Aguarda '>'; conexão e tamanho no contexto, 3 + 12 bits */
+    this->enqueue(NULL, writeSendLength, (const void *)(uintptr_t)(((uint16_t)length << 3) | connection), F(">"),
+                  ESP_SHORT_DELAY, future);
 
-    return serial_get("CLOSED\r\n", ESP_SHORT_DELAY, NULL, 0); // Valor esperado: "CLOSED". Timeout: 100ms.
+    /* Conteúdo: o módulo envia ao completar 'length' bytes */
+    this->enqueue(NULL, writer, context, F("SEND OK\r\n"), ESP_MEDIUM_DELAY, future);
+
+    return true;
 }
 
 /*******************************************************************************
@@ -370,9 +512,9 @@ void ESP8266::sleep()
 {
     /* Entra em soft-sleep */
     /* Caso n�o aceite comando, for�a pino de reset */
-    serial_flush();
-    Serial.print(F("AT+GSLP=0\r\n"));
-    if (!serial_get("OK\r\n", ESP_SHORT_DELAY, NULL, 0))
+    esp_future_t future;
+    this->enqueue(F("AT+GSLP=0\r\n"), NULL, NULL, ESP_OK_RESPONSE, ESP_SHORT_DELAY, &future);
+    if (!this->wait(&future))
         ESP_DESATIVA;
 }
 
@@ -392,6 +534,685 @@ void ESP8266::wakeup()
     delay(250);
 
     /* Remove mensagem de eco da serial */
-    Serial.print(F("ATE0\r\n"));
+    this->serial.print(F("ATE0\r\n"));
     delay(50);
 }
+
+/*******************************************************************************
+   enqueue
+****************************************************************************/
+/**
+ * @brief Queues an AT command. Never blocks; poll() runs it.
+ *
+ * Commands queued with the same future form a sequence: the future is done
+ * when all of them succeed, and the first failure cancels the rest.
+ * @param command Fixed command, or NULL. With a writer, it is written after
+ *        it, as a terminator.
+ * @param writer Command with parameters, or NULL. Nothing is written if both
+ *        are NULL: the command only waits for 'expect'.
+ * @param context Argument of the writer; must live until it runs.
+ * @param expect Response that completes the command, in flash (F()); NULL
+ *        completes it as soon as it is written.
+ * @param timeout Timeout of the response, in ms.
+ * @param[out] future Result, or NULL if ignored.
+ * @param[out] data Buffer for the bytes that follow 'expect', or NULL.
+ * @param dataSize Bytes to read into 'data'.
+ * @param failures Responses that fail the command at once, ESP_FAIL_*.
+ * @param link Connection of the command, or ESP_NO_LINK. A command bound to a
+ *        connection that writes nothing reads 'expect' and 'data' from the
+ *        content of that connection; ESP_FAIL_CLOSED then fails it when the
+ *        connection closes.
+ * @return true if queued.\n
+           false if the queue is full.
+*******************************************************************************/
+bool ESP8266::enqueue(const __FlashStringHelper *command, esp_writer_t writer, const void *context, const __FlashStringHelper *expect,
+                      uint16_t timeout, esp_future_t *future, uint8_t *data, uint8_t dataSize, uint8_t failures,
+                      uint8_t link)
+{
+    if (this->queueCount >= ESP_QUEUE_SIZE)
+        return false;
+
+    esp_command_t *entry = &this->queue[(this->queueHead + this->queueCount) % ESP_QUEUE_SIZE];
+    entry->command = command;
+    entry->writer = writer;
+    entry->context = context;
+    entry->expect = expect;
+    entry->timeout = timeout;
+    entry->data = data;
+    entry->dataSize = data ? dataSize : 0;
+    entry->failures = failures;
+    entry->link = link;
+    entry->future = future;
+    this->queueCount++;
+
+    /* Primeiro comando da sequência */
+    if (future != NULL)
+    {
+        if (future->remaining++ == 0)
+            future->status = ESP_PENDING;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+   poll
+****************************************************************************/
+/**
+ * @brief Advances the AT command state machine. Call it from loop().
+ *
+ * Consumes only the bytes already received and returns; a command that is
+ * still waiting keeps its state for the next call. While the serial is
+ * stalled on a full connection, it returns so that loop() lets the reader of
+ * that connection empty it; the timeout of the command is paused meanwhile.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ESP8266::poll(void)
+{
+    /* Sem comandos, as respostas AT recebidas não têm destino */
+    if (this->queueCount == 0)
+        this->flushResponses();
+
+    while (this->queueCount)
+    {
+        esp_command_t *command = &this->queue[this->queueHead];
+
+        /* Próximo comando da fila */
+        if (this->state == ESP_STATE_IDLE)
+        {
+            /* Sequência cancelada por uma falha anterior */
+            if (command->future != NULL && command->future->status != ESP_PENDING)
+            {
+                this->complete(command->future->status);
+                continue;
+            }
+
+            this->start(command);
+            if (command->expect == NULL && command->dataSize == 0)
+            {
+                this->complete(ESP_DONE);
+                continue;
+            }
+        }
+
+        /* Bytes já recebidos: do conteúdo da conexão, ou das respostas AT */
+        bool readsLink = this->readsLink(command);
+        int16_t received;
+        while (this->state != ESP_STATE_IDLE && (received = readsLink ? this->receive(command->link) : this->receive()) >= 0)
+        {
+            if (this->state == ESP_STATE_DATA)
+            {
+                command->data[this->dataCount++] = (uint8_t)received;
+                if (this->dataCount == command->dataSize)
+                    this->complete(ESP_DONE);
+            }
+            else
+            {
+                /* Índice 0: resposta esperada; os demais: falhas */
+                uint8_t matched = this->matcher.feed((char)received);
+                if (matched == 0 && command->dataSize)
+                    this->state = ESP_STATE_DATA;
+                else if (matched == 0)
+                    this->complete(ESP_DONE);
+                else if (matched != RESPONSE_MATCHER_NONE)
+                    this->complete(ESP_FAILED);
+            }
+        }
+
+        /* Conexão encerrada com o conteúdo já lido */
+        if (this->state != ESP_STATE_IDLE && readsLink && (command->failures & ESP_FAIL_CLOSED) &&
+            this->isClosed(command->link))
+        {
+            this->complete(ESP_FAILED);
+            continue;
+        }
+
+        /* Aguardando resposta */
+        if (this->state != ESP_STATE_IDLE)
+        {
+            /* Serial parada numa conexão cheia: o tempo até seus leitores a esvaziarem não conta */
+            uint8_t blocked;
+            uint32_t now = millis();
+            if (this->isBlocked(&blocked) && blocked != ESP_NO_LINK)
+                this->startMillis += now - this->pollMillis;
+            this->pollMillis = now;
+
+            if (now - this->startMillis > command->timeout)
+                this->complete(ESP_TIMEOUT);
+            else
+                return;
+        }
+    }
+}
+
+/*******************************************************************************
+   wait
+****************************************************************************/
+/**
+ * @brief Runs the queue until the future completes. Blocking, like the
+ *        former synchronous driver; for setup().
+ * @param future Result to wait for.
+ * @return true if it completed successfully.
+*******************************************************************************/
+bool ESP8266::wait(esp_future_t *future)
+{
+    /* Só retorna sem comandos na fila apontando para 'future' */
+    while (future->isPending() || future->remaining)
+    {
+        this->poll();
+
+        /* Atualiza watchdog */
+        wdt_reset();
+    }
+
+    return future->isDone();
+}
+
+/*******************************************************************************
+   start
+****************************************************************************/
+/**
+ * @brief Writes the command at the head of the queue.
+ * @param command Command to start.
+ * @return void
+*******************************************************************************/
+void ESP8266::start(esp_command_t *command)
+{
+    /* Descarta respostas antigas antes de um novo comando; na sua conexão, também o conteúdo */
+    if (command->command != NULL || command->writer != NULL)
+    {
+        this->flushResponses();
+        if (command->link < ESP_MAX_LINKS)
+        {
+            this->links[command->link].clear();
+            this->discardLinks &= ~_BV(command->link);
+            this->closedLinks &= ~_BV(command->link);
+        }
+    }
+
+    if (command->writer != NULL)
+        command->writer(this->serial, command->context);
+    if (command->command != NULL)
+        this->serial.print(command->command);
+
+    /* Resposta esperada e falhas aguardadas em paralelo */
+    /* No conteúdo de uma conexão, apenas a esperada: o encerramento vem como evento */
+    this->matcher.clear();
+    if (command->expect != NULL)
+        this->matcher.add(command->expect);
+    if (!this->readsLink(command))
+    {
+        if (command->failures & ESP_FAIL_ERROR)
+            this->matcher.add(ESP_ERROR_RESPONSE);
+        if (command->failures & ESP_FAIL_FAIL)
+            this->matcher.add(ESP_FAIL_RESPONSE);
+        if (command->failures & ESP_FAIL_BUSY)
+            this->matcher.add(ESP_BUSY_RESPONSE);
+        if (command->failures & ESP_FAIL_CLOSED)
+            this->matcher.add(ESP_CLOSED_RESPONSE);
+    }
+
+    /* Sem resposta esperada, lê os dados direto */
+    this->dataCount = 0;
+    this->startMillis = millis();
+    this->pollMillis = this->startMillis;
+    this->answered = false;
+    this->state = (command->expect == NULL) ? ESP_STATE_DATA : ESP_STATE_WAITING;
+}
+
+/*******************************************************************************
+   complete
+****************************************************************************/
+/**
+ * @brief Removes the command at the head of the queue and updates its future.
+ * @param status Result of the command.
+ * @return void
+*******************************************************************************/
+void ESP8266::complete(esp_status_t status)
+{
+    esp_command_t *command = &this->queue[this->queueHead];
+    esp_future_t *future = command->future;
+
+    /* Resposta obtida: o restante do conteúdo da conexão não tem destino */
+    if (status == ESP_DONE && this->readsLink(command))
+        this->discard(command->link);
+
+    /* Nenhum byte do módulo durante o comando: a serial pode ter perdido a taxa */
+    /* Qualquer resposta, mesmo ERROR, "No AP" ou uma incompleta, mostra que a taxa está certa */
+    if (this->answered || status != ESP_TIMEOUT)
+        this->timeoutStreak = 0;
+    else if (!this->readsLink(command) && this->timeoutStreak < 0xFF)
+        this->timeoutStreak++;
+
+    this->queueHead = (this->queueHead + 1) % ESP_QUEUE_SIZE;
+    this->queueCount--;
+    this->state = ESP_STATE_IDLE;
+
+    if (future == NULL)
+        return;
+
+    if (--future->remaining == 0 && future->status == ESP_PENDING)
+        future->status = status;
+
+    if (status == ESP_DONE)
+        return;
+
+    /* Falha: cancela os demais comandos da sequência */
+    if (future->status == ESP_PENDING)
+        future->status = status;
+    while (this->queueCount && this->queue[this->queueHead].future == future)
+    {
+        this->queueHead = (this->queueHead + 1) % ESP_QUEUE_SIZE;
+        this->queueCount--;
+        future->remaining--;
+    }
+}
+
+/*******************************************************************************
+   readsLink
+****************************************************************************/
+/**
+ * @brief Checks if the command reads the content of its connection.
+ * @param command Command to check.
+ * @return true if it is bound to a connection and writes nothing.
+*******************************************************************************/
+bool ESP8266::readsLink(const esp_command_t *command)
+{
+    return command->link < ESP_MAX_LINKS && command->command == NULL && command->writer == NULL;
+}
+
+/*******************************************************************************
+   receive
+****************************************************************************/
+/**
+ * @brief Gets the next byte of the AT responses.
+ *
+ * The content of "+IPD" frames never shows up here: it goes to the buffer of
+ * its connection.
+ * @param void
+ * @return The byte, or -1 if none was received.
+*******************************************************************************/
+int16_t ESP8266::receive(void)
+{
+    uint8_t received;
+
+    this->pump(ESP_NO_LINK);
+    if (!this->responses.pop(&received))
+        return -1;
+    return received;
+}
+
+/**
+ * @brief Gets the next byte received by a connection.
+ * @param link Connection.
+ * @return The byte, or -1 if none was received.
+*******************************************************************************/
+int16_t ESP8266::receive(uint8_t link)
+{
+    uint8_t received;
+
+    this->pump(link);
+    if (link >= ESP_MAX_LINKS || !this->links[link].pop(&received))
+        return -1;
+    return received;
+}
+
+/*******************************************************************************
+   getPendingLink
+****************************************************************************/
+/**
+ * @brief Gets the first connection with received content.
+ * @param void
+ * @return The connection, or ESP_NO_LINK.
+*******************************************************************************/
+uint8_t ESP8266::getPendingLink(void)
+{
+    this->pump(ESP_NO_READER);
+    for (uint8_t link = 0; link < ESP_MAX_LINKS; link++)
+    {
+        if (!this->links[link].isEmpty())
+            return link;
+    }
+    return ESP_NO_LINK;
+}
+
+/*******************************************************************************
+   discard
+****************************************************************************/
+/**
+ * @brief Drops the content of a connection, including what it still receives
+ *        until it connects again or a command is written on it.
+ * @param link Connection.
+ * @return void
+*******************************************************************************/
+void ESP8266::discard(uint8_t link)
+{
+    if (link >= ESP_MAX_LINKS)
+        return;
+
+    this->links[link].clear();
+    this->discardLinks |= _BV(link);
+}
+
+/*******************************************************************************
+   flushResponses
+****************************************************************************/
+/**
+ * @brief Drops the AT responses received so far. The content and the events
+ *        of the connections are kept.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ESP8266::flushResponses(void)
+{
+    this->pump(ESP_NO_READER);
+    this->responses.clear();
+}
+
+/*******************************************************************************
+   pump
+****************************************************************************/
+/**
+ * @brief Reads the serial and splits it: "+IPD" content to the buffer of
+ *        its connection, everything else to the AT responses. Stops as soon
+ *        as the reader has a byte.
+ *
+ * A byte whose connection is full waits in the serial buffer (and, with
+ * flow control, pauses the module) whoever the reader is: nothing behind it
+ * is read until that connection is read. A full AT response buffer stalls
+ * only its own reader; for a connection reader, the byte is dropped and
+ * counted by getDroppedBytes().
+ * @param reader Destination the caller reads: a connection, ESP_NO_LINK for
+ *        the AT responses, or ESP_NO_READER.
+ * @return void
+*******************************************************************************/
+void ESP8266::pump(uint8_t reader)
+{
+    uint8_t blocked;
+
+    while (this->serial.available())
+    {
+        /* O leitor já tem o que ler: o restante aguarda na serial */
+        if (reader == ESP_NO_LINK && !this->responses.isEmpty())
+            return;
+        if (reader < ESP_MAX_LINKS && !this->links[reader].isEmpty())
+            return;
+
+        /* Conexão cheia: para qualquer leitor, até ser lida; nenhum byte seu se perde */
+        if (this->isBlocked(&blocked) && (blocked != ESP_NO_LINK || reader == ESP_NO_READER || reader == blocked))
+            return;
+
+        char received = (char)this->serial.read();
+        this->answered = true;
+
+        /* Conteúdo de um "+IPD" */
+        if (this->ipdRemaining)
+        {
+            this->ipdRemaining--;
+            if (this->ipdLink == this->watchLink)
+                this->watch(received);
+            else if (this->ipdLink >= ESP_MAX_LINKS)
+                this->droppedBytes++;
+            else if (!(this->discardLinks & _BV(this->ipdLink)) && !this->links[this->ipdLink].push((uint8_t)received))
+                this->droppedBytes++;
+            continue;
+        }
+
+        if (!this->parseHeader(received))
+            this->route(received);
+    }
+}
+
+/*******************************************************************************
+   watchResponses
+****************************************************************************/
+/**
+ * @brief Counts the HTTP responses of a connection as they arrive, in order.
+ *
+ * Lets several requests be sent before any response is read: the content of
+ * the connection is consumed here instead of filling its buffer.
+ * @param link Connection, or ESP_NO_LINK to stop.
+ * @return void
+*******************************************************************************/
+void ESP8266::watchResponses(uint8_t link)
+{
+    this->watchLink = link;
+    this->responseCount = 0;
+    this->responseFailures = 0;
+
+    /* Índice 0: sucesso; os demais: erros do servidor */
+    this->watchMatcher.clear();
+    this->watchMatcher.add(ESP_HTTP_OK_RESPONSE);
+    this->watchMatcher.add(ESP_HTTP_CLIENT_ERROR);
+    this->watchMatcher.add(ESP_HTTP_SERVER_ERROR);
+    this->watchMatcher.reset();
+}
+
+/*******************************************************************************
+   watch
+****************************************************************************/
+/**
+ * @brief Feeds a byte of the observed connection to the response counter.
+ * @param received Byte received.
+ * @return void
+*******************************************************************************/
+void ESP8266::watch(char received)
+{
+    uint8_t matched = this->watchMatcher.feed(received);
+    if (matched == RESPONSE_MATCHER_NONE)
+        return;
+
+    this->responseCount++;
+    if (matched != 0)
+        this->responseFailures++;
+}
+
+/*******************************************************************************
+   isBlocked
+****************************************************************************/
+/**
+ * @brief Checks if the next byte has no room in its destination.
+ * @param[out] destination Connection, or ESP_NO_LINK for the AT responses.
+ * @return true if the buffer that would receive it is full.
+*******************************************************************************/
+bool ESP8266::isBlocked(uint8_t *destination)
+{
+    if (this->ipdRemaining)
+    {
+        *destination = this->ipdLink;
+        return this->ipdLink < ESP_MAX_LINKS && this->ipdLink != this->watchLink &&
+               !(this->discardLinks & _BV(this->ipdLink)) && this->links[this->ipdLink].isFull();
+    }
+
+    *destination = ESP_NO_LINK;
+    return this->headerLength == 0 && this->responses.isFull();
+}
+
+/*******************************************************************************
+   parseHeader
+****************************************************************************/
+/**
+ * @brief Recognizes the "+IPD,<link>,<length>:" header.
+ *
+ * The bytes of a partial prefix are held back; if the prefix breaks, they are
+ * given back to the AT responses.
+ * @param received Byte received.
+ * @return true if the byte belongs to the header.
+*******************************************************************************/
+bool ESP8266::parseHeader(char received)
+{
+    static const char prefix[] PROGMEM = ESP_IPD_PREFIX;
+    const uint8_t prefixLength = sizeof(prefix) - 1;
+
+    /* Prefixo */
+    if (this->headerLength < prefixLength)
+    {
+        if (received == (char)pgm_read_byte(&prefix[this->headerLength]))
+        {
+            this->headerLength++;
+            this->ipdLink = 0;
+            this->ipdLength = 0;
+            return true;
+        }
+
+        /* Não era um "+IPD": devolve os bytes retidos */
+        for (uint8_t i = 0; i < this->headerLength; i++)
+            this->route(pgm_read_byte(&prefix[i]));
+        this->headerLength = 0;
+
+        if (received != (char)pgm_read_byte(&prefix[0]))
+            return false;
+        this->headerLength = 1;
+        return true;
+    }
+
+    /* "<link>,<tamanho>:" */
+    if (received >= '0' && received <= '9')
+    {
+        if (this->headerLength == prefixLength)
+            this->ipdLink = this->ipdLink * 10 + (received - '0');
+        else
+            this->ipdLength = this->ipdLength * 10 + (received - '0');
+        return true;
+    }
+    if (received == ',' && this->headerLength == prefixLength)
+    {
+        this->headerLength++;
+        return true;
+    }
+    if (received == ':' && this->headerLength == prefixLength + 1)
+    {
+        this->headerLength = 0;
+        this->ipdRemaining = this->ipdLength;
+        return true;
+    }
+
+    /* Cabeçalho inválido: o restante segue como resposta */
+    this->headerLength = 0;
+    return false;
+}
+
+/*******************************************************************************
+   route
+****************************************************************************/
+/**
+ * @brief Stores a byte of the AT responses and turns the "<link>,CONNECT" and
+ *        "<link>,CLOSED" lines into events.
+ *
+ * The lines still reach the responses, where commands such as AT+CIPSTART
+ * await them. Events that do not fit are counted by getDroppedEvents().
+ * @param received Byte received.
+ * @return void
+*******************************************************************************/
+void ESP8266::route(char received)
+{
+    if (!this->responses.push((uint8_t)received))
+        this->droppedBytes++;
+
+    /* Início da linha; linhas mais longas não são eventos */
+    if (this->lineLength < sizeof(this->line))
+        this->line[this->lineLength++] = received;
+    if (received != '\n')
+        return;
+
+    uint8_t length = this->lineLength;
+    this->lineLength = 0;
+    if (length < 4 || this->line[1] != ',' || this->line[0] < '0' || this->line[0] >= (char)('0' + ESP_MAX_LINKS))
+        return;
+
+    uint8_t link = this->line[0] - '0';
+    uint8_t event;
+    if (length == 2 + sizeof("CONNECT\r\n") - 1 && !strncmp_P(&this->line[2], PSTR("CONNECT\r\n"), length - 2))
+    {
+        /* Nova conexão: nada da anterior permanece */
+        this->links[link].clear();
+        this->discardLinks &= ~_BV(link);
+        this->closedLinks &= ~_BV(link);
+        event = ESP_EVENT_CONNECT | link;
+    }
+    else if (length == 2 + sizeof("CLOSED\r\n") - 1 && !strncmp_P(&this->line[2], PSTR("CLOSED\r\n"), length - 2))
+    {
+        this->closedLinks |= _BV(link);
+        event = ESP_EVENT_CLOSED | link;
+    }
+    else
+        return;
+
+    if (!this->events.push(event))
+        this->droppedEvents++;
+}
+
+/*******************************************************************************
+   Writers
+****************************************************************************/
+void ESP8266::writeConnect(Stream &serial, const void *context)
+{
+    const ESP8266 *esp = (const ESP8266 *)context;
+
+    serial.print(F("AT+CIPSTART="));
+    serial.print(ESP_CLIENT_LINK);
+    serial.print(esp->connectSsl ? F(",\"SSL\",\"") : F(",\"TCP\",\""));
+    serial.print(esp->connectUrl->host);
+    serial.print(F("\","));
+    serial.print(esp->connectPort);
+    serial.print(F("\r\n"));
+}
+
+void ESP8266::writeClose(Stream &serial, const void *context)
+{
+    serial.print(F("AT+CIPCLOSE="));
+    serial.print((uint8_t)(uintptr_t)context);
+    serial.print(F("\r\n"));
+}
+
+void ESP8266::writeSend(Stream &serial, const void *context)
+{
+    serial.print(F("AT+CIPSENDEX="));
+    serial.print((uint8_t)(uintptr_t)context);
+    serial.print(F(",2047\r\n"));
+}
+
+void ESP8266::writeSendLength(Stream &serial, const void *context)
+{
+    uint16_t packed = (uint16_t)(uintptr_t)context;
+
+    serial.print(F("AT+CIPSEND="));
+    serial.print((uint8_t)(packed & 0x07));
+    serial.print(',');
+    serial.print(packed >> 3);
+    serial.print(F("\r\n"));
+}
+
+void ESP8266::writeUart(Stream &serial, const void *context)
+{
+    serial.print(F("AT+UART_CUR="));
+    serial.print(*(const uint32_t *)context);
+#ifdef ESP_FLOW_CONTROL
+    serial.print(F(",8,1,0,2\r\n"));
+#else
+    serial.print(F(",8,1,0,0\r\n"));
+#endif
+}
+
+void ESP8266::writeJoin(Stream &serial, const void *context)
+{
+    const esp_AP_parameter_t *ap = (const esp_AP_parameter_t *)context;
+
+    serial.print(F("AT+CWJAP_DEF=\""));
+    serial.print(ap->ssid);
+    serial.print(F("\",\""));
+    serial.print(ap->password);
+    serial.print(F("\"\r\n"));
+}
+
+void ESP8266::writeSoftAp(Stream &serial, const void *context)
+{
+    const esp_AP_parameter_t *ap = (const esp_AP_parameter_t *)context;
+
+    serial.print(F("AT+CWSAP_DEF=\""));
+    serial.print(ap->ssid);
+    serial.print(F("\",\""));
+    serial.print(ap->password);
+    serial.print(F("\",6,0\r\n"));
+}
@@ -9,6 +9,8 @@
 * Includes
 *************************************************************************************/
 #include "Arduino.h"
+#include "ResponseMatcher.h"
+#include "RingBuffer.h"
 
 /*************************************************************************************
 * Public macros
@@ -18,9 +20,22 @@
 #define ESP_ENABLE_PIN (2)
 #define ESP_DESATIVA digitalWrite(enablePin, LOW)
 #define ESP_ATIVA digitalWrite(enablePin, HIGH)
+#define ESP_BAUD_RATE (57600u)
+#define ESP_RTS_PIN (5) /* Ao CTS (GPIO13) do módulo; com esse fio, habilite ESP_FLOW_CONTROL */
 
 /* Config */
 #define ESP_SLEEP /**< Enable/Disable the module entering deep-sleep */
+// #define ESP_FLOW_CONTROL /**< Enable/Disable the RTS/CTS flow control of the module serial */
+#define ESP_BAUD_NEGOTIATE /**< Enable/Disable a faster UART rate, negotiated after each module reset */
+
+/* Negociação: AT+UART_CUR não sobrevive a um reset, o módulo sempre volta a ESP_BAUD_RATE */
+#ifdef ESP_FLOW_CONTROL
+#define ESP_BAUD_MAX (1000000ul)
+#else
+#define ESP_BAUD_MAX (115200ul) /* Sem RTS: os 128 bytes de BUFFERED_SERIAL_RX_SIZE enchem em ~11ms */
+#endif
+#define ESP_BAUD_PROBES (10u)		 /* Ida e volta (AT+GMR) por taxa candidata */
+#define ESP_BAUD_TIMEOUT_STREAK (3u) /* Timeouts seguidos: o módulo pode ter voltado à taxa padrão */
 #define ESP_AP_LIST_SIZE (5u)
 
 /* Delay */
@@ -31,11 +46,59 @@
 /* Other */
 #define ESP_CLOSE_ALL (5u)
 
+/* Conexões fixas; o servidor local ocupa as livres a partir da 0 */
+#define ESP_CLIENT_LINK (4u)	/* SSL com a nuvem, mantida aberta entre publicações */
+#define ESP_CLIENT_PORT (443u)	/* connect() sem porta: HTTPS */
+#define ESP_TIMESTAMP_LINK (3u) /* TCP com o servidor de timestamp */
+
+/* Comandos assíncronos */
+#define ESP_QUEUE_SIZE (8u)			 /* Comandos AT aguardando execução */
+#ifdef ESP_FLOW_CONTROL
+#define ESP_CONFIG_COMMANDS (8u) /* Sequência de configure() */
+#else
+#define ESP_CONFIG_COMMANDS (7u)
+#endif
+#define ESP_OK_RESPONSE F("OK\r\n") /* Respostas na flash: ResponseMatcher lê com pgm_read_byte() */
+
+/* Respostas de falha, reconhecidas junto com a esperada: o comando falha em ms */
+#define ESP_ERROR_RESPONSE F("ERROR\r\n")
+#define ESP_FAIL_RESPONSE F("FAIL\r\n")	 /* Também "SEND FAIL" */
+#define ESP_BUSY_RESPONSE F("busy p...") /* Comando ignorado: módulo ocupado */
+#define ESP_CLOSED_RESPONSE F("CLOSED\r\n") /* Conexão encerrada pelo servidor */
+
+/* Respostas HTTP contadas na chegada, na conexão observada por watchResponses() */
+#define ESP_HTTP_OK_RESPONSE F("HTTP/1.1 200 OK\r\n")
+#define ESP_HTTP_CLIENT_ERROR F("HTTP/1.1 4")
+#define ESP_HTTP_SERVER_ERROR F("HTTP/1.1 5")
+
+#define ESP_FAIL_ERROR (0x01)
+#define ESP_FAIL_FAIL (0x02)
+#define ESP_FAIL_BUSY (0x04)
+#define ESP_FAIL_CLOSED (0x08)
+#define ESP_FAIL_DEFAULT (ESP_FAIL_ERROR | ESP_FAIL_FAIL | ESP_FAIL_BUSY)
+
+/* Demultiplexação da serial: respostas AT, conteúdo "+IPD" e eventos de cada conexão */
+#define ESP_MAX_LINKS (5u)
+#define ESP_NO_LINK (0xFF)			   /* Respostas AT, fora de qualquer conexão */
+/* Os leitores consomem byte a byte e um destino cheio espera na serial: os buffers só */
+/* amortecem. 5 x 10 + 34 bytes de RAM; cada dobra de ESP_LINK_BUFFER_SIZE custa 5 x tamanho */
+#define ESP_LINK_BUFFER_SIZE (8u)		   /* Bytes de "+IPD" retidos por conexão, potência de 2 */
+#define ESP_RESPONSE_BUFFER_SIZE (32u) /* Bytes de respostas AT ainda não lidos */
+#define ESP_EVENT_QUEUE_SIZE (8u)
+#define ESP_NO_READER (0xFE)		   /* Ninguém aguarda bytes: destinos cheios esperam na serial */
+#define ESP_IPD_PREFIX "+IPD,"
+
+/* Evento: tipo no nibble alto, conexão no baixo */
+#define ESP_EVENT_CONNECT (0x10)
+#define ESP_EVENT_CLOSED (0x20)
+#define ESP_EVENT_TYPE(event) ((event) & 0xF0)
+#define ESP_EVENT_LINK(event) ((event) & 0x0F)
+
 /*************************************************************************************
 * Public prototypes
 *************************************************************************************/
 extern void serial_flush(void);
-extern bool serial_get(const char *stringChecked, uint32_t timeout, char *serialBuffer, uint16_t serialBufferSize);
+extern bool serial_get(const __FlashStringHelper *stringChecked, uint32_t timeout, char *serialBuffer, uint16_t serialBufferSize);
 
 class ESP8266
 {
@@ -79,16 +142,40 @@ public:
 		int16_t rssi;
 	};
 
+	/* Resultado de um comando, ou de uma sequência de comandos, assíncrono */
+	enum esp_status_t
+	{
+		ESP_PENDING = 0,
+		ESP_DONE,
+		ESP_FAILED,
+		ESP_TIMEOUT
+	};
+
+	struct esp_future_t
+	{
+		esp_status_t status = ESP_DONE;
+		uint8_t remaining = 0; /* Comandos ainda na fila com este resultado */
+
+		bool isPending(void) { return this->status == ESP_PENDING; }
+		bool isDone(void) { return this->status == ESP_DONE; }
+	};
+
+	/* Escreve na serial um comando com parâmetros, ou o conteúdo após o '>' */
+	typedef void (*esp_writer_t)(Stream &serial, const void *context);
+
 	/*************************************************************************************
 	* Public prototypes
 	*************************************************************************************/
-	ESP8266(int pin = 0);
+	ESP8266(int pin, Stream &serial);
 	int getAPList(esp_AP_list_t *apList, int apList_size = 20);
 	uint32_t getUnixTimestamp(void);
 	bool connect_ap(const esp_AP_parameter_t &AP);
 	bool set_ap(const esp_AP_parameter_t &AP);
 	bool config(void);
 	bool checkWifi(void);
+	bool setUartRate(uint32_t baud);
+	bool probe(void);
+	void setEnabled(bool enabled) { digitalWrite(this->enablePin, enabled ? HIGH : LOW); } /* Pino de reset do módulo */
 	bool connect(const esp_URL_parameter_t &url);
 	bool server_start(void);
 	bool server_stop(void);
@@ -96,11 +183,138 @@ public:
 	void wakeup(void);
 	void sleep(void);
 
+	/* Assíncronos: apenas enfileiram; o resultado chega em 'future' (NULL = ignorado) */
+	bool requestUnixTimestamp(esp_future_t *future);
+	uint32_t lastUnixTimestamp(void);
+	bool checkWifi(esp_future_t *future);
+	bool configure(esp_future_t *future);
+	bool setUartRate(uint32_t baud, esp_future_t *future);
+	bool probe(esp_future_t *future);
+	bool connect(const esp_URL_parameter_t &url, esp_future_t *future);
+	bool connect(const esp_URL_parameter_t &url, uint16_t port, bool ssl, esp_future_t *future);
+	bool server_start(esp_future_t *future);
+	bool server_stop(esp_future_t *future);
+	bool close(uint8_t connection, esp_future_t *future);
+	bool send(uint8_t connection, esp_writer_t writer, const void *context, const __FlashStringHelper *expect, uint16_t timeout, esp_future_t *future);
+	bool send(uint8_t connection, uint16_t length, esp_writer_t writer, const void *context, esp_future_t *future);
+
+	/* Máquina de estados dos comandos AT */
+	bool enqueue(const __FlashStringHelper *command, esp_writer_t writer, const void *context, const __FlashStringHelper *expect,
+				 uint16_t timeout, esp_future_t *future, uint8_t *data = NULL, uint8_t dataSize = 0,
+				 uint8_t failures = ESP_FAIL_DEFAULT, uint8_t link = ESP_NO_LINK);
+	void poll(void);
+	bool wait(esp_future_t *future);
+	bool isIdle(void) { return this->queueCount == 0; }
+	uint8_t getQueueFree(void) { return ESP_QUEUE_SIZE - this->queueCount; }
+
+	/* Serial demultiplexada: única leitora da serial do módulo */
+	int16_t receive(void);
+	int16_t receive(uint8_t link);
+	bool getEvent(uint8_t *event) { return this->events.pop(event); }
+	uint8_t getPendingLink(void);
+	bool isClosed(uint8_t link) { return (this->closedLinks >> link) & 1; }
+	void discard(uint8_t link);
+	void flushResponses(void);
+	uint16_t getDroppedBytes(void) { return this->droppedBytes; }
+	uint16_t getDroppedEvents(void) { return this->droppedEvents; }
+	uint8_t getTimeoutStreak(void) { return this->timeoutStreak; }
+
+	/* Requisições em pipeline: respostas contadas em ordem, sem ocupar o buffer da conexão */
+	void watchResponses(uint8_t link);
+	uint8_t getResponseCount(void) { return this->responseCount; }
+	uint8_t getResponseFailures(void) { return this->responseFailures; }
+
 private:
+	/*************************************************************************************
+	* Private struct
+	*************************************************************************************/
+	struct esp_command_t
+	{
+		const __FlashStringHelper *command; /* Comando AT fixo, ou NULL */
+		esp_writer_t writer;				/* Comando com parâmetros, ou NULL */
+		const void *context;
+		const __FlashStringHelper *expect;	/* Resposta esperada; NULL = concluído ao escrever */
+		uint16_t timeout;
+		uint8_t *data;						/* Bytes lidos logo após a resposta esperada */
+		uint8_t dataSize;
+		uint8_t failures;					/* Respostas de falha: ESP_FAIL_* */
+		uint8_t link;						/* Conexão; sem escrita, o comando lê o seu conteúdo */
+		esp_future_t *future;
+	};
+
+	enum esp_state_t
+	{
+		ESP_STATE_IDLE = 0,
+		ESP_STATE_WAITING,
+		ESP_STATE_DATA
+	};
+
+	void start(esp_command_t *command);
+	void complete(esp_status_t status);
+	bool readsLink(const esp_command_t *command);
+
+	void pump(uint8_t reader);
+	bool isBlocked(uint8_t *destination);
+	void watch(char received);
+	bool parseHeader(char received);
+	void route(char received);
+
+	static void writeConnect(Stream &serial, const void *context);
+	static void writeClose(Stream &serial, const void *context);
+	static void writeSend(Stream &serial, const void *context);
+	static void writeSendLength(Stream &serial, const void *context);
+	static void writeJoin(Stream &serial, const void *context);
+	static void writeSoftAp(Stream &serial, const void *context);
+	static void writeUart(Stream &serial, const void *context);
+
 	/*************************************************************************************
 	* Private variables
 	*************************************************************************************/
 	int enablePin;
+	Stream &serial;
+
+	esp_command_t queue[ESP_QUEUE_SIZE];
+	uint8_t queueHead = 0;
+	uint8_t queueCount = 0;
+
+	uint8_t state = ESP_STATE_IDLE;
+	ResponseMatcher matcher;
+	uint8_t dataCount = 0;
+	uint32_t startMillis = 0;
+	uint32_t pollMillis = 0; /* Último poll() do comando: mede o tempo parado numa conexão cheia */
+
+	uint8_t timestampData[4];
+
+	/* Destino do AT+CIPSTART da conexão com a nuvem */
+	const esp_URL_parameter_t *connectUrl = NULL;
+	uint16_t connectPort = ESP_CLIENT_PORT;
+	bool connectSsl = true;
+
+	/* Demultiplexação */
+	RingBuffer<uint8_t, ESP_RESPONSE_BUFFER_SIZE> responses;
+	RingBuffer<uint8_t, ESP_LINK_BUFFER_SIZE> links[ESP_MAX_LINKS];
+	RingBuffer<uint8_t, ESP_EVENT_QUEUE_SIZE> events;
+	uint8_t discardLinks = 0; /* Bit n = conteúdo da conexão n descartado */
+	uint8_t closedLinks = 0;  /* Bit n = conexão n encerrada */
+
+	char line[12]; /* Início da linha de resposta atual: "<link>,CONNECT\r\n" */
+	uint8_t lineLength = 0;
+	uint8_t headerLength = 0; /* Bytes de "+IPD,<link>," já reconhecidos */
+	uint8_t ipdLink = 0;
+	uint16_t ipdLength = 0;
+	uint16_t ipdRemaining = 0;
+
+	uint16_t droppedBytes = 0;
+	uint16_t droppedEvents = 0;
+	uint8_t timeoutStreak = 0; /* Comandos AT seguidos sem nenhum byte do módulo */
+	bool answered = false;	   /* Algum byte do módulo desde o início do comando atual */
+	uint32_t uartRate = 0;	   /* Parâmetro do AT+UART_CUR na fila */
+
+	/* Respostas HTTP da conexão observada */
+	uint8_t watchLink = ESP_NO_LINK;
+	ResponseMatcher watchMatcher;
+	uint8_t responseCount = 0;
+	uint8_t responseFailures = 0;
 };
 
 #endif /* _ESP8266_H_ */
@@ -3,69 +3,518 @@
  */
 
 #include "Energy.h"
-#include "ADS1115.h"
 #include <time.h>
 
 /*******************************************************************************
    measure
 ****************************************************************************/
 /**
- * @brief Read raw data from the Energy.
- * @param data Output buffer.
- * @param size Size of the buffer to read.
- * @return void
+ * @brief Drains the samples acquired by interrupt and reduces them to RMS.
+ *
+ * Non-blocking: consumes whatever settled samples the acquisition session has
+ * buffered for this channel. With 'windowCycles' set, the window opens on a
+ * rising zero crossing and closes on the crossing that completes that many
+ * mains cycles; 'dataSize' then only bounds it (e.g. no current, no
+ * crossings). Otherwise the window is 'dataSize' samples long. When the
+ * window is complete the channel is released to the next one.
+ * @return true if a window was completed and rmsLast updated.\n
+           false if the window is still open or another channel is scheduled.
 *******************************************************************************/
 bool Energy::measure()
 {
-    /* Insere configurações do primeiro ADS */
-    /* Pino de endereço I2C = GND */
-    /* Canal diferencial = A0 - A1 ou A2 - A3 */
-    /* Conversão contínua */
-    /* PGA FS = +-2048mV */
-    /* 860 samples/seg */
-    /* Comparador desabilitado */
-    ADS1115 ads;
-    ADS1115::ADS1115_config_t ADS1115Config = {
-        ADS1115::ADDR_GND,
-        ADS1115::OS_N_EFF,
-        (this->channel == 0) ? ADS1115::MUX_0_1 : ADS1115::MUX_2_3,
-        ADS1115::PGA_2048,
-        ADS1115::MODE_CONT,
-        ADS1115::DR_860,
-        ADS1115::COMP_MODE_TRADITIONAL,
-        ADS1115::COMP_POL_ACTIVE_LOW,
-        ADS1115::COMP_LATCH_OFF,
-        ADS1115::COMP_DISABLE,
-    };
-    ads.config(&ADS1115Config);
-
-    /* Remove primeiras 10 amostras */
-    ADS1115::ADS1115_data_t ADS1115Data = {
-        ADS1115::ADDR_GND,
-        10,
-    };
-    ads.readData(&ADS1115Data);
-
-    /* Realiza a leitura das amostras */
-    float sum = 0;
-    for (uint16_t i = 0; i < this->config.dataSize; i++)
+#ifdef ENERGY_PROFILE
+    uint32_t start = micros();
+#endif
+
+    /* Consome as amostras já adquiridas para este canal */
+    int16_t sample;
+    int16_t voltage = 0;
+    float fraction;
+    bool complete = false;
+    bool crossed = false;
+#ifdef ENERGY_VOLTAGE
+    bool paired = this->hasVoltage();
+#endif
+    while (!complete && this->acquisition.read(this->channel, &sample, &voltage))
+    {
+        /* Janela síncrona com a rede */
+        if (this->config.windowCycles != 0 && this->zeroCrossing(sample, &fraction))
+        {
+            /* Primeiro cruzamento: descarta o ciclo parcial e abre a janela */
+            if (this->crossingCount == 0)
+            {
+                this->clearWindow();
+                this->firstCrossing = fraction - 1;
+            }
+            this->lastCrossing = this->windowCount + fraction - 1;
+
+            /* Ciclos completos: a amostra atual já pertence ao próximo ciclo */
+            if (++this->crossingCount > this->config.windowCycles)
+            {
+                complete = crossed = true;
+                break;
+            }
+        }
+
+        /* Captura da forma de onda: apenas uma cópia da amostra acumulada */
+        if (this->capture != NULL)
+            this->capture->add(this->channel, sample, this->windowCount == 0);
+
+        this->accumulate(sample);
+#ifdef ENERGY_VOLTAGE
+        if (paired)
+            this->accumulatePower(sample, voltage);
+#endif
+#ifdef ENERGY_HARMONICS
+        if (this->harmonics != NULL)
+            this->goertzel(sample);
+#endif
+
+        /* Limite de amostras da janela */
+        complete = (this->windowCount >= this->config.dataSize);
+    }
+
+    /* Janela em andamento */
+    if (!complete)
+    {
+#ifdef ENERGY_PROFILE
+        this->kernelMicros += micros() - start;
+#endif
+        return false;
+    }
+
+    /* Janela completa: libera o ADC para o próximo canal */
+    this->acquisition.release(this->channel, this->windowCount);
+    if (this->capture != NULL)
+        this->capture->windowEnd(this->channel);
+    this->reduce();
+
+    /* Canal único no dispositivo: o cruzamento que fechou a janela abre a próxima, */
+    /* sem esperar o rearme no ciclo seguinte */
+    if (crossed && this->acquisition.isScheduled(this->channel))
+    {
+        this->crossingCount = 1;
+        this->firstCrossing = fraction - 1;
+        this->lastCrossing = fraction - 1;
+        if (this->capture != NULL)
+            this->capture->add(this->channel, sample, true);
+        this->accumulate(sample);
+#ifdef ENERGY_VOLTAGE
+        if (paired)
+            this->accumulatePower(sample, voltage);
+#endif
+#ifdef ENERGY_HARMONICS
+        if (this->harmonics != NULL)
+            this->goertzel(sample);
+#endif
+    }
+
+#ifdef ENERGY_PROFILE
+    this->kernelMicros += micros() - start;
+#endif
+    return true;
+}
+
+/*******************************************************************************
+   accumulate
+****************************************************************************/
+/**
+ * @brief Integer accumulation of one sample into the window.
+ * @param sample Raw conversion.
+ * @return void
+*******************************************************************************/
+void Energy::accumulate(int16_t sample)
+{
+    /* Acumula em inteiros: quadrado (<= 2^30) e soma para o offset DC */
+    uint32_t square = (uint32_t)((int32_t)sample * sample);
+    this->squareSumLow += square;
+    if (this->squareSumLow < square)
+        this->squareSumHigh++;
+    this->windowSum += sample;
+    this->windowCount++;
+}
+
+/*******************************************************************************
+   zeroCrossing
+****************************************************************************/
+/**
+ * @brief Detects a rising zero crossing around the DC offset of the last window.
+ *
+ * The detector is armed only after the signal goes below the offset by
+ * ENERGY_ZERO_CROSSING_HYSTERESIS_MV, so noise around zero does not count.
+ * @param sample Raw conversion.
+ * @param[out] fraction Where the crossing lies between the previous and the
+ *             current sample (0 to 1], by linear interpolation.
+ * @return true if the signal crossed upwards at this sample.
+*******************************************************************************/
+bool Energy::zeroCrossing(int16_t sample, float *fraction)
+{
+    bool crossed = false;
+
+    if ((int32_t)sample < (int32_t)this->offset - this->hysteresis)
+    {
+        this->crossingArmed = true;
+    }
+    else if (this->crossingArmed && sample >= this->offset)
     {
-        /* Leitura do valor do ADC */
-        /* Solicita 1 amostra */
-        ADS1115Data.data_size = 1;
-        ads.readData(&ADS1115Data);
-
-        /* Realiza os cálculos */
-        float adc = ADS1115Data.data_byte[0] * 0.0625f; /* 0.0625 = 2048.0/32768.0 */
-        sum += adc * adc;
+        /* A amostra anterior estava abaixo do offset */
+        *fraction = (float)((int32_t)this->offset - this->previousSample) / ((int32_t)sample - this->previousSample);
+        this->crossingArmed = false;
+        crossed = true;
     }
-    this->rmsLast = sqrt(sum / this->config.dataSize) * this->config.scale * 1e-3; /* Corrente RMS [A] */
+
+    this->previousSample = sample;
+    return crossed;
+}
+
+/*******************************************************************************
+   reduce
+****************************************************************************/
+/**
+ * @brief Reduces the integer accumulators of the window to RMS amperes.
+ *
+ * Runs once per window. The DC offset is removed exactly, in integers:
+ * n^2 * var = n * sum(x^2) - sum(x)^2, with both terms below 2^62 for
+ * n <= 65535. Without DC the result matches the former per-sample float
+ * reduction within 1e-5 relative (the float sum kept only 24 bits).
+ * A cycle-synchronous window also yields the line frequency. The count weight
+ * comes from the converter of the channel, so either backend uses this path.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Energy::reduce(void)
+{
+    uint64_t squareSum = ((uint64_t)this->squareSumHigh << 32) | this->squareSumLow;
+    uint64_t n = this->windowCount;
+    int64_t sum = this->windowSum;
+    uint64_t sumSquared = (uint64_t)(sum * sum);
+    uint64_t scaledSquareSum = n * squareSum;
+    uint64_t variance = (scaledSquareSum > sumSquared) ? scaledSquareSum - sumSquared : 0;
+
+    /* Única conversão para float e escala da janela */
+    /* Janela síncrona: normaliza pela duração interpolada entre os cruzamentos, e não pelo
+       número inteiro de amostras; nas bordas o sinal está no offset e quase não soma */
+    bool cycleWindow = (this->config.windowCycles != 0 && this->crossingCount > this->config.windowCycles);
+    float length = cycleWindow ? (this->lastCrossing - this->firstCrossing) : this->windowCount;
+    float rmsCounts = sqrt((float)variance / ((float)this->windowCount * length));
+    float lsbMillivolts = this->acquisition.getLsbMillivolts(this->channel);
+    this->rmsLast = rmsCounts * lsbMillivolts * this->config.scale * 1e-3; /* Corrente RMS [A] */
     this->rmsSum += this->rmsLast;
     this->rmsCount++;
+#ifdef ENERGY_VOLTAGE
+    if (this->hasVoltage())
+        this->reducePower(length, lsbMillivolts * this->config.scale * 1e-3);
+#endif
+#ifdef ENERGY_HARMONICS
+    if (this->harmonics != NULL)
+        this->reduceHarmonics(lsbMillivolts * this->config.scale * 1e-3);
+#endif
 
-    return true;
+    /* Frequência da rede: ciclos completos pelo tempo entre o primeiro e o último cruzamento */
+    if (cycleWindow)
+    {
+        float periodSamples = length / this->config.windowCycles;
+        float conversionRate = this->acquisition.getConversionRate(this->channel);
+        if (periodSamples > 0 && conversionRate > 0)
+            this->lineFrequency = conversionRate / periodSamples;
+    }
+
+    /* Offset DC para o detector de cruzamento da próxima janela */
+    this->offset = (int16_t)(this->windowSum / (int32_t)this->windowCount);
+    if (lsbMillivolts > 0)
+        this->hysteresis = max((int16_t)(ENERGY_ZERO_CROSSING_HYSTERESIS_MV / lsbMillivolts), (int16_t)ENERGY_ZERO_CROSSING_MIN_COUNTS);
+    this->crossingArmed = false;
+    this->crossingCount = 0;
+    this->clearWindow();
+
+#ifdef ENERGY_HARMONICS
+    /* Filtros da próxima janela, com a frequência e a taxa medidas nesta */
+    if (this->harmonics != NULL)
+        this->tuneHarmonics();
+#endif
+}
+
+/*******************************************************************************
+   clearWindow
+****************************************************************************/
+/**
+ * @brief Clears the accumulators of the window in progress.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Energy::clearWindow(void)
+{
+    this->squareSumLow = 0;
+    this->squareSumHigh = 0;
+    this->windowSum = 0;
+    this->windowCount = 0;
+
+#ifdef ENERGY_VOLTAGE
+    if (this->power != NULL)
+    {
+        Power *p = this->power;
+        p->voltageSquareSumLow = 0;
+        p->voltageSquareSumHigh = 0;
+        p->voltageSum = 0;
+        p->productSumLow = 0;
+        p->productSumHigh = 0;
+        p->delayedSumLow = 0;
+        p->delayedSumHigh = 0;
+        /* O primeiro produto atrasado da janela não usa a tensão da anterior */
+        p->previousVoltage = 0;
+    }
+#endif
+
+#ifdef ENERGY_HARMONICS
+    if (this->harmonics != NULL)
+    {
+        memset(this->harmonics->goertzelState, 0, sizeof(this->harmonics->goertzelState));
+        this->harmonics->goertzelCount = 0;
+    }
+#endif
+}
+
+#ifdef ENERGY_VOLTAGE
+/*******************************************************************************
+   accumulatePower
+****************************************************************************/
+/**
+ * @brief Integer accumulation of the voltage sample taken with the current
+ *        one, and of the two products V.I needs: with the voltage of this
+ *        conversion and with the one before.
+ * @param sample Raw current conversion.
+ * @param voltage Raw voltage conversion.
+ * @return void
+*******************************************************************************/
+void Energy::accumulatePower(int16_t sample, int16_t voltage)
+{
+    Power *p = this->power;
+    add64(&p->voltageSquareSumLow, &p->voltageSquareSumHigh, (int32_t)voltage * voltage);
+    p->voltageSum += voltage;
+    add64(&p->productSumLow, &p->productSumHigh, (int32_t)sample * voltage);
+    add64(&p->delayedSumLow, &p->delayedSumHigh, (int32_t)sample * p->previousVoltage);
+    p->previousVoltage = voltage;
+}
+
+/*******************************************************************************
+   add64
+****************************************************************************/
+/**
+ * @brief Adds a signed 32-bit value to a 32+32-bit sum, with carry.
+ * @param low Low word of the sum.
+ * @param high High word of the sum, signed.
+ * @param value Value.
+ * @return void
+*******************************************************************************/
+void Energy::add64(uint32_t *low, int32_t *high, int32_t value)
+{
+    uint32_t previous = *low;
+    *low += (uint32_t)value;
+    if (*low < previous)
+        (*high)++;
+
+    /* Extensão de sinal de um valor negativo */
+    if (value < 0)
+        (*high)--;
+}
+
+/*******************************************************************************
+   reducePower
+****************************************************************************/
+/**
+ * @brief Reduces the window to RMS volts, real power and the sums of the
+ *        interval; once per window.
+ *
+ * The DC offsets are removed as in reduce(): n^2.cov = n.sum(i.v) - sum(i).sum(v).
+ * The voltage conversion lags the current one by 'phaseCal' hundredths of a
+ * conversion (its ADS1115 is read at the RDY of another one, and the sensors
+ * add their own shift). Both products are samples of the same sinusoid of the
+ * lag, one conversion apart, so the product at zero lag is interpolated
+ * exactly for the fundamental:
+ * P = (P(d).sin(w(d+1)) - P(d+1).sin(w.d)) / sin(w), w = 2pi.f/fs.
+ * @param length Length of the window, in samples, as used by the RMS.
+ * @param amperesPerCount Weight of one count of the current.
+ * @return void
+*******************************************************************************/
+void Energy::reducePower(float length, float amperesPerCount)
+{
+    Power *p = this->power;
+    int64_t n = this->windowCount;
+    int64_t currentSum = this->windowSum;
+    int64_t voltageSum = p->voltageSum;
+    int64_t voltageSquareSum = ((int64_t)p->voltageSquareSumHigh << 32) + p->voltageSquareSumLow;
+    int64_t productSum = ((int64_t)p->productSumHigh << 32) + p->productSumLow;
+    int64_t delayedSum = ((int64_t)p->delayedSumHigh << 32) + p->delayedSumLow;
+
+    /* Única conversão para float, com a mesma normalização da corrente */
+    float scale = (float)n * length;
+    float voltageVariance = (float)(n * voltageSquareSum - voltageSum * voltageSum) / scale;
+    float product = (float)(n * productSum - currentSum * voltageSum) / scale;
+    float delayed = (float)(n * delayedSum - currentSum * voltageSum) / scale;
+
+    /* Atraso da tensão: desfeito para a fundamental da rede */
+    float rate = this->acquisition.getConversionRate(this->channel);
+    float frequency = (this->lineFrequency > 0) ? this->lineFrequency : ENERGY_DEFAULT_LINE_FREQUENCY;
+    float omega = (rate > 0) ? 2 * M_PI * frequency / rate : 0;
+    float lag = this->config.phaseCal / 100.0f;
+    if (sin(omega) > 0.01f)
+        product = (product * sin(omega * (lag + 1)) - delayed * sin(omega * lag)) / sin(omega);
+
+    float voltsPerCount = this->acquisition.getVoltageLsbMillivolts() * this->config.voltageScale * 1e-3;
+    p->voltageLast = (voltageVariance > 0) ? sqrt(voltageVariance) * voltsPerCount : 0; /* Tensão RMS [V] */
+    p->realPowerLast = product * amperesPerCount * voltsPerCount;                    /* Potência real [W] */
+    p->realPowerSum += p->realPowerLast;
+    p->apparentPowerSum += p->voltageLast * this->rmsLast;
 }
 
+/*******************************************************************************
+   setPower
+****************************************************************************/
+/**
+ * @brief Attaches the real power state of this channel.
+ *
+ * Only the channels given one, among those of the paired ADS1115
+ * (Acquisition::hasVoltage()), accumulate V.I; the others report NAN for the
+ * voltage and the power, and their energy uses lineVoltage and powerFactor.
+ * @param power State owned by the caller, or NULL to stop the measurement.
+ * @return void
+*******************************************************************************/
+void Energy::setPower(Power *power)
+{
+    if (power != NULL)
+        memset(power, 0, sizeof(*power));
+    this->power = power;
+}
+#endif
+
+#ifdef ENERGY_HARMONICS
+/*******************************************************************************
+   setHarmonics
+****************************************************************************/
+/**
+ * @brief Attaches the harmonic analysis state of this channel.
+ *
+ * Only the channels given one keep the Goertzel filters; the others report
+ * NAN for the harmonics and the THD. The filters are tuned at the end of the
+ * first window.
+ * @param harmonics State owned by the caller, or NULL to stop the analysis.
+ * @return void
+*******************************************************************************/
+void Energy::setHarmonics(Harmonics *harmonics)
+{
+    if (harmonics != NULL)
+    {
+        memset(harmonics, 0, sizeof(*harmonics));
+        harmonics->thd = NAN;
+        for (uint8_t i = 0; i < ENERGY_HARMONIC_COUNT; i++)
+            harmonics->harmonic[i] = NAN;
+    }
+    this->harmonics = harmonics;
+}
+
+/*******************************************************************************
+   goertzel
+****************************************************************************/
+/**
+ * @brief Advances the Goertzel filter of each harmonic by one sample:
+ *        s0 = c.s1 - s2 + x, in integers.
+ *
+ * c.s1 is split in two products below 2^31, so no 64-bit multiply is needed
+ * on the AVR, while |s| stays below ENERGY_GOERTZEL_MAX_STATE: samples past
+ * 'goertzelLimit' (see tuneHarmonics()) are left out of the window.
+ * @param sample Raw conversion.
+ * @return void
+*******************************************************************************/
+void Energy::goertzel(int16_t sample)
+{
+    Harmonics *h = this->harmonics;
+    if (h->goertzelCount >= h->goertzelLimit)
+        return;
+    h->goertzelCount++;
+
+    /* Sem o offset DC da janela anterior */
+    int32_t input = (int32_t)sample - this->offset;
+    for (uint8_t i = 0; i < h->harmonicCount; i++)
+    {
+        int32_t coeff = h->goertzelCoeff[i];
+        int32_t s1 = h->goertzelState[i][0];
+        int32_t product = coeff * (s1 >> ENERGY_GOERTZEL_SHIFT) +
+                          ((coeff * (s1 & ((1L << ENERGY_GOERTZEL_SHIFT) - 1))) >> ENERGY_GOERTZEL_SHIFT);
+
+        h->goertzelState[i][0] = product - h->goertzelState[i][1] + input;
+        h->goertzelState[i][1] = s1;
+    }
+}
+
+/*******************************************************************************
+   reduceHarmonics
+****************************************************************************/
+/**
+ * @brief Reduces the filters of the window to the RMS of each harmonic and
+ *        to the THD; once per window, in float.
+ * @param amperesPerCount Weight of one ADC count.
+ * @return void
+*******************************************************************************/
+void Energy::reduceHarmonics(float amperesPerCount)
+{
+    Harmonics *h = this->harmonics;
+    float harmonicSquares = 0;
+
+    for (uint8_t i = 0; i < ENERGY_HARMONIC_COUNT; i++)
+    {
+        h->harmonic[i] = 0;
+        if (i >= h->harmonicCount || h->goertzelCount == 0)
+            continue;
+
+        /* |X|^2 = s1^2 + s2^2 - c.s1.s2; RMS da senoide = sqrt(2.|X|^2) / N */
+        float s1 = h->goertzelState[i][0];
+        float s2 = h->goertzelState[i][1];
+        float coeff = h->goertzelCoeff[i] / (float)(1L << ENERGY_GOERTZEL_SHIFT);
+        float power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+        h->harmonic[i] = (power > 0) ? sqrt(2 * power) / h->goertzelCount * amperesPerCount : 0;
+
+        if (i > 0)
+            harmonicSquares += h->harmonic[i] * h->harmonic[i];
+    }
+
+    /* THD: harmônicas medidas em relação à fundamental */
+    h->thd = (h->harmonic[0] > 0) ? 100 * sqrt(harmonicSquares) / h->harmonic[0] : 0;
+}
+
+/*******************************************************************************
+   tuneHarmonics
+****************************************************************************/
+/**
+ * @brief Computes the coefficient of each harmonic below Nyquist, from the
+ *        line frequency (measured or default) and the conversion rate.
+ * @param void
+ * @return void
+*******************************************************************************/
+void Energy::tuneHarmonics(void)
+{
+    Harmonics *h = this->harmonics;
+    float rate = this->acquisition.getConversionRate(this->channel);
+    float frequency = (this->lineFrequency > 0) ? this->lineFrequency : ENERGY_DEFAULT_LINE_FREQUENCY;
+
+    /* Na ressonância o estado cresce |x|/(2.sin(w)) por amostra, com |x| < 2^16 */
+    float limit = 65535;
+    h->harmonicCount = 0;
+    for (uint8_t i = 0; i < ENERGY_HARMONIC_COUNT; i++)
+    {
+        float harmonicFrequency = ENERGY_HARMONIC_ORDER(i) * frequency;
+        if (rate <= 0 || harmonicFrequency >= rate / 2)
+            break;
+
+        float omega = 2 * M_PI * harmonicFrequency / rate;
+        float coeff = 2 * cos(omega) * (1L << ENERGY_GOERTZEL_SHIFT);
+        h->goertzelCoeff[i] = (int16_t)constrain(lround(coeff), -32767L, 32767L);
+        limit = min(limit, 2 * sin(omega) * (ENERGY_GOERTZEL_MAX_STATE >> 16));
+        h->harmonicCount++;
+    }
+    h->goertzelLimit = (uint16_t)limit;
+}
+#endif
+
 /*******************************************************************************
    measure
 ****************************************************************************/
@@ -80,6 +529,13 @@ bool Energy::calculate(uint32_t currentTimestamp)
     if (this->rmsCount == 0 || currentTimestamp < this->lastTimestamp)
     {
         this->currentAmperes = 0;
+#ifdef ENERGY_VOLTAGE
+        if (this->power != NULL)
+        {
+            this->power->realPowerWatts = 0;
+            this->power->apparentPowerVoltAmperes = 0;
+        }
+#endif
         this->lastTimestamp = currentTimestamp;
 
         return false;
@@ -87,6 +543,18 @@ bool Energy::calculate(uint32_t currentTimestamp)
 
     /* Calcula o valor de corrente elétrica média no período, em amperes */
     this->currentAmperes = this->rmsSum / this->rmsCount;
+#ifdef ENERGY_VOLTAGE
+    /* Potências médias no período, por janela */
+    if (this->power != NULL)
+    {
+        Power *p = this->power;
+        p->realPowerWatts = p->realPowerSum / this->rmsCount;
+        p->apparentPowerVoltAmperes = p->apparentPowerSum / this->rmsCount;
+        p->realPowerSum = 0;
+        p->apparentPowerSum = 0;
+        p->realPowerLast = 0;
+    }
+#endif
     this->rmsSum = 0;
     this->rmsLast = 0;
     this->rmsCount = 0;
@@ -111,7 +579,12 @@ bool Energy::calculate(uint32_t currentTimestamp)
     this->currentAccumulatedAmperesHour += this->currentAmperes * (currentTimestamp - this->lastTimestamp) / 3600u;
 
     /* Obtém a potência elétrica média da carga no período, em kW */
+    /* Sem entrada de tensão: tensão e fator de potência nominais */
     float electricPowerKiloWatts = this->currentAmperes * this->config.lineVoltage * this->config.powerFactor / 100000u;
+#ifdef ENERGY_VOLTAGE
+    if (this->hasVoltage())
+        electricPowerKiloWatts = this->power->realPowerWatts / 1000;
+#endif
 
     /* Obtém a energia elétrica no período, em kilowatts-hora */
     float energyKiloWattsHour = electricPowerKiloWatts * (currentTimestamp - this->lastTimestamp) / 3600u;
@@ -9,6 +9,8 @@
 * Includes
 *************************************************************************************/
 #include "Arduino.h"
+#include "Acquisition.h"
+#include "WaveformCapture.h"
 
 /*************************************************************************************
 * Macros
@@ -17,9 +19,33 @@
 #define ENERGY_DEFAULT_POWER_FACTOR_PERCENT (87u)
 #define ENERGY_DEFAULT_SCALE (50u) /* 50A - 1V */
 #define ENERGY_DEFAULT_DATA_SIZE (500u)
+#define ENERGY_DEFAULT_WINDOW_CYCLES (0u) /* 0 = janela fixa de 'dataSize' amostras */
 #define ENERGY_DEFAULT_KWH_BASE_PRICE (0.828844f) /* R$/kWh */
 #define ENERGY_DEFAULT_KWH_FLAG_PRICE (0.142f)	 /* R$/kWh */
 #define ENERGY_DEFAULT_TIMEZONE (-3)
+#define ENERGY_ZERO_CROSSING_HYSTERESIS_MV (1.0f) /* Abaixo do offset para armar o detector */
+#define ENERGY_ZERO_CROSSING_MIN_COUNTS (2)		 /* Mínimo acima do ruído de quantização */
+#define ENERGY_DEFAULT_VOLTAGE_SCALE (250u)		 /* 250V - 1V, na entrada de tensão */
+#define ENERGY_DEFAULT_PHASE_CAL (50u)			 /* Atraso da tensão, em centésimos de conversão */
+
+/* Perfil do kernel de redução: tempo gasto por janela, em microssegundos */
+// #define ENERGY_PROFILE
+
+/* Harmônicas: filtros de Goertzel em ponto fixo, atualizados a cada amostra, sem guardar a janela */
+/* Custo: ~50 bytes de RAM por canal analisado (Energy::Harmonics, ver setHarmonics()) */
+// #define ENERGY_HARMONICS
+#define ENERGY_HARMONIC_CHANNELS (1u)						/* Canais analisados: os primeiros configurados */
+#define ENERGY_HARMONIC_COUNT (3u)							/* Fundamental, 3ª e 5ª */
+#define ENERGY_HARMONIC_ORDER(index) (2u * (index) + 1u) /* Apenas as ímpares */
+#define ENERGY_DEFAULT_LINE_FREQUENCY (60.0f)				/* Sem janela síncrona para medir */
+#define ENERGY_GOERTZEL_SHIFT (14)							/* Coeficientes em Q14 */
+#define ENERGY_GOERTZEL_MAX_STATE (1L << 29)				/* c.s1 em duas partes de 32 bits, com folga */
+
+/* Potência real: V.I amostra a amostra, nos canais com entrada de tensão (Acquisition::hasVoltage()) */
+/* Custo: ~55 bytes de RAM por canal com tensão (Energy::Power, ver setPower()); sem tensão, */
+/* a potência usa lineVoltage e powerFactor. A entrada de tensão ocupa um ADS1115: ADS1115_MAX_DEVICES >= 2 */
+// #define ENERGY_VOLTAGE
+#define ENERGY_VOLTAGE_CHANNELS (2u) /* Canais com potência real: os primeiros do ADS1115 pareado */
 
 /*************************************************************************************
 * Public prototypes
@@ -27,7 +53,7 @@
 class Energy
 {
 public:
-	explicit Energy(uint8_t channel) { this->channel = channel; }
+	Energy(Acquisition &acquisition, uint8_t channel) : acquisition(acquisition), channel(channel) {}
 
 	bool measure(void);
 	bool calculate(uint32_t currentTimestamp);
@@ -38,6 +64,38 @@ public:
 	uint32_t getRmsCount(void) { return this->rmsCount; }
 	float getRmsSum(void) { return this->rmsSum; }
 	float getRmsLast(void) { return this->rmsLast; }
+	float getRmsAverage(void) { return this->rmsCount ? this->rmsSum / this->rmsCount : 0; }
+	float getSampleRate(void) { return this->acquisition.getSampleRate(this->channel); }
+	float getLineFrequency(void) { return this->lineFrequency; }
+	void setCapture(WaveformCapture *capture) { this->capture = capture; }
+#ifdef ENERGY_HARMONICS
+	/* Última janela; NAN nos canais sem estado de harmônicas */
+	float getHarmonic(uint8_t index) { return (this->harmonics != NULL && index < ENERGY_HARMONIC_COUNT) ? this->harmonics->harmonic[index] : NAN; }
+	float getThd(void) { return (this->harmonics != NULL) ? this->harmonics->thd : NAN; }
+#else
+	float getHarmonic(uint8_t index) { (void)index; return NAN; }
+	float getThd(void) { return NAN; }
+#endif
+#ifdef ENERGY_VOLTAGE
+	/* Última janela; NAN sem entrada de tensão */
+	float getVoltageRms(void) { return this->hasVoltage() ? this->power->voltageLast : NAN; }
+	float getRealPowerLast(void) { return this->hasVoltage() ? this->power->realPowerLast : NAN; }
+	float getPowerFactorLast(void) { return this->hasVoltage() ? this->powerFactor(this->power->realPowerLast, this->power->voltageLast * this->rmsLast) : NAN; }
+	/* Média do último intervalo publicado */
+	float getRealPowerWatts(void) { return this->hasVoltage() ? this->power->realPowerWatts : NAN; }
+	float getApparentPowerVoltAmperes(void) { return this->hasVoltage() ? this->power->apparentPowerVoltAmperes : NAN; }
+	float getPowerFactor(void) { return this->hasVoltage() ? this->powerFactor(this->power->realPowerWatts, this->power->apparentPowerVoltAmperes) : NAN; }
+#else
+	float getVoltageRms(void) { return NAN; }
+	float getRealPowerLast(void) { return NAN; }
+	float getPowerFactorLast(void) { return NAN; }
+	float getRealPowerWatts(void) { return NAN; }
+	float getApparentPowerVoltAmperes(void) { return NAN; }
+	float getPowerFactor(void) { return NAN; }
+#endif
+#ifdef ENERGY_PROFILE
+	uint32_t getKernelMicros(void) { return this->kernelMicros; }
+#endif
 
 	struct Config
 	{
@@ -46,9 +104,11 @@ public:
 		uint8_t lineVoltage;
 		uint8_t powerFactor;
 		uint8_t currentDay;
-		uint8_t reserved1;
+		uint8_t windowCycles; /* Janela síncrona, em ciclos da rede (0 = desabilitada) */
 		float basePrice;
 		float flagPrice;
+		uint16_t voltageScale; /* Entrada de tensão: volts da rede por volt no ADC */
+		uint8_t phaseCal;	   /* Atraso da tensão em relação à corrente, em centésimos de conversão */
 	};
 
 	Config config = {
@@ -57,13 +117,99 @@ public:
 		ENERGY_DEFAULT_LINE_VOLTAGE_VOLTS,
 		ENERGY_DEFAULT_POWER_FACTOR_PERCENT,
 		0,
-		0,
+		ENERGY_DEFAULT_WINDOW_CYCLES,
 		ENERGY_DEFAULT_KWH_BASE_PRICE,
 		ENERGY_DEFAULT_KWH_FLAG_PRICE,
+		ENERGY_DEFAULT_VOLTAGE_SCALE,
+		ENERGY_DEFAULT_PHASE_CAL,
+	};
+
+#ifdef ENERGY_HARMONICS
+	/* Filtros da janela em andamento e resultado da última, de um canal analisado */
+	struct Harmonics
+	{
+		int16_t goertzelCoeff[ENERGY_HARMONIC_COUNT]; /* 2cos(2pi.f/fs) em Q14 */
+		int32_t goertzelState[ENERGY_HARMONIC_COUNT][2]; /* Os dois últimos estados */
+		uint16_t goertzelCount;
+		uint16_t goertzelLimit; /* Amostras até o estado chegar a ENERGY_GOERTZEL_MAX_STATE */
+		uint8_t harmonicCount;	/* Harmônicas abaixo de Nyquist; 0 até medir a taxa */
+		float harmonic[ENERGY_HARMONIC_COUNT]; /* RMS de cada harmônica na última janela [A] */
+		float thd;							   /* Distorção harmônica total até a última [%] */
 	};
+	void setHarmonics(Harmonics *harmonics);
+#endif
+
+#ifdef ENERGY_VOLTAGE
+	/* Janela em andamento da tensão, nas amostras da corrente, e potências de um canal com tensão */
+	struct Power
+	{
+		/* Somas de 64 bits em 32+32 */
+		uint32_t voltageSquareSumLow;
+		int32_t voltageSquareSumHigh;
+		int32_t voltageSum;
+		uint32_t productSumLow; /* i[n].v[n] */
+		int32_t productSumHigh;
+		uint32_t delayedSumLow; /* i[n].v[n-1] */
+		int32_t delayedSumHigh;
+		int16_t previousVoltage;
+
+		float voltageLast;	 /* Tensão RMS da última janela [V] */
+		float realPowerLast; /* Potência real da última janela [W] */
+		float realPowerSum;	 /* Somas do intervalo em andamento, por janela */
+		float apparentPowerSum;
+		float realPowerWatts; /* Médias do último intervalo */
+		float apparentPowerVoltAmperes;
+	};
+	void setPower(Power *power);
+#endif
 
 private:
+	Acquisition &acquisition;
 	uint8_t channel;
+	WaveformCapture *capture = NULL; /* Recebe uma cópia das amostras, ou NULL */
+#ifdef ENERGY_HARMONICS
+	Harmonics *harmonics = NULL; /* Canal sem análise de harmônicas: NULL */
+#endif
+#ifdef ENERGY_VOLTAGE
+	Power *power = NULL; /* Canal sem estado de potência: NULL, mesmo no ADS1115 pareado */
+#endif
+
+	void accumulate(int16_t sample);
+	bool zeroCrossing(int16_t sample, float *fraction);
+	void reduce(void);
+	void clearWindow(void);
+#ifdef ENERGY_VOLTAGE
+	bool hasVoltage(void) { return this->power != NULL && this->acquisition.hasVoltage(this->channel); }
+	static float powerFactor(float real, float apparent) { return (apparent > 0) ? real / apparent : NAN; }
+	void accumulatePower(int16_t sample, int16_t voltage);
+	void reducePower(float length, float amperesPerCount);
+	static void add64(uint32_t *low, int32_t *high, int32_t value);
+#endif
+#ifdef ENERGY_HARMONICS
+	void goertzel(int16_t sample);
+	void reduceHarmonics(float amperesPerCount);
+	void tuneHarmonics(void);
+#endif
+
+	/* Janela de aquisição em andamento, em contagens do ADC */
+	/* Soma dos quadrados em 32+32 bits: o AVR soma com carry sem rotina de 64 bits */
+	uint32_t squareSumLow = 0;
+	uint32_t squareSumHigh = 0;
+	int32_t windowSum = 0;
+	uint16_t windowCount = 0;
+
+	/* Detecção de cruzamento por zero (borda de subida), em torno do offset DC */
+	int16_t offset = 0;
+	int16_t hysteresis = ENERGY_ZERO_CROSSING_MIN_COUNTS; /* Contagens do ADC do canal */
+	int16_t previousSample = 0;
+	bool crossingArmed = false;
+	uint8_t crossingCount = 0;
+	float firstCrossing = 0; /* Posição na janela, em amostras (interpolada) */
+	float lastCrossing = 0;
+	float lineFrequency = 0;
+#ifdef ENERGY_PROFILE
+	uint32_t kernelMicros = 0;
+#endif
 
 	uint32_t lastTimestamp = 0;
 	float currentAmperes = 0;
@@ -1,10 +1,18 @@
 #include "config.h"
 #include "ESP8266.h"
+#include "BufferedSerial.h"
 #include "ADS1115.h"
+#include "Acquisition.h"
 #include "Energy.h"
 #include "CRC.h"
+#include "PackedRecord.h"
+#include "Base64Writer.h"
+#include "WaveformCapture.h"
+#include "JsonWriter.h"
+#include "JsonReader.h"
+#include "MqttClient.h"
 #include "Timer.h"
-#include <Wire.h>
+#include "TwiMaster.h"
 #include <LiquidCrystal.h>
 #include <EEPROM.h>
 #include <math.h>
@@ -18,6 +26,7 @@
 #define MEASURE_ELECTRICAL_CURRENT_AMPERE (0x50)
 #define MEASURE_ELECTRICAL_ENERGY_KHW (0x70)
 #define MEASURE_ENERGY_COST_REAIS (0x80)
+#define MEASURE_THD_PERCENT (0x90)
 
 /* Chave bipolar */
 #define SWT1 (3)
@@ -26,6 +35,50 @@
 /* Período de publicação, em segundos */
 #define MESSAGE_SAMPLE_RATE (60u)
 
+/* Publicação por exceção: a cada período, o intervalo só é publicado se mudou além da banda morta */
+/* Padrões; configuráveis em /energy.json */
+#define IOT_REPORT_DEFAULT_BAND_PERCENT (10u)  /* Variação relativa ao último publicado, em % */
+#define IOT_REPORT_DEFAULT_BAND_CURRENT (0.1f) /* Variação mínima de corrente, em A */
+#define IOT_REPORT_DEFAULT_BAND_POWER (20.0f)  /* Variação mínima de potência real, em W */
+#define IOT_REPORT_DEFAULT_MAX_SILENCE (900u)  /* Publica ao menos a cada, em segundos */
+#define IOT_REPORT_DEFAULT_MIN_SPACING (60u)   /* Publica no máximo a cada, em segundos */
+
+/* Publicação em lote: os intervalos acumulam e seguem numa única requisição */
+#define IOT_BATCH_INTERVALS (5u)     /* Intervalos por requisição */
+#define IOT_BATCH_MAX_LATENCY (300u) /* Espera máxima do intervalo mais antigo, em segundos */
+#define IOT_BATCH_POOL_SIZE (30u)    /* Valores retidos (intervalos x medidas x canais) */
+
+/* Formato do conteúdo publicado: JSON legível, ou um registro binário por intervalo em base64 */
+/* (PackedRecord.h; decodificador de referência em tools/packed_decode.py) */
+#define IOT_FORMAT_JSON (0)
+#define IOT_FORMAT_PACKED (1)
+#define IOT_PAYLOAD_FORMAT IOT_FORMAT_JSON
+
+/* Destino da publicação: PATCH HTTPS no Firebase, ou MQTT 3.1.1 num broker (sessão persistente) */
+#define IOT_UPLINK_FIREBASE (0)
+#define IOT_UPLINK_MQTT (1)
+#define IOT_UPLINK IOT_UPLINK_FIREBASE
+
+/* MQTT: broker em espUrl.host; usuário espUrl.client, senha espUrl.auth, client id FIREBASE_SOURCE_ID */
+/* Tópicos: <prefixo><FIREBASE_SOURCE_ID>/<canal>, ou .../packed em IOT_FORMAT_PACKED */
+#ifndef MQTT_PORT
+#define MQTT_PORT (8883u)
+#endif
+#ifndef MQTT_SSL
+#define MQTT_SSL (1)
+#endif
+#ifndef MQTT_TOPIC_PREFIX
+#define MQTT_TOPIC_PREFIX "em/"
+#endif
+#define MQTT_QOS (1u)          /* 1: o lote é liberado após o PUBACK de todas as publicações */
+#define MQTT_KEEP_ALIVE (300u) /* s; ociosa, a sessão envia PINGREQ na metade */
+
+/* Servidor local */
+#define WEB_PATH_SIZE (16u)         /* Maior rota, com o '\0'; as mais longas não correspondem a nenhuma */
+#define WEB_REQUEST_TIMEOUT (2000u) /* Requisição completa, em ms */
+#define WEB_LONG_POLL_TIMEOUT (10000u) /* "?wait" sem nova medida/captura: responde com o estado atual */
+#define WEB_QUEUE_RESERVE (4u)         /* Comandos AT livres deixados para a publicação */
+
 /* Período para atualizar a timestamp, em segundos */
 #define TIMESTAMP_REFRESH_TIME (21600u)
 
@@ -33,36 +86,155 @@
 #define EEPROM_ESP_AP_OFFSET (0)
 #define EEPROM_ESP_URL_OFFSET (1 * EEPROM.length() / 3)
 #define EEPROM_ENERGY_OFFSET (2 * EEPROM.length() / 3)
+#define EEPROM_CHANNELS_OFFSET (EEPROM_ENERGY_OFFSET + sizeof(Energy::Config) + 1)
+#define EEPROM_REPORT_OFFSET (EEPROM_CHANNELS_OFFSET + sizeof(ChannelMap) + 1)
+#define EEPROM_UART_OFFSET (EEPROM_REPORT_OFFSET + sizeof(IOT_report_t) + 1)
+#define EEPROM_BACKLOG_OFFSET (EEPROM_UART_OFFSET + sizeof(UART_link_t) + 1)
+#define EEPROM_BACKLOG_RECORDS_OFFSET (EEPROM_BACKLOG_OFFSET + sizeof(IOT_backlog_t) + 1) /* Até o fim da EEPROM */
 
 /* LDC */
 #define LCD_ENABLE
 #define LCD_REFRESH_MEASURE
 
+/* Captura sob demanda das amostras (/waveform.json); custa WAVEFORM_BUFFER_SIZE + 14 bytes de RAM */
+// #define WAVEFORM_ENABLE
+
 /* Canais */
 #define CHANNEL_1 (0)
-#define CHANNEL_2 (1)
-#define CHANNEL_SIZE (2)
+#define CHANNEL_MAX ACQUISITION_MAX_CHANNELS
+static_assert(CHANNEL_MAX >= 2 && CHANNEL_MAX <= 8, "CHANNEL_MAX: 2 to 8 channels");
 
 /*************************************************************************************
   Private variables
 *************************************************************************************/
 /* Módulo WiFi ESP8266 */
+/* Serial com buffer de recepção por interrupção; o 'Serial' do core não é usado */
 /* Pino de Enable = 2 */
-static ESP8266 esp(ESP_ENABLE_PIN);
-static ESP8266::esp_URL_parameter_t espUrl = {
+static BufferedSerial espSerial;
+static ESP8266 esp(ESP_ENABLE_PIN, espSerial);
+static ESP8266::esp_URL_parameter_t espUrl; /* Da EEPROM, ou o padrão abaixo (EEPROM_load()) */
+static ESP8266::esp_AP_parameter_t espAp;
+static const ESP8266::esp_URL_parameter_t espUrlDefault PROGMEM = {
     FIREBASE_HOST,
     FIREBASE_AUTH,
     FIREBASE_CLIENT};
-static ESP8266::esp_AP_parameter_t espAp = {
+static const ESP8266::esp_AP_parameter_t espApDefault PROGMEM = {
     ESP_CLIENT_SSID,
     ESP_CLIENT_PASSWORD,
 };
 
+/* Taxa da serial do ESP: negociada após cada reset do módulo, a partir de ESP_BAUD_RATE */
+/* Candidatas em ordem crescente; 230400 fica de fora (3,5% de erro a 16 MHz) */
+static const uint32_t uartRates[] PROGMEM = {115200ul, 250000ul, 500000ul, 1000000ul};
+#define UART_RATE_COUNT (sizeof(uartRates) / sizeof(uartRates[0]))
+
+/* A escrita na serial é bloqueante: cada parte de um envio cabe na folga do anel do ADS1115 */
+#define UART_SEND_SLACK (20u)         /* ms, dos ~37ms de ADS1115_RING_BUFFER_SIZE a 860 SPS */
+#define UART_SEND_MAX (2047u)         /* Maior AT+CIPSENDEX */
+#define UART_SEND_CHUNK_FRAMING (12u) /* "<tamanho>\r\n", "\r\n" e o "0\r\n\r\n" final */
+
+/* Resultado da última negociação, salvo na EEPROM: a próxima tenta a mesma taxa primeiro */
+struct UART_link_t
+{
+  uint32_t rate;           /* Taxa em uso */
+  uint16_t framingErrors;  /* Na negociação: bytes sem stop bit e perdidos, nas taxas testadas */
+  uint16_t overflowErrors;
+  uint8_t rejected;        /* Taxas que falharam na negociação */
+};
+static UART_link_t uartLink = {ESP_BAUD_RATE, 0, 0, 0};
+static uint16_t uartRecoveries = 0; /* Módulo reiniciado durante a operação: de volta à taxa padrão */
+static Timer uartTimer = Timer();
+
+/* Negociação e recuperação: uma etapa por loop, nos comandos da fila do ESP */
+enum UART_state_t
+{
+  UART_IDLE = 0,
+  UART_PROBING_DEFAULT, /* Recuperação: o módulo responde na taxa padrão? */
+  UART_RESETTING,       /* Pino de reset em nível baixo */
+  UART_BOOTING,         /* Inicialização do módulo após o reset */
+  UART_CONFIGURING,     /* Módulo na taxa padrão, configurado de novo */
+  UART_STARTING,        /* Servidor local reiniciado */
+  UART_SWITCHING,       /* AT+UART_CUR da candidata */
+  UART_SETTLING,        /* Serial na candidata, antes das sondas */
+  UART_TESTING,         /* Sondas AT+GMR na candidata */
+  UART_RETURNING,       /* Candidata rejeitada: AT+UART_CUR da última taxa boa */
+  UART_RETURNED,        /* Serial na última taxa boa, antes da sonda */
+  UART_CHECKING         /* Sonda na última taxa boa */
+};
+static uint8_t uartState = UART_IDLE;
+static ESP8266::esp_future_t uartFuture;
+static Timer uartStepTimer = Timer();
+static uint32_t uartSaved = 0;      /* Taxa da negociação anterior, tentada primeiro */
+static uint32_t uartCandidate = 0;
+static bool uartTryingSaved = false; /* A candidata é a taxa salva */
+static uint8_t uartNext = 0;         /* Próxima candidata de uartRates */
+static bool uartSettled = false;     /* Fim da escada: a taxa salva passou ou uma candidata falhou */
+static bool uartRecovering = false;  /* Durante a operação: o servidor local é reiniciado após um reset */
+static uint8_t uartProbes = 0;
+static uint16_t uartFramingMark = 0;
+static uint16_t uartOverflowMark = 0;
+
 /* LCD 16x2 */
 static LiquidCrystal lcd(10, 11, 6, 7, 8, 9);
 
-/* Energia para cada canal */
-static Energy energy[CHANNEL_SIZE] = {Energy(CHANNEL_1), Energy(CHANNEL_2)};
+/* Sessão de aquisição dos ADS1115 (e do ADC interno, com ACQUISITION_INTERNAL_ADC), compartilhada pelos canais */
+static Acquisition acquisition;
+
+/* Mapa de canais: entrada (dispositivo + mux) de cada canal, ver ACQUISITION_INPUT() */
+/* ou pino do ADC interno com ACQUISITION_INTERNAL_ADC, ver ACQUISITION_INPUT_INTERNAL() (ex.: 128 = A0) */
+/* Padrão: A0 - A1 e A2 - A3 do ADS1115 em ADDR_GND, sem entrada de tensão */
+/* Tensão: mux simples de um ADS1115 só seu, ver Acquisition::setVoltageInput() */
+struct ChannelMap
+{
+  uint8_t count;
+  uint8_t input[CHANNEL_MAX];
+  uint8_t voltage; /* ACQUISITION_INPUT_NONE = lineVoltage e powerFactor nominais */
+};
+static ChannelMap channelMap = {
+    2,
+    {ACQUISITION_INPUT(0, ADS1115::MUX_0_1), ACQUISITION_INPUT(0, ADS1115::MUX_2_3)},
+    ACQUISITION_INPUT_NONE,
+};
+
+/* Energia para cada canal, até CHANNEL_MAX */
+static Energy energy[CHANNEL_MAX] = {
+    Energy(acquisition, 0),
+    Energy(acquisition, 1),
+#if CHANNEL_MAX > 2
+    Energy(acquisition, 2),
+#endif
+#if CHANNEL_MAX > 3
+    Energy(acquisition, 3),
+#endif
+#if CHANNEL_MAX > 4
+    Energy(acquisition, 4),
+#endif
+#if CHANNEL_MAX > 5
+    Energy(acquisition, 5),
+#endif
+#if CHANNEL_MAX > 6
+    Energy(acquisition, 6),
+#endif
+#if CHANNEL_MAX > 7
+    Energy(acquisition, 7),
+#endif
+};
+static uint8_t channelCount = 0;
+
+#ifdef ENERGY_HARMONICS
+/* Filtros de harmônicas apenas dos primeiros canais configurados; nos demais, THD = NAN */
+static Energy::Harmonics harmonics[min(ENERGY_HARMONIC_CHANNELS, CHANNEL_MAX)];
+#endif
+
+#ifdef ENERGY_VOLTAGE
+/* Potência real apenas dos primeiros canais do ADS1115 pareado; nos demais, tensão e potência = NAN */
+static Energy::Power power[min(ENERGY_VOLTAGE_CHANNELS, CHANNEL_MAX)];
+#endif
+
+#ifdef WAVEFORM_ENABLE
+/* Captura sob demanda das amostras de uma janela de cada canal: /waveform.json */
+static WaveformCapture waveform;
+#endif
 
 /* Timestamp atual */
 static uint32_t timestamp = 0;
@@ -71,26 +243,289 @@ static uint32_t timestamp = 0;
 static Timer timestampTimer = Timer();
 static Timer publishTimer = Timer();
 
+/* Publicação assíncrona: cada etapa enfileira comandos AT e aguarda 'iotFuture' */
+/* A conexão SSL é mantida aberta entre publicações e refeita apenas após falha */
+enum IOT_state_t
+{
+  IOT_IDLE = 0,
+  IOT_CHECKING,
+  IOT_CONNECTING,
+  IOT_SENDING,
+  IOT_RECEIVING,
+  IOT_CLOSING,
+  IOT_SESSION, /* MQTT: CONNECT enviado, aguardando o CONNACK */
+  IOT_PINGING  /* MQTT: PINGREQ enviado, aguardando o PINGRESP */
+};
+static uint8_t iotState = IOT_IDLE;
+static bool iotConnected = false;
+static uint32_t iotStartMillis = 0; /* Duração da publicação, mostrada ao final */
+static Timer iotTimer = Timer();
+static ESP8266::esp_future_t iotFuture;
+static ESP8266::esp_future_t timestampFuture;
+static bool timestampRequested = false;
+
+/* Medidas publicadas, em ordem; na flash, lidas por IOT_measure() */
+struct IOT_measure_t
+{
+  float (Energy::*getter)(void);
+  uint8_t type;
+  char path[8];  /* Em /users/<client>/measures/ */
+  bool additive; /* Soma dos canais tem sentido; razões (THD, fator de potência) não */
+};
+static const IOT_measure_t iotMeasures[] PROGMEM = {
+    {&Energy::getElectricCurrentAmperes, MEASURE_ELECTRICAL_CURRENT_AMPERE, "current", true},
+    {&Energy::getEnergyAccumulatedKiloWattsHour, MEASURE_ELECTRICAL_ENERGY_KHW, "energy", true},
+    {&Energy::getCostAccumulatedReais, MEASURE_ENERGY_COST_REAIS, "cost", true},
+#ifdef ENERGY_HARMONICS
+    {&Energy::getThd, MEASURE_THD_PERCENT, "thd", false}, /* Da última janela do intervalo */
+#endif
+};
+#define IOT_MEASURE_COUNT (sizeof(iotMeasures) / sizeof(iotMeasures[0]))
+
+/* Intervalos ainda não publicados, os mais antigos; com canais demais, o lote tem menos intervalos */
+/* Após falha, os intervalos permanecem e o excedente segue para a EEPROM */
+struct IOT_batch_t
+{
+  uint8_t count;
+  uint8_t sent; /* Intervalos na requisição em andamento */
+  uint32_t seqNumber[IOT_BATCH_INTERVALS];
+  uint32_t timestamp[IOT_BATCH_INTERVALS];
+  float values[IOT_BATCH_POOL_SIZE]; /* [intervalo][medida][canal] */
+};
+static IOT_batch_t iotBatch;
+static uint32_t iotSeqNumber = 0; /* Do próximo intervalo */
+
+/* Intervalo como gravado na EEPROM: apenas os valores dos canais ativos */
+struct IOT_record_t
+{
+  uint32_t seqNumber;
+  uint32_t timestamp;
+  float values[IOT_MEASURE_COUNT * CHANNEL_MAX];
+};
+
+/* Fila circular de registros na EEPROM, após a configuração; sobrevive a um reset */
+struct IOT_backlog_t
+{
+  uint8_t head;
+  uint8_t count;
+  uint8_t recordSize; /* Muda com o número de canais: a fila é descartada */
+};
+static IOT_backlog_t iotBacklog;
+
+/* Estatísticas da fila */
+static uint16_t iotDropped = 0;          /* Intervalos perdidos: fila cheia ou registro corrompido */
+static bool iotDraining = false;         /* Fila acumulada: o lote seguinte sai sem aguardar o período */
+static uint16_t iotDrained = 0;          /* Intervalos publicados na última recuperação */
+static uint32_t iotDrainStartMillis = 0;
+static uint32_t iotDrainMillis = 0;      /* Duração da última recuperação */
+static uint32_t iotPayloadBytes = 0;     /* Bytes da última requisição, escritos na UART */
+static uint32_t iotPayloadMicros = 0;    /* Tempo de escrita da última requisição */
+static uint32_t iotLatencyMillis = 0;    /* Da última publicação confirmada, desde IOT_connect() */
+static uint16_t iotSendNext = 0;         /* Lote em partes: próxima unidade do corpo, ou pacote MQTT */
+
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+/* Sessão MQTT sobre a conexão da nuvem: as respostas do broker são lidas a cada loop */
+static MqttClient mqtt;
+static uint8_t mqttConnack = 0xFF;  /* Código do CONNACK; 0xFF = ainda não recebido */
+static uint8_t mqttPending = 0;     /* Publicações do lote sem PUBACK */
+static bool mqttPinging = false;    /* PINGREQ sem PINGRESP */
+static Timer mqttTimer = Timer();   /* Desde o último pacote enviado ao broker */
+
+/* Publicação em andamento: um intervalo do lote e um canal */
+struct MQTT_publish_t
+{
+  uint8_t interval;
+  uint8_t channel;
+};
+#endif
+
+/* Política de publicação por exceção: publica quando a corrente ou a potência de algum canal */
+/* se afasta do último valor publicado mais do que a maior das bandas (percentual ou absoluta) */
+struct IOT_report_t
+{
+  uint8_t bandPercent; /* 0 = apenas a banda absoluta */
+  float bandCurrent;   /* A */
+  float bandPower;     /* W, apenas nos canais com entrada de tensão */
+  uint16_t maxSilence; /* s; MESSAGE_SAMPLE_RATE ou menos = todo intervalo é publicado */
+  uint16_t minSpacing; /* s */
+};
+static IOT_report_t iotReport = {
+    IOT_REPORT_DEFAULT_BAND_PERCENT,
+    IOT_REPORT_DEFAULT_BAND_CURRENT,
+    IOT_REPORT_DEFAULT_BAND_POWER,
+    IOT_REPORT_DEFAULT_MAX_SILENCE,
+    IOT_REPORT_DEFAULT_MIN_SPACING,
+};
+static float iotReportedCurrent[CHANNEL_MAX]; /* Valores do último intervalo publicado */
+static float iotReportedPower[CHANNEL_MAX];
+static uint32_t iotReportTimestamp = 0; /* 0 = nenhum ainda */
+static uint16_t iotReportsSent = 0;       /* Intervalos publicados e suprimidos desde o reset */
+static uint16_t iotReportsSuppressed = 0;
+
+/* Servidor local: cada conexão avança a sua requisição a cada loop, sem bloquear a medição */
+/* A resposta vai no AT+CIPSENDEX da própria conexão, que é a única encerrada ao final */
+enum WEB_state_t
+{
+  WEB_FREE = 0,
+  WEB_METHOD,     /* Linha de requisição */
+  WEB_PATH,
+  WEB_QUERY,
+  WEB_HEADERS,    /* Até "\r\n\r\n" */
+  WEB_BODY,       /* Headers recebidos; POST: corpo JSON */
+  WEB_WAITING,    /* Long-poll: aguardando a próxima medida ou o fim da captura */
+  WEB_RESPONDING, /* Aguardando espaço na fila de comandos */
+  WEB_SENDING,
+  WEB_CLOSING
+};
+enum WEB_method_t
+{
+  WEB_GET = 0,
+  WEB_POST,
+  WEB_OTHER
+};
+enum WEB_route_t
+{
+  WEB_ROUTE_NONE = 0,
+  WEB_ROUTE_WIFI,
+  WEB_ROUTE_SERVERS,
+  WEB_ROUTE_ENERGY,
+  WEB_ROUTE_QUEUE,
+  WEB_ROUTE_MEASURES,
+  WEB_ROUTE_WAVEFORM
+};
+enum WEB_status_t
+{
+  WEB_200_OK = 0,
+  WEB_204_NO_CONTENT,
+  WEB_400_BAD_REQUEST,
+  WEB_404_NOT_FOUND,
+  WEB_405_METHOD_NOT_ALLOWED
+};
+/* Método ou rota aceitos na linha da requisição */
+struct WEB_name_t
+{
+  char name[WEB_PATH_SIZE];
+  uint8_t route;   /* WEB_route_t */
+  uint8_t methods; /* Bits de WEB_method_t aceitos */
+};
+struct WEB_link_t
+{
+  uint8_t state;
+  uint8_t method; /* Linha: candidatos em webMethods */
+  uint8_t route;  /* Linha: candidatos em webRoutes */
+  uint8_t status;
+  bool wait;      /* "?wait": long-poll */
+  uint8_t length; /* Linha: caracteres do item; query: de "wait"; headers: bytes de "\r\n\r\n"; long-poll: medida */
+  uint16_t unit;  /* Resposta: primeira unidade do corpo na próxima parte (JsonWriter::writeChunk()) */
+  Timer timer;    /* Desde o primeiro byte da requisição */
+  ESP8266::esp_future_t future;
+};
+static WEB_link_t webLinks[ESP_MAX_LINKS];
+static uint8_t webMeasureSequence = 0; /* Medidas concluídas: acorda os long-polls */
+
+/* /energy.json é lido numa cópia, aplicada apenas se o corpo inteiro for válido */
+struct WEB_energy_t
+{
+  Energy::Config config;
+  ChannelMap channels;
+  IOT_report_t report;
+};
+
+/* Um POST por vez: os demais aguardam no buffer da sua conexão */
+/* /wifi.json e /servers.json são lidos no próprio espAp/espUrl: sem cópia, restaurados se não aplicados */
+static uint8_t webPostLink = ESP_NO_LINK;
+static WEB_energy_t webPostEnergy;
+static JsonReader webReader(NULL, 0, NULL);
+static const char *webPostError = NULL; /* Campo do 400 */
+
 /*************************************************************************************
   Public prototypes
 *************************************************************************************/
-bool IOT_send_GET(const char *path, const char *query, const char *host);
-bool IOT_send_POST(float value, uint32_t timestamp);
+void UART_negotiate(void);
+void UART_start(void);
+void UART_advance(void);
+void UART_accept(void);
+void UART_reject(void);
+void UART_recover(void);
+void UART_poll(void);
+bool UART_busy(void);
+uint16_t UART_send_size(void);
+uint16_t UART_send_space(uint16_t written);
 
-void WEB_init(void);
-bool WEB_process_GET(uint8_t connection, char *path, char *parameters, uint32_t parametersSize);
-bool WEB_process_POST(uint8_t connection, char *path, char *body, uint32_t bodySize);
+bool IOT_send_GET(const char *path, const char *query, const char *host);
+bool IOT_connect(void);
+void IOT_poll(void);
+void IOT_disconnect(void);
+void IOT_finish(bool ok);
+bool IOT_send_measures(void);
+void IOT_write_PATCH(Stream &serial, const void *context);
+IOT_measure_t IOT_measure(uint8_t index);
+uint8_t IOT_batch_capacity(void);
+bool IOT_send_part(void);
+bool IOT_send_pending(void);
+void IOT_batch_add(uint32_t intervalTimestamp);
+bool IOT_report_due(void);
+bool IOT_report_changed(float value, float reported, float band);
+void IOT_batch_store(const IOT_record_t *record);
+bool IOT_batch_due(void);
+void IOT_batch_release(uint8_t count);
+void IOT_batch_confirm(void);
+void IOT_backlog_init(void);
+uint8_t IOT_backlog_capacity(void);
+int IOT_backlog_address(uint8_t slot);
+bool IOT_backlog_push(const IOT_record_t *record);
+bool IOT_backlog_pop(IOT_record_t *record);
+void IOT_write_body(JsonWriter &json, const void *context);
+
+bool MQTT_send_connect(void);
+void MQTT_write_CONNECT(Stream &serial, const void *context);
+bool MQTT_send_publish(void);
+void MQTT_write_PUBLISH(Stream &serial, const void *context);
+bool MQTT_send_part(void);
+void MQTT_write_packets(Print &out, uint8_t first, uint8_t last);
+void MQTT_write_topic(Print &out, const void *context);
+void MQTT_write_payload(Print &out, const void *context);
+uint8_t MQTT_packets_per_interval(void);
+bool MQTT_send_ping(void);
+void MQTT_write_PINGREQ(Stream &serial, const void *context);
+void MQTT_receive(void);
+
+void WEB_event(uint8_t event);
+void WEB_poll(void);
+void WEB_serve(uint8_t link);
+void WEB_parse(WEB_link_t *web, char received);
+uint8_t WEB_match(const WEB_name_t *names, uint8_t count, uint8_t candidates, uint8_t position, char received);
+void WEB_process_GET(uint8_t link);
+void WEB_process_POST(uint8_t link);
+bool WEB_post_reading(uint8_t route);
+void WEB_apply_POST(uint8_t link);
+void WEB_respond(uint8_t link, uint8_t status);
+void WEB_release(uint8_t link);
+bool WEB_valid_input(float value);
+bool WEB_valid_voltage(float value);
+
+void JSON_array(JsonWriter &json, const __FlashStringHelper *key, float (Energy::*getter)(void), uint8_t digits);
+void WEB_write_response(Stream &serial, const void *context);
+JsonWriter::json_body_t WEB_body(uint8_t route);
+void WEB_body_wifi(JsonWriter &json, const void *context);
+void WEB_body_server(JsonWriter &json, const void *context);
+void WEB_body_energy(JsonWriter &json, const void *context);
+void WEB_body_queue(JsonWriter &json, const void *context);
+void WEB_body_measures(JsonWriter &json, const void *context);
+#ifdef WAVEFORM_ENABLE
+void WEB_body_waveform(JsonWriter &json, const void *context);
+#endif
 
-bool WEB_chunk_init(uint8_t connection);
-void WEB_chunk_send(char *chuck);
-bool WEB_chunk_finish(void);
-bool WEB_headers(uint8_t connection);
+float ENERGY_total(float (Energy::*getter)(void));
+void WEB_body_error(JsonWriter &json, const void *context);
 
 void serial_flush(void);
-bool serial_get(const char *stringChecked, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize);
+bool serial_get(const __FlashStringHelper *stringChecked, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize);
+uint8_t serial_match(ResponseMatcher &matcher, uint8_t link, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize);
 
 bool EEPROM_write(const uint8_t *buffer, int size, int addr);
 bool EEPROM_read(uint8_t *buffer, int size, int addr);
+bool EEPROM_load(void *buffer, int size, int addr, const void *defaults);
 
 /* Converts a hex character to its integer value */
 char from_hex(char ch);
@@ -100,6 +535,58 @@ void url_decode(char *str, char *decoded, int size);
 void str_safe(char *str, uint32_t size);
 void LCD_print(const __FlashStringHelper *line1, const __FlashStringHelper *line2, uint32_t delayMs = 0);
 
+/* Campos aceitos pelos POST de configuração; os ausentes mantêm o valor atual */
+static const JsonReader::json_field_t webWifiFields[] PROGMEM = {
+    {"ssid", JsonReader::JSON_STRING, sizeof(espAp.ssid), offsetof(ESP8266::esp_AP_parameter_t, ssid), 0, 0, NULL},
+    {"password", JsonReader::JSON_STRING, sizeof(espAp.password), offsetof(ESP8266::esp_AP_parameter_t, password), 0, 0, NULL},
+};
+static const JsonReader::json_field_t webServerFields[] PROGMEM = {
+    {"host", JsonReader::JSON_STRING, sizeof(espUrl.host), offsetof(ESP8266::esp_URL_parameter_t, host), 0, 0, NULL},
+    {"auth", JsonReader::JSON_STRING, sizeof(espUrl.auth), offsetof(ESP8266::esp_URL_parameter_t, auth), 0, 0, NULL},
+    {"client", JsonReader::JSON_STRING, sizeof(espUrl.client), offsetof(ESP8266::esp_URL_parameter_t, client), 0, 0, NULL},
+};
+static const JsonReader::json_field_t webEnergyFields[] PROGMEM = {
+    {"dataSize", JsonReader::JSON_UINT, 2, offsetof(WEB_energy_t, config.dataSize), 1, 60000, NULL},
+    {"scale", JsonReader::JSON_UINT, 2, offsetof(WEB_energy_t, config.scale), 1, 1000, NULL},
+    {"lineVoltage", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, config.lineVoltage), 1, 255, NULL},
+    {"powerFactor", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, config.powerFactor), 1, 100, NULL},
+    {"basePrice", JsonReader::JSON_FLOAT, 4, offsetof(WEB_energy_t, config.basePrice), 0, 100, NULL},
+    {"flagPrice", JsonReader::JSON_FLOAT, 4, offsetof(WEB_energy_t, config.flagPrice), 0, 100, NULL},
+    {"windowCycles", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, config.windowCycles), 0, 200, NULL},
+    {"channels", JsonReader::JSON_BYTE_ARRAY, CHANNEL_MAX, offsetof(WEB_energy_t, channels), 0, 255, WEB_valid_input},
+    {"voltage", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, channels.voltage), 0, 255, WEB_valid_voltage},
+    {"voltageScale", JsonReader::JSON_UINT, 2, offsetof(WEB_energy_t, config.voltageScale), 1, 1000, NULL},
+    {"phaseCal", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, config.phaseCal), 0, 200, NULL},
+    {"bandPercent", JsonReader::JSON_UINT, 1, offsetof(WEB_energy_t, report.bandPercent), 0, 100, NULL},
+    {"bandCurrent", JsonReader::JSON_FLOAT, 4, offsetof(WEB_energy_t, report.bandCurrent), 0, 100, NULL},
+    {"bandPower", JsonReader::JSON_FLOAT, 4, offsetof(WEB_energy_t, report.bandPower), 0, 100000, NULL},
+    {"maxSilence", JsonReader::JSON_UINT, 2, offsetof(WEB_energy_t, report.maxSilence), 0, 65535, NULL},
+    {"minSpacing", JsonReader::JSON_UINT, 2, offsetof(WEB_energy_t, report.minSpacing), 0, 65535, NULL},
+};
+#define WEB_ENERGY_CHANNELS_FIELD (7u) /* Índice de "channels" em webEnergyFields */
+#define WEB_ENERGY_VOLTAGE_FIELD (8u)  /* Índice de "voltage" */
+#define WEB_FIELD_COUNT(fields) ((uint8_t)(sizeof(fields) / sizeof(fields[0])))
+
+/* Métodos e rotas, comparados a cada byte recebido: a linha da requisição não é guardada */
+static const WEB_name_t webMethods[] PROGMEM = {
+    {"GET", WEB_ROUTE_NONE, 0},
+    {"POST", WEB_ROUTE_NONE, 0},
+};
+static const WEB_name_t webRoutes[] PROGMEM = {
+    {"/wifi.json", WEB_ROUTE_WIFI, _BV(WEB_GET) | _BV(WEB_POST)},
+    {"/server.json", WEB_ROUTE_SERVERS, _BV(WEB_GET)}, /* Servidores: GET em /server.json, POST em /servers.json */
+    {"/servers.json", WEB_ROUTE_SERVERS, _BV(WEB_POST)},
+    {"/energy.json", WEB_ROUTE_ENERGY, _BV(WEB_GET) | _BV(WEB_POST)},
+    {"/queue.json", WEB_ROUTE_QUEUE, _BV(WEB_GET)}, /* Fila de publicação e medidas: apenas leitura */
+    {"/measures.json", WEB_ROUTE_MEASURES, _BV(WEB_GET)},
+#ifdef WAVEFORM_ENABLE
+    {"/waveform.json", WEB_ROUTE_WAVEFORM, _BV(WEB_GET)},
+#endif
+};
+#define WEB_NAME_COUNT(names) ((uint8_t)(sizeof(names) / sizeof(names[0])))
+#define WEB_ALL_NAMES (0xFFu) /* Candidatos no início de cada item: até 8 nomes por tabela */
+static_assert(WEB_NAME_COUNT(webRoutes) <= 8, "WEB: up to 8 routes");
+
 /* Soft Reset */
 void (*softReset)(void) = 0;
 
@@ -116,6 +603,9 @@ void setup()
   lcd.begin(16, 2);
 #endif
 
+  /* Barramento I2C do ADS1115 */
+  TwiMaster::begin(ADS1115_I2C_CLOCK);
+
 #ifdef FREE_MEMORY_DISPLAY
 #ifdef LCD_ENABLE
   /* Imprime a quantidade de memória disponível */
@@ -127,6 +617,12 @@ void setup()
 #endif
 #endif
 
+  /* Inicializa serial do ESP em 57600 baud/s */
+  espSerial.begin(ESP_BAUD_RATE);
+#ifdef ESP_FLOW_CONTROL
+  espSerial.setFlowControl(ESP_RTS_PIN);
+#endif
+
   /* Configuração inicial do ESP */
   if (!esp.config())
   {
@@ -138,8 +634,24 @@ void setup()
   }
   LCD_print(F("ESP CONFIG:"), F("OK"), 1000);
 
+#ifdef ESP_BAUD_NEGOTIATE
+  /* Obtém a última taxa da EEPROM, caso haja, e negocia a partir dela */
+  EEPROM_read((uint8_t *)&uartLink, sizeof(uartLink), EEPROM_UART_OFFSET);
+  UART_negotiate();
+
+#ifdef LCD_ENABLE
+  lcd.clear();
+  lcd.print(F("UART: "));
+  lcd.print(uartLink.rate);
+  lcd.setCursor(0, 1);
+  lcd.print(F("REJECTED: "));
+  lcd.print(uartLink.rejected);
+  delay(1000);
+#endif
+#endif
+
   /* Obtém AP da EEPROM, caso haja */
-  if (EEPROM_read((uint8_t *)&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET))
+  if (EEPROM_load(&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET, &espApDefault))
     LCD_print(F("EEPROM FOUND:"), F("AP"), 1000);
   else
     LCD_print(F("EEPROM NOT FOUND:"), F("AP"), 1000);
@@ -186,7 +698,7 @@ void setup()
 #endif
 
   /* Obtém SERVER da EEPROM, caso haja */
-  if (EEPROM_read((uint8_t *)&espUrl, sizeof(espUrl), EEPROM_ESP_URL_OFFSET))
+  if (EEPROM_load(&espUrl, sizeof(espUrl), EEPROM_ESP_URL_OFFSET, &espUrlDefault))
     LCD_print(F("EEPROM FOUND:"), F("SERVER"), 1000);
   else
     LCD_print(F("EEPROM NOT FOUND:"), F("SERVER"), 1000);
@@ -207,8 +719,9 @@ void setup()
   /* Obtém ENERGY da EEPROM, caso haja */
   if (EEPROM_read((uint8_t *)&energy[CHANNEL_1].config, sizeof(energy[CHANNEL_1].config), EEPROM_ENERGY_OFFSET))
   {
-    /* Duplica para o segundo canal */
-    energy[CHANNEL_2].config = energy[CHANNEL_1].config;
+    /* Duplica para os demais canais */
+    for (uint8_t i = 1; i < CHANNEL_MAX; i++)
+      energy[i].config = energy[CHANNEL_1].config;
     LCD_print(F("EEPROM FOUND:"), F("ENERGY"), 1000);
   }
   else
@@ -241,9 +754,66 @@ void setup()
   delay(3000);
 #endif
 
+  /* Obtém mapa de CANAIS da EEPROM, caso haja */
+  if (EEPROM_read((uint8_t *)&channelMap, sizeof(channelMap), EEPROM_CHANNELS_OFFSET))
+    LCD_print(F("EEPROM FOUND:"), F("CHANNELS"), 1000);
+  else
+    LCD_print(F("EEPROM NOT FOUND:"), F("CHANNELS"), 1000);
+
+  /* Obtém política de PUBLICAÇÃO da EEPROM, caso haja */
+  if (EEPROM_read((uint8_t *)&iotReport, sizeof(iotReport), EEPROM_REPORT_OFFSET))
+    LCD_print(F("EEPROM FOUND:"), F("REPORT"), 1000);
+  else
+    LCD_print(F("EEPROM NOT FOUND:"), F("REPORT"), 1000);
+
+  /* Configura cada ADS1115 uma única vez; o escalonador troca apenas o mux */
+  /* Entradas inválidas são ignoradas, mantendo energy[i] = canal i */
+  for (uint8_t i = 0; i < channelMap.count && i < CHANNEL_MAX; i++)
+    acquisition.addChannel(channelMap.input[i]);
+  channelCount = acquisition.getChannelCount();
+  if (channelMap.voltage != ACQUISITION_INPUT_NONE && !acquisition.setVoltageInput(channelMap.voltage))
+    LCD_print(F("VOLTAGE INPUT:"), F("IGNORED"), 1000);
+  acquisition.begin();
+#ifdef WAVEFORM_ENABLE
+  for (uint8_t i = 0; i < channelCount; i++)
+    energy[i].setCapture(&waveform);
+#endif
+#ifdef ENERGY_HARMONICS
+  for (uint8_t i = 0; i < channelCount && i < sizeof(harmonics) / sizeof(harmonics[0]); i++)
+    energy[i].setHarmonics(&harmonics[i]);
+#endif
+#ifdef ENERGY_VOLTAGE
+  for (uint8_t i = 0, p = 0; i < channelCount && p < sizeof(power) / sizeof(power[0]); i++)
+  {
+    if (acquisition.hasVoltage(i))
+      energy[i].setPower(&power[p++]);
+  }
+#endif
+
+#ifdef LCD_ENABLE
+  lcd.clear();
+  lcd.print(F("CHANNELS: "));
+  lcd.print(channelCount);
+  delay(1000);
+#endif
+
+  /* Intervalos não publicados antes do reset */
+  IOT_backlog_init();
+
+#ifdef LCD_ENABLE
+  lcd.clear();
+  lcd.print(F("BACKLOG: "));
+  lcd.print(iotBacklog.count);
+  delay(1000);
+#endif
+
   /* Atualiza timestamp inicial */
-  energy[CHANNEL_1].calculate(timestamp);
-  energy[CHANNEL_2].calculate(timestamp);
+  for (uint8_t i = 0; i < channelCount; i++)
+    energy[i].calculate(timestamp);
+
+  /* Servidor local: permanece ativo durante as publicações */
+  if (!esp.server_start())
+    LCD_print(F("ESP SERVER:"), F("ERROR"), 1000);
 
   /* Restaura timer para publicação de dados */
   publishTimer.resetTimer();
@@ -262,7 +832,9 @@ void setup()
 void loop()
 {
   /* Verifica se já passou o período de publicação de dados */
-  if (publishTimer.checkIntervalPassed((uint32_t) MESSAGE_SAMPLE_RATE * 1000u))
+  /* A publicação anterior ou a timestamp ainda em andamento adiam esta */
+  if (iotState == IOT_IDLE && !timestampFuture.isPending() &&
+      publishTimer.checkIntervalPassed((uint32_t) MESSAGE_SAMPLE_RATE * 1000u))
   {
     /* Incrementa a timestamp */
     timestamp += publishTimer.getElapsedTime() / 1000u;
@@ -271,29 +843,58 @@ void loop()
     publishTimer.resetTimer();
 
     /* Finaliza o cálculo de energia elétrica */
-    energy[CHANNEL_1].calculate(timestamp);
-    energy[CHANNEL_2].calculate(timestamp);
-
-    /* Desativa servidor */
-    esp.server_stop();
+    for (uint8_t i = 0; i < channelCount; i++)
+      energy[i].calculate(timestamp);
+
+    /* Acumula o intervalo, se mudou; o lote segue cheio ou quando o mais antigo expira */
+    /* Envia para servidores, sem bloquear a medida */
+    if (IOT_report_due())
+      IOT_batch_add(timestamp);
+    /* Com a serial do módulo mudando de taxa, ou espUrl sendo lido por um POST, o lote segue no próximo período */
+    if (IOT_batch_due() && !UART_busy() && !WEB_post_reading(WEB_ROUTE_SERVERS))
+      IOT_connect();
+  }
 
-    /* Envia para servidores */
+  /* Conectividade de volta: esvazia a fila sem aguardar o período de publicação */
+  if (iotState == IOT_IDLE && iotDraining && !timestampFuture.isPending() && !UART_busy() &&
+      !WEB_post_reading(WEB_ROUTE_SERVERS))
     IOT_connect();
 
-    /* Ativa servidor */
-    esp.server_start();
-
-    serial_flush();
-  }
-
   /* Verifica se passou do período de obter nova timestamp */
-  if (timestampTimer.checkIntervalPassed((uint32_t) TIMESTAMP_REFRESH_TIME * 1000u))
+  if (iotState == IOT_IDLE && !timestampFuture.isPending() && !UART_busy() &&
+      timestampTimer.checkIntervalPassed((uint32_t) TIMESTAMP_REFRESH_TIME * 1000u))
   {
     /* Reseta o timer para obter a timestamp */
     timestampTimer.resetTimer();
 
-    /* Tenta obter nova timestamp do servidor */
-    uint32_t newTimestamp = esp.getUnixTimestamp();
+    /* Solicita nova timestamp do servidor; a resposta chega pelo 'timestampFuture' */
+    timestampRequested = esp.requestUnixTimestamp(&timestampFuture);
+  }
+
+  /* Avança os comandos AT em andamento */
+  esp.poll();
+  IOT_poll();
+
+#ifdef ESP_BAUD_NEGOTIATE
+  /* Módulo mudo na taxa negociada: pode ter reiniciado na taxa padrão */
+  if (!UART_busy() && iotState == IOT_IDLE && esp.isIdle() && uartLink.rate != ESP_BAUD_RATE &&
+      esp.getTimeoutStreak() >= ESP_BAUD_TIMEOUT_STREAK && uartTimer.checkIntervalPassed(ESP_LONG_DELAY))
+    UART_recover();
+  UART_poll();
+#endif
+
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  /* Sessão MQTT ociosa: PINGREQ antes que o broker a encerre */
+  if (iotState == IOT_IDLE && iotConnected && !UART_busy() && mqttTimer.checkIntervalPassed(MQTT_KEEP_ALIVE * 500ul))
+    MQTT_send_ping();
+#endif
+
+  /* Timestamp recebida */
+  if (timestampRequested && !timestampFuture.isPending())
+  {
+    timestampRequested = false;
+
+    uint32_t newTimestamp = timestampFuture.isDone() ? esp.lastUnixTimestamp() : 0;
     if (newTimestamp != 0)
       timestamp = newTimestamp;
 
@@ -302,30 +903,45 @@ void loop()
     lcd.print(F("ESP TIMESTAMP:"));
     lcd.setCursor(0, 1);
     lcd.print(newTimestamp);
-    delay(3000);
 #endif
   }
 
-  /* Verifica se houve conexão ao servidor do ESP8266 */
-  if (Serial.available())
-    WEB_init();
+  /* Servidor local: conexões encerradas pelos clientes e requisições em andamento */
+  /* Aguardam o fim de uma negociação da taxa da serial */
+  uint8_t event;
+  while (!UART_busy() && esp.getEvent(&event))
+    WEB_event(event);
+  if (!UART_busy())
+    WEB_poll();
 
   /* Realiza medida */
-  energy[CHANNEL_1].measure();
-  energy[CHANNEL_2].measure();
+  /* As amostras chegam por interrupção; cada canal fecha sua janela e passa o ADC ao próximo */
+  /* Qualquer janela concluída acorda os long-polls; a tela segue o primeiro canal */
+  bool measured = false;
+  bool firstMeasured = false;
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    if (energy[i].measure())
+    {
+      measured = true;
+      firstMeasured |= (i == CHANNEL_1);
+    }
+  }
+  if (measured)
+    webMeasureSequence++;
 
 #ifdef LCD_ENABLE
 #ifdef LCD_REFRESH_MEASURE
-  /* Mostra na tela a cada 50 interações */
+  /* Mostra na tela a cada 10 medidas */
   uint32_t rmsCount = energy[CHANNEL_1].getRmsCount();
-  if (!(rmsCount % 10))
+  if (firstMeasured && !(rmsCount % 10))
   {
     lcd.clear();
-    lcd.print("I: ");
-    lcd.print(energy[CHANNEL_1].getRmsLast() + energy[CHANNEL_2].getRmsLast(), 1);
-    lcd.print(" A");
+    lcd.print(F("I: "));
+    lcd.print(ENERGY_total(&Energy::getRmsLast), 1);
+    lcd.print(F(" A"));
     lcd.setCursor(0, 1);
-    lcd.print("C: ");
+    lcd.print(F("C: "));
     lcd.print(rmsCount);
   }
 #endif
@@ -336,751 +952,2180 @@ void loop()
 }
 
 /************************************************************************************
-  IOT_connect
+  UART_negotiate
 
-  .
+  Raises the rate of the ESP serial, one candidate at a time, while each one
+  passes its probes; the first failure returns to the last good rate. The
+  rate of the previous negotiation is tried first, skipping the ladder. The
+  module must be at ESP_BAUD_RATE, as after a reset. The result is saved.
+  Runs UART_poll() until it is done: for setup(), before the local server.
 
 ************************************************************************************/
-bool IOT_connect()
+void UART_negotiate()
 {
-  /* Verifica conexão com o ponto de acesso wifi */
-  if (!esp.checkWifi())
+  UART_start();
+  UART_advance();
+  while (UART_busy())
   {
-    LCD_print(F("ESP CONNECT AP:"), F("ERROR"));
-    return false;
+    esp.poll();
+    UART_poll();
+    wdt_reset();
   }
-  LCD_print(F("ESP CONNECT AP:"), F("OK"));
+}
 
-  /* Abre conexão com servidor */
-  if (!esp.connect(espUrl))
-  {
-    LCD_print(F("ESP CONNECT:"), F("ERROR"));
-    esp.close(ESP_CLOSE_ALL);
-    return false;
-  }
-  LCD_print(F("ESP CONNECT:"), F("OK"));
+/************************************************************************************
+  UART_start
 
-  /* Envia conteudo */
-  if (IOT_send_POST(energy[CHANNEL_1].getElectricCurrentAmperes() + energy[CHANNEL_2].getElectricCurrentAmperes(), MEASURE_ELECTRICAL_CURRENT_AMPERE, timestamp) &&
-      IOT_send_POST(energy[CHANNEL_1].getEnergyAccumulatedKiloWattsHour() + energy[CHANNEL_2].getEnergyAccumulatedKiloWattsHour(), MEASURE_ELECTRICAL_ENERGY_KHW, timestamp) &&
-      IOT_send_POST(energy[CHANNEL_1].getCostAccumulatedReais() + energy[CHANNEL_2].getCostAccumulatedReais(), MEASURE_ENERGY_COST_REAIS, timestamp))
-  {
-    LCD_print(F("ESP SEND:"), F("OK"));
-    esp.close(ESP_CLOSE_ALL);
-  }
-  else
-  {
-    LCD_print(F("ESP SEND:"), F("ERROR"));
-    esp.close(ESP_CLOSE_ALL);
-    return false;
-  }
+  Resets the result for a new negotiation from ESP_BAUD_RATE; the rate in
+  use becomes the first candidate.
 
-  return true;
+************************************************************************************/
+void UART_start()
+{
+  uartSaved = uartLink.rate;
+  uartLink.rate = ESP_BAUD_RATE;
+  uartLink.framingErrors = 0;
+  uartLink.overflowErrors = 0;
+  uartLink.rejected = 0;
+  uartNext = 0;
+  uartSettled = false;
 }
 
 /************************************************************************************
-  IOT_send_POST
+  UART_advance
 
-  .
+  Moves the module to the next candidate: the saved rate, then the ladder
+  above the current one. With no candidate left, the result is saved and the
+  negotiation ends.
 
 ************************************************************************************/
-bool IOT_send_POST(float value, uint8_t type, uint32_t timestamp)
+void UART_advance()
 {
-  /* Sequencial number */
-  static uint32_t seqNumber = 0;
-
-  /* ESP8266: Inicializar envio */
-  serial_flush();
-  Serial.print(F("AT+CIPSENDEX=0,2047\r\n"));
-  if (!serial_get(">", 100, NULL, 0)) /* Aguarda '>' */
-    return false;
+  uartCandidate = 0;
+  uartTryingSaved = false;
+  if (!uartSettled)
+  {
+    if (uartSaved > ESP_BAUD_RATE && uartSaved <= ESP_BAUD_MAX)
+    {
+      uartCandidate = uartSaved;
+      uartTryingSaved = true;
+    }
+    uartSaved = 0;
 
-  /* HTTP HEADERS */
-  /* HTTP POST */
-  serial_flush();
-  Serial.print(F("POST /users/"));
-  Serial.print(espUrl.client);
-  Serial.print(F("/measures/"));
-
-  if (type == MEASURE_ELECTRICAL_CURRENT_AMPERE)
-    Serial.print(F("current"));
-  else if (type == MEASURE_ELECTRICAL_ENERGY_KHW)
-    Serial.print(F("energy"));
-  else if (type == MEASURE_ENERGY_COST_REAIS)
-    Serial.print(F("cost"));
-  else
-    return false;
+    while (uartCandidate == 0 && uartNext < UART_RATE_COUNT)
+    {
+      uint32_t rate = pgm_read_dword(&uartRates[uartNext++]);
+      if (rate > uartLink.rate && rate <= ESP_BAUD_MAX)
+        uartCandidate = rate;
+    }
+  }
 
-  Serial.print(F(".json?auth="));
-  Serial.print(espUrl.auth);
-  Serial.print(F(" HTTP/1.1\r\n"));
-  /* Host */
-  Serial.print(F("Host: "));
-  Serial.print(espUrl.host);
-  Serial.print(F("\r\n"));
-  /* Connection */
-  Serial.print(F("Connection: keep-alive\r\n"));
-  /* Chunked */
-  Serial.print(F("Transfer-Encoding: chunked\r\n"));
-  /* Header End */
-  Serial.print(F("\r\n"));
-
-  /* Formata body */
-  char buffer[50];
-  sprintf(buffer, "{\"value\":%s,\r\n", String(value, 5).c_str());
-  Serial.println(strlen(buffer) - 2, HEX);
-  Serial.print(buffer);
-
-  sprintf(buffer, "\"type\":%u,\r\n", type); /* MEASURE_ELECTRICAL_CURRENT_AMPERE : 0x50 / MEASURE_ELECTRICAL_ENERGY_KHW : 0x60 */
-  Serial.println(strlen(buffer) - 2, HEX);
-  Serial.print(buffer);
-
-  sprintf(buffer, "\"seqNumber\":%lu,\r\n", seqNumber++);
-  Serial.println(strlen(buffer) - 2, HEX);
-  Serial.print(buffer);
-
-  sprintf(buffer, "\"timestamp\":%lu,\r\n", timestamp);
-  Serial.println(strlen(buffer) - 2, HEX);
-  Serial.print(buffer);
-
-  sprintf(buffer, "\"device\":\"%s\"}\r\n", FIREBASE_SOURCE_ID);
-  Serial.println(strlen(buffer) - 2, HEX);
-  Serial.print(buffer);
-
-  /* End chunk */
-  Serial.write("0\r\n\r\n");
-
-  /* AT: End Send */
-  Serial.write("\\0");
-
-  /* Return */
-  serial_get("SEND OK", 1000, NULL, 0);
-  if (!serial_get("HTTP/1.1 200 OK\r\n", 1000, NULL, 0))
-    return false;
+  /* O módulo responde na taxa atual e muda em seguida */
+  if (uartCandidate != 0 && esp.setUartRate(uartCandidate, &uartFuture))
+  {
+    uartState = UART_SWITCHING;
+    return;
+  }
 
-  return true;
+  /* Apenas os bytes alterados são gravados */
+  EEPROM_write((uint8_t *)&uartLink, sizeof(uartLink), EEPROM_UART_OFFSET);
+  uartRecovering = false;
+  uartState = UART_IDLE;
 }
 
 /************************************************************************************
-  WEB_init
+  UART_accept
 
-  .
+  Ends the probes of the candidate: every AT+GMR round trip completed,
+  without framing errors or lost bytes. The errors are added to those of
+  the negotiation.
 
 ************************************************************************************/
-void WEB_init()
+void UART_accept()
 {
-  char strBuffer[250];
-  char path[25];
-  uint8_t connection;
-
-  /* Obtém os parâmetros da requisição feita pelo browser */
-  if (!serial_get("HTTP/1.1\r\n", 500, strBuffer, sizeof(strBuffer)))
+  uint16_t framing = espSerial.getFramingErrorCount() - uartFramingMark;
+  uint16_t overflow = espSerial.getOverflowCount() - uartOverflowMark;
+  uartLink.framingErrors += framing;
+  uartLink.overflowErrors += overflow;
+  if (!uartFuture.isDone() || framing != 0 || overflow != 0)
   {
-    /* Fecha todas as conexões */
-    esp.close(ESP_CLOSE_ALL);
+    UART_reject();
     return;
   }
 
-  /* Obtém o index da conexão */
-  char *tkn;
-  strtok(strstr(strBuffer, "+IPD"), ",");
-  tkn = strtok(NULL, ",");
-  connection = (uint8_t)atoi(tkn);
+  /* A taxa salva dispensa a escada */
+  uartLink.rate = uartCandidate;
+  if (uartTryingSaved)
+    uartSettled = true;
+  UART_advance();
+}
 
-  /* Obtém tipo de requisição: GET ou POST */
-  strtok(NULL, ":");
-  tkn = strtok(NULL, " ");
-  if (!strcmp(tkn, "GET"))
-  {
-    /* Obtém a rota da conexão */
-    memset(path, 0, sizeof(path));
-    tkn = strtok(NULL, " ?");
-    if (tkn)
-    {
-      strncpy(path, tkn, sizeof(path));
-      path[sizeof(path) - 1] = '\0';
-    }
+/************************************************************************************
+  UART_reject
 
-    /* Obtém parâmetro do GET, caso haja */
-    tkn = strtok(NULL, " ?");
-    if (tkn)
-    {
-      uint32_t lenght = strlen(tkn);
-      memmove(strBuffer, tkn, lenght);
-      strBuffer[lenght] = '\0';
-    }
+  The candidate failed: both ends return to the last good rate. The saved
+  rate failing still lets the ladder run; a ladder rate failing ends it.
 
-    /* Inicializa GET */
-    WEB_process_GET(connection, path, strBuffer, sizeof(strBuffer));
-  }
-  else if (!strcmp(tkn, "POST"))
-  {
-    /* Obtém a rota da conexão */
-    memset(path, 0, sizeof(path));
-    tkn = strtok(NULL, " ?");
-    if (tkn)
-    {
-      strncpy(path, tkn, sizeof(path));
-      path[sizeof(path) - 1] = '\0';
-    }
+************************************************************************************/
+void UART_reject()
+{
+  uartLink.rejected++;
+  if (!uartTryingSaved)
+    uartSettled = true;
 
-    /* Varre todos os parâmetros do header, até encontrar o body com a mensagem do POST */
-    serial_get("\r\n\r\n", 500, NULL, 0);
-    serial_get("\r\n", 500, strBuffer, sizeof(strBuffer));
+  /* O pedido pode chegar, mesmo com a resposta corrompida */
+  esp.setUartRate(uartLink.rate, &uartFuture);
+  uartState = UART_RETURNING;
+}
 
-    /* Inicializa POST */
-    WEB_process_POST(connection, path, strBuffer, sizeof(strBuffer));
-  }
-  /* 405 - METHOD NOT ALLOWED */
-  else
-  {
-    /* ESP8266: Inicializar envio */
-    serial_flush();
-    Serial.print("AT+CIPSENDEX="); /* AT: Send command */
-    Serial.print(connection);
-    Serial.print(",2047\r\n");
-    if (!serial_get(">", 100, NULL, 0)) /* Aguarda '>' */
-    {
-      esp.close(ESP_CLOSE_ALL);
-      return;
-    }
+/************************************************************************************
+  UART_recover
 
-    /* Header */
-    Serial.print(F("HTTP/1.1 405 Method Not Allowed\r\n"));
+  Called when the module stops answering at the negotiated rate. If it
+  answers at ESP_BAUD_RATE, it was reset: it is configured again, the local
+  server restarted and the rate negotiated again. Otherwise the negotiated
+  rate is kept. Only queues the probe; UART_poll() does the rest.
 
-    /* Finaliza comando de envio ao módulo WiFi */
-    Serial.print("\\0");
+************************************************************************************/
+void UART_recover()
+{
+  uartTimer.resetTimer();
 
-    /* Obtém resposta e encerra conexão */
-    serial_get("SEND OK\r\n", 100, NULL, 0);
-    esp.close(connection);
+  espSerial.begin(ESP_BAUD_RATE);
+  if (!esp.probe(&uartFuture))
+  {
+    espSerial.begin(uartLink.rate);
+    return;
   }
-
-  serial_flush();
-  return;
+  uartState = UART_PROBING_DEFAULT;
 }
 
 /************************************************************************************
-  WEB_process_GET
+  UART_busy
 
-  .
+  The serial is changing rate: nothing else may use the module.
 
 ************************************************************************************/
-bool WEB_process_GET(uint8_t connection, char *path, char *parameter, uint32_t parameterSize)
+bool UART_busy()
 {
-  LCD_print(F("ESP SERVER:"), F("GET"), 1000);
+  return uartState != UART_IDLE;
+}
 
-  /* WIFI */
-  if (!strcmp(path, "/wifi.json"))
-  {
-    /* ESP8266: Inicializar envio */
-    if (!WEB_headers(connection))
-      return false;
+/************************************************************************************
+  UART_send_size
 
-    /* ssid */
-    sprintf(parameter, "{\"ssid\":\"%s\",\r\n", espAp.ssid);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+  Bytes of each part of a send: what the serial writes, blocking, at the
+  current rate while the ring of the ADS1115 still has room (UART_SEND_SLACK).
 
-    /* password */
-    sprintf(parameter, "\"password\":\"%s\"}\r\n", espAp.password);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+************************************************************************************/
+uint16_t UART_send_size()
+{
+  uint32_t size = uartLink.rate / 10u * UART_SEND_SLACK / 1000u;
+  return min(size, UART_SEND_MAX);
+}
 
-    /* End chunk */
-    Serial.write("0\r\n\r\n");
-    return WEB_chunk_finish();
-  }
+/************************************************************************************
+  UART_send_space
 
-  /* SERVER */
-  else if (!strcmp(path, "/server.json"))
-  {
-    /* ESP8266: Inicializar envio */
-    if (!WEB_headers(connection))
-      return false;
+  Bytes left for a JSON chunk in a part that already holds 'written' bytes
+  (JsonWriter::writeChunk() still writes one unit when nothing fits).
 
-    /* host */
-    sprintf(parameter, "{\"host\":\"%s\",\r\n", espUrl.host);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+************************************************************************************/
+uint16_t UART_send_space(uint16_t written)
+{
+  uint16_t size = UART_send_size();
+  return (size > written + UART_SEND_CHUNK_FRAMING) ? size - written - UART_SEND_CHUNK_FRAMING : 1;
+}
 
-    /* auth */
-    sprintf(parameter, "\"auth\":\"%s\",\r\n", espUrl.auth);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+/************************************************************************************
+  UART_poll
 
-    /* client */
-    sprintf(parameter, "\"client\":\"%s\"}\r\n", espUrl.client);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+  Advances the negotiation or the recovery by one step, when its AT command
+  completes or its wait is over. Never blocks.
 
-    /* End chunk */
-    Serial.write("0\r\n\r\n");
-    return WEB_chunk_finish();
-  }
+************************************************************************************/
+void UART_poll()
+{
+  if (uartState == UART_IDLE || uartFuture.isPending())
+    return;
 
-  /* ENERGY */
-  else if (!strcmp(path, "/energy.json"))
+  bool ok = uartFuture.isDone();
+  switch (uartState)
   {
-    /* ESP8266: Inicializar envio */
-    if (!WEB_headers(connection))
-      return false;
-
-    /* dataSize */
-    sprintf(parameter, "{\"dataSize\":%u,\r\n", energy[0].config.dataSize);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
-
-    /* scale */
-    sprintf(parameter, "\"scale\":%u,\r\n", energy[0].config.scale);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
-
-    /* lineVoltage */
-    sprintf(parameter, "\"lineVoltage\":%u,\r\n", energy[0].config.lineVoltage);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
-
-    /* powerFactor */
-    sprintf(parameter, "\"powerFactor\":%u,\r\n", energy[0].config.powerFactor);
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
-
-    /* basePrice */
-    sprintf(parameter, "\"basePrice\":%s,\r\n", String(energy[0].config.basePrice, 3).c_str());
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
-
-    /* flagPrice */
-    sprintf(parameter, "\"flagPrice\":%s}\r\n", String(energy[0].config.flagPrice, 3).c_str());
-    Serial.println(strlen(parameter) - 2, HEX);
-    Serial.print(parameter);
+  case UART_PROBING_DEFAULT:
+    if (!ok)
+    {
+      /* Mudo também na taxa padrão: mantém a negociada */
+      espSerial.begin(uartLink.rate);
+      uartState = UART_IDLE;
+      break;
+    }
+    uartRecoveries++;
+    iotConnected = false;
+    uartRecovering = true;
+    UART_start();
+    esp.configure(&uartFuture);
+    uartState = UART_CONFIGURING;
+    break;
+
+  case UART_RESETTING:
+    if (!uartStepTimer.checkIntervalPassed(250))
+      break;
+    esp.setEnabled(true);
+    uartStepTimer.resetTimer();
+    uartState = UART_BOOTING;
+    break;
 
-    /* End chunk */
-    Serial.write("0\r\n\r\n");
-    return WEB_chunk_finish();
-  }
+  case UART_BOOTING:
+    if (!uartStepTimer.checkIntervalPassed(ESP_MEDIUM_DELAY))
+      break;
+    esp.flushResponses();
+    esp.configure(&uartFuture);
+    uartState = UART_CONFIGURING;
+    break;
+
+  case UART_CONFIGURING:
+    esp.flushResponses();
+    if (!ok)
+    {
+      uartRecovering = false;
+      uartState = UART_IDLE;
+    }
+    else if (uartRecovering && esp.server_start(&uartFuture))
+      uartState = UART_STARTING;
+    else
+      UART_advance();
+    break;
 
-  /* 404 - NOT FOUND */
-  else
-  {
-    /* ESP8266: Inicializar envio */
-    serial_flush();
-    Serial.print("AT+CIPSENDEX="); /* AT: Send command */
-    Serial.print(connection);
-    Serial.print(",2047\r\n");
-    if (!serial_get(">", 100, NULL, 0)) /* Aguarda '>' */
+  case UART_STARTING:
+    UART_advance();
+    break;
+
+  case UART_SWITCHING:
+    if (!ok)
     {
-      esp.close(ESP_CLOSE_ALL);
-      return false;
+      UART_reject();
+      break;
     }
+    espSerial.begin(uartCandidate);
+    uartStepTimer.resetTimer();
+    uartState = UART_SETTLING;
+    break;
 
-    /* Header */
-    Serial.print(F("HTTP/1.1 404 Not Found\r\n"));
+  case UART_SETTLING:
+    if (!uartStepTimer.checkIntervalPassed(10))
+      break;
+    uartFramingMark = espSerial.getFramingErrorCount();
+    uartOverflowMark = espSerial.getOverflowCount();
+    uartProbes = 1;
+    esp.probe(&uartFuture);
+    uartState = UART_TESTING;
+    break;
+
+  case UART_TESTING:
+    /* Uma sonda após a outra, sem ocupar a fila */
+    if (ok && uartProbes < ESP_BAUD_PROBES)
+    {
+      uartProbes++;
+      esp.probe(&uartFuture);
+    }
+    else
+      UART_accept();
+    break;
 
-    /* Finaliza comando de envio ao módulo WiFi */
-    Serial.print("\\0");
+  case UART_RETURNING:
+    espSerial.begin(uartLink.rate);
+    uartStepTimer.resetTimer();
+    uartState = UART_RETURNED;
+    break;
 
-    /* Obtém resposta e encerra conexão */
-    serial_get("SEND OK\r\n", 100, NULL, 0);
-    esp.close(connection);
-  }
+  case UART_RETURNED:
+    if (!uartStepTimer.checkIntervalPassed(10))
+      break;
+    esp.probe(&uartFuture);
+    uartState = UART_CHECKING;
+    break;
 
-  return false;
+  case UART_CHECKING:
+    if (ok)
+    {
+      UART_advance();
+      break;
+    }
+
+    /* Mudo na última taxa boa: o reset o traz de volta à taxa padrão */
+    espSerial.begin(ESP_BAUD_RATE);
+    uartLink.rate = ESP_BAUD_RATE;
+    esp.setEnabled(false);
+    uartStepTimer.resetTimer();
+    uartState = UART_RESETTING;
+    break;
+  }
 }
 
 /************************************************************************************
-  WEB_process_POST
+  IOT_connect
 
-  .
+  Starts the publication. An open connection from the previous one is reused;
+  otherwise the AP is checked and the connection opened. The remaining steps
+  are chained by IOT_poll(), so measurement and the local server keep running.
 
 ************************************************************************************/
-bool WEB_process_POST(uint8_t connection, char *path, char *body, uint32_t bodySize)
+bool IOT_connect()
 {
-  LCD_print(F("ESP SERVER:"), F("POST"), 1000);
+  iotStartMillis = millis();
 
-  /* Verifica o início do objeto */
-  if (body[0] != '{')
-  {
-    WEB_400_bad_request(connection);
+  /* Conexão mantida desde a publicação anterior */
+  if (iotConnected && !esp.isClosed(ESP_CLIENT_LINK))
+    return IOT_send_measures();
+  iotConnected = false;
+
+  /* Verifica conexão com o ponto de acesso wifi */
+  if (!esp.checkWifi(&iotFuture))
     return false;
-  }
 
-  /* Início do json */
-  char *tkn = body + 1;
+  iotState = IOT_CHECKING;
+  return true;
+}
 
-  /* WIFI */
-  if (strstr(path, "/wifi.json"))
-  {
-    /* Para cada campo do objeto */
-    while ((tkn = strtok(tkn, "\"")) != NULL)
+/************************************************************************************
+  IOT_poll
+
+  Advances the publication once the AT commands of the current step complete.
+
+************************************************************************************/
+void IOT_poll()
+{
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  /* Respostas do broker: lidas sempre, para não reter a serial do módulo */
+  MQTT_receive();
+#endif
+
+  if (iotState == IOT_IDLE || iotFuture.isPending())
+    return;
+
+  bool ok = iotFuture.isDone();
+  switch (iotState)
+  {
+  case IOT_CHECKING:
+    if (!ok)
+    {
+      LCD_print(F("ESP CONNECT AP:"), F("ERROR"));
+      IOT_finish(false);
+      break;
+    }
+    LCD_print(F("ESP CONNECT AP:"), F("OK"));
+
+    /* Abre conexão com servidor */
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+    esp.connect(espUrl, MQTT_PORT, MQTT_SSL, &iotFuture);
+#else
+    esp.connect(espUrl, &iotFuture);
+#endif
+    iotState = IOT_CONNECTING;
+    break;
+
+  case IOT_CONNECTING:
+    if (!ok)
+    {
+      LCD_print(F("ESP CONNECT:"), F("ERROR"));
+      IOT_disconnect();
+      break;
+    }
+    LCD_print(F("ESP CONNECT:"), F("OK"));
+
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+    /* Abre a sessão; publica após o CONNACK */
+    if (!MQTT_send_connect())
+      IOT_disconnect();
+#else
+    iotConnected = true;
+
+    /* Envia conteudo */
+    if (!IOT_send_measures())
+      IOT_disconnect();
+#endif
+    break;
+
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  case IOT_SESSION:
+    if (!ok)
+    {
+      IOT_disconnect();
+      break;
+    }
+
+    /* Sessão aceita: envia conteudo */
+    if (mqttConnack == MQTT_CONNACK_ACCEPTED)
+    {
+      iotConnected = true;
+      if (!IOT_send_measures())
+        IOT_disconnect();
+    }
+    else if (mqttConnack != 0xFF || esp.isClosed(ESP_CLIENT_LINK) || iotTimer.checkIntervalPassed(ESP_LONG_DELAY))
+    {
+      LCD_print(F("MQTT CONNACK:"), F("ERROR"));
+      IOT_disconnect();
+    }
+    break;
+
+  case IOT_PINGING:
+    /* Sem PINGRESP: a sessão é refeita na próxima publicação */
+    if (!ok || esp.isClosed(ESP_CLIENT_LINK) || (mqttPinging && iotTimer.checkIntervalPassed(ESP_LONG_DELAY)))
+      IOT_disconnect();
+    else if (!mqttPinging)
+      iotState = IOT_IDLE;
+    break;
+#endif
+
+  case IOT_SENDING:
+    if (!ok)
+    {
+      IOT_disconnect();
+      break;
+    }
+
+    /* Parte enviada: a próxima segue; sem espaço na fila, no próximo loop */
+    if (IOT_send_pending())
+    {
+      IOT_send_part();
+      break;
+    }
+
+    /* Lote enviado: aguarda a resposta */
+    iotTimer.resetTimer();
+    iotState = IOT_RECEIVING;
+    break;
+
+  case IOT_RECEIVING:
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+    /* QoS 1: confirmado pelo PUBACK de cada publicação; QoS 0: pelo SEND OK */
+    if (mqttPending == 0)
+    {
+      IOT_batch_confirm();
+      IOT_finish(true);
+    }
+    else if (esp.isClosed(ESP_CLIENT_LINK) || iotTimer.checkIntervalPassed(ESP_LONG_DELAY))
+      IOT_disconnect();
+#else
+    if (esp.getResponseCount() >= 1)
+    {
+      if (esp.getResponseFailures() == 0)
+      {
+        /* Confirmado: libera os intervalos publicados */
+        IOT_batch_confirm();
+        IOT_finish(true);
+      }
+      else
+        IOT_disconnect();
+    }
+    else if (esp.isClosed(ESP_CLIENT_LINK) || iotTimer.checkIntervalPassed(ESP_LONG_DELAY))
+      IOT_disconnect();
+#endif
+    break;
+
+  case IOT_CLOSING:
+  default:
+    IOT_finish(false);
+    break;
+  }
+}
+
+/************************************************************************************
+  IOT_disconnect
+
+  Closes the cloud connection after a failure; the next publication opens it
+  again.
+
+************************************************************************************/
+void IOT_disconnect()
+{
+  iotConnected = false;
+  esp.watchResponses(ESP_NO_LINK);
+  esp.close(ESP_CLIENT_LINK, &iotFuture);
+  iotState = IOT_CLOSING;
+}
+
+/************************************************************************************
+  IOT_finish
+
+  Ends the publication and shows its result and duration.
+
+************************************************************************************/
+void IOT_finish(bool ok)
+{
+  iotState = IOT_IDLE;
+  iotBatch.sent = 0; /* O lote volta a aceitar o descarte do mais antigo */
+
+  /* Falha: a fila aguarda a próxima publicação */
+  if (!ok)
+    iotDraining = false;
+  else
+    iotLatencyMillis = millis() - iotStartMillis;
+
+#ifdef LCD_ENABLE
+  lcd.clear();
+  lcd.print(ok ? F("ESP SEND: OK") : F("ESP SEND: ERROR"));
+  lcd.setCursor(0, 1);
+  lcd.print(millis() - iotStartMillis);
+  lcd.print(F(" ms Q:"));
+  lcd.print(iotBatch.count + iotBacklog.count);
+#endif
+}
+
+/************************************************************************************
+  IOT_send_measures
+
+  Starts sending the batch as a single multi-path PATCH, in the same chunked
+  request, so the whole batch costs one response. The body goes in parts of
+  UART_send_size() bytes, one CIPSENDEX each, queued by IOT_poll() as the
+  previous one completes. With the MQTT uplink, the batch goes as PUBLISH
+  packets instead (MQTT_send_publish()).
+
+************************************************************************************/
+bool IOT_send_measures()
+{
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  return MQTT_send_publish();
+#else
+  if (iotBatch.count == 0)
+    return false;
+
+  iotBatch.sent = iotBatch.count;
+  iotSendNext = 0;
+  iotPayloadBytes = 0;
+  iotPayloadMicros = 0;
+  esp.watchResponses(ESP_CLIENT_LINK);
+  if (!IOT_send_part())
+    return false;
+
+  iotState = IOT_SENDING;
+  return true;
+#endif
+}
+
+/************************************************************************************
+  IOT_send_part
+
+  Queues the next part of the batch. Its content is chosen when the module
+  prompts for it, so each part fits in UART_send_size() bytes. Returns false
+  when the queue of commands is full; IOT_poll() tries again.
+
+************************************************************************************/
+bool IOT_send_part()
+{
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  return MQTT_send_part();
+#else
+  return esp.send(ESP_CLIENT_LINK, IOT_write_PATCH, NULL, NULL, 0, &iotFuture);
+#endif
+}
+
+/************************************************************************************
+  IOT_send_pending
+
+  Whether parts of the batch are still to be queued.
+
+************************************************************************************/
+bool IOT_send_pending()
+{
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+  return iotSendNext < iotBatch.sent * MQTT_packets_per_interval();
+#else
+  return iotSendNext != JSON_WRITER_END;
+#endif
+}
+
+/************************************************************************************
+  IOT_write_PATCH
+
+  Writes one part of the batch request, after the '>' prompt of the module:
+  the headers go in the first part, then the entries of the body that still
+  fit, as one chunk, and the end of the body in the last one. Each interval
+  adds one entry per measure at /users/<client>/measures/<measure>/<timestamp>.
+
+************************************************************************************/
+void IOT_write_PATCH(Stream &serial, const void *context)
+{
+  (void)context;
+  uint32_t startBytes = espSerial.getWriteCount();
+  uint32_t startMicros = micros();
+
+  if (iotSendNext == 0)
+  {
+    /* HTTP HEADERS */
+    /* HTTP PATCH: atualização de vários caminhos de uma vez */
+    serial.print(F("PATCH /users/"));
+    serial.print(espUrl.client);
+    serial.print(F(".json?auth="));
+    serial.print(espUrl.auth);
+    serial.print(F(" HTTP/1.1\r\n"));
+    /* Host */
+    serial.print(F("Host: "));
+    serial.print(espUrl.host);
+    serial.print(F("\r\n"));
+    /* Connection */
+    serial.print(F("Connection: keep-alive\r\n"));
+    /* Chunked */
+    serial.print(F("Transfer-Encoding: chunked\r\n"));
+    /* Header End */
+    serial.print(F("\r\n"));
+  }
+
+  /* Formata body: um chunk por parte, com o que ainda cabe nela */
+  uint16_t written = espSerial.getWriteCount() - startBytes;
+  if (JsonWriter::writeChunk(serial, IOT_write_body, NULL, &iotSendNext, UART_send_space(written)))
+    serial.print(F("0\r\n\r\n"));
+
+  /* Custo do formato: bytes e tempo na UART (escrita bloqueante) */
+  iotPayloadBytes += espSerial.getWriteCount() - startBytes;
+  iotPayloadMicros += micros() - startMicros;
+}
+
+/************************************************************************************
+  IOT_write_body
+
+  Writes the intervals of the batch being sent, as one object; the part
+  written is picked by JsonWriter::writeChunk().
+
+************************************************************************************/
+void IOT_write_body(JsonWriter &json, const void *context)
+{
+  (void)context;
+
+  json.beginObject();
+  for (uint8_t i = 0; i < iotBatch.sent; i++)
+  {
+#if IOT_PAYLOAD_FORMAT == IOT_FORMAT_PACKED
+    /* Um registro por intervalo, em base64: todas as medidas e canais */
+    json.beginKey();
+    json.raw().print(F("measures/packed/"));
+    json.raw().print(F(FIREBASE_SOURCE_ID));
+    json.raw().print('/');
+    json.raw().print(iotBatch.timestamp[i]);
+    json.endKey();
+
+    json.beginString();
+    PackedRecord record(json.raw());
+    record.begin(iotBatch.seqNumber[i], iotBatch.timestamp[i], IOT_MEASURE_COUNT, channelCount);
+    for (uint8_t m = 0; m < IOT_MEASURE_COUNT; m++)
+      record.addType(IOT_measure(m).type);
+    for (uint8_t v = 0; v < IOT_MEASURE_COUNT * channelCount; v++)
+      record.addValue(iotBatch.values[i * IOT_MEASURE_COUNT * channelCount + v]);
+    record.end();
+    json.endString();
+#else
+    /* value: total dos canais, só nas medidas aditivas; channels: valor de cada canal */
+    for (uint8_t m = 0; m < IOT_MEASURE_COUNT; m++)
+    {
+      const float *values = &iotBatch.values[(i * IOT_MEASURE_COUNT + m) * channelCount];
+      IOT_measure_t measure = IOT_measure(m);
+
+      json.beginKey();
+      json.raw().print(F("measures/"));
+      json.raw().print(measure.path);
+      json.raw().print('/');
+      json.raw().print(iotBatch.timestamp[i]);
+      json.endKey();
+
+      json.beginObject();
+      if (measure.additive)
+      {
+        float total = 0;
+        for (uint8_t c = 0; c < channelCount; c++)
+          total += values[c];
+        json.member(F("value"), total, 5);
+      }
+      json.key(F("channels"));
+      json.beginArray();
+      for (uint8_t c = 0; c < channelCount; c++)
+        json.value(values[c], 5);
+      json.endArray();
+      json.member(F("type"), measure.type); /* MEASURE_ELECTRICAL_CURRENT_AMPERE : 0x50 / MEASURE_ELECTRICAL_ENERGY_KHW : 0x70 */
+      json.member(F("seqNumber"), iotBatch.seqNumber[i]);
+      json.member(F("timestamp"), iotBatch.timestamp[i]);
+      json.member(F("device"), F(FIREBASE_SOURCE_ID));
+      json.endObject();
+    }
+#endif
+  }
+
+  json.endObject();
+}
+
+#if IOT_UPLINK == IOT_UPLINK_MQTT
+/************************************************************************************
+  MQTT_send_connect
+
+  Opens the MQTT session on the cloud connection just opened: a CONNECT with a
+  clean session. IOT_poll() publishes the batch once the CONNACK arrives.
+
+************************************************************************************/
+bool MQTT_send_connect()
+{
+  PrintCounter counter;
+  MqttClient::writeConnect(counter, FIREBASE_SOURCE_ID, espUrl.client, espUrl.auth, MQTT_KEEP_ALIVE);
+
+  mqtt.reset();
+  mqttConnack = 0xFF;
+  mqttPending = 0;
+  mqttPinging = false;
+  if (!esp.send(ESP_CLIENT_LINK, counter.count, MQTT_write_CONNECT, NULL, &iotFuture))
+    return false;
+
+  mqttTimer.resetTimer();
+  iotTimer.resetTimer();
+  iotState = IOT_SESSION;
+  return true;
+}
+
+/************************************************************************************
+  MQTT_write_CONNECT
+
+  Writes the CONNECT packet, after the '>' prompt of the module.
+
+************************************************************************************/
+void MQTT_write_CONNECT(Stream &serial, const void *context)
+{
+  (void)context;
+  MqttClient::writeConnect(serial, FIREBASE_SOURCE_ID, espUrl.client, espUrl.auth, MQTT_KEEP_ALIVE);
+}
+
+/************************************************************************************
+  MQTT_send_publish
+
+  Starts sending the batch as PUBLISH packets, one per interval and channel
+  (one per interval in IOT_FORMAT_PACKED). Consecutive packets share each
+  CIPSEND, up to UART_send_size() bytes; IOT_poll() queues the next one as
+  the previous one completes.
+
+************************************************************************************/
+bool MQTT_send_publish()
+{
+  if (iotBatch.count == 0)
+    return false;
+
+  iotBatch.sent = iotBatch.count;
+  iotSendNext = 0;
+  iotPayloadBytes = 0;
+  iotPayloadMicros = 0;
+  mqttPending = MQTT_QOS ? iotBatch.sent * MQTT_packets_per_interval() : 0;
+  if (!MQTT_send_part())
+    return false;
+
+  mqttTimer.resetTimer();
+  iotState = IOT_SENDING;
+  return true;
+}
+
+/************************************************************************************
+  MQTT_send_part
+
+  Queues the next packets of the batch in one CIPSEND: whole packets while
+  they fit in UART_send_size() bytes, at least one. Their exact length is
+  counted beforehand.
+
+************************************************************************************/
+bool MQTT_send_part()
+{
+  uint8_t total = iotBatch.sent * MQTT_packets_per_interval();
+  uint8_t first = iotSendNext, last = first;
+  uint16_t size = UART_send_size(), length = 0;
+
+  while (last < total)
+  {
+    PrintCounter counter;
+    MQTT_write_packets(counter, last, last + 1);
+    if (last > first && length + counter.count > size)
+      break;
+    length += counter.count;
+    last++;
+  }
+
+  /* Pacotes [first, last) no contexto */
+  if (!esp.send(ESP_CLIENT_LINK, length, MQTT_write_PUBLISH, (const void *)(uintptr_t)((first << 8) | last), &iotFuture))
+    return false;
+
+  iotSendNext = last;
+  return true;
+}
+
+/************************************************************************************
+  MQTT_write_PUBLISH
+
+  Writes the packets of one part of the batch, after the '>' prompt of the
+  module.
+
+************************************************************************************/
+void MQTT_write_PUBLISH(Stream &serial, const void *context)
+{
+  uint16_t range = (uint16_t)(uintptr_t)context;
+  uint32_t startBytes = espSerial.getWriteCount();
+  uint32_t startMicros = micros();
+
+  MQTT_write_packets(serial, range >> 8, range & 0xFF);
+
+  /* Custo do formato: bytes e tempo na UART (escrita bloqueante) */
+  iotPayloadBytes += espSerial.getWriteCount() - startBytes;
+  iotPayloadMicros += micros() - startMicros;
+}
+
+/************************************************************************************
+  MQTT_write_packets
+
+  Writes the PUBLISH packets [first, last) of the batch, in the order of the
+  intervals and then of the channels. The packet identifiers follow the
+  position in the batch, so the same packets are written when counting and
+  when sending.
+
+************************************************************************************/
+void MQTT_write_packets(Print &out, uint8_t first, uint8_t last)
+{
+  uint8_t perInterval = MQTT_packets_per_interval();
+
+  for (uint8_t packet = first; packet < last; packet++)
+  {
+    MQTT_publish_t publish = {(uint8_t)(packet / perInterval), (uint8_t)(packet % perInterval)};
+    MqttClient::writePublish(out, MQTT_write_topic, MQTT_write_payload, &publish, MQTT_QOS, 1 + packet);
+  }
+}
+
+/************************************************************************************
+  MQTT_write_topic
+
+  Writes the topic of a publication: <prefix><source>/<channel>, or
+  <prefix><source>/packed.
+
+************************************************************************************/
+void MQTT_write_topic(Print &out, const void *context)
+{
+  const MQTT_publish_t *publish = (const MQTT_publish_t *)context;
+
+  out.print(F(MQTT_TOPIC_PREFIX));
+  out.print(FIREBASE_SOURCE_ID);
+  out.print('/');
+#if IOT_PAYLOAD_FORMAT == IOT_FORMAT_PACKED
+  (void)publish;
+  out.print(F("packed"));
+#else
+  out.print(publish->channel);
+#endif
+}
+
+/************************************************************************************
+  MQTT_write_payload
+
+  Writes the content of a publication: the measures of a channel in an
+  interval as a flat JSON object, or the packed record of the interval in
+  base64 (all measures and channels).
+
+************************************************************************************/
+void MQTT_write_payload(Print &out, const void *context)
+{
+  const MQTT_publish_t *publish = (const MQTT_publish_t *)context;
+  uint8_t i = publish->interval;
+
+#if IOT_PAYLOAD_FORMAT == IOT_FORMAT_PACKED
+  PackedRecord record(out);
+  record.begin(iotBatch.seqNumber[i], iotBatch.timestamp[i], IOT_MEASURE_COUNT, channelCount);
+  for (uint8_t m = 0; m < IOT_MEASURE_COUNT; m++)
+    record.addType(IOT_measure(m).type);
+  for (uint8_t v = 0; v < IOT_MEASURE_COUNT * channelCount; v++)
+    record.addValue(iotBatch.values[i * IOT_MEASURE_COUNT * channelCount + v]);
+  record.end();
+#else
+  JsonWriter json(out);
+  json.beginObject();
+  json.member(F("seqNumber"), iotBatch.seqNumber[i]);
+  json.member(F("timestamp"), iotBatch.timestamp[i]);
+  for (uint8_t m = 0; m < IOT_MEASURE_COUNT; m++)
+  {
+    json.beginKey();
+    json.raw().print(IOT_measure(m).path);
+    json.endKey();
+    json.value(iotBatch.values[(i * IOT_MEASURE_COUNT + m) * channelCount + publish->channel], 5);
+  }
+  json.endObject();
+#endif
+}
+
+/************************************************************************************
+  MQTT_packets_per_interval
+
+  Number of PUBLISH packets of each interval of the batch.
+
+************************************************************************************/
+uint8_t MQTT_packets_per_interval()
+{
+#if IOT_PAYLOAD_FORMAT == IOT_FORMAT_PACKED
+  return 1;
+#else
+  return max(channelCount, 1);
+#endif
+}
+
+/************************************************************************************
+  MQTT_send_ping
+
+  Keeps the idle session alive with a PINGREQ; IOT_poll() waits for the
+  PINGRESP, and closes the connection without it.
+
+************************************************************************************/
+bool MQTT_send_ping()
+{
+  mqttTimer.resetTimer();
+  if (!esp.send(ESP_CLIENT_LINK, 2, MQTT_write_PINGREQ, NULL, &iotFuture))
+    return false;
+
+  mqttPinging = true;
+  iotTimer.resetTimer();
+  iotState = IOT_PINGING;
+  return true;
+}
+
+/************************************************************************************
+  MQTT_write_PINGREQ
+
+  Writes the PINGREQ packet, after the '>' prompt of the module.
+
+************************************************************************************/
+void MQTT_write_PINGREQ(Stream &serial, const void *context)
+{
+  (void)context;
+  MqttClient::writePingreq(serial);
+}
+
+/************************************************************************************
+  MQTT_receive
+
+  Reads the replies of the broker: the CONNACK of the session, the PUBACK of
+  each publication of the batch and the PINGRESP. Other packets are skipped.
+
+************************************************************************************/
+void MQTT_receive()
+{
+  int16_t received;
+  while ((received = esp.receive(ESP_CLIENT_LINK)) >= 0)
+  {
+    switch (mqtt.feed((uint8_t)received))
+    {
+    case MQTT_CONNACK:
+      mqttConnack = mqtt.getReturnCode();
+      break;
+
+    case MQTT_PUBACK:
+      /* Identificadores 1..N do lote em andamento */
+      if (mqttPending && mqtt.getPacketId() >= 1 && mqtt.getPacketId() <= iotBatch.sent * MQTT_packets_per_interval())
+        mqttPending--;
+      break;
+
+    case MQTT_PINGRESP:
+      mqttPinging = false;
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+#endif
+
+/************************************************************************************
+  IOT_measure
+
+  Copy of a published measure, from the flash.
+
+************************************************************************************/
+IOT_measure_t IOT_measure(uint8_t index)
+{
+  IOT_measure_t measure;
+  memcpy_P(&measure, &iotMeasures[index], sizeof(measure));
+  return measure;
+}
+
+/************************************************************************************
+  IOT_batch_capacity
+
+  Number of intervals the batch holds with the current channels.
+
+************************************************************************************/
+uint8_t IOT_batch_capacity()
+{
+  uint8_t capacity = IOT_BATCH_POOL_SIZE / (IOT_MEASURE_COUNT * max(channelCount, 1));
+  return constrain(capacity, 1, IOT_BATCH_INTERVALS);
+}
+
+/************************************************************************************
+  IOT_batch_add
+
+  Stores the results of the interval just calculated. The oldest intervals
+  stay in RAM; while the EEPROM holds a backlog, new ones go to its end, so
+  the order is kept. With both full, the oldest interval not being sent is
+  dropped.
+
+************************************************************************************/
+void IOT_batch_add(uint32_t intervalTimestamp)
+{
+  IOT_record_t record;
+  record.seqNumber = iotSeqNumber++;
+  record.timestamp = intervalTimestamp;
+
+  float *values = record.values;
+  for (uint8_t m = 0; m < IOT_MEASURE_COUNT; m++)
+  {
+    float (Energy::*getter)(void) = IOT_measure(m).getter;
+    for (uint8_t c = 0; c < channelCount; c++)
+      *values++ = (energy[c].*getter)();
+  }
+
+  if (iotBacklog.count == 0 && iotBatch.count < IOT_batch_capacity())
+  {
+    IOT_batch_store(&record);
+    return;
+  }
+
+  /* Fila cheia: descarta o mais antigo; a RAM é completada com a EEPROM */
+  if (iotBacklog.count >= IOT_backlog_capacity())
+  {
+    iotDropped++;
+    if (iotBatch.sent == 0)
+      IOT_batch_release(1);
+    /* Envio em curso: a RAM não pode deslocar sob o escritor; descarta o
+       mais antigo da EEPROM ou, sem ela, o próprio intervalo novo */
+    else if (!IOT_backlog_pop(NULL))
+      return;
+  }
+
+  /* Sem espaço na EEPROM para um registro: apenas a RAM */
+  if (!IOT_backlog_push(&record))
+    IOT_batch_store(&record);
+}
+
+/************************************************************************************
+  IOT_report_due
+
+  Report-by-exception: whether the interval just calculated is published.
+  It is when the maximum silence has passed, when it closes the day (the
+  daily energy is reset by the next one) or when the current or the real
+  power of a channel left the deadband around its last published value;
+  never closer than the minimum spacing. Energy and cost are accumulated,
+  so a skipped interval is only missing its current and power.
+
+************************************************************************************/
+bool IOT_report_due()
+{
+  uint32_t silence = timestamp - iotReportTimestamp;
+  bool due = (iotReportTimestamp == 0 || silence >= iotReport.maxSilence);
+
+  /* Último intervalo do dia local, como em Energy::calculate() */
+  const uint32_t day = 86400ul;
+  const int32_t zone = ENERGY_DEFAULT_TIMEZONE * 3600l;
+  due = due || (timestamp + zone) / day != (timestamp + zone + MESSAGE_SAMPLE_RATE) / day;
+
+  for (uint8_t i = 0; i < channelCount && !due; i++)
+  {
+    due = IOT_report_changed(energy[i].getElectricCurrentAmperes(), iotReportedCurrent[i], iotReport.bandCurrent) ||
+          IOT_report_changed(energy[i].getRealPowerWatts(), iotReportedPower[i], iotReport.bandPower);
+  }
+
+  if (!due || (iotReportTimestamp != 0 && silence < iotReport.minSpacing))
+  {
+    iotReportsSuppressed++;
+    return false;
+  }
+
+  /* Nova referência das bandas */
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    iotReportedCurrent[i] = energy[i].getElectricCurrentAmperes();
+    iotReportedPower[i] = energy[i].getRealPowerWatts();
+  }
+  iotReportTimestamp = timestamp;
+  iotReportsSent++;
+  return true;
+}
+
+/************************************************************************************
+  IOT_report_changed
+
+  Whether a value left the deadband around the published one: the larger of
+  the absolute band and 'bandPercent' of the published value. Values not
+  measured (NAN) never trigger.
+
+************************************************************************************/
+bool IOT_report_changed(float value, float reported, float band)
+{
+  if (isnan(value) || isnan(reported))
+    return isnan(value) != isnan(reported);
+
+  band = max(band, fabs(reported) * iotReport.bandPercent / 100);
+  return fabs(value - reported) > band;
+}
+
+/************************************************************************************
+  IOT_batch_store
+
+  Appends an interval to the RAM batch, which must have room for it.
+
+************************************************************************************/
+void IOT_batch_store(const IOT_record_t *record)
+{
+  const uint8_t intervalValues = IOT_MEASURE_COUNT * channelCount;
+
+  memcpy(&iotBatch.values[iotBatch.count * intervalValues], record->values, intervalValues * sizeof(float));
+  iotBatch.seqNumber[iotBatch.count] = record->seqNumber;
+  iotBatch.timestamp[iotBatch.count++] = record->timestamp;
+}
+
+/************************************************************************************
+  IOT_batch_due
+
+  Whether the batch must be sent: full, or its oldest interval waited the
+  maximum latency.
+
+************************************************************************************/
+bool IOT_batch_due()
+{
+  if (iotBatch.count == 0)
+    return false;
+
+  return iotBatch.count >= IOT_batch_capacity() ||
+         timestamp - iotBatch.timestamp[0] >= IOT_BATCH_MAX_LATENCY;
+}
+
+/************************************************************************************
+  IOT_batch_release
+
+  Removes the oldest intervals of the batch, published or dropped, and refills
+  it from the EEPROM backlog.
+
+************************************************************************************/
+void IOT_batch_release(uint8_t count)
+{
+  const uint8_t intervalValues = IOT_MEASURE_COUNT * channelCount;
+
+  count = min(count, iotBatch.count);
+  iotBatch.count -= count;
+
+  memmove(iotBatch.seqNumber, &iotBatch.seqNumber[count], iotBatch.count * sizeof(iotBatch.seqNumber[0]));
+  memmove(iotBatch.timestamp, &iotBatch.timestamp[count], iotBatch.count * sizeof(iotBatch.timestamp[0]));
+  memmove(iotBatch.values, &iotBatch.values[count * intervalValues], iotBatch.count * intervalValues * sizeof(float));
+
+  /* Oldest first: a EEPROM só guarda intervalos mais novos que os da RAM */
+  IOT_record_t record;
+  while (iotBatch.count < IOT_batch_capacity() && iotBacklog.count)
+  {
+    if (IOT_backlog_pop(&record))
+      IOT_batch_store(&record);
+  }
+}
+
+/************************************************************************************
+  IOT_batch_confirm
+
+  Releases the intervals accepted by the server. A batch refilled from the
+  backlog is sent at once, without waiting for the publish period, and the
+  drain throughput is measured.
+
+************************************************************************************/
+void IOT_batch_confirm()
+{
+  bool draining = iotDraining;
+
+  IOT_batch_release(iotBatch.sent);
+  iotDraining = iotBacklog.count || IOT_batch_due();
+
+  if (!draining && iotDraining)
+  {
+    iotDrainStartMillis = iotStartMillis;
+    iotDrained = 0;
+  }
+
+  if (draining || iotDraining)
+  {
+    iotDrained += iotBatch.sent;
+    iotDrainMillis = millis() - iotDrainStartMillis;
+  }
+}
+
+/************************************************************************************
+  IOT_backlog_init
+
+  Restores the EEPROM backlog of a previous run. It is discarded when the
+  record layout changed (number of channels).
+
+************************************************************************************/
+void IOT_backlog_init()
+{
+  uint8_t recordSize = offsetof(IOT_record_t, values) + IOT_MEASURE_COUNT * channelCount * sizeof(float);
+
+  if (!EEPROM_read((uint8_t *)&iotBacklog, sizeof(iotBacklog), EEPROM_BACKLOG_OFFSET) ||
+      iotBacklog.recordSize != recordSize || iotBacklog.count > IOT_backlog_capacity())
+  {
+    iotBacklog.head = 0;
+    iotBacklog.count = 0;
+    iotBacklog.recordSize = recordSize;
+    EEPROM_write((uint8_t *)&iotBacklog, sizeof(iotBacklog), EEPROM_BACKLOG_OFFSET);
+    return;
+  }
+
+  /* Continua a sequência do último registro: o servidor elimina duplicados por ela */
+  IOT_record_t record;
+  uint8_t last = (iotBacklog.head + iotBacklog.count - 1) % IOT_backlog_capacity();
+  if (iotBacklog.count && EEPROM_read((uint8_t *)&record, recordSize, IOT_backlog_address(last)))
+    iotSeqNumber = record.seqNumber + 1;
+
+  IOT_batch_release(0);
+}
+
+/************************************************************************************
+  IOT_backlog_capacity
+
+  Number of records that fit in the EEPROM after the configuration.
+
+************************************************************************************/
+uint8_t IOT_backlog_capacity()
+{
+  uint16_t space = EEPROM.length() - EEPROM_BACKLOG_RECORDS_OFFSET;
+  return min(space / (iotBacklog.recordSize + 1u), 255u);
+}
+
+/************************************************************************************
+  IOT_backlog_address
+
+  EEPROM address of a record slot; each record has its CRC8.
+
+************************************************************************************/
+int IOT_backlog_address(uint8_t slot)
+{
+  return EEPROM_BACKLOG_RECORDS_OFFSET + slot * (iotBacklog.recordSize + 1);
+}
+
+/************************************************************************************
+  IOT_backlog_push
+
+  Appends a record to the end of the EEPROM backlog.
+
+************************************************************************************/
+bool IOT_backlog_push(const IOT_record_t *record)
+{
+  uint8_t capacity = IOT_backlog_capacity();
+  if (iotBacklog.count >= capacity)
+    return false;
+
+  uint8_t slot = (iotBacklog.head + iotBacklog.count) % capacity;
+  EEPROM_write((const uint8_t *)record, iotBacklog.recordSize, IOT_backlog_address(slot));
+
+  iotBacklog.count++;
+  return EEPROM_write((uint8_t *)&iotBacklog, sizeof(iotBacklog), EEPROM_BACKLOG_OFFSET);
+}
+
+/************************************************************************************
+  IOT_backlog_pop
+
+  Removes the oldest record of the EEPROM backlog. A corrupted record is
+  removed too, counted as dropped. Without a record, it is just discarded.
+
+************************************************************************************/
+bool IOT_backlog_pop(IOT_record_t *record)
+{
+  if (iotBacklog.count == 0)
+    return false;
+
+  bool ok = record == NULL || EEPROM_read((uint8_t *)record, iotBacklog.recordSize, IOT_backlog_address(iotBacklog.head));
+  if (!ok)
+    iotDropped++;
+
+  iotBacklog.head = (iotBacklog.head + 1) % IOT_backlog_capacity();
+  iotBacklog.count--;
+  EEPROM_write((uint8_t *)&iotBacklog, sizeof(iotBacklog), EEPROM_BACKLOG_OFFSET);
+  return ok;
+}
+
+/************************************************************************************
+  WEB_event
+
+  Follows the connections of the local server: a request whose client closed
+  the connection before the response is dropped.
+
+************************************************************************************/
+void WEB_event(uint8_t event)
+{
+  uint8_t link = ESP_EVENT_LINK(event);
+  if (link >= ESP_MAX_LINKS || ESP_EVENT_TYPE(event) != ESP_EVENT_CLOSED || !esp.isClosed(link))
+    return;
+
+  /* Sem requisição: com comandos AT em andamento, o conteúdo pode ser de um deles */
+  if (webLinks[link].state == WEB_FREE)
+  {
+    if (esp.isIdle())
+      esp.discard(link);
+    return;
+  }
+
+  /* Resposta ainda fora da fila de comandos: nada a enviar */
+  if (webLinks[link].state <= WEB_RESPONDING)
+  {
+    esp.discard(link);
+    WEB_release(link);
+  }
+}
+
+/************************************************************************************
+  WEB_poll
+
+  Advances the request of every connection of the local server. Called once
+  per loop; nothing here waits for the module.
+
+************************************************************************************/
+void WEB_poll(void)
+{
+  for (uint8_t link = 0; link < ESP_MAX_LINKS; link++)
+    WEB_serve(link);
+}
+
+/************************************************************************************
+  WEB_serve
+
+  Advances the request of a connection: reads what has been received so far,
+  queues the response in its own AT+CIPSENDEX and then closes only this
+  connection.
+
+************************************************************************************/
+void WEB_serve(uint8_t link)
+{
+  WEB_link_t *web = &webLinks[link];
+  int16_t received;
+
+  /* Requisição já lida: o que o cliente ainda envia não tem destino e não pode parar a serial */
+  if (web->state >= WEB_WAITING)
+    esp.discard(link);
+
+  switch (web->state)
+  {
+  case WEB_FREE:
+    /* Conexões fixas: com comandos AT ou um lote em andamento, o conteúdo pode ser de um deles */
+    if ((link == ESP_CLIENT_LINK || link == ESP_TIMESTAMP_LINK) && (!esp.isIdle() || iotState != IOT_IDLE))
+      return;
+    if ((received = esp.receive(link)) < 0)
+      return;
+
+    /* Nova requisição */
+    web->state = WEB_METHOD;
+    web->method = WEB_ALL_NAMES;
+    web->route = WEB_ALL_NAMES;
+    web->wait = false;
+    web->length = 0;
+    web->timer.resetTimer();
+    WEB_parse(web, (char)received);
+    /* fall through */
+
+  case WEB_METHOD:
+  case WEB_PATH:
+  case WEB_QUERY:
+  case WEB_HEADERS:
+    while (web->state != WEB_BODY && (received = esp.receive(link)) >= 0)
+      WEB_parse(web, (char)received);
+
+    /* Fim dos headers */
+    if (web->state == WEB_BODY)
+    {
+      if (web->method == WEB_GET)
+        WEB_process_GET(link);
+      else if (web->method != WEB_POST)
+        WEB_respond(link, WEB_405_METHOD_NOT_ALLOWED);
+      else if (web->route == WEB_ROUTE_NONE)
+        WEB_respond(link, WEB_404_NOT_FOUND);
+    }
+    break;
+
+  case WEB_BODY:
+    /* Um POST por vez: os demais aguardam no buffer da conexão */
+    if (webPostLink != link)
+    {
+      if (webPostLink != ESP_NO_LINK)
+        break;
+      WEB_process_POST(link);
+    }
+
+    while (webReader.getResult() == JsonReader::JSON_PARTIAL && (received = esp.receive(link)) >= 0)
+      webReader.feed((char)received);
+
+    if (webReader.getResult() != JsonReader::JSON_PARTIAL)
+      WEB_apply_POST(link);
+    break;
+
+  case WEB_WAITING:
+    /* Long-poll: responde com a próxima medida ou a captura concluída, ou com o estado atual ao expirar */
+#ifdef WAVEFORM_ENABLE
+    if ((web->route == WEB_ROUTE_WAVEFORM) ? (waveform.getState() != WaveformCapture::WAVEFORM_CAPTURING)
+                                           : (webMeasureSequence != web->length))
+#else
+    if (webMeasureSequence != web->length)
+#endif
+      WEB_respond(link, WEB_200_OK);
+    else if (web->timer.checkIntervalPassed(WEB_LONG_POLL_TIMEOUT))
+      WEB_respond(link, WEB_200_OK);
+    return;
+
+  case WEB_RESPONDING:
+    /* A publicação tem prioridade na fila de comandos: tenta no próximo loop */
+    if (esp.getQueueFree() < WEB_QUEUE_RESERVE + 2)
+      return;
+    if (esp.send(link, WEB_write_response, (const void *)(uintptr_t)link, NULL, 0, &web->future))
+      web->state = WEB_SENDING;
+    return;
+
+  case WEB_SENDING:
+    if (web->future.isPending())
+      return;
+    /* Corpo em partes: a próxima segue quando a anterior termina */
+    if (web->future.isDone() && web->unit != JSON_WRITER_END)
+    {
+      if (esp.getQueueFree() >= WEB_QUEUE_RESERVE + 2)
+        esp.send(link, WEB_write_response, (const void *)(uintptr_t)link, NULL, 0, &web->future);
+      return;
+    }
+    if (esp.close(link, &web->future))
+      web->state = WEB_CLOSING;
+    return;
+
+  case WEB_CLOSING:
+    if (!web->future.isPending())
+      WEB_release(link);
+    return;
+  }
+
+  /* Requisição incompleta: o corpo de um POST responde 400, o restante apenas encerra */
+  if (web->state <= WEB_BODY && web->timer.checkIntervalPassed(WEB_REQUEST_TIMEOUT))
+  {
+    if (webPostLink == link)
+      WEB_respond(link, WEB_400_BAD_REQUEST);
+    else
+    {
+      /* Sem resposta: segue direto para o encerramento */
+      esp.discard(link);
+      web->unit = JSON_WRITER_END;
+      web->state = WEB_SENDING;
+    }
+  }
+}
+
+/************************************************************************************
+  WEB_parse
+
+  Reads the request line and the headers, one byte at a time. The method and
+  the route are matched as they arrive, with 'method' and 'route' holding the
+  names still possible; the "wait" flag of the query is kept and the headers
+  are ignored. Once the headers end, the state is WEB_BODY.
+
+************************************************************************************/
+void WEB_parse(WEB_link_t *web, char received)
+{
+  uint8_t candidates;
+
+  switch (web->state)
+  {
+  case WEB_METHOD:
+    if (received != ' ')
+    {
+      web->method = WEB_match(webMethods, WEB_NAME_COUNT(webMethods), web->method, web->length++, received);
+      break;
+    }
+
+    /* O primeiro que termina aqui */
+    candidates = WEB_match(webMethods, WEB_NAME_COUNT(webMethods), web->method, web->length, '\0');
+    web->method = (candidates & _BV(WEB_GET)) ? WEB_GET : ((candidates & _BV(WEB_POST)) ? WEB_POST : WEB_OTHER);
+    web->length = 0;
+    web->state = WEB_PATH;
+    break;
+
+  case WEB_PATH:
+    /* A rota termina no '?' da query */
+    if (received != ' ' && received != '?')
     {
-      /* SSID */
-      if (!strcmp(tkn, "ssid"))
-      {
-        strtok(NULL, "\"");
-        tkn = strtok(NULL, "\"");
-        url_decode(tkn, espAp.ssid, sizeof(espAp.ssid)); /* Decodifica caracteres especiais */
-        str_safe(espAp.ssid, sizeof(espAp.ssid));        /* Torna a string 'segura' */
-      }
-      /* PASSWORD */
-      else if (!strcmp(tkn, "password"))
-      {
-        strtok(NULL, "\"");
-        tkn = strtok(NULL, "\"");
-        url_decode(tkn, espAp.password, sizeof(espAp.password)); /* Decodifica caracteres especiais */
-        str_safe(espAp.password, sizeof(espAp.password));        /* Torna a string 'segura' */
-      }
+      web->route = WEB_match(webRoutes, WEB_NAME_COUNT(webRoutes), web->route, web->length++, received);
+      break;
+    }
 
-      /* Continua parser */
-      tkn = NULL;
+    candidates = WEB_match(webRoutes, WEB_NAME_COUNT(webRoutes), web->route, web->length, '\0');
+    web->route = WEB_ROUTE_NONE;
+    for (uint8_t i = 0; i < WEB_NAME_COUNT(webRoutes); i++)
+      if (((candidates >> i) & 1) && ((pgm_read_byte(&webRoutes[i].methods) >> web->method) & 1))
+        web->route = pgm_read_byte(&webRoutes[i].route);
+    web->length = 0;
+    web->state = (received == '?') ? WEB_QUERY : WEB_HEADERS;
+    break;
+
+  case WEB_QUERY:
+    if (received == ' ')
+    {
+      web->length = 0;
+      web->state = WEB_HEADERS;
+      break;
     }
 
-    /* Salva AP na EEPROM */
-    LCD_print(F("ESP SERVER:"), F("GOT NEW WIFI"), 1000);
-    if (EEPROM_write((uint8_t *)&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET))
+    /* "wait" em qualquer ponto da query: letras distintas, um recomeço basta */
+    if (received == pgm_read_byte(&PSTR("wait")[web->length]))
+      web->length++;
+    else
+      web->length = (received == 'w') ? 1 : 0;
+    if (web->length == 4)
     {
-#ifdef LCD_ENABLE
-      LCD_print(F("EEPROM SAVED:"), F("AP"), 1000);
-
-      lcd.clear();
-      lcd.print(espAp.ssid);
-      lcd.setCursor(0, 1);
-      lcd.print(espAp.password);
-      delay(3000);
-      wdt_reset();
-#endif
+      web->wait = true;
+      web->length = 0;
     }
+    break;
+
+  case WEB_HEADERS:
+    /* Bytes de "\r\n\r\n" já recebidos */
+    if (received == ((web->length & 1) ? '\n' : '\r'))
+      web->length++;
+    else
+      web->length = (received == '\r') ? 1 : 0;
+
+    if (web->length == 4)
+      web->state = WEB_BODY;
+    break;
   }
+}
 
-  /* SERVERS */
-  if (strstr(path, "/servers.json"))
+/************************************************************************************
+  WEB_match
+
+  Narrows the candidates of a name table to those with 'received' at
+  'position'; '\0' keeps the ones that end there.
+
+************************************************************************************/
+uint8_t WEB_match(const WEB_name_t *names, uint8_t count, uint8_t candidates, uint8_t position, char received)
+{
+  /* Mais longo que todos: nenhum */
+  if (position >= WEB_PATH_SIZE)
+    return 0;
+
+  candidates &= (uint8_t)(_BV(count) - 1);
+  for (uint8_t i = 0; i < count; i++)
+    if (((candidates >> i) & 1) && (char)pgm_read_byte(&names[i].name[position]) != received)
+      candidates &= ~_BV(i);
+  return candidates;
+}
+
+/************************************************************************************
+  WEB_process_GET
+
+  Answers a GET. The body is generated when the module asks for it, with the
+  values of that moment. "/measures.json?wait" is answered only after the
+  next measure, and "/waveform.json?wait" starts a capture and is answered
+  once it is complete (long-poll).
+
+************************************************************************************/
+void WEB_process_GET(uint8_t link)
+{
+  WEB_link_t *web = &webLinks[link];
+
+  /* Monitoração contínua não ocupa o LCD */
+  if (web->route != WEB_ROUTE_MEASURES)
+    LCD_print(F("ESP SERVER:"), F("GET"));
+
+#ifdef WAVEFORM_ENABLE
+  if (web->route == WEB_ROUTE_WAVEFORM && web->wait)
   {
-    /* Para cada campo do objeto */
-    while ((tkn = strtok(tkn, "\"")) != NULL)
-    {
-      /* host */
-      if (!strcmp(tkn, "host"))
-      {
-        strtok(NULL, "\"");
-        tkn = strtok(NULL, "\"");
-        url_decode(tkn, espUrl.host, sizeof(espUrl.host)); /* Decodifica caracteres especiais */
-        str_safe(espUrl.host, sizeof(espUrl.host));        /* Torna a string 'segura' */
-      }
-      /* auth */
-      else if (!strcmp(tkn, "auth"))
-      {
-        strtok(NULL, "\"");
-        tkn = strtok(NULL, "\"");
-        url_decode(tkn, espUrl.auth, sizeof(espUrl.auth)); /* Decodifica caracteres especiais */
-        str_safe(espUrl.auth, sizeof(espUrl.auth));        /* Torna a string 'segura' */
-      }
-      /* client */
-      else if (!strcmp(tkn, "client"))
-      {
-        strtok(NULL, "\"");
-        tkn = strtok(NULL, "\"");
-        url_decode(tkn, espUrl.client, sizeof(espUrl.client)); /* Decodifica caracteres especiais */
-        str_safe(espUrl.client, sizeof(espUrl.client));        /* Torna a string 'segura' */
-      }
+    /* Uma captura em andamento é compartilhada pelos clientes que aguardam */
+    if (waveform.getState() != WaveformCapture::WAVEFORM_CAPTURING)
+      waveform.arm(channelCount);
+    web->timer.resetTimer();
+    web->state = WEB_WAITING;
+    return;
+  }
+#endif
 
-      /* Continua parser */
-      tkn = NULL;
-    }
+  if (web->route == WEB_ROUTE_MEASURES && web->wait)
+  {
+    web->length = webMeasureSequence;
+    web->timer.resetTimer();
+    web->state = WEB_WAITING;
+    return;
+  }
+
+  WEB_respond(link, (web->route == WEB_ROUTE_NONE) ? WEB_404_NOT_FOUND : WEB_200_OK);
+}
+
+/************************************************************************************
+  WEB_process_POST
+
+  Takes the POST slot: the JSON body is read from the connection into a copy
+  of the energy configuration, or straight into espAp or espUrl. Those are
+  restored by WEB_release() unless the body is applied; meanwhile, no
+  publication starts with a half-read espUrl.
+
+************************************************************************************/
+void WEB_process_POST(uint8_t link)
+{
+  LCD_print(F("ESP SERVER:"), F("POST"));
+
+  webPostLink = link;
+  webPostError = NULL;
+  webLinks[link].status = WEB_400_BAD_REQUEST; /* Até ser aplicado */
+
+  switch (webLinks[link].route)
+  {
+  case WEB_ROUTE_WIFI:
+    webReader = JsonReader(webWifiFields, WEB_FIELD_COUNT(webWifiFields), &espAp);
+    break;
+
+  case WEB_ROUTE_SERVERS:
+    webReader = JsonReader(webServerFields, WEB_FIELD_COUNT(webServerFields), &espUrl);
+    break;
+
+  case WEB_ROUTE_ENERGY:
+    webPostEnergy.config = energy[0].config;
+    webPostEnergy.channels = channelMap;
+    webPostEnergy.report = iotReport;
+    webReader = JsonReader(webEnergyFields, WEB_FIELD_COUNT(webEnergyFields), &webPostEnergy);
+    break;
+  }
+}
+
+/************************************************************************************
+  WEB_post_reading
+
+  Whether the POST slot holds a body of the route, not applied yet.
+
+************************************************************************************/
+bool WEB_post_reading(uint8_t route)
+{
+  return webPostLink != ESP_NO_LINK && webLinks[webPostLink].route == route;
+}
+
+/************************************************************************************
+  WEB_apply_POST
+
+  Applies the body read, only if the whole body is valid: the fields sent
+  are saved in the EEPROM. Otherwise, 400 names the failing field.
+
+************************************************************************************/
+void WEB_apply_POST(uint8_t link)
+{
+  if (webReader.getResult() != JsonReader::JSON_DONE)
+  {
+    webPostError = webReader.getErrorKey();
+    WEB_respond(link, WEB_400_BAD_REQUEST);
+    return;
+  }
+
+  switch (webLinks[link].route)
+  {
+  /* WIFI */
+  case WEB_ROUTE_WIFI:
+  {
+    ESP8266::esp_AP_parameter_t *ap = &espAp;
+    url_decode(ap->ssid, ap->ssid, sizeof(ap->ssid)); /* Decodifica caracteres especiais */
+    str_safe(ap->ssid, sizeof(ap->ssid));             /* Torna a string 'segura' */
+    url_decode(ap->password, ap->password, sizeof(ap->password));
+    str_safe(ap->password, sizeof(ap->password));
+
+    /* Salva AP na EEPROM */
+    if (EEPROM_write((uint8_t *)&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET))
+      LCD_print(F("EEPROM SAVED:"), F("AP"));
+    break;
+  }
+
+  /* SERVERS */
+  case WEB_ROUTE_SERVERS:
+  {
+    ESP8266::esp_URL_parameter_t *url = &espUrl;
+    url_decode(url->host, url->host, sizeof(url->host)); /* Decodifica caracteres especiais */
+    str_safe(url->host, sizeof(url->host));               /* Torna a string 'segura' */
+    url_decode(url->auth, url->auth, sizeof(url->auth));
+    str_safe(url->auth, sizeof(url->auth));
+    url_decode(url->client, url->client, sizeof(url->client));
+    str_safe(url->client, sizeof(url->client));
 
     /* Salva URL na EEPROM */
-    LCD_print(F("ESP SERVER:"), F("GOT NEW SERVER"), 1000);
     if (EEPROM_write((uint8_t *)&espUrl, sizeof(espUrl), EEPROM_ESP_URL_OFFSET))
-    {
-#ifdef LCD_ENABLE
-      LCD_print(F("EEPROM SAVED:"), F("SERVER"), 1000);
-
-      lcd.clear();
-      lcd.print(espUrl.host);
-      delay(3000);
-      wdt_reset();
-
-      lcd.clear();
-      lcd.print(espUrl.auth);
-      lcd.setCursor(0, 1);
-      lcd.print(espUrl.client);
-      delay(3000);
-      wdt_reset();
-#endif
-    }
+      LCD_print(F("EEPROM SAVED:"), F("SERVER"));
+    break;
   }
 
   /* ENERGY */
-  if (strstr(path, "/energy.json"))
+  case WEB_ROUTE_ENERGY:
   {
-    /* Para cada campo do objeto */
-    while ((tkn = strtok(tkn, "\"")) != NULL)
+    /* channels: ao menos uma entrada; aplicado na próxima inicialização, assim como voltage */
+    bool channelMapChanged = webReader.isSet(WEB_ENERGY_CHANNELS_FIELD) || webReader.isSet(WEB_ENERGY_VOLTAGE_FIELD);
+    if (channelMapChanged && webPostEnergy.channels.count == 0)
     {
-      /* dataSize */
-      if (!strcmp(tkn, "dataSize"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.dataSize = atoi(tkn);
-        energy[1].config.dataSize = atoi(tkn);
-      }
-      /* scale */
-      else if (!strcmp(tkn, "scale"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.scale = atoi(tkn);
-        energy[1].config.scale = atoi(tkn);
-      }
-      /* lineVoltage */
-      else if (!strcmp(tkn, "lineVoltage"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.lineVoltage = atoi(tkn);
-        energy[1].config.lineVoltage = atoi(tkn);
-      }
-      /* powerFactor */
-      else if (!strcmp(tkn, "powerFactor"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.powerFactor = atoi(tkn);
-        energy[1].config.powerFactor = atoi(tkn);
-      }
-      /* basePrice */
-      else if (!strcmp(tkn, "basePrice"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.basePrice = atof(tkn);
-        energy[1].config.basePrice = atof(tkn);
-      }
-      /* flagPrice */
-      else if (!strcmp(tkn, "flagPrice"))
-      {
-        tkn = strtok(NULL, ":,}");
-        energy[0].config.flagPrice = atof(tkn);
-        energy[1].config.flagPrice = atof(tkn);
-      }
-
-      /* Continua parser */
-      tkn = NULL;
+      webPostError = "channels";
+      WEB_respond(link, WEB_400_BAD_REQUEST);
+      return;
     }
 
-    /* Salva URL na EEPROM */
-    LCD_print(F("ESP SERVER:"), F("GOT NEW ENERGY"), 1000);
+    channelMap = webPostEnergy.channels;
+    for (uint8_t i = 0; i < CHANNEL_MAX; i++)
+      energy[i].config = webPostEnergy.config;
+    iotReport = webPostEnergy.report;
+
+    /* Salva mapa de canais na EEPROM */
+    if (channelMapChanged && EEPROM_write((uint8_t *)&channelMap, sizeof(channelMap), EEPROM_CHANNELS_OFFSET))
+      LCD_print(F("EEPROM SAVED:"), F("CHANNELS"));
+
+    /* Salva configuração e política de publicação na EEPROM */
     if (EEPROM_write((uint8_t *)&energy[0].config, sizeof(energy[0].config), EEPROM_ENERGY_OFFSET))
-    {
-#ifdef LCD_ENABLE
-      LCD_print(F("EEPROM SAVED:"), F("ENERGY"), 1000);
-
-      /* Imprime configuração SERVER atual */
-      lcd.clear();
-      lcd.print(F("dataSize: "));
-      lcd.print(energy[CHANNEL_1].config.dataSize);
-      lcd.setCursor(0, 1);
-      lcd.print(F("scale: "));
-      lcd.print(energy[CHANNEL_1].config.scale);
-      delay(3000);
-      wdt_reset();
-
-      lcd.clear();
-      lcd.print(F("basePrice: "));
-      lcd.print(energy[CHANNEL_1].config.basePrice, 3);
-      lcd.setCursor(0, 1);
-      lcd.print(F("flagPrice: "));
-      lcd.print(energy[CHANNEL_1].config.flagPrice, 3);
-      delay(3000);
-      wdt_reset();
-
-      lcd.clear();
-      lcd.print(F("lineVoltage: "));
-      lcd.print(energy[CHANNEL_1].config.lineVoltage);
-      lcd.setCursor(0, 1);
-      lcd.print(F("powerFactor: "));
-      lcd.print(energy[CHANNEL_1].config.powerFactor);
-      delay(3000);
-      wdt_reset();
-#endif
-    }
+      LCD_print(F("EEPROM SAVED:"), F("ENERGY"));
+    EEPROM_write((uint8_t *)&iotReport, sizeof(iotReport), EEPROM_REPORT_OFFSET);
+    break;
+  }
   }
 
-  /* 404 - NOT FOUND */
-  else
+  WEB_respond(link, WEB_204_NO_CONTENT);
+}
+
+/************************************************************************************
+  WEB_respond
+
+  Sets the response of a connection; it is queued by WEB_serve(). The rest of
+  the request is dropped.
+
+************************************************************************************/
+void WEB_respond(uint8_t link, uint8_t status)
+{
+  esp.discard(link);
+  webLinks[link].status = status;
+  webLinks[link].unit = 0;
+  webLinks[link].state = WEB_RESPONDING;
+}
+
+/************************************************************************************
+  WEB_release
+
+  Frees a connection for the next request, and the POST slot if it was taken.
+
+************************************************************************************/
+void WEB_release(uint8_t link)
+{
+  if (webPostLink == link)
   {
-    /* ESP8266: Inicializar envio */
-    serial_flush();
-    Serial.print("AT+CIPSENDEX="); /* AT: Send command */
-    Serial.print(connection);
-    Serial.print(",2047\r\n");
-    if (!serial_get(">", 100, NULL, 0)) /* Aguarda '>' */
+    /* Corpo lido no lugar e não aplicado: volta ao que está salvo */
+    if (webLinks[link].status != WEB_204_NO_CONTENT)
     {
-      esp.close(ESP_CLOSE_ALL);
-      return false;
+      if (webLinks[link].route == WEB_ROUTE_WIFI)
+        EEPROM_load(&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET, &espApDefault);
+      else if (webLinks[link].route == WEB_ROUTE_SERVERS)
+        EEPROM_load(&espUrl, sizeof(espUrl), EEPROM_ESP_URL_OFFSET, &espUrlDefault);
     }
+    webPostLink = ESP_NO_LINK;
+  }
+
+  webLinks[link].state = WEB_FREE;
+  webLinks[link].route = WEB_ROUTE_NONE;
+}
 
-    /* Header */
-    Serial.print(F("HTTP/1.1 404 Not Found\r\n"));
+/************************************************************************************
+  WEB_valid_input
 
-    /* Finaliza comando de envio ao módulo WiFi */
-    Serial.print("\\0");
+  Input accepted in "channels".
 
-    /* Obtém resposta e encerra conexão */
-    serial_get("SEND OK\r\n", 100, NULL, 0);
-    esp.close(connection);
-  }
+************************************************************************************/
+bool WEB_valid_input(float value)
+{
+  return ACQUISITION_INPUT_VALID((uint8_t)value);
+}
 
-  /* ESP8266: Inicializar envio */
-  if (!WEB_204_no_content(connection))
-    return false;
+/************************************************************************************
+  WEB_valid_voltage
 
-  return false;
+  Input accepted in "voltage": single-ended, or none.
+
+************************************************************************************/
+bool WEB_valid_voltage(float value)
+{
+  return (uint8_t)value == ACQUISITION_INPUT_NONE || ACQUISITION_INPUT_SINGLE_ENDED((uint8_t)value);
 }
 
 /*******************************************************************************
-   WEB_chuck_init
+   JSON_array
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Writes a member with a per-channel array: "key":[v0,v1,...].
+ * @param json Writer.
+ * @param key Name of the field.
+ * @param getter Energy method giving the value of each channel.
+ * @param digits Decimal places.
+ * @return void
  *******************************************************************************/
-bool WEB_chunk_init(uint8_t connection)
-{
-  /* ESP8266: Inicializar envio */
-  serial_flush();
-  Serial.print(F("AT+CIPSENDEX="));
-  Serial.print(connection);
-  Serial.print(",2047\r\n");
-  if (!serial_get(">", 1000, NULL, 0))
-  {
-    esp.close(ESP_CLOSE_ALL);
-    return false;
-  }
-  return true;
+void JSON_array(JsonWriter &json, const __FlashStringHelper *key, float (Energy::*getter)(void), uint8_t digits)
+{
+  json.key(key);
+  json.beginArray();
+  for (uint8_t i = 0; i < channelCount; i++)
+    json.value((energy[i].*getter)(), digits);
+  json.endArray();
 }
 
 /*******************************************************************************
-   WEB_chuck_send
+   WEB_write_response
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Writes one part of the response of a connection, after the '>' of
+ *        its AT+CIPSENDEX: the headers in the first part, then the JSON body
+ *        in chunks of UART_send_size() bytes, one per part. WEB_serve()
+ *        queues the next part while web->unit is not JSON_WRITER_END.
+ * @param serial Serial of the module.
+ * @param context Connection.
+ * @return void
  *******************************************************************************/
-void WEB_chunk_send(char *chuck)
+void WEB_write_response(Stream &serial, const void *context)
 {
-  /* ENVIO DO CHUNCK */
-  Serial.println(strlen(chuck), HEX); /* CHUNCK SIZE */
-  Serial.println(chuck);
+  WEB_link_t *web = &webLinks[(uintptr_t)context];
+  JsonWriter::json_body_t body = NULL;
+  const void *bodyContext = NULL;
+  uint32_t startBytes = espSerial.getWriteCount();
+
+  /* Corpo de cada status */
+  if (web->status == WEB_200_OK)
+    body = WEB_body(web->route);
+  else if (web->status == WEB_400_BAD_REQUEST)
+  {
+    /* {"error":"<campo>"} */
+    body = WEB_body_error;
+    bodyContext = (webPostError && webPostError[0]) ? webPostError : "body";
+  }
+
+  if (web->unit == 0)
+  {
+    /* HTTP HEADERS */
+    switch (web->status)
+    {
+    case WEB_200_OK:
+      serial.print(F("HTTP/1.1 200 OK\r\n"));
+      break;
+    case WEB_204_NO_CONTENT:
+      serial.print(F("HTTP/1.1 204 No Content\r\n"));
+      break;
+    case WEB_400_BAD_REQUEST:
+      serial.print(F("HTTP/1.1 400 Bad Request\r\n"));
+      break;
+    case WEB_404_NOT_FOUND:
+      serial.print(F("HTTP/1.1 404 Not Found\r\n"));
+      break;
+    default:
+      serial.print(F("HTTP/1.1 405 Method Not Allowed\r\n"));
+      break;
+    }
+    /* Hosts */
+    serial.print(F("Host: 192.168.4.1\r\n"));
+    /* Connection */
+    serial.print(F("Connection: Close\r\n"));
+
+    if (body == NULL)
+    {
+      /* Header End */
+      serial.print(F("\r\n"));
+      web->unit = JSON_WRITER_END;
+      return;
+    }
+
+    /* Transfer-Encoding */
+    serial.print(F("Transfer-Encoding: Chunked\r\n"));
+    /* Header End */
+    serial.print(F("\r\n"));
+  }
+
+  /* Body: as unidades que ainda cabem na parte, num chunk */
+  uint16_t written = espSerial.getWriteCount() - startBytes;
+  if (JsonWriter::writeChunk(serial, body, bodyContext, &web->unit, UART_send_space(written)))
+  {
+    /* End chunk */
+    serial.print(F("0\r\n\r\n"));
+  }
 }
 
 /*******************************************************************************
-   WEB_chuck_finish
+   WEB_body
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Gets the body of a GET route.
+ * @param route WEB_ROUTE_*.
+ * @return Generates the body, or NULL.
  *******************************************************************************/
-bool WEB_chunk_finish(void)
+JsonWriter::json_body_t WEB_body(uint8_t route)
 {
-  /* Finaliza envio e obtém confirmação */
-  Serial.print("\\0");
-  if (!serial_get("SEND OK\r\n", 1000, NULL, 0))
+  switch (route)
   {
-    esp.close(ESP_CLOSE_ALL);
-    return false;
+  case WEB_ROUTE_WIFI:
+    return WEB_body_wifi;
+  case WEB_ROUTE_SERVERS:
+    return WEB_body_server;
+  case WEB_ROUTE_ENERGY:
+    return WEB_body_energy;
+  case WEB_ROUTE_QUEUE:
+    return WEB_body_queue;
+  case WEB_ROUTE_MEASURES:
+    return WEB_body_measures;
+#ifdef WAVEFORM_ENABLE
+  case WEB_ROUTE_WAVEFORM:
+    return WEB_body_waveform;
+#endif
   }
-  esp.close(ESP_CLOSE_ALL);
-  return true;
+  return NULL;
 }
 
 /*******************************************************************************
-   ESP_local_server_init
+   WEB_body_wifi
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Body of /wifi.json: the access point used.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
  *******************************************************************************/
-bool WEB_headers(uint8_t connection)
+void WEB_body_wifi(JsonWriter &json, const void *context)
 {
-  /* ESP8266: Inicializar 1º envio */
-  if (!WEB_chunk_init(connection))
-    return false;
+  (void)context;
 
-  /* HTTP HEADERS */
-  serial_flush();
-  Serial.print(F("HTTP/1.1 200 OK\r\n"));
-  /* Hosts */
-  Serial.print(F("Host: 192.168.4.1\r\n"));
-  /* Connection */
-  Serial.print(F("Connection: Close\r\n"));
-  /* Transfer-Encoding */
-  Serial.print(F("Transfer-Encoding: Chunked\r\n"));
-  /* Header End */
-  Serial.print(F("\r\n"));
+  json.beginObject();
+  json.member(F("ssid"), espAp.ssid);
+  json.member(F("password"), espAp.password);
+  json.endObject();
+}
 
-  return true;
+/*******************************************************************************
+   WEB_body_server
+****************************************************************************/
+/**
+ * @brief Body of /server.json: the cloud server.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
+ *******************************************************************************/
+void WEB_body_server(JsonWriter &json, const void *context)
+{
+  (void)context;
+
+  json.beginObject();
+  json.member(F("host"), espUrl.host);
+  json.member(F("auth"), espUrl.auth);
+  json.member(F("client"), espUrl.client);
+  json.endObject();
 }
 
 /*******************************************************************************
-   WEB_204_no_content
+   WEB_body_energy
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Body of /energy.json: the energy configuration and the channels.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
  *******************************************************************************/
-bool WEB_204_no_content(uint8_t connection)
+void WEB_body_energy(JsonWriter &json, const void *context)
 {
-  /* ESP8266: Inicializar 1º envio */
-  if (!WEB_chunk_init(connection))
-    return false;
+  (void)context;
+
+  json.beginObject();
+  json.member(F("dataSize"), energy[0].config.dataSize);
+  json.member(F("scale"), energy[0].config.scale);
+  json.member(F("lineVoltage"), energy[0].config.lineVoltage);
+  json.member(F("powerFactor"), energy[0].config.powerFactor);
+  json.member(F("basePrice"), energy[0].config.basePrice, 3);
+  json.member(F("flagPrice"), energy[0].config.flagPrice, 3);
+  json.member(F("windowCycles"), energy[0].config.windowCycles);
+
+  /* channels: entrada de cada canal, ver ACQUISITION_INPUT() e ACQUISITION_INPUT_INTERNAL() */
+  json.key(F("channels"));
+  json.beginArray();
+  for (uint8_t i = 0; i < channelCount; i++)
+    json.value(acquisition.getInput(i));
+  json.endArray();
+
+  /* voltage: entrada de tensão em uso, ou ACQUISITION_INPUT_NONE */
+  json.member(F("voltage"), acquisition.getVoltageInput());
+  json.member(F("voltageScale"), energy[0].config.voltageScale);
+  json.member(F("phaseCal"), energy[0].config.phaseCal);
+
+  /* Publicação por exceção; contadores em /queue.json */
+  json.member(F("bandPercent"), iotReport.bandPercent);
+  json.member(F("bandCurrent"), iotReport.bandCurrent, 3);
+  json.member(F("bandPower"), iotReport.bandPower, 1);
+  json.member(F("maxSilence"), iotReport.maxSilence);
+  json.member(F("minSpacing"), iotReport.minSpacing);
+
+  /* Por canal (somente leitura): corrente da última janela, frequência medida na janela síncrona e taxa efetiva */
+  JSON_array(json, F("current"), &Energy::getRmsLast, 3);
+  JSON_array(json, F("lineFrequency"), &Energy::getLineFrequency, 2);
+  JSON_array(json, F("sampleRate"), &Energy::getSampleRate, 1);
+  json.endObject();
+}
 
-  /* HTTP HEADERS */
-  serial_flush();
-  Serial.print(F("HTTP/1.1 204 No Content\r\n"));
-  /* Hosts */
-  Serial.print(F("Host: 192.168.4.1\r\n"));
-  /* Connection */
-  Serial.print(F("Connection: Close\r\n"));
-  /* Header End */
-  Serial.print(F("\r\n"));
-
-  /* Finaliza conexão */
-  if (!WEB_chunk_finish())
-    return false;
+/*******************************************************************************
+   WEB_body_queue
+****************************************************************************/
+/**
+ * @brief Body of /queue.json: the publication queue and the last uploads.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
+ *******************************************************************************/
+void WEB_body_queue(JsonWriter &json, const void *context)
+{
+  (void)context;
+
+  json.beginObject();
+
+  /* depth: intervalos na RAM e na EEPROM */
+  json.member(F("ram"), iotBatch.count);
+  json.member(F("eeprom"), iotBacklog.count);
+  json.member(F("capacity"), IOT_batch_capacity() + IOT_backlog_capacity());
+
+  /* dropped */
+  json.member(F("dropped"), iotDropped);
+  json.member(F("seqNumber"), iotSeqNumber);
+
+  /* Publicação por exceção: intervalos publicados e suprimidos, e a economia estimada */
+  uint16_t reports = iotReportsSent + iotReportsSuppressed;
+  json.member(F("reportsSent"), iotReportsSent);
+  json.member(F("reportsSuppressed"), iotReportsSuppressed);
+  json.member(F("suppressedPercent"), reports ? iotReportsSuppressed * 100.0f / reports : 0.0f, 1);
+
+  /* Última requisição, por intervalo: bytes e tempo na UART do formato em uso */
+  uint8_t intervals = max(iotBatch.sent, 1);
+  json.member(F("format"), IOT_PAYLOAD_FORMAT == IOT_FORMAT_PACKED ? F("packed") : F("json"));
+  json.member(F("bytesPerInterval"), iotPayloadBytes / intervals);
+  json.member(F("uartMicrosPerInterval"), iotPayloadMicros / intervals);
+  json.member(F("uplink"), IOT_UPLINK == IOT_UPLINK_MQTT ? F("mqtt") : F("firebase"));
+  json.member(F("latencyMillis"), iotLatencyMillis); /* Da última publicação, até a confirmação */
+  json.member(F("savedBytes"), iotReportsSuppressed * (iotPayloadBytes / intervals)); /* Estimativa, pelo último lote */
+
+  /* Serial do ESP: taxa negociada, erros da negociação e desde o reset */
+  json.key(F("uart"));
+  json.beginObject();
+  json.member(F("rate"), uartLink.rate);
+  json.member(F("rejected"), uartLink.rejected);
+  json.member(F("negotiationFramingErrors"), uartLink.framingErrors);
+  json.member(F("negotiationOverflows"), uartLink.overflowErrors);
+  json.member(F("framingErrors"), espSerial.getFramingErrorCount());
+  json.member(F("overflows"), espSerial.getOverflowCount());
+  json.member(F("recoveries"), uartRecoveries);
+  json.endObject();
+
+  /* drain: última recuperação, em intervalos por minuto */
+  json.member(F("drained"), iotDrained);
+  json.member(F("drainMillis"), iotDrainMillis);
+  json.member(F("drainRate"), iotDrainMillis ? iotDrained * 60000.0f / iotDrainMillis : 0.0f, 1);
+  json.endObject();
+}
 
-  return true;
+/*******************************************************************************
+   WEB_body_measures
+****************************************************************************/
+/**
+ * @brief Body of /measures.json: the latest values of each channel.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
+ *******************************************************************************/
+void WEB_body_measures(JsonWriter &json, const void *context)
+{
+  (void)context;
+
+  json.beginObject();
+  json.member(F("timestamp"), timestamp + publishTimer.getElapsedTime() / 1000u);
+  json.member(F("sequence"), webMeasureSequence); /* Com "?wait": medidas perdidas entre requisições */
+
+  /* Por canal: última janela, média do intervalo em andamento e do último publicado */
+  JSON_array(json, F("current"), &Energy::getRmsLast, 3);
+  JSON_array(json, F("average"), &Energy::getRmsAverage, 3);
+  JSON_array(json, F("interval"), &Energy::getElectricCurrentAmperes, 3);
+
+  /* Última janela, nos canais com entrada de tensão (null nos demais) */
+  JSON_array(json, F("voltage"), &Energy::getVoltageRms, 1);
+  JSON_array(json, F("power"), &Energy::getRealPowerLast, 1);
+  JSON_array(json, F("powerFactor"), &Energy::getPowerFactorLast, 3);
+
+  /* Acumulados do dia */
+  JSON_array(json, F("energy"), &Energy::getEnergyAccumulatedKiloWattsHour, 4);
+  JSON_array(json, F("cost"), &Energy::getCostAccumulatedReais, 2);
+
+#ifdef ENERGY_HARMONICS
+  /* Última janela: RMS da fundamental, 3ª e 5ª harmônicas [A] e THD [%]; null sem análise */
+  JSON_array(json, F("thd"), &Energy::getThd, 1);
+  json.key(F("harmonics"));
+  json.beginArray();
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    json.beginArray();
+    for (uint8_t h = 0; h < ENERGY_HARMONIC_COUNT; h++)
+      json.value(energy[i].getHarmonic(h), 3);
+    json.endArray();
+  }
+  json.endArray();
+#endif
+  json.endObject();
 }
 
+#ifdef WAVEFORM_ENABLE
 /*******************************************************************************
-   WEB_204_no_content
+   WEB_body_waveform
 ****************************************************************************/
 /**
- * @brief
- * @param
- * @return
+ * @brief Body of /waveform.json: the state of the capture and, once it is
+ *        complete, its buffer in base64 with what rebuilds the samples.
+ * @param json Writer.
+ * @param context Unused.
+ * @return void
  *******************************************************************************/
-bool WEB_400_bad_request(uint8_t connection)
+void WEB_body_waveform(JsonWriter &json, const void *context)
 {
-  /* ESP8266: Inicializar 1º envio */
-  if (!WEB_chunk_init(connection))
-    return false;
+  (void)context;
 
-  /* HTTP HEADERS */
-  serial_flush();
-  Serial.print(F("HTTP/1.1 400 Bad Request\r\n"));
-  /* Hosts */
-  Serial.print(F("Host: 192.168.4.1\r\n"));
-  /* Connection */
-  Serial.print(F("Connection: Close\r\n"));
-  /* Header End */
-  Serial.print(F("\r\n"));
-
-  /* Finaliza conexão */
-  if (!WEB_chunk_finish())
-    return false;
+  uint8_t state = waveform.getState();
+  json.beginObject();
+  json.member(F("state"), state == WaveformCapture::WAVEFORM_DONE ? F("done") : (state == WaveformCapture::WAVEFORM_CAPTURING ? F("capturing") : F("idle")));
+  if (state != WaveformCapture::WAVEFORM_DONE)
+  {
+    json.endObject();
+    return;
+  }
 
-  return true;
+  /* Por canal capturado: taxa de amostragem e peso da contagem, para amostras em amperes */
+  json.key(F("sampleRate"));
+  json.beginArray();
+  for (uint8_t i = 0; i < waveform.getChannelCount(); i++)
+    json.value(acquisition.getConversionRate(i), 1);
+  json.endArray();
+  json.key(F("lsbMillivolts"));
+  json.beginArray();
+  for (uint8_t i = 0; i < waveform.getChannelCount(); i++)
+    json.value(acquisition.getLsbMillivolts(i), 6);
+  json.endArray();
+  json.member(F("scale"), energy[CHANNEL_1].config.scale);
+
+  /* Segmentos zig-zag/varint, ver WaveformCapture.h (tools/waveform_decode.py) */
+  json.key(F("data"));
+  json.beginString();
+  Base64Writer encoder(json.raw());
+  encoder.begin();
+  for (uint16_t i = 0; i < waveform.getSize(); i++)
+    encoder.write(waveform.getData()[i]);
+  encoder.end();
+  json.endString();
+  json.endObject();
+}
+#endif
+
+/*******************************************************************************
+   WEB_body_error
+****************************************************************************/
+/**
+ * @brief Body of a 400 answer.
+ * @param json Writer.
+ * @param context Key of the failing field.
+ * @return void
+ *******************************************************************************/
+void WEB_body_error(JsonWriter &json, const void *context)
+{
+  json.beginObject();
+  json.member(F("error"), (const char *)context);
+  json.endObject();
 }
 
 /************************************************************************************
@@ -1091,11 +3136,11 @@ bool WEB_400_bad_request(uint8_t connection)
 ************************************************************************************/
 bool EEPROM_write(const uint8_t *buffer, int size, int addr)
 {
-  /* Escreve buffer na EEPROM */
+  /* Escreve buffer na EEPROM, apenas os bytes alterados (desgaste da fila de publicação) */
   /* Salva CRC8 no final */
   for (int i = 0; i < size; i++)
-    EEPROM.write(addr++, buffer[i]);
-  EEPROM.write(addr, CRC_8(buffer, size, CRC_8_MAXIM_POLY));
+    EEPROM.update(addr++, buffer[i]);
+  EEPROM.update(addr, CRC_8(buffer, size, CRC_8_MAXIM_POLY));
 
   return true;
 }
@@ -1108,39 +3153,49 @@ bool EEPROM_write(const uint8_t *buffer, int size, int addr)
 ************************************************************************************/
 bool EEPROM_read(uint8_t *buffer, int size, int addr)
 {
-  uint8_t *temp = (uint8_t *)malloc(size);
-  if (!temp)
-    return false;
-
-  /* Escreve buffer na EEPROM */
+  /* Verifica o CRC8 no final antes de copiar: em falha, o buffer mantém o padrão */
+  /* Byte a byte, sem cópia temporária: o CRC_8 (MSB primeiro, inicial 0) continua de 'crc ^ dado' */
+  uint8_t crc = 0;
   for (int i = 0; i < size; i++)
-    temp[i] = EEPROM.read(addr++);
-
-  /* Verifica CRC8 no final */
-  if (EEPROM.read(addr) != CRC_8(temp, size, CRC_8_MAXIM_POLY))
   {
-    free(temp);
-    return false;
+    crc ^= EEPROM.read(addr + i);
+    crc = CRC_8(&crc, 1, CRC_8_MAXIM_POLY);
   }
+  if (EEPROM.read(addr + size) != crc)
+    return false;
 
-  /* Copia o buffer recebido */
-  memcpy(buffer, temp, size);
-  free(temp);
+  /* Copia para o buffer */
+  for (int i = 0; i < size; i++)
+    buffer[i] = EEPROM.read(addr + i);
   return true;
 }
 
+/************************************************************************************
+  EEPROM_load
+
+  Reads a configuration from the EEPROM or, without a valid copy there, its
+  default from the flash.
+
+************************************************************************************/
+bool EEPROM_load(void *buffer, int size, int addr, const void *defaults)
+{
+  if (EEPROM_read((uint8_t *)buffer, size, addr))
+    return true;
+
+  memcpy_P(buffer, defaults, size);
+  return false;
+}
+
 /************************************************************************************
   serial_flush
 
-  This function flushes the serial buffer.
+  This function flushes the AT responses received so far. The content of the
+  connections is kept.
 
 ************************************************************************************/
 void serial_flush(void)
 {
-  /* Obt�m bytes dispon�veis */
-  while (Serial.available())
-    Serial.read();
-
+  esp.flushResponses();
   return;
 }
 
@@ -1148,30 +3203,54 @@ void serial_flush(void)
   serial_get
 
   This function gets messages from serial, during a certain timeout.
+  The usual AT failures end the wait at once.
+
+************************************************************************************/
+bool serial_get(const __FlashStringHelper *stringChecked, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize)
+{
+  ResponseMatcher matcher;
+
+  /* Índice 0: string esperada; os demais: falhas do módulo */
+  if (matcher.add(stringChecked) != 0)
+    return false;
+  matcher.add(ESP_ERROR_RESPONSE);
+  matcher.add(ESP_FAIL_RESPONSE);
+  matcher.add(ESP_BUSY_RESPONSE);
+
+  return serial_match(matcher, ESP_NO_LINK, timeout, returnBuffer, returnBufferSize) == 0;
+}
+
+/************************************************************************************
+  serial_match
+
+  This function waits for any of the patterns of the matcher, during a certain
+  timeout, in the AT responses (ESP_NO_LINK) or in the content of a connection.
+  Returns the index of the pattern, or RESPONSE_MATCHER_NONE.
 
 ************************************************************************************/
-bool serial_get(const char *stringChecked, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize)
+uint8_t serial_match(ResponseMatcher &matcher, uint8_t link, uint32_t timeout, char *returnBuffer, uint16_t returnBufferSize)
 {
-  uint16_t position = 0;
   uint16_t returnBufferPosition = 0;
   Timer serialTimer = Timer();
 
   /* Verifica argumentos de entrada */
-  if (stringChecked[position] == '\0' || timeout == 0)
-    return false;
+  if (timeout == 0)
+    return RESPONSE_MATCHER_NONE;
   if (returnBuffer != NULL)
   {
     if (returnBufferSize < 2)
-      return false;
+      return RESPONSE_MATCHER_NONE;
     returnBuffer[returnBufferPosition] = '\0';
   }
+  matcher.reset();
 
   while (true)
   {
     /* Enquanto houver dados no buffer, receber e comparar com a string a ser checada */
-    while (Serial.available())
+    int16_t received;
+    while ((received = (link == ESP_NO_LINK) ? esp.receive() : esp.receive(link)) >= 0)
     {
-      char buffer = (char)Serial.read();
+      char buffer = (char)received;
 
       /* Caso tenha recebido null char, subtitui por um espaço */
       if (buffer == '\0')
@@ -1188,26 +3267,15 @@ bool serial_get(const char *stringChecked, uint32_t timeout, char *returnBuffer,
           returnBufferPosition = 0;
       }
 
-      /* Avança ponteiro e coloca NULL char para finalizar string */
-      if (buffer == stringChecked[position])
-      {
-        /* Incrementa posição da string de verificação */
-        position++;
-
-        /* Verifica se atingiu o final da string de verificação */
-        if (stringChecked[position] == '\0')
-          return true;
-      }
-      else
-      {
-        /* Inicia verificação do início */
-        position = 0;
-      }
+      /* Avança todos os padrões; sobreposições não reiniciam a busca */
+      uint8_t matched = matcher.feed(buffer);
+      if (matched != RESPONSE_MATCHER_NONE)
+        return matched;
     }
 
     /* Verifica se já passou o limite */
     if (serialTimer.checkIntervalPassed(timeout))
-      return false;
+      return RESPONSE_MATCHER_NONE;
 
     /* Atualiza watchdog */
     wdt_reset();
@@ -1303,6 +3371,16 @@ void str_safe(char *str, uint32_t size)
   }
 }
 
+/* Sum of a measure over every channel */
+float ENERGY_total(float (Energy::*getter)(void))
+{
+  float total = 0;
+  for (uint8_t i = 0; i < channelCount; i++)
+    total += (energy[i].*getter)();
+
+  return total;
+}
+
 void LCD_print(const __FlashStringHelper *line1, const __FlashStringHelper *line2, uint32_t delayMs)
 {
 #ifdef LCD_ENABLE
@@ -0,0 +1,198 @@
+/** @file InternalADC.cpp
+ *  @brief Functions related with the MCU internal 10 bits ADC, in free-running mode.
+ */
+#include "InternalADC.h"
+
+/*******************************************************************************
+   start
+****************************************************************************/
+/**
+ * @brief Starts free-running conversions on an analog pin.
+ *
+ * The ADC runs from AVcc at 125kHz (~9.6 kS/s) and auto-triggers itself; each
+ * conversion is stored by the ADC interrupt in a double buffer. Use read() to
+ * drain it.
+ * @param pin Analog input (0 = A0 ... 7 = A7).
+ * @return void
+*******************************************************************************/
+void InternalADC::start(uint8_t pin)
+{
+    this->stop();
+
+    noInterrupts();
+    instance = this;
+    this->reset();
+
+    /* Desliga o buffer digital do pino analógico */
+    if (pin < 6)
+        DIDR0 |= _BV(pin);
+
+    /* Referência AVcc, canal */
+    ADMUX = _BV(REFS0) | (pin & INTERNAL_ADC_MAX_PIN);
+
+    /* Auto-trigger em free running */
+    ADCSRB = 0;
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | INTERNAL_ADC_PRESCALER;
+    ADCSRA |= _BV(ADSC);
+    interrupts();
+}
+
+/*******************************************************************************
+   selectPin
+****************************************************************************/
+/**
+ * @brief Switches the analog input without stopping the conversions.
+ *
+ * The conversion in progress completes on the previous input, so the caller
+ * must discard the first samples. Buffered samples are dropped.
+ * @param pin Analog input (0 = A0 ... 7 = A7).
+ * @return void
+*******************************************************************************/
+void InternalADC::selectPin(uint8_t pin)
+{
+    noInterrupts();
+    if (pin < 6)
+        DIDR0 |= _BV(pin);
+    ADMUX = _BV(REFS0) | (pin & INTERNAL_ADC_MAX_PIN);
+    this->reset();
+    interrupts();
+}
+
+/*******************************************************************************
+   stop
+****************************************************************************/
+/**
+ * @brief Stops the free-running conversions.
+ * @param void
+ * @return void
+*******************************************************************************/
+void InternalADC::stop(void)
+{
+    noInterrupts();
+    if (instance == this)
+    {
+        ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+        instance = NULL;
+    }
+    interrupts();
+}
+
+/*******************************************************************************
+   read
+****************************************************************************/
+/**
+ * @brief Gets the next sample from the half of the double buffer that is ready.
+ * @param[out] sample Conversion, centered on mid-scale.
+ * @return true if a sample was returned.\n
+           false if no half is complete yet.
+*******************************************************************************/
+bool InternalADC::read(int16_t *sample)
+{
+    if (!(this->readyMask & _BV(this->readBlock)))
+        return false;
+
+    *sample = this->blocks[this->readBlock][this->readIndex++];
+
+    /* Metade consumida: devolve à ISR */
+    if (this->readIndex == INTERNAL_ADC_BLOCK_SIZE)
+    {
+        this->readIndex = 0;
+        noInterrupts();
+        this->readyMask &= ~_BV(this->readBlock);
+        interrupts();
+        this->readBlock ^= 1;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+   getConversionStamp
+****************************************************************************/
+/**
+ * @brief Gets the conversion counter and the time of the last complete half.
+ * @param[out] count Conversions stored in complete halves.
+ * @param[out] micros Time of the last one, in microseconds.
+ * @return void
+*******************************************************************************/
+void InternalADC::getConversionStamp(uint16_t *count, uint32_t *micros)
+{
+    noInterrupts();
+    *count = this->conversionCount;
+    *micros = this->conversionMicros;
+    interrupts();
+}
+
+/*******************************************************************************
+   conversionHandler
+****************************************************************************/
+/**
+ * @brief Dispatches the ADC interrupt to the active instance.
+ * @param void
+ * @return void
+*******************************************************************************/
+void InternalADC::conversionHandler(void)
+{
+    if (instance != NULL)
+        instance->onConversion();
+}
+
+/*******************************************************************************
+   onConversion
+****************************************************************************/
+/**
+ * @brief Stores one conversion. Runs in interrupt context.
+ *
+ * When a half is full it is handed to the consumer and filling moves to the
+ * other half. If the consumer still holds the other half, the half just
+ * filled is overwritten and the loss is counted.
+ * @param void
+ * @return void
+*******************************************************************************/
+void InternalADC::onConversion(void)
+{
+    this->blocks[this->fillBlock][this->fillIndex++] = (int16_t)ADC - INTERNAL_ADC_MIDSCALE;
+    if (this->fillIndex < INTERNAL_ADC_BLOCK_SIZE)
+        return;
+
+    this->fillIndex = 0;
+    this->conversionCount += INTERNAL_ADC_BLOCK_SIZE;
+    this->conversionMicros = micros();
+
+    /* A outra metade ainda não foi lida */
+    if (this->readyMask & _BV(this->fillBlock ^ 1))
+    {
+        this->overrunCount += INTERNAL_ADC_BLOCK_SIZE;
+        return;
+    }
+
+    this->readyMask |= _BV(this->fillBlock);
+    this->fillBlock ^= 1;
+}
+
+/*******************************************************************************
+   reset
+****************************************************************************/
+/**
+ * @brief Empties the double buffer. Interrupts must be disabled.
+ * @param void
+ * @return void
+*******************************************************************************/
+void InternalADC::reset(void)
+{
+    this->readyMask = 0;
+    this->fillBlock = 0;
+    this->fillIndex = 0;
+    this->readBlock = 0;
+    this->readIndex = 0;
+}
+
+/*******************************************************************************
+   ISR
+****************************************************************************/
+InternalADC *InternalADC::instance = NULL;
+
+ISR(ADC_vect)
+{
+    InternalADC::conversionHandler();
+}
@@ -0,0 +1,60 @@
+/** @file InternalADC.h
+ *  @brief Header to the MCU internal 10 bits ADC, in free-running mode.
+ */
+
+#ifndef _INTERNAL_ADC_H_
+#define _INTERNAL_ADC_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define INTERNAL_ADC_BLOCK_SIZE (32u) /* Amostras por metade do buffer duplo (~3.3ms) */
+#define INTERNAL_ADC_PRESCALER (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0)) /* 16MHz/128 = 125kHz */
+#define INTERNAL_ADC_RATE (9615u)		/* 125kHz / 13 ciclos por conversão */
+#define INTERNAL_ADC_LSB_MV (4.8828125f) /* Referência AVcc: 5000.0/1024.0 */
+#define INTERNAL_ADC_MIDSCALE (512)		/* Entrada polarizada em AVcc/2 */
+#define INTERNAL_ADC_MAX_PIN (7u)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+class InternalADC
+{
+public:
+	void start(uint8_t pin);
+	void selectPin(uint8_t pin);
+	void stop(void);
+	bool read(int16_t *sample);
+	uint16_t getOverrunCount(void) { return this->overrunCount; }
+	void getConversionStamp(uint16_t *count, uint32_t *micros);
+
+	static void conversionHandler(void);
+
+private:
+	void onConversion(void);
+	void reset(void);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	static InternalADC *instance;
+
+	/* Buffer duplo: a ISR preenche uma metade enquanto o loop lê a outra */
+	int16_t blocks[2][INTERNAL_ADC_BLOCK_SIZE];
+	volatile uint8_t readyMask = 0; /* Bit n = metade n pronta para leitura */
+	uint8_t fillBlock = 0;			/* Usado apenas pela ISR */
+	uint8_t fillIndex = 0;
+	uint8_t readBlock = 0;			/* Usado apenas pelo consumidor */
+	uint8_t readIndex = 0;
+
+	volatile uint16_t overrunCount = 0;
+	volatile uint16_t conversionCount = 0; /* Conversões em metades completas */
+	volatile uint32_t conversionMicros = 0; /* Instante da última metade completa */
+};
+
+#endif /* _INTERNAL_ADC_H_ */
@@ -0,0 +1,444 @@
+/** @file JsonReader.cpp
+ *  @brief Functions related with the streaming JSON reader.
+ */
+#include "JsonReader.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+   feed
+****************************************************************************/
+/**
+ * @brief Consumes the next byte of the body.
+ * @param received Byte.
+ * @return JSON_PARTIAL while the object is open, JSON_DONE once it is closed,
+ *         or JSON_ERROR (see getErrorKey()).
+*******************************************************************************/
+JsonReader::json_result_t JsonReader::feed(char received)
+{
+    bool space = (received == ' ' || received == '\t' || received == '\r' || received == '\n');
+    bool numeric = (isdigit(received) || received == '-');
+
+    switch (this->state)
+    {
+    case STATE_START:
+        if (space)
+            break;
+        if (received != '{')
+            return this->fail();
+        this->state = STATE_KEY_OR_END;
+        break;
+
+    case STATE_KEY_OR_END:
+    case STATE_KEY_START:
+        if (space)
+            break;
+        if (received == '}' && this->state == STATE_KEY_OR_END)
+        {
+            this->state = STATE_DONE;
+            break;
+        }
+        if (received != '"')
+            return this->fail();
+
+        this->keyLength = 0;
+        this->key[0] = '\0';
+        this->keyEscape = false;
+        this->known = true;
+        this->state = STATE_KEY;
+        break;
+
+    case STATE_KEY:
+        /* Chaves com escape ou longas demais não são de nenhum campo */
+        if (this->keyEscape)
+            this->keyEscape = false;
+        else if (received == '\\')
+        {
+            this->keyEscape = true;
+            this->known = false;
+        }
+        else if (received == '"')
+        {
+            this->findField();
+            this->state = STATE_COLON;
+        }
+        else if (this->keyLength < JSON_READER_KEY_SIZE - 1)
+        {
+            this->key[this->keyLength++] = received;
+            this->key[this->keyLength] = '\0';
+        }
+        else
+            this->known = false;
+        break;
+
+    case STATE_COLON:
+        if (space)
+            break;
+        if (received != ':')
+            return this->fail();
+        this->state = STATE_VALUE;
+        break;
+
+    case STATE_VALUE:
+        if (space)
+            break;
+
+        /* Chave desconhecida: ignora o valor, de qualquer tipo */
+        if (!this->known)
+        {
+            this->skipDepth = 0;
+            this->skipString = false;
+            this->escape = 0;
+            if (received == '"')
+                this->skipString = true;
+            else if (received == '{' || received == '[')
+                this->skipDepth = 1;
+            else if (isalnum(received) || received == '-')
+            {
+                this->state = STATE_SKIP_WORD;
+                break;
+            }
+            else
+                return this->fail();
+            this->state = STATE_SKIP;
+            break;
+        }
+
+        switch (this->field.type)
+        {
+        case JSON_STRING:
+            if (received != '"')
+                return this->fail();
+            this->length = 0;
+            this->escape = 0;
+            this->state = STATE_STRING;
+            break;
+
+        case JSON_BYTE_ARRAY:
+            if (received != '[')
+                return this->fail();
+            this->length = 0;
+            this->state = STATE_ARRAY_VALUE_OR_END;
+            break;
+
+        default:
+            if (!numeric)
+                return this->fail();
+            this->tokenLength = 0;
+            this->state = STATE_NUMBER;
+            return this->feed(received);
+        }
+        break;
+
+    case STATE_STRING:
+        if (this->escape == 1)
+        {
+            this->escape = 0;
+            char decoded;
+            switch (received)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                decoded = received;
+                break;
+            case 'b':
+                decoded = '\b';
+                break;
+            case 'f':
+                decoded = '\f';
+                break;
+            case 'n':
+                decoded = '\n';
+                break;
+            case 'r':
+                decoded = '\r';
+                break;
+            case 't':
+                decoded = '\t';
+                break;
+            case 'u':
+                this->escape = 2;
+                this->unicode = 0;
+                return JSON_PARTIAL;
+            default:
+                return this->fail();
+            }
+            if (!this->appendString(decoded))
+                return this->fail();
+        }
+        else if (this->escape >= 2)
+        {
+            /* "\uXXXX": fora do ASCII vira '?' */
+            if (!isxdigit(received))
+                return this->fail();
+            this->unicode = (this->unicode << 4) | (isdigit(received) ? received - '0' : (received | 0x20) - 'a' + 10);
+            if (++this->escape == 6)
+            {
+                this->escape = 0;
+                if (!this->appendString(this->unicode < 0x80 ? (char)this->unicode : '?'))
+                    return this->fail();
+            }
+        }
+        else if (received == '\\')
+            this->escape = 1;
+        else if (received == '"')
+        {
+            this->target[this->field.offset + this->length] = '\0';
+            this->setFields |= 1 << this->fieldIndex;
+            this->state = STATE_AFTER_VALUE;
+        }
+        else if ((uint8_t)received < 0x20 || !this->appendString(received))
+            return this->fail();
+        break;
+
+    case STATE_NUMBER:
+        if (numeric || received == '.' || received == '+' || received == 'e' || received == 'E')
+        {
+            if (this->tokenLength >= JSON_READER_TOKEN_SIZE - 1)
+                return this->fail();
+            this->token[this->tokenLength++] = received;
+            break;
+        }
+
+        /* Fim do número: o caractere seguinte é processado no próximo estado */
+        this->token[this->tokenLength] = '\0';
+        if (!this->storeNumber())
+            return this->fail();
+        this->state = (this->field.type == JSON_BYTE_ARRAY) ? STATE_ARRAY_AFTER : STATE_AFTER_VALUE;
+        return this->feed(received);
+
+    case STATE_ARRAY_VALUE_OR_END:
+        if (space)
+            break;
+        if (received == ']')
+        {
+            this->target[this->field.offset] = 0;
+            this->setFields |= 1 << this->fieldIndex;
+            this->state = STATE_AFTER_VALUE;
+            break;
+        }
+        if (!numeric)
+            return this->fail();
+        this->tokenLength = 0;
+        this->state = STATE_NUMBER;
+        return this->feed(received);
+
+    case STATE_ARRAY_VALUE:
+        if (space)
+            break;
+        if (!numeric)
+            return this->fail();
+        this->tokenLength = 0;
+        this->state = STATE_NUMBER;
+        return this->feed(received);
+
+    case STATE_ARRAY_AFTER:
+        if (space)
+            break;
+        if (received == ',')
+            this->state = STATE_ARRAY_VALUE;
+        else if (received == ']')
+        {
+            this->target[this->field.offset] = this->length;
+            this->setFields |= 1 << this->fieldIndex;
+            this->state = STATE_AFTER_VALUE;
+        }
+        else
+            return this->fail();
+        break;
+
+    case STATE_SKIP:
+        if (this->skipString)
+        {
+            if (this->escape)
+                this->escape = 0;
+            else if (received == '\\')
+                this->escape = 1;
+            else if (received == '"')
+            {
+                this->skipString = false;
+                if (this->skipDepth == 0)
+                    this->state = STATE_AFTER_VALUE;
+            }
+        }
+        else if (received == '"')
+            this->skipString = true;
+        else if (received == '{' || received == '[')
+            this->skipDepth++;
+        else if (received == '}' || received == ']')
+        {
+            if (--this->skipDepth == 0)
+                this->state = STATE_AFTER_VALUE;
+        }
+        break;
+
+    case STATE_SKIP_WORD:
+        /* true, false, null ou número */
+        if (isalnum(received) || received == '.' || received == '-' || received == '+')
+            break;
+        this->state = STATE_AFTER_VALUE;
+        return this->feed(received);
+
+    case STATE_AFTER_VALUE:
+        if (space)
+            break;
+        if (received == ',')
+            this->state = STATE_KEY_START;
+        else if (received == '}')
+            this->state = STATE_DONE;
+        else
+            return this->fail();
+        break;
+
+    case STATE_DONE:
+        /* Conteúdo após o objeto é ignorado */
+        break;
+
+    case STATE_ERROR:
+    default:
+        return JSON_ERROR;
+    }
+
+    return this->getResult();
+}
+
+/*******************************************************************************
+   getResult
+****************************************************************************/
+/**
+ * @brief Gets the state of the reading.
+ * @param void
+ * @return JSON_PARTIAL, JSON_DONE or JSON_ERROR.
+*******************************************************************************/
+JsonReader::json_result_t JsonReader::getResult(void)
+{
+    if (this->state == STATE_DONE)
+        return JSON_DONE;
+    if (this->state == STATE_ERROR)
+        return JSON_ERROR;
+    return JSON_PARTIAL;
+}
+
+/*******************************************************************************
+   fail
+****************************************************************************/
+/**
+ * @brief Stops the reading; the current key is kept as the failing one.
+ * @param void
+ * @return JSON_ERROR.
+*******************************************************************************/
+JsonReader::json_result_t JsonReader::fail(void)
+{
+    this->state = STATE_ERROR;
+    return JSON_ERROR;
+}
+
+/*******************************************************************************
+   findField
+****************************************************************************/
+/**
+ * @brief Looks for the field of the key just read.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonReader::findField(void)
+{
+    if (!this->known)
+        return;
+
+    this->known = false;
+    for (uint8_t i = 0; i < this->fieldCount && i < JSON_READER_MAX_FIELDS; i++)
+    {
+        /* Apenas o campo encontrado é copiado da flash */
+        if (!strcmp_P(this->key, this->fields[i].key))
+        {
+            memcpy_P(&this->field, &this->fields[i], sizeof(this->field));
+            this->fieldIndex = i;
+            this->known = true;
+            return;
+        }
+    }
+}
+
+/*******************************************************************************
+   appendString
+****************************************************************************/
+/**
+ * @brief Writes a character of a string value in its field.
+ * @param character Character.
+ * @return False if the field is full.
+*******************************************************************************/
+bool JsonReader::appendString(char character)
+{
+    if (this->length >= this->field.size - 1)
+        return false;
+
+    this->target[this->field.offset + this->length++] = character;
+    return true;
+}
+
+/*******************************************************************************
+   storeNumber
+****************************************************************************/
+/**
+ * @brief Validates the number just read and writes it in its field, or as the
+ *        next element of the array.
+ * @param void
+ * @return False if it is not a number, out of range or not an integer.
+*******************************************************************************/
+bool JsonReader::storeNumber(void)
+{
+    float number;
+    if (!this->parseNumber(&number))
+        return false;
+
+    if (number < this->field.min || number > this->field.max)
+        return false;
+    if (this->field.valid != NULL && !this->field.valid(number))
+        return false;
+
+    uint8_t *destination = this->target + this->field.offset;
+    if (this->field.type == JSON_FLOAT)
+    {
+        memcpy(destination, &number, sizeof(number));
+        this->setFields |= 1 << this->fieldIndex;
+        return true;
+    }
+
+    /* Inteiros: sem parte fracionária */
+    uint32_t integer = (uint32_t)number;
+    if ((float)integer != number)
+        return false;
+
+    if (this->field.type == JSON_BYTE_ARRAY)
+    {
+        if (this->length >= this->field.size)
+            return false;
+        destination[1 + this->length++] = (uint8_t)integer;
+        return true;
+    }
+
+    /* Little-endian: os bytes baixos primeiro */
+    memcpy(destination, &integer, this->field.size);
+    this->setFields |= 1 << this->fieldIndex;
+    return true;
+}
+
+/*******************************************************************************
+   parseNumber
+****************************************************************************/
+/**
+ * @brief Converts the token read.
+ * @param number Result.
+ * @return False if the whole token is not a number.
+*******************************************************************************/
+bool JsonReader::parseNumber(float *number)
+{
+    if (this->tokenLength == 0)
+        return false;
+
+    char *end;
+    *number = (float)strtod(this->token, &end);
+    return end == this->token + this->tokenLength;
+}
@@ -0,0 +1,127 @@
+/** @file JsonReader.h
+ *  @brief Header to the streaming JSON reader: a flat object into typed fields.
+ */
+
+#ifndef _JSON_READER_H_
+#define _JSON_READER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define JSON_READER_KEY_SIZE (13u)   /* Maior chave conhecida, com o '\0' */
+#define JSON_READER_TOKEN_SIZE (16u) /* Maior número aceito, com o '\0' */
+#define JSON_READER_MAX_FIELDS (16u) /* Bits de isSet() */
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Lê um objeto JSON byte a byte, em memória constante: sem buffer do corpo inteiro */
+/* Cada chave conhecida é gravada direto no seu campo do destino, com validação; */
+/* chaves ausentes mantêm o valor atual e as desconhecidas são ignoradas */
+class JsonReader
+{
+public:
+	/*************************************************************************************
+	* Public enumeration
+	*************************************************************************************/
+	enum json_type_t
+	{
+		JSON_STRING = 0, /* char[size], com o '\0' */
+		JSON_UINT,		 /* Inteiro sem sinal de 'size' bytes (1, 2 ou 4) */
+		JSON_FLOAT,		 /* float */
+		JSON_BYTE_ARRAY	 /* uint8_t count + uint8_t[size] */
+	};
+
+	enum json_result_t
+	{
+		JSON_PARTIAL = 0,
+		JSON_DONE,
+		JSON_ERROR
+	};
+
+	/*************************************************************************************
+	* Public struct
+	*************************************************************************************/
+	/* Descrição de um campo, em PROGMEM */
+	struct json_field_t
+	{
+		char key[JSON_READER_KEY_SIZE];
+		uint8_t type;		 /* json_type_t */
+		uint8_t size;		 /* Ver json_type_t */
+		uint8_t offset;		 /* No destino, ver offsetof() */
+		float min;			 /* Números e elementos de arrays */
+		float max;
+		bool (*valid)(float value); /* Validação adicional, ou NULL */
+	};
+
+	/*************************************************************************************
+	* Public prototypes
+	*************************************************************************************/
+	JsonReader(const json_field_t *fields, uint8_t fieldCount, void *target)
+		: fields(fields), fieldCount(fieldCount), target((uint8_t *)target) {}
+
+	json_result_t feed(char received);
+	json_result_t getResult(void);
+	const char *getErrorKey(void) { return this->key; }
+	bool isSet(uint8_t field) { return (this->setFields >> field) & 1; }
+
+private:
+	enum json_state_t
+	{
+		STATE_START = 0,
+		STATE_KEY_OR_END,
+		STATE_KEY_START,
+		STATE_KEY,
+		STATE_COLON,
+		STATE_VALUE,
+		STATE_STRING,
+		STATE_NUMBER,
+		STATE_ARRAY_VALUE_OR_END,
+		STATE_ARRAY_VALUE,
+		STATE_ARRAY_AFTER,
+		STATE_SKIP,
+		STATE_SKIP_WORD,
+		STATE_AFTER_VALUE,
+		STATE_DONE,
+		STATE_ERROR
+	};
+
+	json_result_t fail(void);
+	void findField(void);
+	bool appendString(char character);
+	bool storeNumber(void);
+	bool parseNumber(float *number);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	const json_field_t *fields;
+	uint8_t fieldCount;
+	uint8_t *target;
+
+	uint8_t state = STATE_START;
+	json_field_t field; /* Campo da chave atual (cópia da flash) */
+	uint8_t fieldIndex = 0;
+	bool known = false; /* A chave atual é um dos campos */
+	uint16_t setFields = 0;
+
+	char key[JSON_READER_KEY_SIZE] = ""; /* Chave atual; após erro, a que falhou */
+	uint8_t keyLength = 0;
+	bool keyEscape = false;
+
+	char token[JSON_READER_TOKEN_SIZE]; /* Número em andamento */
+	uint8_t tokenLength = 0;
+	uint8_t length = 0;					/* String: caracteres gravados; array: elementos */
+
+	uint8_t escape = 0;		  /* String: 1 após '\', 2-5 nos dígitos de "\uXXXX" */
+	uint16_t unicode = 0;
+	uint8_t skipDepth = 0;	  /* Valor ignorado: objetos e arrays abertos */
+	bool skipString = false;
+};
+
+#endif /* _JSON_READER_H_ */
@@ -0,0 +1,383 @@
+/** @file JsonWriter.cpp
+ *  @brief Functions related with the streaming JSON writer.
+ */
+#include "JsonWriter.h"
+#include <math.h>
+
+/*******************************************************************************
+   Private variables
+****************************************************************************/
+static const char hexDigits[] PROGMEM = "0123456789abcdef";
+
+/*******************************************************************************
+   writeChunk
+****************************************************************************/
+/**
+ * @brief Writes a body as a single HTTP chunk. The body is generated twice:
+ *        first only counted, for the size, then written.
+ * @param out Destination.
+ * @param body Generates the body.
+ * @param context Passed to 'body'.
+ * @return void
+*******************************************************************************/
+void JsonWriter::writeChunk(Print &out, json_body_t body, const void *context)
+{
+    uint16_t unit = 0;
+    writeChunk(out, body, context, &unit, (size_t)-1);
+}
+
+/**
+ * @brief Writes one part of a body as an HTTP chunk, for a body sent in
+ *        several writes: the units from '*unit' on, while they fit in 'limit'
+ *        bytes (at least one).
+ *
+ * A unit starts at each member or element, so the parts concatenate into
+ * the whole body even when its values change between them; 'body' must
+ * only keep the same structure.
+ * @param out Destination.
+ * @param body Generates the body.
+ * @param context Passed to 'body'.
+ * @param[in,out] unit First unit of the part; on return, of the next part,
+ *        or JSON_WRITER_END.
+ * @param limit Bytes of the part, without the chunk framing.
+ * @return true if the body is complete.
+*******************************************************************************/
+bool JsonWriter::writeChunk(Print &out, json_body_t body, const void *context, uint16_t *unit, size_t limit)
+{
+    PrintCounter counter;
+    JsonWriter dryRun(counter);
+    dryRun.first = *unit;
+    dryRun.counter = &counter;
+    dryRun.limit = limit;
+    body(dryRun, context);
+    dryRun.boundary();
+
+    /* Um chunk vazio encerraria o corpo */
+    if (counter.count)
+    {
+        out.println(counter.count, HEX);
+        JsonWriter json(out);
+        json.first = *unit;
+        json.next = dryRun.next;
+        body(json, context);
+        out.print(F("\r\n"));
+    }
+
+    *unit = dryRun.next;
+    return *unit == JSON_WRITER_END;
+}
+
+/*******************************************************************************
+   beginObject
+****************************************************************************/
+/**
+ * @brief Opens an object, as a value or as an element.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::beginObject(void)
+{
+    this->open('{');
+}
+
+/*******************************************************************************
+   endObject
+****************************************************************************/
+/**
+ * @brief Closes the current object.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::endObject(void)
+{
+    if (this->depth)
+        this->depth--;
+    this->raw().write('}');
+}
+
+/*******************************************************************************
+   beginArray
+****************************************************************************/
+/**
+ * @brief Opens an array, as a value or as an element.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::beginArray(void)
+{
+    this->open('[');
+}
+
+/*******************************************************************************
+   endArray
+****************************************************************************/
+/**
+ * @brief Closes the current array.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::endArray(void)
+{
+    if (this->depth)
+        this->depth--;
+    this->raw().write(']');
+}
+
+/*******************************************************************************
+   resumeObject
+****************************************************************************/
+/**
+ * @brief Continues an object opened by another writer, when a body is split
+ *        across parts: the next member is preceded by a comma.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::resumeObject(void)
+{
+    this->depth = 1;
+    this->hasItems = 0x02;
+    this->afterKey = false;
+}
+
+/*******************************************************************************
+   key
+****************************************************************************/
+/**
+ * @brief Writes the key of the next member.
+ * @param name Key, in flash.
+ * @return void
+*******************************************************************************/
+void JsonWriter::key(const __FlashStringHelper *name)
+{
+    this->beginKey();
+    this->raw().print(name);
+    this->endKey();
+}
+
+/*******************************************************************************
+   beginKey
+****************************************************************************/
+/**
+ * @brief Starts a key written in parts through raw(), closed by endKey().
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::beginKey(void)
+{
+    this->separator();
+    this->raw().write('"');
+}
+
+/*******************************************************************************
+   endKey
+****************************************************************************/
+/**
+ * @brief Ends the key; the next value belongs to it.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::endKey(void)
+{
+    this->raw().print(F("\":"));
+    this->afterKey = true;
+}
+
+/*******************************************************************************
+   value
+****************************************************************************/
+/**
+ * @brief Writes a string value, escaped.
+ * @param text String; NULL is written as null.
+ * @return void
+*******************************************************************************/
+void JsonWriter::value(const char *text)
+{
+    if (text == NULL)
+    {
+        this->separator();
+        this->raw().print(F("null"));
+        return;
+    }
+
+    this->beginString();
+    while (*text)
+        this->escape(*text++);
+    this->endString();
+}
+
+/**
+ * @brief Writes a constant string value, escaped.
+ * @param text String in flash (F()).
+ * @return void
+*******************************************************************************/
+void JsonWriter::value(const __FlashStringHelper *text)
+{
+    const char *character = (const char *)text;
+
+    this->beginString();
+    for (char c; (c = pgm_read_byte(character)) != '\0'; character++)
+        this->escape(c);
+    this->endString();
+}
+
+/**
+ * @brief Writes an integer value.
+ * @param number Value.
+ * @return void
+*******************************************************************************/
+void JsonWriter::value(long number)
+{
+    this->separator();
+    this->raw().print(number);
+}
+
+/**
+ * @brief Writes an unsigned integer value.
+ * @param number Value.
+ * @return void
+*******************************************************************************/
+void JsonWriter::value(unsigned long number)
+{
+    this->separator();
+    this->raw().print(number);
+}
+
+/**
+ * @brief Writes a float value with fixed decimals. NaN, infinite and values
+ *        the Print cannot format are written as null.
+ * @param number Value.
+ * @param digits Decimals.
+ * @return void
+*******************************************************************************/
+void JsonWriter::value(float number, uint8_t digits)
+{
+    this->separator();
+    if (this->muted())
+        return;
+    if (isnan(number) || isinf(number) || fabs(number) > JSON_WRITER_MAX_FLOAT)
+        this->raw().print(F("null"));
+    else
+        this->raw().print(number, digits);
+}
+
+/*******************************************************************************
+   beginString
+****************************************************************************/
+/**
+ * @brief Starts a string value written through raw(), closed by endString().
+ *        The content is not escaped.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::beginString(void)
+{
+    this->separator();
+    this->raw().write('"');
+}
+
+/*******************************************************************************
+   endString
+****************************************************************************/
+/**
+ * @brief Ends the string value.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::endString(void)
+{
+    this->raw().write('"');
+}
+
+/*******************************************************************************
+   separator
+****************************************************************************/
+/**
+ * @brief Writes the comma before a member or element, except the first of
+ *        its level and the value of a key.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::separator(void)
+{
+    if (this->afterKey)
+    {
+        this->afterKey = false;
+        return;
+    }
+
+    this->boundary();
+    uint8_t mask = 1 << this->depth;
+    if (this->hasItems & mask)
+        this->raw().write(',');
+    this->hasItems |= mask;
+}
+
+/*******************************************************************************
+   boundary
+****************************************************************************/
+/**
+ * @brief Starts the next unit. While a part is counted, the unit just ended
+ *        that goes over the limit is left to the next part, unless nothing
+ *        was written before it.
+ * @param void
+ * @return void
+*******************************************************************************/
+void JsonWriter::boundary(void)
+{
+    if (this->unit < JSON_WRITER_END - 1)
+        this->unit++;
+    if (this->counter == NULL || this->unit <= this->first || this->next != JSON_WRITER_END)
+        return;
+
+    if (this->counter->count > this->limit && this->unitStart)
+    {
+        this->counter->count = this->unitStart;
+        this->next = this->unit - 1;
+    }
+    else
+        this->unitStart = this->counter->count;
+}
+
+/*******************************************************************************
+   open
+****************************************************************************/
+/**
+ * @brief Opens an object or array, one level deeper.
+ * @param bracket '{' or '['.
+ * @return void
+*******************************************************************************/
+void JsonWriter::open(char bracket)
+{
+    this->separator();
+    this->raw().write(bracket);
+
+    if (this->depth < JSON_WRITER_MAX_DEPTH - 1)
+        this->depth++;
+    this->hasItems &= ~(1 << this->depth);
+}
+
+/*******************************************************************************
+   escape
+****************************************************************************/
+/**
+ * @brief Writes a character of a string, escaped when needed.
+ * @param character Character.
+ * @return void
+*******************************************************************************/
+void JsonWriter::escape(char character)
+{
+    if (character == '"' || character == '\\')
+    {
+        this->raw().write('\\');
+        this->raw().write(character);
+    }
+    else if ((uint8_t)character < 0x20)
+    {
+        /* Controle: \u00XX */
+        this->raw().print(F("\\u00"));
+        this->raw().write(pgm_read_byte(&hexDigits[(character >> 4) & 0x0F]));
+        this->raw().write(pgm_read_byte(&hexDigits[character & 0x0F]));
+    }
+    else
+        this->raw().write(character);
+}
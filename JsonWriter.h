@@ -0,0 +1,112 @@
+/** @file JsonWriter.h
+ *  @brief Header to the streaming JSON writer, without buffers or heap.
+ */
+
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define JSON_WRITER_MAX_DEPTH (8u) /* Objetos e arrays aninhados */
+#define JSON_WRITER_MAX_FLOAT (4294967040.0f) /* Acima disso o Print escreve "ovf" */
+#define JSON_WRITER_END (0xFFFFu) /* writeChunk() em partes: corpo concluído */
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Apenas conta os bytes: permite escrever o tamanho de um chunk antes do seu conteúdo */
+class PrintCounter : public Print
+{
+public:
+	size_t write(uint8_t data)
+	{
+		(void)data;
+		this->count++;
+		return 1;
+	}
+	using Print::write;
+
+	size_t count = 0;
+};
+
+/* Escreve o JSON direto no 'out': chaves da flash, números pelo Print (sem String) */
+/* As vírgulas entre membros e elementos são inseridas pelo próprio escritor */
+class JsonWriter
+{
+public:
+	/* Gera um conteúdo no 'json' recebido; chamado duas vezes por writeChunk() */
+	typedef void (*json_body_t)(JsonWriter &json, const void *context);
+
+	JsonWriter(Print &out) : out(out) {}
+
+	static void writeChunk(Print &out, json_body_t body, const void *context);
+	static bool writeChunk(Print &out, json_body_t body, const void *context, uint16_t *unit, size_t limit);
+
+	void beginObject(void);
+	void endObject(void);
+	void beginArray(void);
+	void endArray(void);
+	void resumeObject(void);
+
+	void key(const __FlashStringHelper *name);
+	void beginKey(void);
+	void endKey(void);
+
+	void value(const char *text);
+	void value(const __FlashStringHelper *text);
+	void value(int number) { this->value((long)number); }
+	void value(unsigned int number) { this->value((unsigned long)number); }
+	void value(long number);
+	void value(unsigned long number);
+	void value(float number, uint8_t digits);
+	void beginString(void);
+	void endString(void);
+
+	/* Membro completo de um objeto: chave e valor */
+	template <typename T>
+	void member(const __FlashStringHelper *name, T data)
+	{
+		this->key(name);
+		this->value(data);
+	}
+	void member(const __FlashStringHelper *name, float number, uint8_t digits)
+	{
+		this->key(name);
+		this->value(number, digits);
+	}
+
+	/* Conteúdo livre: partes de uma chave ou string entre begin/end */
+	Print &raw(void) { return this->muted() ? this->skipped : this->out; }
+
+private:
+	void separator(void);
+	void boundary(void);
+	void open(char bracket);
+	void escape(char character);
+	bool muted(void) { return this->unit < this->first || this->unit >= this->next; }
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	Print &out;
+	uint8_t depth = 0;
+	uint8_t hasItems = 0;  /* Bit n = nível n já tem um membro/elemento */
+	bool afterKey = false; /* O próximo valor pertence à chave escrita */
+
+	/* Corpo em partes: cada membro/elemento começa uma unidade; só [first, next) é escrito */
+	uint16_t unit = 0;
+	uint16_t first = 0;
+	uint16_t next = JSON_WRITER_END;
+	PrintCounter *counter = NULL; /* Contagem de uma parte: fecha a parte em 'limit' bytes */
+	size_t limit = 0;
+	size_t unitStart = 0; /* Bytes da parte antes da unidade atual */
+	PrintCounter skipped; /* Destino das unidades fora da parte */
+};
+
+#endif /* _JSON_WRITER_H_ */
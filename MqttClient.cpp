@@ -0,0 +1,212 @@
+/** @file MqttClient.cpp
+ *  @brief Functions related with the minimal MQTT 3.1.1 client.
+ */
+#include "MqttClient.h"
+#include "JsonWriter.h"
+
+/*******************************************************************************
+   writeConnect
+****************************************************************************/
+/**
+ * @brief Writes a CONNECT packet, with a clean session.
+ * @param out Output.
+ * @param clientId Client identifier.
+ * @param username User name, or NULL / empty for none.
+ * @param password Password, or NULL / empty for none; only sent with a user name.
+ * @param keepAlive Seconds without packets before the broker closes the session.
+ * @return void
+*******************************************************************************/
+void MqttClient::writeConnect(Print &out, const char *clientId, const char *username, const char *password,
+                              uint16_t keepAlive)
+{
+    bool hasUsername = (username != NULL && username[0] != '\0');
+    bool hasPassword = hasUsername && (password != NULL && password[0] != '\0');
+
+    uint32_t length = MQTT_CONNECT_HEADER_SIZE + 2 + strlen(clientId);
+    if (hasUsername)
+        length += 2 + strlen(username);
+    if (hasPassword)
+        length += 2 + strlen(password);
+
+    out.write((uint8_t)MQTT_CONNECT);
+    writeLength(out, length);
+
+    /* Cabeçalho variável: protocolo, nível, flags (0x02 = sessão limpa) e keep alive */
+    writeString(out, "MQTT");
+    out.write((uint8_t)MQTT_PROTOCOL_LEVEL);
+    out.write((uint8_t)(0x02 | (hasUsername ? 0x80 : 0) | (hasPassword ? 0x40 : 0)));
+    write16(out, keepAlive);
+
+    writeString(out, clientId);
+    if (hasUsername)
+        writeString(out, username);
+    if (hasPassword)
+        writeString(out, password);
+}
+
+/*******************************************************************************
+   writePublish
+****************************************************************************/
+/**
+ * @brief Writes a PUBLISH packet.
+ * @param out Output.
+ * @param topic Writes the topic; must write the same bytes every call.
+ * @param payload Writes the content; must write the same bytes every call.
+ * @param context Argument of both writers.
+ * @param qos 0 (no reply) or 1 (PUBACK with the packet identifier).
+ * @param packetId Packet identifier, not 0; only written with QoS 1.
+ * @return void
+*******************************************************************************/
+void MqttClient::writePublish(Print &out, mqtt_writer_t topic, mqtt_writer_t payload, const void *context, uint8_t qos,
+                              uint16_t packetId)
+{
+    /* Passada de contagem: o tamanho vem antes do conteúdo */
+    PrintCounter topicCounter;
+    topic(topicCounter, context);
+    PrintCounter payloadCounter;
+    payload(payloadCounter, context);
+
+    uint32_t length = 2 + topicCounter.count + (qos ? 2 : 0) + payloadCounter.count;
+
+    out.write((uint8_t)(MQTT_PUBLISH | (qos ? 0x02 : 0)));
+    writeLength(out, length);
+    write16(out, (uint16_t)topicCounter.count);
+    topic(out, context);
+    if (qos)
+        write16(out, packetId);
+    payload(out, context);
+}
+
+/*******************************************************************************
+   writePingreq
+****************************************************************************/
+/**
+ * @brief Writes a PINGREQ packet: keeps the session alive while idle.
+ * @param out Output.
+ * @return void
+*******************************************************************************/
+void MqttClient::writePingreq(Print &out)
+{
+    out.write((uint8_t)MQTT_PINGREQ);
+    out.write((uint8_t)0);
+}
+
+/*******************************************************************************
+   writeDisconnect
+****************************************************************************/
+/**
+ * @brief Writes a DISCONNECT packet: ends the session cleanly.
+ * @param out Output.
+ * @return void
+*******************************************************************************/
+void MqttClient::writeDisconnect(Print &out)
+{
+    out.write((uint8_t)MQTT_DISCONNECT);
+    out.write((uint8_t)0);
+}
+
+/*******************************************************************************
+   feed
+****************************************************************************/
+/**
+ * @brief Consumes the next byte received from the broker.
+ *
+ * Only the first two bytes of each packet are kept (see getReturnCode() and
+ * getPacketId()); the rest of longer packets is skipped.
+ * @param received Byte.
+ * @return Type of the packet just completed (MQTT_CONNACK, MQTT_PUBACK,
+ *         MQTT_PINGRESP...), or 0 while incomplete.
+*******************************************************************************/
+uint8_t MqttClient::feed(uint8_t received)
+{
+    switch (this->state)
+    {
+    case STATE_HEADER:
+        this->header = received;
+        this->remaining = 0;
+        this->lengthShift = 0;
+        this->dataCount = 0;
+        this->data[0] = this->data[1] = 0;
+        this->state = STATE_LENGTH;
+        break;
+
+    case STATE_LENGTH:
+        /* Tamanho restante: 7 bits por byte, até 4 bytes */
+        this->remaining |= (uint32_t)(received & 0x7F) << this->lengthShift;
+        this->lengthShift += 7;
+        if (received & 0x80)
+        {
+            if (this->lengthShift >= 28)
+                this->state = STATE_HEADER;
+            break;
+        }
+        if (this->remaining)
+        {
+            this->state = STATE_BODY;
+            break;
+        }
+        this->state = STATE_HEADER;
+        return this->header & 0xF0;
+
+    case STATE_BODY:
+    default:
+        if (this->dataCount < sizeof(this->data))
+            this->data[this->dataCount++] = received;
+        if (--this->remaining)
+            break;
+        this->state = STATE_HEADER;
+        return this->header & 0xF0;
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+   writeLength
+****************************************************************************/
+/**
+ * @brief Writes the remaining length of a packet: 7 bits per byte, the
+ *        highest bit set while more bytes follow.
+ * @param out Output.
+ * @param length Bytes after the fixed header.
+ * @return void
+*******************************************************************************/
+void MqttClient::writeLength(Print &out, uint32_t length)
+{
+    do
+    {
+        uint8_t encoded = length & 0x7F;
+        length >>= 7;
+        out.write((uint8_t)(encoded | (length ? 0x80 : 0)));
+    } while (length);
+}
+
+/*******************************************************************************
+   writeString
+****************************************************************************/
+/**
+ * @brief Writes a string prefixed by its length.
+ * @param out Output.
+ * @param text String.
+ * @return void
+*******************************************************************************/
+void MqttClient::writeString(Print &out, const char *text)
+{
+    write16(out, (uint16_t)strlen(text));
+    out.print(text);
+}
+
+/*******************************************************************************
+   write16
+****************************************************************************/
+/**
+ * @brief Writes a 16-bit integer, big-endian.
+ * @param out Output.
+ * @param value Integer.
+ * @return void
+*******************************************************************************/
+void MqttClient::write16(Print &out, uint16_t value)
+{
+    out.write((uint8_t)(value >> 8));
+    out.write((uint8_t)value);
+}
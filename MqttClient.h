@@ -0,0 +1,76 @@
+/** @file MqttClient.h
+ *  @brief Header to the minimal MQTT 3.1.1 client: packets written to a Print, replies parsed byte by byte.
+ */
+
+#ifndef _MQTT_CLIENT_H_
+#define _MQTT_CLIENT_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define MQTT_PROTOCOL_LEVEL (4u) /* 3.1.1 */
+#define MQTT_CONNECT_HEADER_SIZE (10u) /* "MQTT", nível, flags e keep alive */
+#define MQTT_CONNACK_ACCEPTED (0u)
+
+/* Tipos de pacote: 4 bits altos do primeiro byte */
+#define MQTT_CONNECT (0x10)
+#define MQTT_CONNACK (0x20)
+#define MQTT_PUBLISH (0x30)
+#define MQTT_PUBACK (0x40)
+#define MQTT_PINGREQ (0xC0)
+#define MQTT_PINGRESP (0xD0)
+#define MQTT_DISCONNECT (0xE0)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Apenas publica: CONNECT, PUBLISH (QoS 0/1), PINGREQ e DISCONNECT, sem buffer do pacote */
+/* Os tamanhos vêm de uma passada de contagem (PrintCounter) do tópico e do conteúdo */
+class MqttClient
+{
+public:
+	/* Escreve o tópico ou o conteúdo de uma publicação; chamado duas vezes, com a mesma saída */
+	typedef void (*mqtt_writer_t)(Print &out, const void *context);
+
+	static void writeConnect(Print &out, const char *clientId, const char *username, const char *password,
+							 uint16_t keepAlive);
+	static void writePublish(Print &out, mqtt_writer_t topic, mqtt_writer_t payload, const void *context, uint8_t qos,
+							 uint16_t packetId);
+	static void writePingreq(Print &out);
+	static void writeDisconnect(Print &out);
+
+	/* Respostas do broker */
+	uint8_t feed(uint8_t received);
+	uint8_t getReturnCode(void) { return this->data[1]; }
+	uint16_t getPacketId(void) { return ((uint16_t)this->data[0] << 8) | this->data[1]; }
+	void reset(void) { this->state = STATE_HEADER; }
+
+private:
+	enum mqtt_state_t
+	{
+		STATE_HEADER = 0,
+		STATE_LENGTH,
+		STATE_BODY
+	};
+
+	static void writeLength(Print &out, uint32_t length);
+	static void writeString(Print &out, const char *text);
+	static void write16(Print &out, uint16_t value);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	uint8_t state = STATE_HEADER;
+	uint8_t header = 0;
+	uint8_t lengthShift = 0;
+	uint32_t remaining = 0;
+	uint8_t data[2] = {0}; /* Dois primeiros bytes do pacote: CONNACK e PUBACK */
+	uint8_t dataCount = 0;
+};
+
+#endif /* _MQTT_CLIENT_H_ */
@@ -0,0 +1,97 @@
+/** @file PackedRecord.cpp
+ *  @brief Functions related with the compact binary record of a publish interval.
+ */
+#include "PackedRecord.h"
+
+/*******************************************************************************
+   begin
+****************************************************************************/
+/**
+ * @brief Starts a record and writes its header.
+ * @param seqNumber Sequence number of the interval.
+ * @param timestamp Unix timestamp of the interval.
+ * @param measures Number of measures, each followed by addType().
+ * @param channels Number of channels; addValue() is called measures x channels times.
+ * @return void
+*******************************************************************************/
+void PackedRecord::begin(uint32_t seqNumber, uint32_t timestamp, uint8_t measures, uint8_t channels)
+{
+    this->encoder.begin();
+
+    this->put(PACKED_RECORD_VERSION);
+    this->put(measures);
+    this->put(channels);
+    this->put32(seqNumber);
+    this->put32(timestamp);
+}
+
+/*******************************************************************************
+   addType
+****************************************************************************/
+/**
+ * @brief Adds the type of the next measure (MEASURE_*).
+ * @param type Measure type.
+ * @return void
+*******************************************************************************/
+void PackedRecord::addType(uint8_t type)
+{
+    this->put(type);
+}
+
+/*******************************************************************************
+   addValue
+****************************************************************************/
+/**
+ * @brief Adds the value of the next channel, as a float32.
+ * @param value Value.
+ * @return void
+*******************************************************************************/
+void PackedRecord::addValue(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    this->put32(bits);
+}
+
+/*******************************************************************************
+   end
+****************************************************************************/
+/**
+ * @brief Writes the last characters, with the base64 padding.
+ * @param void
+ * @return Characters written for the record: PACKED_RECORD_BASE64_SIZE().
+*******************************************************************************/
+size_t PackedRecord::end(void)
+{
+    return this->encoder.end();
+}
+
+/*******************************************************************************
+   put
+****************************************************************************/
+/**
+ * @brief Adds one byte of the record.
+ * @param data Byte.
+ * @return void
+*******************************************************************************/
+void PackedRecord::put(uint8_t data)
+{
+    this->encoder.write(data);
+}
+
+/*******************************************************************************
+   put32
+****************************************************************************/
+/**
+ * @brief Adds a 32-bit word, little-endian.
+ * @param data Word.
+ * @return void
+*******************************************************************************/
+void PackedRecord::put32(uint32_t data)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        this->put(data & 0xFF);
+        data >>= 8;
+    }
+}
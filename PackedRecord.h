@@ -0,0 +1,55 @@
+/** @file PackedRecord.h
+ *  @brief Header to the compact binary record of a publish interval, written in base64.
+ */
+
+#ifndef _PACKED_RECORD_H_
+#define _PACKED_RECORD_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+#include "Base64Writer.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+/* Registro v1, little-endian (decodificador de referência: tools/packed_decode.py):
+ *   [0]  versão            uint8
+ *   [1]  medidas (M)       uint8
+ *   [2]  canais (C)        uint8
+ *   [3]  seqNumber         uint32
+ *   [7]  timestamp         uint32
+ *   [11] tipo de cada medida, M x uint8
+ *   [..] valores, M x C x float32 (IEEE 754), por medida e depois por canal
+ */
+#define PACKED_RECORD_VERSION (1u)
+#define PACKED_RECORD_HEADER_SIZE (11u)
+#define PACKED_RECORD_SIZE(measures, channels) (PACKED_RECORD_HEADER_SIZE + (measures) + 4u * (measures) * (channels))
+#define PACKED_RECORD_BASE64_SIZE(size) BASE64_SIZE(size)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Codifica em base64 enquanto escreve: nenhum buffer do registro inteiro */
+class PackedRecord
+{
+public:
+	PackedRecord(Print &out) : encoder(out) {}
+
+	void begin(uint32_t seqNumber, uint32_t timestamp, uint8_t measures, uint8_t channels);
+	void addType(uint8_t type);
+	void addValue(float value);
+	size_t end(void);
+
+private:
+	void put(uint8_t data);
+	void put32(uint32_t data);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	Base64Writer encoder;
+};
+
+#endif /* _PACKED_RECORD_H_ */
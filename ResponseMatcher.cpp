@@ -0,0 +1,112 @@
+/** @file ResponseMatcher.cpp
+ *  @brief Multi-pattern matcher of the ESP8266 responses.
+ */
+#include "ResponseMatcher.h"
+
+/*******************************************************************************
+   add
+****************************************************************************/
+/**
+ * @brief Adds a pattern to the set. The string must outlive the matcher use.
+ * @param pattern Non-empty string in flash, see F().
+ * @return Index of the pattern, returned by feed() when it matches, or
+ *         RESPONSE_MATCHER_NONE if the set is full.
+*******************************************************************************/
+uint8_t ResponseMatcher::add(const __FlashStringHelper *pattern)
+{
+    const char *text = (const char *)pattern;
+    if (this->count >= RESPONSE_MATCHER_MAX_PATTERNS || text == NULL || pgm_read_byte(text) == '\0')
+        return RESPONSE_MATCHER_NONE;
+
+    this->patterns[this->count] = text;
+    this->positions[this->count] = 0;
+    return this->count++;
+}
+
+/*******************************************************************************
+   reset
+****************************************************************************/
+/**
+ * @brief Restarts the search of every pattern.
+ * @param void
+ * @return void
+*******************************************************************************/
+void ResponseMatcher::reset(void)
+{
+    for (uint8_t i = 0; i < this->count; i++)
+        this->positions[i] = 0;
+}
+
+/*******************************************************************************
+   feed
+****************************************************************************/
+/**
+ * @brief Advances every pattern with a received character.
+ * @param received New character.
+ * @return Index of the pattern completed by this character (the lowest one if
+ *         several end here), or RESPONSE_MATCHER_NONE.
+*******************************************************************************/
+uint8_t ResponseMatcher::feed(char received)
+{
+    uint8_t matched = RESPONSE_MATCHER_NONE;
+
+    for (uint8_t i = 0; i < this->count; i++)
+    {
+        this->positions[i] = next(this->patterns[i], this->positions[i], received);
+        if (pgm_read_byte(&this->patterns[i][this->positions[i]]) == '\0')
+        {
+            this->positions[i] = 0;
+            if (matched == RESPONSE_MATCHER_NONE)
+                matched = i;
+        }
+    }
+
+    return matched;
+}
+
+/*******************************************************************************
+   next
+****************************************************************************/
+/**
+ * @brief Transition of the automaton of a pattern.
+ * @param pattern String searched, in flash.
+ * @param position Characters of the pattern matched so far.
+ * @param received New character.
+ * @return Length of the longest prefix of the pattern that ends at 'received'.
+*******************************************************************************/
+uint8_t ResponseMatcher::next(const char *pattern, uint8_t position, char received)
+{
+    while (true)
+    {
+        if ((char)pgm_read_byte(&pattern[position]) == received)
+            return position + 1;
+        if (position == 0)
+            return 0;
+
+        /* Divergência: recua para a maior borda do trecho já reconhecido */
+        position = border(pattern, position);
+    }
+}
+
+/*******************************************************************************
+   border
+****************************************************************************/
+/**
+ * @brief Longest proper prefix of pattern[0, length) that is also its suffix.
+ * @param pattern String searched, in flash.
+ * @param length Length of the matched prefix.
+ * @return Length of the border.
+*******************************************************************************/
+uint8_t ResponseMatcher::border(const char *pattern, uint8_t length)
+{
+    for (uint8_t k = length - 1; k > 0; k--)
+    {
+        uint8_t i = 0;
+        while (i < k && pgm_read_byte(&pattern[i]) == pgm_read_byte(&pattern[length - k + i]))
+            i++;
+        if (i == k)
+            return k;
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+/** @file ResponseMatcher.h
+ *  @brief Header to the multi-pattern matcher of the ESP8266 responses.
+ */
+
+#ifndef _RESPONSE_MATCHER_H_
+#define _RESPONSE_MATCHER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define RESPONSE_MATCHER_MAX_PATTERNS (5u) /* Resposta esperada + respostas de falha */
+#define RESPONSE_MATCHER_NONE (0xFF)
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/**
+ * @brief Espera por vários padrões ao mesmo tempo, um caractere por vez.
+ *
+ * Cada padrão é um autômato KMP: em uma divergência o estado recua para a maior
+ * borda já lida, em vez de voltar ao início, então prefixos sobrepostos
+ * ("OOK", "SEND SEND OK") não perdem a ocorrência. As bordas são calculadas
+ * sob demanda, sem tabela em RAM; os padrões são curtos e ficam na flash (F()).
+ */
+class ResponseMatcher
+{
+public:
+	void clear(void) { this->count = 0; }
+	uint8_t add(const __FlashStringHelper *pattern);
+	void reset(void);
+	uint8_t feed(char received);
+
+private:
+	static uint8_t next(const char *pattern, uint8_t position, char received);
+	static uint8_t border(const char *pattern, uint8_t length);
+
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	const char *patterns[RESPONSE_MATCHER_MAX_PATTERNS]; /* Na flash: lidos com pgm_read_byte() */
+	uint8_t positions[RESPONSE_MATCHER_MAX_PATTERNS];
+	uint8_t count = 0;
+};
+
+#endif /* _RESPONSE_MATCHER_H_ */
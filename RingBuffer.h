@@ -0,0 +1,80 @@
+/** @file RingBuffer.h
+ *  @brief Lock-free single-producer/single-consumer ring buffer.
+ */
+
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+/* Impede o compilador de reordenar acessos à memória em torno dos índices */
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/**
+ * @brief Fila circular sem travas, para um produtor (ex.: ISR) e um consumidor (loop).
+ *
+ * Os índices são de 8 bits e incrementam livremente, portanto a leitura e a escrita
+ * de cada um são atômicas no AVR. O produtor só escreve 'head' e o consumidor só
+ * escreve 'tail'. SIZE deve ser potência de 2 e no máximo 128.
+ */
+template <typename T, uint8_t SIZE>
+class RingBuffer
+{
+	static_assert(SIZE != 0 && (SIZE & (SIZE - 1)) == 0 && SIZE <= 128, "RingBuffer: SIZE must be a power of 2 up to 128");
+
+public:
+	/* Lado do produtor */
+	bool push(const T &item)
+	{
+		uint8_t head = this->head;
+		if ((uint8_t)(head - this->tail) == SIZE)
+			return false;
+
+		this->buffer[head & (SIZE - 1)] = item;
+		RING_BUFFER_BARRIER();
+		this->head = head + 1;
+		return true;
+	}
+
+	/* Lado do consumidor */
+	bool pop(T *item)
+	{
+		uint8_t tail = this->tail;
+		if (tail == this->head)
+			return false;
+
+		*item = this->buffer[tail & (SIZE - 1)];
+		RING_BUFFER_BARRIER();
+		this->tail = tail + 1;
+		return true;
+	}
+
+	T *peek(void)
+	{
+		if (this->tail == this->head)
+			return NULL;
+
+		return &this->buffer[this->tail & (SIZE - 1)];
+	}
+
+	void clear(void) { this->tail = this->head; }
+	uint8_t count(void) { return (uint8_t)(this->head - this->tail); }
+	bool isEmpty(void) { return this->head == this->tail; }
+	bool isFull(void) { return this->count() == SIZE; }
+
+private:
+	T buffer[SIZE];
+	volatile uint8_t head = 0;
+	volatile uint8_t tail = 0;
+};
+
+#endif /* _RING_BUFFER_H_ */
@@ -0,0 +1,142 @@
+/** @file TwiMaster.cpp
+ *  @brief Functions related with the TWI (I2C) master, polled.
+ */
+#include "TwiMaster.h"
+#include <util/twi.h>
+
+/*******************************************************************************
+   begin
+****************************************************************************/
+/**
+ * @brief Starts the TWI with the internal pull-ups on SDA and SCL.
+ * @param clock SCL frequency, in Hz.
+ * @return void
+*******************************************************************************/
+void TwiMaster::begin(uint32_t clock)
+{
+    /* Mesmo cálculo da Wire: prescaler 1 */
+    TWSR = 0;
+    TWBR = ((F_CPU / clock) - 16) / 2;
+    TWCR = _BV(TWEN);
+
+    digitalWrite(SDA, HIGH);
+    digitalWrite(SCL, HIGH);
+}
+
+/*******************************************************************************
+   write
+****************************************************************************/
+/**
+ * @brief Writes bytes to a device, in a single transfer.
+ * @param address 7-bit address.
+ * @param data Bytes to write (register pointer first).
+ * @param length Number of bytes.
+ * @return true if the device acknowledged every byte.\n
+           false if opposite.
+*******************************************************************************/
+bool TwiMaster::write(uint8_t address, const uint8_t *data, uint8_t length)
+{
+    bool acked = start(address, TW_WRITE);
+    for (uint8_t i = 0; acked && i < length; i++)
+    {
+        TWDR = data[i];
+        acked = transfer(0) == TW_MT_DATA_ACK;
+    }
+    stop();
+    return acked;
+}
+
+/*******************************************************************************
+   read
+****************************************************************************/
+/**
+ * @brief Reads bytes from a device, from its current register pointer.
+ * @param address 7-bit address.
+ * @param data Output buffer.
+ * @param length Number of bytes.
+ * @return Bytes received: less than length on a NACK or timeout.
+*******************************************************************************/
+uint8_t TwiMaster::read(uint8_t address, uint8_t *data, uint8_t length)
+{
+    uint8_t received = 0;
+    if (start(address, TW_READ))
+    {
+        while (received < length)
+        {
+            /* ACK em todos menos no último: o dispositivo libera o barramento */
+            bool last = received + 1 == length;
+            if (transfer(last ? 0 : _BV(TWEA)) != (last ? TW_MR_DATA_NACK : TW_MR_DATA_ACK))
+                break;
+            data[received++] = TWDR;
+        }
+    }
+    stop();
+    return received;
+}
+
+/*******************************************************************************
+   start
+****************************************************************************/
+/**
+ * @brief Sends START and the address.
+ * @param address 7-bit address.
+ * @param direction TW_WRITE or TW_READ.
+ * @return true if the device acknowledged its address.\n
+           false if opposite.
+*******************************************************************************/
+bool TwiMaster::start(uint8_t address, uint8_t direction)
+{
+    uint8_t status = transfer(_BV(TWSTA));
+    if (status != TW_START && status != TW_REP_START)
+        return false;
+
+    TWDR = (address << 1) | direction;
+    status = transfer(0);
+    return status == (direction == TW_READ ? TW_MR_SLA_ACK : TW_MT_SLA_ACK);
+}
+
+/*******************************************************************************
+   transfer
+****************************************************************************/
+/**
+ * @brief Runs one step of the bus and waits for it.
+ * @param control TWSTA or TWEA, added to TWINT and TWEN.
+ * @return TWI status, or TW_BUS_ERROR on timeout.
+*******************************************************************************/
+uint8_t TwiMaster::transfer(uint8_t control)
+{
+    TWCR = _BV(TWINT) | _BV(TWEN) | control;
+    for (uint16_t counter = TWI_MASTER_TIMEOUT; !(TWCR & _BV(TWINT)); counter--)
+    {
+        /* Barramento preso (ex.: SDA em nível baixo): reinicia o módulo */
+        if (counter == 0)
+        {
+            TWCR = 0;
+            TWCR = _BV(TWEN);
+            return TW_BUS_ERROR;
+        }
+    }
+    return TW_STATUS;
+}
+
+/*******************************************************************************
+   stop
+****************************************************************************/
+/**
+ * @brief Sends STOP and waits for it to leave the bus.
+ * @param void
+ * @return void
+*******************************************************************************/
+void TwiMaster::stop(void)
+{
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+    for (uint16_t counter = TWI_MASTER_TIMEOUT; TWCR & _BV(TWSTO); counter--)
+    {
+        if (counter == 0)
+        {
+            TWCR = 0;
+            TWCR = _BV(TWEN);
+            return;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+/** @file TwiMaster.h
+ *  @brief Header to the polled TWI (I2C) master driver.
+ */
+
+#ifndef _TWI_MASTER_H_
+#define _TWI_MASTER_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+#define TWI_MASTER_TIMEOUT (2000u) /* Voltas de espera por TWINT: ~1ms, bem acima de um byte a 100 kHz */
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Substitui a Wire do core: sem buffers nem interrupção, cabe numa ISR; sem referências a ela, twi.c não é ligado */
+class TwiMaster
+{
+public:
+	static void begin(uint32_t clock);
+	static bool write(uint8_t address, const uint8_t *data, uint8_t length);
+	static uint8_t read(uint8_t address, uint8_t *data, uint8_t length);
+
+private:
+	static bool start(uint8_t address, uint8_t direction);
+	static uint8_t transfer(uint8_t control);
+	static void stop(void);
+};
+
+#endif /* _TWI_MASTER_H_ */
@@ -0,0 +1,112 @@
+/** @file WaveformCapture.cpp
+ *  @brief Functions related with the capture of raw sample windows.
+ */
+#include "WaveformCapture.h"
+
+/*******************************************************************************
+   arm
+****************************************************************************/
+/**
+ * @brief Starts a new capture; the previous one is dropped.
+ * @param channelCount Channels to capture, from 0.
+ * @return void
+*******************************************************************************/
+void WaveformCapture::arm(uint8_t channelCount)
+{
+    this->buffer[0] = WAVEFORM_VERSION;
+    this->size = 1;
+    this->channelCount = channelCount;
+    this->channel = 0;
+    this->started = false;
+
+    /* Mesma parte do buffer para cada canal */
+    uint16_t segmentSize = channelCount ? (WAVEFORM_BUFFER_SIZE - 1) / channelCount : 0;
+    this->capacity = (segmentSize > WAVEFORM_SEGMENT_HEADER_SIZE) ? segmentSize - WAVEFORM_SEGMENT_HEADER_SIZE : 0;
+    this->state = this->capacity ? WAVEFORM_CAPTURING : WAVEFORM_IDLE;
+}
+
+/*******************************************************************************
+   add
+****************************************************************************/
+/**
+ * @brief Copies a sample accumulated by a channel. Called for every sample,
+ *        so anything but the channel being captured returns at once. The
+ *        first sample that does not fit closes the segment: the copy is
+ *        always the beginning of the window, with no gaps.
+ * @param channel Channel of the sample.
+ * @param sample Raw conversion.
+ * @param windowStart The sample opens the window of the channel.
+ * @return void
+*******************************************************************************/
+void WaveformCapture::add(uint8_t channel, int16_t sample, bool windowStart)
+{
+    if (this->state != WAVEFORM_CAPTURING || channel != this->channel)
+        return;
+
+    /* A janela (re)começa: uma janela síncrona recomeça no primeiro cruzamento */
+    if (windowStart)
+    {
+        this->started = true;
+        this->full = false;
+        this->count = 0;
+        this->length = 0;
+        this->previous = 0;
+    }
+    if (!this->started || this->full)
+        return;
+
+    /* Zig-zag: diferenças pequenas, de qualquer sinal, em poucos bits */
+    int32_t delta = (int32_t)sample - this->previous;
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+    uint8_t encoded[WAVEFORM_VARINT_MAX_SIZE];
+    uint8_t encodedLength = 0;
+    do
+    {
+        encoded[encodedLength] = zigzag & 0x7F;
+        zigzag >>= 7;
+        if (zigzag)
+            encoded[encodedLength] |= 0x80;
+        encodedLength++;
+    } while (zigzag);
+
+    /* Segmento cheio: o restante da janela não é copiado, nem uma amostra */
+    /* posterior que ainda coubesse, o que deixaria um salto entre as gravadas */
+    if (this->length + encodedLength > this->capacity)
+    {
+        this->full = true;
+        return;
+    }
+
+    memcpy(this->buffer + this->size + WAVEFORM_SEGMENT_HEADER_SIZE + this->length, encoded, encodedLength);
+    this->length += encodedLength;
+    this->count++;
+    this->previous = sample;
+}
+
+/*******************************************************************************
+   windowEnd
+****************************************************************************/
+/**
+ * @brief Closes the segment of the channel being captured when its window
+ *        is complete; the capture moves to the next channel.
+ * @param channel Channel whose window is complete.
+ * @return void
+*******************************************************************************/
+void WaveformCapture::windowEnd(uint8_t channel)
+{
+    if (this->state != WAVEFORM_CAPTURING || channel != this->channel || !this->started)
+        return;
+
+    uint8_t *header = this->buffer + this->size;
+    header[0] = channel;
+    header[1] = this->count & 0xFF;
+    header[2] = this->count >> 8;
+    header[3] = this->length & 0xFF;
+    header[4] = this->length >> 8;
+    this->size += WAVEFORM_SEGMENT_HEADER_SIZE + this->length;
+
+    this->started = false;
+    if (++this->channel >= this->channelCount)
+        this->state = WAVEFORM_DONE;
+}
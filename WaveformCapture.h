@@ -0,0 +1,74 @@
+/** @file WaveformCapture.h
+ *  @brief Header to the on-demand capture of raw sample windows.
+ */
+
+#ifndef _WAVEFORM_CAPTURE_H_
+#define _WAVEFORM_CAPTURE_H_
+
+/*************************************************************************************
+* Includes
+*************************************************************************************/
+#include "Arduino.h"
+
+/*************************************************************************************
+* Public macros
+*************************************************************************************/
+/* Captura v1 (decodificador de referência: tools/waveform_decode.py):
+ *   [0]  versão                    uint8
+ *   [1]  segmentos, um por canal, na ordem dos canais:
+ *        [0] canal                 uint8
+ *        [1] amostras (N)          uint16, little-endian
+ *        [3] bytes dos dados (L)   uint16, little-endian
+ *        [5] N varints (LEB128) do zig-zag da diferença para a amostra anterior
+ *            (a primeira, para 0); L bytes
+ * Cada canal ocupa no máximo 1/canais do buffer: uma janela longa é truncada.
+ */
+#define WAVEFORM_VERSION (1u)
+#define WAVEFORM_BUFFER_SIZE (192u)
+#define WAVEFORM_SEGMENT_HEADER_SIZE (5u)
+#define WAVEFORM_VARINT_MAX_SIZE (3u) /* Zig-zag de uma diferença de 17 bits */
+
+/*************************************************************************************
+* Public prototypes
+*************************************************************************************/
+/* Copia as amostras das janelas já adquiridas, sem alterar o cálculo do RMS */
+/* Os canais são capturados um por vez, cada um na sua próxima janela completa */
+class WaveformCapture
+{
+public:
+	enum waveform_state_t
+	{
+		WAVEFORM_IDLE = 0,
+		WAVEFORM_CAPTURING,
+		WAVEFORM_DONE
+	};
+
+	void arm(uint8_t channelCount);
+	void add(uint8_t channel, int16_t sample, bool windowStart);
+	void windowEnd(uint8_t channel);
+
+	uint8_t getState(void) { return this->state; }
+	uint8_t getChannelCount(void) { return this->channelCount; }
+	const uint8_t *getData(void) { return this->buffer; }
+	uint16_t getSize(void) { return this->size; }
+
+private:
+	/*************************************************************************************
+	* Private variables
+	*************************************************************************************/
+	uint8_t buffer[WAVEFORM_BUFFER_SIZE];
+	uint16_t size = 0; /* Bytes dos segmentos concluídos */
+	uint8_t state = WAVEFORM_IDLE;
+	uint8_t channelCount = 0;
+
+	/* Segmento em andamento */
+	uint8_t channel = 0;
+	bool started = false;	  /* A janela do canal já começou */
+	bool full = false;		  /* Uma amostra não coube: as seguintes são descartadas */
+	uint16_t capacity = 0;	  /* Bytes de dados por segmento */
+	uint16_t count = 0;
+	uint16_t length = 0;
+	int16_t previous = 0;
+};
+
+#endif /* _WAVEFORM_CAPTURE_H_ */
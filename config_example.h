@@ -9,6 +9,11 @@
 #define FIREBASE_AUTH "<FIREBASE_AUTH>"
 #define FIREBASE_CLIENT "<FIREBASE_CLIENT_ID>"
 
+/* Configurações MQTT (IOT_UPLINK_MQTT): broker em FIREBASE_HOST, usuário FIREBASE_CLIENT, senha FIREBASE_AUTH */
+#define MQTT_PORT (8883)
+#define MQTT_SSL (1)
+#define MQTT_TOPIC_PREFIX "em/"
+
 /* Dados do AP */
 #define ESP_CLIENT_SSID "<WIFI_SSID>"
 #define ESP_CLIENT_PASSWORD "<WIFI_PASSWORD>"
@@ -0,0 +1,60 @@
+#!/bin/sh
+# AVR code of one function of the sketch, without avr-gcc: instructions,
+# bytes and the libgcc helpers it calls (software multiply, float).
+#
+# The source goes through the same clang AVR front end as ram_budget.sh and
+# LLVM's AVR backend (llc -O2). Its code is close to, not the same as, what
+# avr-gcc emits, and the helpers (__mulsi3, __mulsf3, __addsf3, ...) are not
+# part of the listing: their cycles come on top of the counts. Cycle counts
+# need avr-gcc and a simulator (simavr), which this script does not replace.
+#
+#   test/avr_listing.sh [-s] <source.cpp> <symbol regex> [-DMACRO ...]
+# SKETCH_DIR selects another tree (e.g. a git worktree of an older commit).
+# -s prints the assembly as well.
+
+set -e
+cd "$(dirname "$0")/.."
+tools=$(pwd)/test
+
+LLVM_DIR=${LLVM_DIR:-/usr/lib/llvm-14}
+SKETCH_DIR=${SKETCH_DIR:-.}
+
+listing=0
+if [ "$1" = "-s" ]; then
+	listing=1
+	shift
+fi
+source=$1
+symbol=$2
+shift 2
+
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+cp "$SKETCH_DIR/config_example.h" "$out/config.h"
+
+g++ -O1 "$tools/ram/avr_cc1.cpp" -o "$out/avr_cc1" "$LLVM_DIR/lib/libclang-cpp.so.14" "$LLVM_DIR/lib/libLLVM-14.so" \
+	-Wl,-rpath,"$LLVM_DIR/lib"
+"$out/avr_cc1" "$SKETCH_DIR/$source" -triple avr -target-cpu atmega328p -x c++ -std=gnu++11 -Os -fgnuc-version=4.2.1 \
+	-fno-rtti -fno-threadsafe-statics -ffreestanding -nostdsysteminc -nobuiltininc -fembed-bitcode=all -disable-llvm-verifier \
+	-D__AVR_ATmega328P__ -DF_CPU=16000000L -DARDUINO=10813 -DHOST_AVR_LAYOUT "$@" \
+	-isystem "$tools/ram" -I "$tools/host" -I "$SKETCH_DIR" -I "$out" -o "$out/unit.o"
+"$LLVM_DIR/bin/llvm-objcopy" --dump-section .llvmbc="$out/unit.bc" "$out/unit.o" "$out/unit.strip"
+"$LLVM_DIR/bin/opt" -passes='default<Os>' "$out/unit.bc" -o "$out/unit.opt.bc"
+"$LLVM_DIR/bin/llc" -O2 -mtriple=avr -mcpu=atmega328p "$out/unit.opt.bc" -o "$out/unit.s"
+
+# Corpo de cada função cujo nome casa com 'symbol': do rótulo até .Lfunc_end
+awk -v pattern="$symbol" -v listing=$listing '
+	/^[A-Za-z_][A-Za-z0-9_.]*:/ { name = substr($1, 1, length($1) - 1); inside = (name ~ pattern); count = 0; bytes = 0; calls = ""; next }
+	inside && /^\.Lfunc_end/ {
+		printf "%s: %d instructions, %d bytes%s\n", name, count, bytes, calls == "" ? "" : ", calls" calls
+		inside = 0; next
+	}
+	inside && /^\t[a-z]/ {
+		count++
+		bytes += ($1 ~ /^(call|jmp|lds|sts)$/) ? 4 : 2
+		if ($1 == "call" || $1 == "rcall")
+			calls = calls " " $2
+		if (listing)
+			print
+	}
+' "$out/unit.s"
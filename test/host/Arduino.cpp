@@ -0,0 +1,350 @@
+/** @file Arduino.cpp
+ *  @brief Host stand-in for the Arduino AVR core, for the tests in test/.
+ */
+#include "host.h"
+#include "EEPROM.h"
+#include "CRC.h"
+#include <avr/wdt.h>
+#include <util/twi.h>
+
+/*******************************************************************************
+   Registers
+*******************************************************************************/
+volatile uint8_t SREG;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t PINB, PORTB, DDRB, PINC, PORTC, DDRC, PIND, PORTD, DDRD;
+volatile uint8_t ADCSRA, ADCSRB, ADMUX, DIDR0, ADCL, ADCH;
+volatile uint16_t ADC;
+volatile uint8_t UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+volatile uint16_t UBRR0;
+HostUsartStatus UCSR0A;
+HostUsartData UDR0;
+volatile uint8_t TWBR, TWSR, TWDR;
+HostTwiControl TWCR;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+/*******************************************************************************
+   Clock
+*******************************************************************************/
+uint32_t hostMicros = 0;
+uint32_t hostWdtStepMicros = 1000;
+void (*hostYield)(void) = NULL;
+
+void hostAdvance(uint32_t micros)
+{
+    hostMicros += micros;
+}
+
+unsigned long millis(void)
+{
+    return hostMicros / 1000ul;
+}
+
+unsigned long micros(void)
+{
+    return hostMicros;
+}
+
+void delay(unsigned long ms)
+{
+    hostAdvance(ms * 1000ul);
+    if (hostYield != NULL)
+        hostYield();
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    hostAdvance(us);
+}
+
+void wdt_enable(int)
+{
+}
+
+void wdt_disable(void)
+{
+}
+
+void wdt_reset(void)
+{
+    hostAdvance(hostWdtStepMicros);
+    if (hostYield != NULL)
+        hostYield();
+}
+
+/*******************************************************************************
+   Pins
+*******************************************************************************/
+uint8_t hostPins[20];
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < sizeof(hostPins))
+        hostPins[pin] = value;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < sizeof(hostPins) ? hostPins[pin] : LOW;
+}
+
+int analogRead(uint8_t)
+{
+    return 0;
+}
+
+void attachInterrupt(uint8_t, void (*)(void), int)
+{
+}
+
+void detachInterrupt(uint8_t)
+{
+}
+
+/*******************************************************************************
+   USART0
+*******************************************************************************/
+void (*hostUartTx)(uint8_t data) = NULL;
+
+HostUsartData &HostUsartData::operator=(uint8_t data)
+{
+    if (hostUartTx != NULL)
+        hostUartTx(data);
+    return *this;
+}
+
+extern "C" void USART_RX_vect(void) __attribute__((weak));
+
+void hostUartReceive(uint8_t data, uint8_t status)
+{
+    UDR0.received = data;
+    UCSR0A.value = (UCSR0A.value & _BV(U2X0)) | status | _BV(RXC0);
+    if (USART_RX_vect)
+        USART_RX_vect();
+    UCSR0A.value &= ~(_BV(RXC0) | _BV(FE0) | _BV(DOR0));
+}
+
+/*******************************************************************************
+   Print
+*******************************************************************************/
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    while (size--)
+        written += this->write(*buffer++);
+    return written;
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base)
+{
+    char buffer[8 * sizeof(long) + 1];
+    char *str = &buffer[sizeof(buffer) - 1];
+    *str = '\0';
+    if (base < 2)
+        base = 10;
+    do
+    {
+        char digit = value % base;
+        value /= base;
+        *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+    } while (value);
+    return this->write(str);
+}
+
+size_t Print::print(const __FlashStringHelper *str) { return this->write((const char *)str); }
+size_t Print::print(const char *str) { return this->write(str); }
+size_t Print::print(char c) { return this->write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return this->print((unsigned long)value, base); }
+size_t Print::print(int value, int base) { return this->print((long)value, base); }
+size_t Print::print(unsigned int value, int base) { return this->print((unsigned long)value, base); }
+size_t Print::print(unsigned long value, int base) { return this->printNumber(value, base); }
+
+size_t Print::print(long value, int base)
+{
+    if (base == DEC && value < 0)
+        return this->print('-') + this->printNumber(-(unsigned long)value, DEC);
+    return this->printNumber(value, base);
+}
+
+/* Mesmo algoritmo do core: arredonda na última casa, no máximo 4294967040 */
+size_t Print::print(double value, int digits)
+{
+    if (isnan(value))
+        return this->print("nan");
+    if (isinf(value))
+        return this->print("inf");
+    if (value > 4294967040.0 || value < -4294967040.0)
+        return this->print("ovf");
+
+    size_t written = 0;
+    if (value < 0.0)
+    {
+        written += this->print('-');
+        value = -value;
+    }
+
+    double rounding = 0.5;
+    for (int i = 0; i < digits; i++)
+        rounding /= 10.0;
+    value += rounding;
+
+    unsigned long integer = (unsigned long)value;
+    double remainder = value - (double)integer;
+    written += this->print(integer);
+    if (digits > 0)
+        written += this->print('.');
+    while (digits-- > 0)
+    {
+        remainder *= 10.0;
+        unsigned int digit = (unsigned int)remainder;
+        written += this->print(digit);
+        remainder -= digit;
+    }
+    return written;
+}
+
+size_t Print::println(void) { return this->write("\r\n"); }
+size_t Print::println(const __FlashStringHelper *str) { return this->print(str) + this->println(); }
+size_t Print::println(const char *str) { return this->print(str) + this->println(); }
+size_t Print::println(char c) { return this->print(c) + this->println(); }
+size_t Print::println(unsigned char value, int base) { return this->print(value, base) + this->println(); }
+size_t Print::println(int value, int base) { return this->print(value, base) + this->println(); }
+size_t Print::println(unsigned int value, int base) { return this->print(value, base) + this->println(); }
+size_t Print::println(long value, int base) { return this->print(value, base) + this->println(); }
+size_t Print::println(unsigned long value, int base) { return this->print(value, base) + this->println(); }
+size_t Print::println(double value, int digits) { return this->print(value, digits) + this->println(); }
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        int c = this->read();
+        if (c < 0)
+            break;
+        *buffer++ = (char)c;
+        count++;
+    }
+    return count;
+}
+
+/*******************************************************************************
+   TWI
+*******************************************************************************/
+#define HOST_TWI_BUFFER_SIZE 32
+
+static HostI2CDevice *i2cDevices[128];
+static HostI2CDevice *twiDevice = NULL; /* Endereçado na transferência em curso */
+static bool twiStarted = false;
+static bool twiAddressing = false; /* Próximo byte em TWDR é SLA+R/W */
+static bool twiReading = false;
+static uint8_t twiBuffer[HOST_TWI_BUFFER_SIZE];
+static uint8_t twiLength = 0;
+static uint8_t twiIndex = 0;
+
+void hostAttachI2C(uint8_t address, HostI2CDevice *device)
+{
+    i2cDevices[address & 0x7F] = device;
+}
+
+/* Fim da transferência: a escrita vai inteira ao dispositivo */
+static void twiDeliver(void)
+{
+    if (twiDevice != NULL && !twiReading)
+        twiDevice->receive(twiBuffer, twiLength);
+    twiDevice = NULL;
+}
+
+static uint8_t twiStep(uint8_t control)
+{
+    if (control & _BV(TWSTA))
+    {
+        uint8_t status = twiStarted ? TW_REP_START : TW_START;
+        twiDeliver();
+        twiStarted = twiAddressing = true;
+        return status;
+    }
+    if (control & _BV(TWSTO))
+    {
+        twiDeliver();
+        twiStarted = twiAddressing = false;
+        return TW_NO_INFO;
+    }
+    if (!twiStarted)
+        return TW_BUS_ERROR;
+
+    if (twiAddressing)
+    {
+        twiAddressing = false;
+        twiReading = TWDR & 0x01;
+        twiDevice = i2cDevices[TWDR >> 1];
+        twiLength = twiIndex = 0;
+        if (twiDevice == NULL)
+            return twiReading ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+        if (twiReading)
+            twiLength = twiDevice->request(twiBuffer, HOST_TWI_BUFFER_SIZE);
+        return twiReading ? TW_MR_SLA_ACK : TW_MT_SLA_ACK;
+    }
+    if (twiDevice == NULL)
+        return TW_BUS_ERROR;
+    if (!twiReading)
+    {
+        if (twiLength >= HOST_TWI_BUFFER_SIZE)
+            return TW_MT_DATA_NACK;
+        twiBuffer[twiLength++] = TWDR;
+        return TW_MT_DATA_ACK;
+    }
+    TWDR = twiIndex < twiLength ? twiBuffer[twiIndex++] : 0xFF;
+    return (control & _BV(TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+}
+
+HostTwiControl &HostTwiControl::operator=(uint8_t control)
+{
+    /* TWINT escrito em 1 dispara o passo; ao ler, já terminou (e o STOP já saiu) */
+    this->value = control & ~_BV(TWSTO);
+    if ((control & _BV(TWEN)) && (control & _BV(TWINT)))
+        TWSR = (TWSR & 0x03) | twiStep(control);
+    return *this;
+}
+
+/*******************************************************************************
+   CRC
+*******************************************************************************/
+uint8_t CRC_8(const uint8_t *data, int length, uint8_t polynomial)
+{
+    uint8_t crc = 0;
+    while (length-- > 0)
+    {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ polynomial : crc << 1;
+    }
+    return crc;
+}
+
+/*******************************************************************************
+   Checks
+*******************************************************************************/
+int hostFailures = 0;
+
+bool hostCheck(bool passed, const char *expression, const char *file, int line)
+{
+    if (!passed)
+    {
+        printf("%s:%d: check failed: %s\n", file, line, expression);
+        hostFailures++;
+    }
+    return passed;
+}
+
+int hostResult(const char *name)
+{
+    printf("%s: %s (%d failures)\n", name, hostFailures ? "FAILED" : "passed", hostFailures);
+    return hostFailures ? 1 : 0;
+}
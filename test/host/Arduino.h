@@ -0,0 +1,155 @@
+/** @file Arduino.h
+ *  @brief Host stand-in for the Arduino AVR core, for the tests in test/.
+ *
+ *  Only what the sketch and its classes use. The clock is virtual: it only
+ *  moves through hostAdvance(), delay() and wdt_reset() (see host.h).
+ *  With HOST_AVR_LAYOUT (test/ram_budget.sh), PROGMEM data and F()/PSTR
+ *  strings go to a .progmem section, as they stay in flash on the AVR.
+ */
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define HEX 16
+#define DEC 10
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define SDA 18
+#define SCL 19
+#define F_CPU 16000000UL
+#define clockCyclesPerMicrosecond() (F_CPU / 1000000UL)
+#define _BV(b) (1u << (b))
+#define bit(b) (1UL << (b))
+#define noInterrupts() cli()
+#define interrupts() sei()
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+#define NOT_AN_INTERRUPT -1
+
+class __FlashStringHelper;
+#ifdef HOST_AVR_LAYOUT
+#define F(s) (__extension__({static const char __c[] PROGMEM = (s); (const __FlashStringHelper *)__c; }))
+#else
+#define F(s) ((const __FlashStringHelper *)(s))
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+class Print
+{
+public:
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return str ? this->write((const uint8_t *)str, strlen(str)) : 0; }
+	size_t write(const char *buffer, size_t size) { return this->write((const uint8_t *)buffer, size); }
+	virtual int availableForWrite(void) { return 0; }
+	virtual void flush(void) {}
+
+	size_t print(const __FlashStringHelper *str);
+	size_t print(const char *str);
+	size_t print(char c);
+	size_t print(unsigned char value, int base = DEC);
+	size_t print(int value, int base = DEC);
+	size_t print(unsigned int value, int base = DEC);
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println(const __FlashStringHelper *str);
+	size_t println(const char *str);
+	size_t println(char c);
+	size_t println(unsigned char value, int base = DEC);
+	size_t println(int value, int base = DEC);
+	size_t println(unsigned int value, int base = DEC);
+	size_t println(long value, int base = DEC);
+	size_t println(unsigned long value, int base = DEC);
+	size_t println(double value, int digits = 2);
+	size_t println(void);
+
+private:
+	size_t printNumber(unsigned long value, uint8_t base);
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available(void) = 0;
+	virtual int read(void) = 0;
+	virtual int peek(void) = 0;
+	size_t readBytes(char *buffer, size_t length);
+	size_t readBytes(uint8_t *buffer, size_t length) { return this->readBytes((char *)buffer, length); }
+	void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+
+protected:
+	unsigned long timeout = 1000;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+	void begin(unsigned long baud) { (void)baud; }
+	void begin(unsigned long baud, uint8_t config) { (void)baud; (void)config; }
+	void end(void) {}
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	int peek(void) { return -1; }
+	size_t write(uint8_t c) { (void)c; return 1; }
+	using Print::write;
+	int availableForWrite(void) { return 63; }
+	void flush(void) {}
+	operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+#define SERIAL_8N1 0x06
+
+/* ALERT/RDY em D12 (PB4, PCINT4) e RTS em D5 (PD5), como no UNO */
+#define digitalPinToPCICR(p) (&PCICR)
+#define digitalPinToPCICRbit(p) ((p) <= 7 ? 2 : ((p) <= 13 ? 0 : 1))
+#define digitalPinToPCMSK(p) ((p) <= 7 ? &PCMSK2 : ((p) <= 13 ? &PCMSK0 : &PCMSK1))
+#define digitalPinToPCMSKbit(p) ((p) <= 7 ? (p) : ((p) <= 13 ? (p) - 8 : (p) - 14))
+#define digitalPinToPort(p) ((p) <= 7 ? 4 : ((p) <= 13 ? 2 : 3))
+#define digitalPinToBitMask(p) ((uint8_t)_BV(digitalPinToPCMSKbit(p)))
+#define portInputRegister(port) ((port) == 4 ? &PIND : ((port) == 2 ? &PINB : &PINC))
+#define portOutputRegister(port) ((port) == 4 ? &PORTD : ((port) == 2 ? &PORTB : &PORTC))
+
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#endif /* _HOST_ARDUINO_H_ */
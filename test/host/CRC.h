@@ -0,0 +1,14 @@
+/** @file CRC.h
+ *  @brief Host stand-in for the CRC library: CRC-8, MSB first, initial value 0.
+ */
+
+#ifndef _HOST_CRC_H_
+#define _HOST_CRC_H_
+
+#include <stdint.h>
+
+#define CRC_8_MAXIM_POLY 0x31
+
+uint8_t CRC_8(const uint8_t *data, int length, uint8_t polynomial);
+
+#endif /* _HOST_CRC_H_ */
@@ -0,0 +1,38 @@
+/** @file EEPROM.h
+ *  @brief Host stand-in for the 1 KB EEPROM of the ATmega328P (erased: 0xFF).
+ */
+
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include "Arduino.h"
+
+#define HOST_EEPROM_SIZE 1024
+
+struct EEPROMClass
+{
+	uint8_t cells[HOST_EEPROM_SIZE];
+
+	EEPROMClass(void) { memset(this->cells, 0xFF, sizeof(this->cells)); }
+	uint8_t read(int address) { return this->cells[address]; }
+	void write(int address, uint8_t value) { this->cells[address] = value; }
+	void update(int address, uint8_t value) { this->cells[address] = value; }
+	uint16_t length(void) { return HOST_EEPROM_SIZE; }
+
+	template <typename T>
+	T &get(int address, T &value)
+	{
+		memcpy(&value, &this->cells[address], sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	const T &put(int address, const T &value)
+	{
+		memcpy(&this->cells[address], &value, sizeof(T));
+		return value;
+	}
+};
+extern EEPROMClass EEPROM;
+
+#endif /* _HOST_EEPROM_H_ */
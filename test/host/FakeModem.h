@@ -0,0 +1,82 @@
+/** @file FakeModem.h
+ *  @brief Scripted ESP8266 AT firmware on a host Stream: each rule answers
+ *         once when the bytes written so far contain its command.
+ */
+
+#ifndef _FAKE_MODEM_H_
+#define _FAKE_MODEM_H_
+
+/* Antes do Arduino.h, cujos min()/max() são macros */
+#include <string>
+#include <deque>
+#include <vector>
+#include "host.h"
+
+class FakeModem : public Stream
+{
+public:
+	/* Resposta a um comando, entregue 'delayMicros' após a escrita */
+	struct Rule
+	{
+		std::string command;
+		std::string response;
+		uint32_t delayMicros;
+	};
+
+	void expect(const std::string &command, const std::string &response, uint32_t delayMicros = 2000)
+	{
+		this->rules.push_back({command, response, delayMicros});
+	}
+
+	/* Bytes não solicitados (ex.: "+IPD" de um cliente), a partir de agora */
+	void push(const std::string &data) { this->pending.push_back({hostMicros, data}); }
+
+	size_t write(uint8_t c)
+	{
+		this->written += (char)c;
+		this->all += (char)c;
+		for (std::vector<Rule>::iterator rule = this->rules.begin(); rule != this->rules.end(); ++rule)
+		{
+			if (this->written.find(rule->command) == std::string::npos)
+				continue;
+			this->pending.push_back({hostMicros + rule->delayMicros, rule->response});
+			this->written.clear();
+			this->rules.erase(rule);
+			break;
+		}
+		return 1;
+	}
+	using Print::write;
+
+	int available(void)
+	{
+		while (!this->pending.empty() && this->pending.front().first <= hostMicros)
+		{
+			this->rx += this->pending.front().second;
+			this->pending.pop_front();
+		}
+		/* Como a serial: no máximo o buffer de recepção de uma vez */
+		return this->rx.size() < 64 ? (int)this->rx.size() : 64;
+	}
+
+	int read(void)
+	{
+		if (this->available() == 0)
+			return -1;
+		int c = (uint8_t)this->rx[0];
+		this->rx.erase(0, 1);
+		return c;
+	}
+
+	int peek(void) { return this->available() ? (uint8_t)this->rx[0] : -1; }
+
+	std::string all; /* Tudo o que foi escrito */
+
+private:
+	std::vector<Rule> rules;
+	std::string written; /* Desde a última regra atendida */
+	std::deque<std::pair<uint32_t, std::string> > pending;
+	std::string rx;
+};
+
+#endif /* _FAKE_MODEM_H_ */
@@ -0,0 +1,21 @@
+/** @file LiquidCrystal.h
+ *  @brief Host stand-in for the 16x2 LCD: output is discarded.
+ */
+
+#ifndef _HOST_LIQUID_CRYSTAL_H_
+#define _HOST_LIQUID_CRYSTAL_H_
+
+#include "Arduino.h"
+
+class LiquidCrystal : public Print
+{
+public:
+	LiquidCrystal(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) {}
+	void begin(uint8_t cols, uint8_t rows) { (void)cols; (void)rows; }
+	void clear(void) {}
+	void setCursor(uint8_t col, uint8_t row) { (void)col; (void)row; }
+	size_t write(uint8_t c) { (void)c; return 1; }
+	using Print::write;
+};
+
+#endif /* _HOST_LIQUID_CRYSTAL_H_ */
@@ -0,0 +1,86 @@
+/** @file SimADS1115.h
+ *  @brief Simulated ADS1115 on the host I2C bus: registers, mux and a sine
+ *         source per input, sampled on the virtual clock at each convert().
+ */
+
+#ifndef _SIM_ADS1115_H_
+#define _SIM_ADS1115_H_
+
+#include "host.h"
+
+class SimADS1115 : public HostI2CDevice
+{
+public:
+	/* Fonte de cada mux (config >> 12 & 7): amplitude em LSB, frequência, deslocamento
+	   e, opcionais, as amplitudes da 3ª e da 5ª harmônicas */
+	struct Source
+	{
+		float amplitude;
+		float frequency;
+		int16_t offset;
+		float third;
+		float fifth;
+	};
+
+	explicit SimADS1115(uint8_t address) { hostAttachI2C(address, this); }
+
+	/* Fim de uma conversão: amostra a entrada selecionada no instante atual */
+	void convert(void)
+	{
+		const Source &source = this->sources[this->mux()];
+		float t = hostMicros * 1e-6f;
+		float phase = 2.0f * (float)M_PI * source.frequency * t;
+		this->conversion = source.offset + (int16_t)lroundf(source.amplitude * sinf(phase) + source.third * sinf(3 * phase) +
+															source.fifth * sinf(5 * phase));
+		this->conversions++;
+	}
+
+	uint8_t mux(void) { return (this->config >> 12) & 0x07; }
+	bool continuous(void) { return !(this->config & 0x0100); }
+	bool readySignal(void) { return (this->hiThresh & 0x8000) && !(this->loThresh & 0x8000) && (this->config & 0x03) != 0x03; }
+
+	void receive(const uint8_t *data, uint8_t length)
+	{
+		if (length == 0)
+			return;
+		this->pointer = data[0] & 0x03;
+		if (length < 3)
+			return;
+		uint16_t value = (data[1] << 8) | data[2];
+		if (this->pointer == 1)
+			this->config = value;
+		else if (this->pointer == 2)
+			this->loThresh = value;
+		else if (this->pointer == 3)
+			this->hiThresh = value;
+		this->writes++;
+	}
+
+	uint8_t request(uint8_t *data, uint8_t length)
+	{
+		if (this->onRequest != NULL)
+			this->onRequest();
+		uint16_t value = this->pointer == 0 ? (uint16_t)this->conversion : this->pointer == 1 ? this->config : this->pointer == 2 ? this->loThresh : this->hiThresh;
+		if (length > 2)
+			length = 2;
+		if (length > 0)
+			data[0] = value >> 8;
+		if (length > 1)
+			data[1] = value & 0xFF;
+		this->reads++;
+		return length;
+	}
+
+	Source sources[8] = {};
+	void (*onRequest)(void) = NULL; /* Chamada no meio de cada leitura, como uma interrupção aninhada */
+	uint8_t pointer = 0;
+	uint16_t config = 0x8583; /* Padrão após reset */
+	uint16_t loThresh = 0x8000;
+	uint16_t hiThresh = 0x7FFF;
+	int16_t conversion = 0;
+	uint32_t conversions = 0;
+	uint32_t reads = 0;
+	uint32_t writes = 0;
+};
+
+#endif /* _SIM_ADS1115_H_ */
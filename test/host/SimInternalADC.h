@@ -0,0 +1,43 @@
+/** @file SimInternalADC.h
+ *  @brief Simulated internal ADC in free running: a sine source per analog
+ *         pin, converted every 13 ADC clocks on the virtual clock.
+ */
+
+#ifndef _SIM_INTERNAL_ADC_H_
+#define _SIM_INTERNAL_ADC_H_
+
+#include "host.h"
+
+extern "C" void ADC_vect(void);
+
+class SimInternalADC
+{
+public:
+	/* Fonte de cada pino: amplitude e deslocamento em LSB (0...1023), frequência */
+	struct Source
+	{
+		float amplitude;
+		float frequency;
+		int16_t offset;
+	};
+
+	/* Uma conversão de 104us (125kHz / 13) no pino de ADMUX, entregue à ISR */
+	void convert(void)
+	{
+		hostAdvance(104);
+		if (!(ADCSRA & _BV(ADEN)) || !(ADCSRA & _BV(ADATE)))
+			return;
+		const Source &source = this->sources[ADMUX & 0x07];
+		float t = hostMicros * 1e-6f;
+		long value = source.offset + lroundf(source.amplitude * sinf(2.0f * (float)M_PI * source.frequency * t));
+		ADC = (uint16_t)(value < 0 ? 0 : value > 1023 ? 1023 : value);
+		this->conversions++;
+		if (ADCSRA & _BV(ADIE))
+			ADC_vect();
+	}
+
+	Source sources[8] = {};
+	uint32_t conversions = 0;
+};
+
+#endif /* _SIM_INTERNAL_ADC_H_ */
@@ -0,0 +1,13 @@
+/** @file interrupt.h
+ *  @brief Host stand-in: ISR(v) defines a plain function the tests call.
+ */
+
+#ifndef _HOST_AVR_INTERRUPT_H_
+#define _HOST_AVR_INTERRUPT_H_
+
+#define ISR_NOBLOCK
+#define ISR(vector, ...) extern "C" void vector(void); void vector(void)
+#define cli() do { } while (0)
+#define sei() do { } while (0)
+
+#endif /* _HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,90 @@
+/** @file io.h
+ *  @brief Host stand-in for the ATmega328P registers used by the sketch.
+ */
+
+#ifndef _HOST_AVR_IO_H_
+#define _HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t PINB, PORTB, DDRB, PINC, PORTC, DDRC, PIND, PORTD, DDRD;
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX, DIDR0, ADCL, ADCH;
+extern volatile uint16_t ADC;
+extern volatile uint8_t UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+extern volatile uint16_t UBRR0;
+
+/* USART0: o transmissor esvazia na hora; os bytes escritos vão para hostUartTx (host.h) */
+struct HostUsartStatus
+{
+	uint8_t value;
+	operator uint8_t() const { return this->value | 0x60; /* UDRE0 | TXC0 */ }
+	HostUsartStatus &operator=(uint8_t value) { this->value = value; return *this; }
+};
+struct HostUsartData
+{
+	uint8_t received;
+	operator uint8_t() const { return this->received; }
+	HostUsartData &operator=(uint8_t data);
+};
+extern HostUsartStatus UCSR0A;
+extern HostUsartData UDR0;
+
+/* TWI: cada passo escrito em TWCR termina na hora, sobre os HostI2CDevice (host.h) */
+struct HostTwiControl
+{
+	uint8_t value;
+	operator uint8_t() const { return this->value; }
+	HostTwiControl &operator=(uint8_t control);
+};
+extern volatile uint8_t TWBR, TWSR, TWDR;
+extern HostTwiControl TWCR;
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define PCINT4 4
+#define PB4 4
+#define PINB4 4
+
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ01 2
+#define UCSZ00 1
+
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN 2
+
+#endif /* _HOST_AVR_IO_H_ */
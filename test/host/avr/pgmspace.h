@@ -0,0 +1,32 @@
+/** @file pgmspace.h
+ *  @brief Host stand-in: flash is ordinary memory.
+ */
+
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+#include <string.h>
+
+#ifdef HOST_AVR_LAYOUT
+#define PROGMEM __attribute__((section(".progmem")))
+#define PSTR(s) (__extension__({static const char __c[] PROGMEM = (s); &__c[0]; }))
+#else
+#define PROGMEM
+#define PSTR(s) (s)
+#endif
+#define PGM_P const char *
+
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_float(p) (*(const float *)(p))
+#define pgm_read_ptr(p) (*(void *const *)(p))
+
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strstr_P strstr
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+
+#endif /* _HOST_AVR_PGMSPACE_H_ */
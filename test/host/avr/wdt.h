@@ -0,0 +1,14 @@
+/** @file wdt.h
+ *  @brief Host stand-in for the watchdog; wdt_reset() yields to the test (host.h).
+ */
+
+#ifndef _HOST_AVR_WDT_H_
+#define _HOST_AVR_WDT_H_
+
+#define WDTO_8S 9
+
+void wdt_enable(int timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#endif /* _HOST_AVR_WDT_H_ */
@@ -0,0 +1,44 @@
+/** @file host.h
+ *  @brief Test-side controls of the host stand-ins: virtual clock, pins,
+ *         I2C devices, USART0 and a minimal check macro.
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include "Arduino.h"
+
+/* Relógio virtual, em us: só avança por hostAdvance(), delay() e wdt_reset() */
+extern uint32_t hostMicros;
+void hostAdvance(uint32_t micros);
+
+/* Chamada por delay() e wdt_reset(), depois de avançar o relógio: o teste */
+/* responde ali pelo periférico (ex.: o módulo WiFi) enquanto o código espera */
+extern void (*hostYield)(void);
+extern uint32_t hostWdtStepMicros; /* Avanço do relógio em cada wdt_reset() */
+
+/* Níveis escritos por digitalWrite() */
+extern uint8_t hostPins[20];
+
+/* Dispositivo no barramento I2C */
+class HostI2CDevice
+{
+public:
+	/* Bytes de uma escrita (ponteiro de registrador + dados) */
+	virtual void receive(const uint8_t *data, uint8_t length) = 0;
+	/* Preenche uma leitura; retorna os bytes fornecidos */
+	virtual uint8_t request(uint8_t *data, uint8_t length) = 0;
+};
+void hostAttachI2C(uint8_t address, HostI2CDevice *device);
+
+/* USART0: bytes escritos em UDR0; hostUartReceive() entrega um byte à ISR */
+extern void (*hostUartTx)(uint8_t data);
+void hostUartReceive(uint8_t data, uint8_t status = 0);
+
+/* Verificação: imprime a falha e segue; main() retorna hostResult() */
+extern int hostFailures;
+#define CHECK(condition) hostCheck((condition), #condition, __FILE__, __LINE__)
+bool hostCheck(bool passed, const char *expression, const char *file, int line);
+int hostResult(const char *name);
+
+#endif /* _HOST_H_ */
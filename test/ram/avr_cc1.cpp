@@ -0,0 +1,50 @@
+/** @file avr_cc1.cpp
+ *  @brief Compiles one C++ file for the ATmega328P with the clang front end
+ *         that ships as libclang-cpp, for test/ram_budget.sh.
+ *
+ *  There is no avr-gcc here, but libclang-cpp exports the handler of the
+ *  clang-fuzzer, which runs "clang -cc1" on a source buffer and emits an
+ *  object through the AVR backend of libLLVM. Same data layout as avr-gcc:
+ *  16-bit int, pointers and enums, 32-bit double, no padding.
+ *
+ *  avr_cc1 <source> <cc1 arguments...>. Diagnostics are not reported: a
+ *  failed compile leaves no output file.
+ */
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace clang_fuzzer
+{
+    void HandleCXX(const std::string &source, const char *fileName, const std::vector<const char *> &arguments);
+}
+
+extern "C"
+{
+    void LLVMInitializeAVRTargetInfo(void);
+    void LLVMInitializeAVRTarget(void);
+    void LLVMInitializeAVRTargetMC(void);
+    void LLVMInitializeAVRAsmPrinter(void);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        return 2;
+
+    LLVMInitializeAVRTargetInfo();
+    LLVMInitializeAVRTarget();
+    LLVMInitializeAVRTargetMC();
+    LLVMInitializeAVRAsmPrinter();
+
+    std::ifstream file(argv[1]);
+    if (!file)
+        return 2;
+    std::stringstream source;
+    source << file.rdbuf();
+
+    std::vector<const char *> arguments(argv + 2, argv + argc);
+    clang_fuzzer::HandleCXX(source.str(), argv[1], arguments);
+    return 0;
+}
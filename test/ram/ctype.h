@@ -0,0 +1,13 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_CTYPE_H_
+#define _RAM_CTYPE_H_
+extern "C" {
+int isdigit(int);
+int isalpha(int);
+int isalnum(int);
+int isxdigit(int);
+int isspace(int);
+int tolower(int);
+int toupper(int);
+}
+#endif
@@ -0,0 +1,27 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_MATH_H_
+#define _RAM_MATH_H_
+#define M_PI 3.14159265358979323846
+#define NAN __builtin_nanf("")
+#define INFINITY __builtin_inff()
+#define isnan(x) __builtin_isnan(x)
+#define isinf(x) __builtin_isinf(x)
+extern "C" {
+double sin(double);
+double cos(double);
+double sqrt(double);
+double fabs(double);
+double floor(double);
+double ceil(double);
+double round(double);
+double pow(double, double);
+double log10(double);
+double atan2(double, double);
+long lround(double);
+float sinf(float);
+float cosf(float);
+float sqrtf(float);
+float fabsf(float);
+long lroundf(float);
+}
+#endif
@@ -0,0 +1,8 @@
+/* avr-libc subset for test/ram_budget.sh */
+#ifndef _RAM_STDDEF_H_
+#define _RAM_STDDEF_H_
+typedef __SIZE_TYPE__ size_t;
+typedef __PTRDIFF_TYPE__ ptrdiff_t;
+#define NULL __null
+#define offsetof(type, member) __builtin_offsetof(type, member)
+#endif
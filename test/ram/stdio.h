@@ -0,0 +1,9 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_STDIO_H_
+#define _RAM_STDIO_H_
+#include <stddef.h>
+extern "C" {
+int sprintf(char *, const char *, ...);
+int snprintf(char *, size_t, const char *, ...);
+}
+#endif
@@ -0,0 +1,17 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_STDLIB_H_
+#define _RAM_STDLIB_H_
+#include <stddef.h>
+extern "C" {
+void *malloc(size_t);
+void free(void *);
+int atoi(const char *);
+double atof(const char *);
+long atol(const char *);
+double strtod(const char *, char **);
+long strtol(const char *, char **, int);
+unsigned long strtoul(const char *, char **, int);
+int abs(int);
+long labs(long);
+}
+#endif
@@ -0,0 +1,19 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_STRING_H_
+#define _RAM_STRING_H_
+#include <stddef.h>
+extern "C" {
+void *memcpy(void *, const void *, size_t);
+void *memmove(void *, const void *, size_t);
+void *memset(void *, int, size_t);
+int memcmp(const void *, const void *, size_t);
+size_t strlen(const char *);
+int strcmp(const char *, const char *);
+int strncmp(const char *, const char *, size_t);
+char *strcpy(char *, const char *);
+char *strncpy(char *, const char *, size_t);
+char *strstr(const char *, const char *);
+char *strchr(const char *, int);
+char *strtok(char *, const char *);
+}
+#endif
@@ -0,0 +1,15 @@
+/* avr-libc subset for test/ram_budget.sh: declarations only, nothing is linked */
+#ifndef _RAM_TIME_H_
+#define _RAM_TIME_H_
+#include <stdint.h>
+typedef uint32_t time_t;
+struct tm
+{
+	int8_t tm_sec, tm_min, tm_hour, tm_mday, tm_wday, tm_mon;
+	int16_t tm_year, tm_yday;
+	int16_t tm_isdst;
+};
+extern "C" {
+struct tm *localtime(const time_t *);
+}
+#endif
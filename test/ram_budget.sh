@@ -0,0 +1,84 @@
+#!/bin/sh
+# Static RAM (.data + .bss, as avr-size reports) of the sketch on the
+# ATmega328P, without avr-gcc.
+#
+# Each translation unit goes through the clang AVR front end (ram/avr_cc1.cpp,
+# built on libclang-cpp and libLLVM) against the core stand-ins in test/host
+# and the libc declarations in test/ram. The bitcode is linked, internalized
+# but for setup(), loop() and the ISRs, and optimized for size before the AVR
+# backend runs, like the LTO link of the Arduino builder. .rodata is counted
+# with .data: the AVR copies strings, vtables and const tables to RAM.
+# PROGMEM, F() and PSTR() data stay in flash (.progmem).
+#
+# The Arduino core is not compiled. Its RAM is added as CORE_RAM: millis 9
+# and the pins of LiquidCrystal 19. Nothing references Serial, Wire or
+# malloc(), so their buffers and twi.c are not linked.
+#
+#   test/ram_budget.sh [-v] [-DMACRO[=value] ...]
+# -v lists the largest symbols. Exits 1 above RAM_SIZE - STACK_RESERVE.
+
+set -e
+cd "$(dirname "$0")/.."
+
+LLVM_DIR=${LLVM_DIR:-/usr/lib/llvm-14}
+RAM_SIZE=2048
+STACK_RESERVE=${STACK_RESERVE:-400} # Pilha de loop() + ISRs aninhadas (a do ADS1115 reabilita interrupções)
+CORE_RAM=${CORE_RAM:-28}
+
+verbose=0
+if [ "$1" = "-v" ]; then
+	verbose=1
+	shift
+fi
+
+out=$(mktemp -d)
+trap '[ -n "$KEEP" ] || rm -rf "$out"' EXIT
+cp config_example.h "$out/config.h"
+
+g++ -O1 test/ram/avr_cc1.cpp -o "$out/avr_cc1" "$LLVM_DIR/lib/libclang-cpp.so.14" "$LLVM_DIR/lib/libLLVM-14.so" \
+	-Wl,-rpath,"$LLVM_DIR/lib"
+
+test/sketch_cpp.sh Energy_meter.ino "$out/Energy_meter.cpp"
+
+for source in *.cpp "$out/Energy_meter.cpp"; do
+	name=$(basename "$source" .cpp)
+	"$out/avr_cc1" "$source" -triple avr -target-cpu atmega328p -x c++ -std=gnu++11 -Os -fgnuc-version=4.2.1 \
+		-fno-rtti -fno-threadsafe-statics -ffreestanding -nostdsysteminc -nobuiltininc -fembed-bitcode=all -disable-llvm-verifier \
+		-D__AVR_ATmega328P__ -DF_CPU=16000000L -DARDUINO=10813 -DHOST_AVR_LAYOUT "$@" \
+		-isystem test/ram -I test/host -I . -I "$out" -o "$out/$name.o"
+	if [ ! -f "$out/$name.o" ]; then
+		echo "$source: does not compile for AVR; check.sh shows the errors" >&2
+		exit 2
+	fi
+	"$LLVM_DIR/bin/llvm-objcopy" --dump-section .llvmbc="$out/$name.bc" "$out/$name.o" "$out/$name.strip"
+done
+
+"$LLVM_DIR/bin/llvm-link" "$out"/*.bc -o "$out/sketch.bc"
+"$LLVM_DIR/bin/opt" -passes='internalize,globaldce,default<Os>' \
+	-internalize-public-api-list=_Z5setupv,_Z4loopv,PCINT0_vect,USART_RX_vect,ADC_vect \
+	"$out/sketch.bc" -o "$out/sketch.opt.bc"
+# A RAM sai só das variáveis: as funções viram declarações antes do backend,
+# que no LLVM 14 ainda quebra na alocação de registradores de algumas delas
+"$LLVM_DIR/bin/llvm-extract" --delete --rfunc='.*' "$out/sketch.opt.bc" -o "$out/globals.bc"
+"$LLVM_DIR/bin/llc" -O0 -mtriple=avr -mcpu=atmega328p -filetype=obj "$out/globals.bc" -o "$out/globals.o"
+
+sections() {
+	"$LLVM_DIR/bin/llvm-size" -A "$1" | awk -v pattern="$2" '$1 ~ pattern { sum += $2 } END { print sum + 0 }'
+}
+data=$(sections "$out/globals.o" '^\.(data|rodata)')
+bss=$(sections "$out/globals.o" '^\.bss')
+progmem=$(sections "$out/globals.o" '^\.progmem')
+if "$LLVM_DIR/bin/llc" -O2 -mtriple=avr -mcpu=atmega328p -filetype=obj "$out/sketch.opt.bc" -o "$out/sketch.elf" 2>/dev/null; then
+	text=$(sections "$out/sketch.elf" '^\.text')
+else
+	text="n/a (llc)"
+fi
+total=$((data + bss + CORE_RAM))
+limit=$((RAM_SIZE - STACK_RESERVE))
+
+if [ $verbose = 1 ]; then
+	"$LLVM_DIR/bin/llvm-objdump" -t -C "$out/globals.o" | grep -E " \\.(data|rodata|bss)" | sort -k5 | tail -30
+fi
+echo "data $data + bss $bss + core $CORE_RAM = $total B of RAM, limit $limit B ($RAM_SIZE - $STACK_RESERVE of stack)"
+echo "flash: text $text + progmem $progmem B, without the core"
+[ $total -le $limit ]
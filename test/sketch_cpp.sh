@@ -0,0 +1,21 @@
+#!/bin/sh
+# .ino -> .cpp with the prototypes, as the Arduino builder does: the
+# functions declared after the private variables, before the first one.
+#
+#   test/sketch_cpp.sh <sketch.ino> <output.cpp>
+# Used by ram_budget.sh and by the host tests that drive the sketch.
+
+set -e
+sketch=$1
+output=$2
+
+proto='^[a-zA-Z_][a-zA-Z0-9_ *:<>]*[ *]+[A-Za-z_][A-Za-z0-9_]*\([^;]*\)$'
+first=$(grep -nE "$proto" "$sketch" | grep -v ':static' | head -1 | cut -d: -f1)
+{
+	echo '#include "Arduino.h"'
+	echo "#line 1 \"$sketch\""
+	head -n $((first - 1)) "$sketch"
+	grep -E "$proto" "$sketch" | grep -v '^static' | sed 's/ = [^,)]*//g; s/$/;/'
+	echo "#line $first \"$sketch\""
+	tail -n +"$first" "$sketch"
+} > "$output"
@@ -0,0 +1,66 @@
+/** @file test_acquisition.cpp
+ *  @brief Channels on two ADS1115 paced by the RDY of the first one: the
+ *         second one, on a slower oscillator, is resampled at the pacing rate.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "Acquisition.h"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+static SimADS1115 adc1(ADS1115::ADDR_VDD);
+
+/* Pulso do ALERT/RDY do primeiro, 1162us a 860 SPS; o segundo converte a cada 'every' pulsos */
+static void rdyPulse(uint8_t every)
+{
+    static uint32_t pulses = 0;
+    hostAdvance(1162);
+    adc0.convert();
+    if (++pulses % every == 0)
+        adc1.convert();
+    PCINT0_vect();
+}
+
+int main(void)
+{
+    adc0.sources[0] = {8000.0f, 60.0f, 0};
+    adc1.sources[0] = {8000.0f, 60.0f, 0};
+
+    static Acquisition acquisition;
+    /* Sem ACQUISITION_INTERNAL_ADC, os pinos do ADC interno são entradas inválidas */
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT_INTERNAL(0)) == ACQUISITION_MAX_CHANNELS);
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(0, ADS1115::MUX_0_1)) == 0);
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(1, ADS1115::MUX_0_1)) == 1);
+    acquisition.begin();
+
+    /* Conversão de assentamento após o início, descartada */
+    int16_t samples[100], sample;
+    rdyPulse(2);
+    CHECK(!acquisition.read(0, &sample) && !acquisition.read(1, &sample));
+
+    /* Duas janelas de 100 pulsos; o segundo dispositivo com metade da taxa */
+    for (uint8_t window = 0; window < 2; window++)
+    {
+        for (uint8_t i = 0; i < 100; i++)
+        {
+            rdyPulse(2);
+            CHECK(acquisition.read(0, &sample));
+            CHECK(acquisition.read(1, &samples[i]));
+        }
+        acquisition.release(0, 100);
+        acquisition.release(1, 100);
+    }
+
+    /* Uma amostra por pulso em cada canal: a do mais lento repete a conversão */
+    for (uint8_t i = 0; i < 100; i += 2)
+        CHECK(samples[i] == samples[i + 1]);
+    CHECK(samples[1] != samples[2]);
+
+    /* Taxa das amostras, a mesma nos dois: a do RDY que cadencia a leitura */
+    float rate = 1e6f / 1162;
+    CHECK(fabsf(acquisition.getConversionRate(0) - rate) < 0.1f);
+    CHECK(fabsf(acquisition.getConversionRate(1) - rate) < 0.1f);
+
+    return hostResult("test_acquisition");
+}
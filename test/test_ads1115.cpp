@@ -0,0 +1,112 @@
+/** @file test_ads1115.cpp
+ *  @brief Interrupt-driven ADS1115 acquisition: RDY setup, ISR ring buffer,
+ *         overrun accounting, nested RDY edges and the device list.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "ADS1115.h"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+static SimADS1115 adc1(ADS1115::ADDR_VDD);
+
+/* Pulso do ALERT/RDY: os dois conversores terminam juntos, 1162us a 860 SPS */
+static void rdyPulse(void)
+{
+    hostAdvance(1162);
+    adc0.convert();
+    adc1.convert();
+    PCINT0_vect();
+}
+
+static void nestedEdge(void)
+{
+    /* Borda de subida do pulso durante a leitura: deve ser ignorada */
+    PCINT0_vect();
+}
+
+int main(void)
+{
+    ADS1115 ads0, ads1;
+    ADS1115::ADS1115_config_t config = ADS1115Channel<ADS1115::ADDR_GND, ADS1115::MUX_0_1>::config();
+    adc0.sources[0] = {1000.0f, 60.0f, 0};
+    adc1.sources[3] = {0.0f, 0.0f, -123};
+
+    /* Comparador como RDY, conversão contínua e interrupção do pino habilitada */
+    CHECK(ads0.startContinuous(&config));
+    CHECK(adc0.readySignal());
+    CHECK(adc0.continuous());
+    CHECK(adc0.pointer == ADS1115::REG_CONVERSION);
+    CHECK(PCMSK0 & _BV(PCINT4));
+
+    /* Cada pulso enfileira uma conversão, na ordem */
+    int16_t expected[8];
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        rdyPulse();
+        expected[i] = adc0.conversion;
+    }
+    CHECK(ads0.getCount() == 8);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        int16_t sample;
+        CHECK(ads0.read(&sample) && sample == expected[i]);
+    }
+    CHECK(ads0.getCount() == 0);
+
+    /* Marca de tempo: contador de conversões e instante da última */
+    uint16_t count;
+    uint32_t stamp;
+    ads0.getConversionStamp(&count, &stamp);
+    CHECK(count == 8 && stamp == hostMicros);
+
+    /* Fila cheia: as conversões seguintes são contadas como perdidas */
+    for (uint8_t i = 0; i < ADS1115_RING_BUFFER_SIZE + 5; i++)
+        rdyPulse();
+    CHECK(ads0.getCount() == ADS1115_RING_BUFFER_SIZE);
+    CHECK(ads0.getOverrunCount() == 5);
+
+    /* Borda aninhada: uma única leitura por pulso */
+    int16_t sample;
+    while (ads0.read(&sample))
+        ;
+    uint32_t reads = adc0.reads;
+    adc0.onRequest = nestedEdge;
+    rdyPulse();
+    adc0.onRequest = NULL;
+    CHECK(adc0.reads == reads + 1);
+    CHECK(ads0.getCount() == 1);
+
+    /* Segundo dispositivo: lido no mesmo pulso, em sua própria fila */
+    ADS1115::ADS1115_config_t config1 = ADS1115Channel<ADS1115::ADDR_VDD, ADS1115::MUX_2_3>::config();
+    CHECK(ads1.startContinuous(&config1));
+    CHECK(adc1.mux() == 3);
+    rdyPulse();
+    CHECK(ads0.getCount() == 2);
+    CHECK(ads1.read(&sample) && sample == -123);
+
+    /* Troca de mux: amostras da entrada anterior descartadas */
+    rdyPulse();
+    ads1.selectMux(&config1, ADS1115::MUX_0_1);
+    CHECK(adc1.mux() == 0);
+    CHECK(ads1.getCount() == 0);
+
+    /* Parada: sem dispositivos, a interrupção do pino é desabilitada */
+    ads0.stop();
+    rdyPulse();
+    CHECK(ads1.getCount() == 1);
+    CHECK(PCMSK0 & _BV(PCINT4));
+    ads1.stop();
+    CHECK(!(PCMSK0 & _BV(PCINT4)));
+
+    /* Peso do LSB: FS / 32768, igual em tempo de compilação e com o ganho em execução */
+    static_assert(ADS1115Channel<ADS1115::ADDR_GND, ADS1115::MUX_0_1>::lsbMillivolts == 0.0625f, "PGA_2048");
+    const ADS1115::ADS1115_gain_t gains[] = {ADS1115::PGA_6144, ADS1115::PGA_4096, ADS1115::PGA_2048,
+                                             ADS1115::PGA_1024, ADS1115::PGA_0512, ADS1115::PGA_0256};
+    const float fullScale[] = {6144.0f, 4096.0f, 2048.0f, 1024.0f, 512.0f, 256.0f};
+    for (volatile uint8_t i = 0; i < 6; i++)
+        CHECK(ADS1115::lsbMillivolts(gains[i]) == fullScale[i] / 32768.0f);
+
+    return hostResult("test_ads1115");
+}
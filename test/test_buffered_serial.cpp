@@ -0,0 +1,71 @@
+/** @file test_buffered_serial.cpp
+ *  @brief USART0 receive buffer under a burst from the module while loop()
+ *         stalls: bytes lost without RTS, none with it.
+ */
+#include "host.h"
+#include "BufferedSerial.h"
+#include "ESP8266.h"
+
+/* Rajada de 'length' bytes a 'baud', com loop() lendo a cada 1ms exceto por 'stallMicros' */
+/* Com RTS, o transmissor ainda termina o byte em andamento ao ver o CTS alto */
+static uint16_t burst(BufferedSerial &serial, uint32_t baud, bool flow, uint16_t length, uint32_t stallMicros)
+{
+    serial.begin(baud);
+    serial.setFlowControl(flow ? ESP_RTS_PIN : BUFFERED_SERIAL_NO_PIN);
+
+    uint32_t byteMicros = 10000000ul / baud; /* 8N1: 10 bits */
+    if (byteMicros == 0)
+        byteMicros = 1;
+    uint32_t start = hostMicros, lastRead = hostMicros;
+    uint16_t sent = 0, received = 0;
+    bool ctsHigh = false;
+    while (received < length && hostMicros - start < 2000000ul)
+    {
+        hostAdvance(byteMicros);
+        if (sent < length && !(flow && ctsHigh))
+        {
+            hostUartReceive((uint8_t)sent);
+            sent++;
+        }
+        ctsHigh = hostPins[ESP_RTS_PIN] == HIGH;
+
+        bool stalled = hostMicros - start < stallMicros;
+        if (!stalled && hostMicros - lastRead >= 1000)
+        {
+            lastRead = hostMicros;
+            while (serial.read() >= 0)
+                received++;
+        }
+        if (sent == length && !stalled && serial.available() == 0)
+            break;
+    }
+    while (serial.read() >= 0)
+        ;
+    return serial.getOverflowCount();
+}
+
+int main(void)
+{
+    /* Segmento TCP inteiro ("+IPD" de 1460 bytes) durante 40ms de loop() ocupado */
+    static BufferedSerial plain57600, plain115200, flow115200, flow1M;
+    uint16_t lost57600 = burst(plain57600, 57600ul, false, 1460, 40000ul);
+    uint16_t lost115200 = burst(plain115200, 115200ul, false, 1460, 40000ul);
+    uint16_t flowLost115200 = burst(flow115200, 115200ul, true, 1460, 40000ul);
+    uint16_t flowLost1M = burst(flow1M, 1000000ul, true, 1460, 40000ul);
+    printf("overflow, 1460 bytes during a 40ms stall: 57600 %u, 115200 %u; with RTS: 115200 %u, 1M %u; high water %u\n",
+           lost57600, lost115200, flowLost115200, flowLost1M, flow1M.getHighWater());
+
+    /* Sem RTS o buffer de BUFFERED_SERIAL_RX_SIZE bytes não cobre a parada; com RTS nada se perde */
+    CHECK(lost57600 > 0 && lost115200 > lost57600);
+    CHECK(flowLost115200 == 0 && flowLost1M == 0);
+    CHECK(flow1M.getHighWater() < BUFFERED_SERIAL_RX_SIZE);
+
+#ifdef ESP_FLOW_CONTROL
+    CHECK(ESP_BAUD_MAX == 1000000ul);
+#else
+    /* Sem o fio de RTS: a taxa negociada fica onde o buffer ainda cobre o loop() */
+    CHECK(ESP_BAUD_MAX == 115200ul);
+#endif
+
+    return hostResult("test_buffered_serial");
+}
@@ -0,0 +1,86 @@
+/** @file test_energy_harmonics.cpp
+ *  @brief Goertzel harmonics of Energy (ENERGY_HARMONICS) on a synthetic
+ *         current with known 3rd and 5th harmonics: magnitudes and THD with
+ *         the fixed and the synchronous window, and the channels without
+ *         harmonic state.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "Acquisition.h"
+#include "Energy.h"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+static SimADS1115 adc1(ADS1115::ADDR_VDD);
+
+static void rdyPulse(void)
+{
+    hostAdvance(1162);
+    adc0.convert();
+    adc1.convert();
+    PCINT0_vect();
+}
+
+/* Uma janela do canal que fecha primeiro; o outro segue na fila */
+static void window(Energy &first, Energy &second)
+{
+    for (uint16_t i = 0; i < 4 * ENERGY_DEFAULT_DATA_SIZE; i++)
+    {
+        rdyPulse();
+        second.measure();
+        if (first.measure())
+            return;
+    }
+}
+
+/* Erro de cada harmônica e da THD contra os valores da fonte */
+static void report(Energy &energy, double tolerance, double thdTolerance)
+{
+    double lsb = ADS1115::lsbMillivolts(ACQUISITION_DEFAULT_GAIN) * ENERGY_DEFAULT_SCALE * 1e-3;
+    const double peaks[ENERGY_HARMONIC_COUNT] = {16000, 2400, 1280};
+    for (uint8_t i = 0; i < ENERGY_HARMONIC_COUNT; i++)
+    {
+        double expected = peaks[i] / sqrt(2.0) * lsb;
+        double error = fabs(energy.getHarmonic(i) - expected) / expected;
+        printf("window %3u cycles, harmonic %u: %.4f A, expected %.4f A, error %.3f%%\n", energy.config.windowCycles,
+               ENERGY_HARMONIC_ORDER(i), energy.getHarmonic(i), expected, 100 * error);
+        CHECK(error < tolerance);
+    }
+    double thd = 100 * sqrt(2400.0 * 2400 + 1280.0 * 1280) / 16000;
+    printf("window %3u cycles, THD: %.3f%%, expected %.3f%%\n", energy.config.windowCycles, energy.getThd(), thd);
+    CHECK(fabs(energy.getThd() - thd) < thdTolerance);
+}
+
+int main(void)
+{
+    /* 16000, 2400 e 1280 LSB de pico (50A, 7.5A e 4A), um canal por dispositivo: 860 SPS cada */
+    adc0.sources[0] = {16000.0f, 60.0f, 0, 2400.0f, 1280.0f};
+    adc1.sources[0] = {16000.0f, 60.0f, 0, 2400.0f, 1280.0f};
+
+    static Acquisition acquisition;
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(0, ADS1115::MUX_0_1)) == 0);
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(1, ADS1115::MUX_0_1)) == 1);
+    acquisition.begin();
+
+    /* Estado só no primeiro canal: o segundo informa NAN */
+    static Energy analyzed(acquisition, 0), plain(acquisition, 1);
+    static Energy::Harmonics harmonics;
+    analyzed.setHarmonics(&harmonics);
+    for (uint8_t i = 0; i < 4; i++)
+        window(analyzed, plain);
+
+    /* Janela fixa de 500 amostras (34.9 ciclos): vazamento da fundamental sobre as harmônicas */
+    report(analyzed, 0.03, 0.4);
+
+    /* Janela síncrona de 30 ciclos, aberta no cruzamento por zero */
+    analyzed.config.windowCycles = 30;
+    for (uint8_t i = 0; i < 4; i++)
+        window(analyzed, plain);
+    report(analyzed, 0.006, 0.05);
+
+    CHECK(isnan(plain.getThd()) && isnan(plain.getHarmonic(0)));
+    CHECK(plain.getRmsLast() > 0);
+
+    return hostResult("test_energy_harmonics");
+}
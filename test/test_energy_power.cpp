@@ -0,0 +1,77 @@
+/** @file test_energy_power.cpp
+ *  @brief Real power on the paired ADS1115 (ENERGY_VOLTAGE): state only on
+ *         the channels given one, overruns of the voltage device and the
+ *         reset of the window.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "Acquisition.h"
+#include "Energy.h"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+static SimADS1115 adc1(ADS1115::ADDR_VDD);
+
+/* Pulso do ALERT/RDY: corrente e tensão terminam juntas, 1162us a 860 SPS */
+static void rdyPulse(void)
+{
+    hostAdvance(1162);
+    adc0.convert();
+    adc1.convert();
+    PCINT0_vect();
+}
+
+/* Uma janela completa do canal, com a fila drenada a cada pulso */
+static bool window(Energy &energy)
+{
+    for (uint16_t i = 0; i < 2 * ENERGY_DEFAULT_DATA_SIZE; i++)
+    {
+        rdyPulse();
+        if (energy.measure())
+            return true;
+    }
+    return false;
+}
+
+int main(void)
+{
+    /* Corrente em A0-A1 do primeiro ADS1115 e tensão em A0 do segundo, em fase */
+    adc0.sources[0] = {8000.0f, 60.0f, 0};
+    adc1.sources[4] = {10000.0f, 60.0f, 0};
+
+    static Acquisition acquisition;
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(0, ADS1115::MUX_0_1)) == 0);
+    CHECK(acquisition.setVoltageInput(ACQUISITION_INPUT(1, ADS1115::MUX_0_GND)));
+    acquisition.begin();
+    CHECK(acquisition.hasVoltage(0));
+    CHECK(adc1.mux() == 4 && adc1.continuous());
+
+    /* Sem estado de potência: tensão e potência NAN, mesmo no dispositivo pareado */
+    static Energy energy(acquisition, 0);
+    energy.config.phaseCal = 0; /* Conversões simultâneas no simulador */
+    CHECK(window(energy));
+    CHECK(isnan(energy.getVoltageRms()));
+    CHECK(isnan(energy.getPowerFactorLast()));
+
+    /* Com estado: 10000 LSB de pico = 7071 LSB RMS, 0.0625mV/LSB, 250V/V */
+    static Energy::Power power;
+    energy.setPower(&power);
+    CHECK(window(energy));
+    CHECK(window(energy));
+    float volts = 10000.0f / sqrtf(2.0f) * 0.0625e-3f * ENERGY_DEFAULT_VOLTAGE_SCALE;
+    CHECK(fabsf(energy.getVoltageRms() - volts) < 0.01f * volts);
+    CHECK(energy.getPowerFactorLast() > 0.99f && energy.getPowerFactorLast() <= 1.0f);
+    CHECK(energy.getRealPowerLast() > 0);
+
+    /* Nova janela: o produto atrasado não usa a tensão da janela anterior */
+    CHECK(power.voltageSum == 0 && power.productSumLow == 0 && power.delayedSumLow == 0);
+    CHECK(power.previousVoltage == 0);
+
+    /* Fila cheia: as perdas da tensão, que não é marcada como 'running', também contam */
+    for (uint8_t i = 0; i < ADS1115_RING_BUFFER_SIZE + 3; i++)
+        rdyPulse();
+    CHECK(acquisition.getOverrunCount() == 2 * 3);
+
+    return hostResult("test_energy_power");
+}
@@ -0,0 +1,107 @@
+/** @file test_energy_rms.cpp
+ *  @brief Integer RMS kernel of Energy against a double reference on the same
+ *         samples, next to the float accumulation it replaced.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "Acquisition.h"
+#include "Energy.h"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+
+/* Últimas conversões, na ordem em que o Energy as consome */
+static int16_t history[ENERGY_DEFAULT_DATA_SIZE];
+static uint16_t historyIndex = 0;
+
+static void rdyPulse(void)
+{
+    hostAdvance(1162);
+    adc0.convert();
+    history[historyIndex] = adc0.conversion;
+    historyIndex = (historyIndex + 1) % ENERGY_DEFAULT_DATA_SIZE;
+    PCINT0_vect();
+}
+
+static bool window(Energy &energy)
+{
+    for (uint16_t i = 0; i < 2 * ENERGY_DEFAULT_DATA_SIZE; i++)
+    {
+        rdyPulse();
+        if (energy.measure())
+            return true;
+    }
+    return false;
+}
+
+/* Referência em double, sem o nível DC, e o caminho em float anterior (soma de x² em float, com o DC) */
+static void reference(double lsb, double &exact, double &former)
+{
+    double sum = 0, squareSum = 0;
+    float floatSum = 0;
+    for (uint16_t i = 0; i < ENERGY_DEFAULT_DATA_SIZE; i++)
+    {
+        sum += history[i];
+        squareSum += (double)history[i] * history[i];
+        float value = (float)history[i] * (float)lsb;
+        floatSum += value * value;
+    }
+    double mean = sum / ENERGY_DEFAULT_DATA_SIZE;
+    exact = sqrt(squareSum / ENERGY_DEFAULT_DATA_SIZE - mean * mean) * lsb;
+    former = sqrtf(floatSum / ENERGY_DEFAULT_DATA_SIZE);
+}
+
+int main(void)
+{
+    static Acquisition acquisition;
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT(0, ADS1115::MUX_0_1)) == 0);
+    acquisition.begin();
+    static Energy energy(acquisition, 0);
+    double lsb = acquisition.getLsbMillivolts(0) * ENERGY_DEFAULT_SCALE * 1e-3;
+
+    /* Amplitudes de 10 a 30000 LSB, sem DC: o kernel inteiro fica dentro de 1e-5 */
+    const float amplitudes[] = {10.0f, 100.0f, 1000.0f, 10000.0f, 30000.0f};
+    for (uint8_t i = 0; i < sizeof(amplitudes) / sizeof(amplitudes[0]); i++)
+    {
+        adc0.sources[0] = {amplitudes[i], 60.0f, 0};
+        CHECK(window(energy)); /* Descarta a janela com a amplitude anterior */
+        CHECK(window(energy));
+        double exact, former;
+        reference(lsb, exact, former);
+        double error = fabs(energy.getRmsLast() - exact) / exact;
+        printf("amplitude %5.0f LSB: %.4f A, integer %.1e, float %.1e\n", amplitudes[i], exact, error,
+               fabs(former - exact) / exact);
+        CHECK(error < 1e-5);
+    }
+
+    /* 1000 LSB de DC sobre 1000 LSB de pico: o kernel remove o nível, a soma em float não */
+    adc0.sources[0] = {1000.0f, 60.0f, 1000};
+    CHECK(window(energy));
+    CHECK(window(energy));
+    double exact, former;
+    reference(lsb, exact, former);
+    printf("offset 1000 LSB: integer %.1e, float %.1e\n", fabs(energy.getRmsLast() - exact) / exact,
+           fabs(former - exact) / exact);
+    CHECK(fabs(energy.getRmsLast() - exact) / exact < 1e-5);
+    CHECK(former > 1.2 * exact);
+
+    /* Janelas síncronas de 10 ciclos, canal único: emendadas no cruzamento, sem um ciclo de rearme */
+    adc0.sources[0] = {1000.0f, 60.0f, 0};
+    energy.config.windowCycles = 10;
+    CHECK(window(energy));
+    CHECK(window(energy));
+    for (uint8_t w = 0; w < 3; w++)
+    {
+        uint16_t pulses = 0;
+        for (bool done = false; !done && pulses < ENERGY_DEFAULT_DATA_SIZE; pulses++)
+        {
+            rdyPulse();
+            done = energy.measure();
+        }
+        printf("synchronous window %u: %u samples, expected %.1f\n", w, pulses, 10 * 1e6 / 1162 / 60);
+        CHECK(fabs(pulses - 10 * 1e6 / 1162 / 60) < 1.5);
+    }
+
+    return hostResult("test_energy_rms");
+}
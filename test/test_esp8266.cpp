@@ -0,0 +1,162 @@
+/** @file test_esp8266.cpp
+ *  @brief ESP8266 command queue against a scripted modem: non-blocking
+ *         commands, sequences cancelled on failure, "+IPD" demultiplexing
+ *         (also while another connection awaits its "SEND OK"),
+ *         the streak of silent commands and the asynchronous UART commands.
+ */
+#include "FakeModem.h"
+#include "ESP8266.h"
+
+void serial_flush(void) {}
+bool serial_get(const __FlashStringHelper *, uint32_t, char *, uint16_t) { return false; }
+
+static FakeModem modem;
+static ESP8266 esp(ESP_ENABLE_PIN, modem);
+
+/* Resposta de 17 bytes do servidor local */
+static void writeResponse(Stream &serial, const void *)
+{
+    serial.print("HTTP/1.1 200 OK\r\n");
+}
+
+/* Executa a fila até o resultado, com o relógio andando 1ms por passo */
+static ESP8266::esp_status_t run(ESP8266::esp_future_t *future)
+{
+    for (uint16_t i = 0; i < 5000 && future->isPending(); i++)
+    {
+        hostAdvance(1000);
+        esp.poll();
+    }
+    return future->status;
+}
+
+int main(void)
+{
+    ESP8266::esp_future_t future;
+
+    /* Conexão lenta (SSL, 2s): poll() nunca espera, o loop segue medindo */
+    modem.expect("AT+CIPSTART=4,\"SSL\",\"example.com\",443\r\n", "4,CONNECT\r\n\r\nOK\r\n", 2000000ul);
+    static ESP8266::esp_URL_parameter_t url = {"example.com", "secret", "meter"};
+    CHECK(esp.connect(url, &future));
+    uint32_t loops = 0, longest = 0;
+    while (future.isPending() && loops < 10000)
+    {
+        hostAdvance(1000); /* Uma passada do loop: measure() e o restante */
+        uint32_t before = hostMicros;
+        esp.poll();
+        if (hostMicros - before > longest)
+            longest = hostMicros - before;
+        loops++;
+    }
+    CHECK(future.isDone());
+    CHECK(loops >= 2000 && longest == 0);
+
+    /* Sequência: a falha do primeiro comando cancela o segundo, com o mesmo resultado */
+    modem.expect("AT+CIPSERVER=1,80\r\n", "\r\nERROR\r\n");
+    CHECK(esp.server_start(&future));
+    CHECK(run(&future) == ESP8266::ESP_FAILED);
+    CHECK(future.remaining == 0 && esp.isIdle());
+    CHECK(modem.all.find("AT+CIFSR") == std::string::npos);
+
+    /* Timestamp: o conteúdo "+IPD" da conexão 3 é o dado do segundo comando */
+    modem.expect("AT+CIPSTART=3,\"TCP\",\"time.nist.gov\",37\r\n",
+                 std::string("3,CONNECT\r\n\r\nOK\r\n+IPD,3,4:\xE9\x6B\x2A\x00", 30) + "3,CLOSED\r\n");
+    CHECK(esp.requestUnixTimestamp(&future));
+    CHECK(run(&future) == ESP8266::ESP_DONE);
+    CHECK(esp.lastUnixTimestamp() == 0xE96B2A00ul - 2208988800ul);
+
+    /* Requisição de um cliente no servidor: evento e conteúdo só na sua conexão */
+    modem.push("1,CONNECT\r\n\r\n+IPD,1,14:GET / HTTP/1.1");
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        hostAdvance(1000);
+        esp.poll();
+    }
+    uint8_t event;
+    while (esp.getEvent(&event) && ESP_EVENT_LINK(event) != 1)
+        ;
+    CHECK(event == (ESP_EVENT_CONNECT | 1));
+    CHECK(esp.getPendingLink() == 1);
+    std::string request;
+    for (int16_t c; (c = esp.receive(1)) >= 0;)
+        request += (char)c;
+    CHECK(request == "GET / HTTP/1.1");
+    CHECK(esp.receive(0) < 0);
+
+    /* Requisições sobrepostas: 200 bytes da conexão 2 chegam antes do "SEND OK" da resposta */
+    /* da conexão 1; a conexão cheia para a serial até ser lida, e o tempo parado não conta */
+    std::string second = "GET /measures.json?wait HTTP/1.1\r\nHost: meter\r\n";
+    second += "User-Agent: " + std::string(200 - second.size() - 16, 'a') + "\r\n\r\n";
+    second.resize(200, '\n');
+    modem.expect("AT+CIPSENDEX=1,2047\r\n", "\r\nOK\r\n> ");
+    modem.expect("\\0", "2,CONNECT\r\n\r\n+IPD,2,200:" + second + "\r\nRecv 17 bytes\r\n\r\nSEND OK\r\n");
+    uint16_t dropped = esp.getDroppedBytes();
+    CHECK(esp.send(1, writeResponse, NULL, NULL, 0, &future));
+    std::string received;
+    for (uint16_t i = 0; i < 5000 && (future.isPending() || received.size() < second.size()); i++)
+    {
+        hostAdvance(1000);
+        esp.poll();
+        /* Leitor da conexão 2 ocupado por 2s, mais que o timeout do "SEND OK" */
+        for (int16_t c; i >= 2000 && (c = esp.receive(2)) >= 0;)
+            received += (char)c;
+    }
+    CHECK(future.isDone());
+    CHECK(received == second);
+    CHECK(esp.getDroppedBytes() == dropped);
+
+    /* Forma bloqueante: wait() roda a mesma fila, com o watchdog atualizado */
+    modem.expect("AT+CIPSERVER=0\r\n", "\r\nOK\r\n");
+    CHECK(esp.server_stop());
+
+    /* Sem nenhum byte do módulo: cada timeout conta */
+    for (uint8_t i = 1; i <= 3; i++)
+    {
+        CHECK(esp.probe(&future));
+        CHECK(run(&future) == ESP8266::ESP_TIMEOUT);
+        CHECK(esp.getTimeoutStreak() == i);
+    }
+
+    /* ERROR é resposta: a taxa está certa */
+    modem.expect("AT+GMR\r\n", "\r\nERROR\r\n");
+    CHECK(esp.probe(&future));
+    CHECK(run(&future) == ESP8266::ESP_FAILED);
+    CHECK(esp.getTimeoutStreak() == 0);
+
+    /* "No AP" sem o valor esperado termina em timeout, mas também é resposta */
+    CHECK(esp.probe(&future) && run(&future) == ESP8266::ESP_TIMEOUT);
+    CHECK(esp.getTimeoutStreak() == 1);
+    modem.expect("AT+CWJAP_DEF?\r\n", "No AP\r\n\r\nOK\r\n");
+    CHECK(esp.checkWifi(&future));
+    CHECK(run(&future) == ESP8266::ESP_TIMEOUT);
+    CHECK(esp.getTimeoutStreak() == 0);
+
+    /* Resposta truncada (taxa errada costuma corromper, não calar) */
+    modem.expect("AT+GMR\r\n", "AT ver");
+    CHECK(esp.probe(&future) && run(&future) == ESP8266::ESP_TIMEOUT);
+    CHECK(esp.getTimeoutStreak() == 0);
+
+    /* AT+UART_CUR assíncrono: a taxa é lida ao escrever, não ao enfileirar */
+    modem.expect("AT+UART_CUR=", "\r\nOK\r\n");
+    CHECK(esp.setUartRate(250000ul, &future));
+    CHECK(run(&future) == ESP8266::ESP_DONE);
+#ifdef ESP_FLOW_CONTROL
+    CHECK(modem.all.find("AT+UART_CUR=250000,8,1,0,2\r\n") != std::string::npos);
+#else
+    CHECK(modem.all.find("AT+UART_CUR=250000,8,1,0,0\r\n") != std::string::npos);
+#endif
+
+    /* Configuração assíncrona: cabe na fila e a primeira falha cancela o resto */
+    CHECK(esp.isIdle());
+    modem.expect("ATE0\r\n", "ATE0\r\r\n\r\nOK\r\n");
+#ifdef ESP_FLOW_CONTROL
+    modem.expect("AT+UART_CUR=", "\r\nOK\r\n");
+#endif
+    modem.expect("AT+CIPMUX=1\r\n", "\r\nERROR\r\n");
+    CHECK(esp.configure(&future));
+    CHECK(run(&future) == ESP8266::ESP_FAILED);
+    CHECK(esp.isIdle());
+    CHECK(modem.all.find("AT+CWMODE") == std::string::npos);
+
+    return hostResult("test_esp8266");
+}
@@ -0,0 +1,85 @@
+/** @file test_internal_adc.cpp
+ *  @brief Internal ADC backend on a synthetic waveform: free-running setup,
+ *         double buffer hand-off and overrun, and the same RMS path as the
+ *         ADS1115 through Acquisition and Energy.
+ */
+#include "host.h"
+#include "SimInternalADC.h"
+#include "InternalADC.h"
+#include "Acquisition.h"
+#include "Energy.h"
+
+static SimInternalADC adc;
+
+/* Conversões de 'micros', com o loop drenando as duas medidas a cada 16 (~1.7ms) */
+static void run(Energy &first, Energy &second, uint32_t micros)
+{
+    for (uint32_t t = 0; t < micros; t += 104)
+    {
+        adc.convert();
+        if (adc.conversions % 16 == 0)
+        {
+            first.measure();
+            second.measure();
+        }
+    }
+}
+
+int main(void)
+{
+    /* 60Hz em A0 e A1, polarizados em AVcc/2; 200 e 50 LSB de pico */
+    adc.sources[0] = {200.0f, 60.0f, INTERNAL_ADC_MIDSCALE};
+    adc.sources[1] = {50.0f, 60.0f, INTERNAL_ADC_MIDSCALE};
+
+    /* Free running em AVcc, com interrupção */
+    {
+        InternalADC internal;
+        internal.start(1);
+        CHECK(ADMUX == (_BV(REFS0) | 1));
+        CHECK((ADCSRA & (_BV(ADEN) | _BV(ADATE) | _BV(ADIE))) == (_BV(ADEN) | _BV(ADATE) | _BV(ADIE)));
+        CHECK(DIDR0 & _BV(1));
+
+        /* Nada antes de uma metade completa; depois, as amostras centradas, na ordem */
+        int16_t sample;
+        for (uint8_t i = 0; i < INTERNAL_ADC_BLOCK_SIZE - 1; i++)
+            adc.convert();
+        CHECK(!internal.read(&sample));
+        adc.convert();
+        int16_t last = (int16_t)ADC - INTERNAL_ADC_MIDSCALE;
+        for (uint8_t i = 0; i < INTERNAL_ADC_BLOCK_SIZE; i++)
+            CHECK(internal.read(&sample) && sample >= -50 && sample <= 50);
+        CHECK(sample == last);
+        CHECK(!internal.read(&sample));
+
+        /* Consumidor parado: com uma metade pronta, a outra é sobrescrita ao completar */
+        for (uint8_t i = 0; i < 2 * INTERNAL_ADC_BLOCK_SIZE; i++)
+            adc.convert();
+        CHECK(internal.getOverrunCount() == INTERNAL_ADC_BLOCK_SIZE);
+        internal.stop();
+        CHECK(!(ADCSRA & _BV(ADIE)));
+    }
+
+    /* Dois canais no ADC interno, em rodízio: mesma redução do ADS1115 */
+    static Acquisition acquisition;
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT_INTERNAL(0)) == 0);
+    CHECK(acquisition.addChannel(ACQUISITION_INPUT_INTERNAL(1)) == 1);
+    acquisition.begin();
+
+    static Energy first(acquisition, 0), second(acquisition, 1);
+    first.config.windowCycles = 3;
+    second.config.windowCycles = 3;
+    run(first, second, 2000000ul);
+    CHECK(first.getRmsCount() > 2 && second.getRmsCount() > 2);
+    CHECK(acquisition.getOverrunCount() == 0);
+
+    /* 200 LSB de pico = 141.4 LSB RMS, 4.883mV/LSB, 50A/V */
+    float amperes = 200.0f / sqrtf(2.0f) * INTERNAL_ADC_LSB_MV * ENERGY_DEFAULT_SCALE * 1e-3f;
+    printf("internal ADC: %.3f A (expected %.3f), %.3f A (expected %.3f), %.1f Hz at %.0f S/s\n",
+           first.getRmsLast(), amperes, second.getRmsLast(), amperes / 4, first.getLineFrequency(), acquisition.getConversionRate(0));
+    CHECK(fabsf(first.getRmsLast() - amperes) < 0.01f * amperes);
+    CHECK(fabsf(second.getRmsLast() - amperes / 4) < 0.02f * amperes / 4);
+    CHECK(fabsf(first.getLineFrequency() - 60.0f) < 0.5f);
+    CHECK(fabsf(acquisition.getConversionRate(0) - 1e6f / 104) < 5.0f);
+
+    return hostResult("test_internal_adc");
+}
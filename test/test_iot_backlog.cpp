@@ -0,0 +1,143 @@
+/** @file test_iot_backlog.cpp
+ *  @brief EEPROM backlog of the sketch behind the batch: refilled oldest
+ *         first across the wraparound, the oldest interval dropped when full
+ *         (but not from under a send in flight), corrupted records skipped,
+ *         and the sequence kept across a reset.
+ */
+#include <vector>
+#include "host.h"
+#include "Energy_meter.cpp"
+
+static uint32_t next = 1760000000ul; /* Timestamp do próximo intervalo */
+
+static void add(uint16_t count)
+{
+    while (count--)
+    {
+        timestamp = next;
+        IOT_batch_add(next);
+        next += MESSAGE_SAMPLE_RATE;
+    }
+}
+
+/* Fila inteira, do mais antigo: o lote e, depois, os registros da EEPROM */
+static std::vector<uint32_t> queue(void)
+{
+    std::vector<uint32_t> sequence(iotBatch.seqNumber, iotBatch.seqNumber + iotBatch.count);
+    for (uint8_t i = 0; i < iotBacklog.count; i++)
+    {
+        IOT_record_t record;
+        uint8_t slot = (iotBacklog.head + i) % IOT_backlog_capacity();
+        CHECK(EEPROM_read((uint8_t *)&record, iotBacklog.recordSize, IOT_backlog_address(slot)));
+        sequence.push_back(record.seqNumber);
+    }
+    return sequence;
+}
+
+static std::vector<uint32_t> range(uint32_t first, uint32_t last)
+{
+    std::vector<uint32_t> sequence;
+    for (uint32_t seq = first; seq <= last; seq++)
+        sequence.push_back(seq);
+    return sequence;
+}
+
+/* Publicação confirmada do lote inteiro, como em IOT_poll() */
+static std::vector<uint32_t> publish(void)
+{
+    std::vector<uint32_t> sent(iotBatch.seqNumber, iotBatch.seqNumber + iotBatch.count);
+    iotBatch.sent = iotBatch.count;
+    IOT_batch_confirm();
+    IOT_finish(true);
+    return sent;
+}
+
+/* Reset: a RAM se perde, a EEPROM fica */
+static void reboot(void)
+{
+    memset(&iotBatch, 0, sizeof(iotBatch));
+    memset(&iotBacklog, 0, sizeof(iotBacklog));
+    iotSeqNumber = 0;
+    iotDropped = 0;
+    IOT_backlog_init();
+}
+
+int main(void)
+{
+    channelCount = 2;
+    IOT_backlog_init();
+    const uint8_t batch = IOT_batch_capacity();
+    const uint8_t capacity = IOT_backlog_capacity();
+    CHECK(batch == 5 && capacity > batch);
+    printf("batch %u intervals, backlog %u records of %u bytes\n", batch, capacity, iotBacklog.recordSize);
+
+    /* Sem conexão: a RAM enche primeiro, os seguintes vão para a EEPROM, na ordem */
+    add(batch + capacity);
+    CHECK(iotBatch.count == batch && iotBacklog.count == capacity);
+    CHECK(queue() == range(0, batch + capacity - 1));
+    CHECK(iotDropped == 0);
+
+    /* Cheia: descarta o mais antigo (na RAM) e completa o lote com a EEPROM */
+    add(1);
+    CHECK(iotDropped == 1);
+    CHECK(queue() == range(1, batch + capacity));
+
+    /* Envio em curso: a RAM não desloca; sai o mais antigo da EEPROM */
+    iotBatch.sent = iotBatch.count;
+    add(1);
+    CHECK(iotDropped == 2);
+    std::vector<uint32_t> expected = range(1, batch);
+    std::vector<uint32_t> rest = range(batch + 2, batch + capacity + 1);
+    expected.insert(expected.end(), rest.begin(), rest.end());
+    CHECK(queue() == expected);
+
+    /* Confirmado: o lote segue da EEPROM sem aguardar o período */
+    IOT_batch_confirm();
+    IOT_finish(true);
+    CHECK(!queue().empty() && queue() == rest);
+    CHECK(iotDraining && iotBatch.sent == 0);
+
+    /* Encerrado o envio, o mais antigo volta a sair da RAM */
+    add(capacity - iotBacklog.count + 1);
+    CHECK(iotDropped == 3 && queue().front() == rest.front() + 1);
+
+    /* Muitas voltas na EEPROM: cada publicação leva os mais antigos, sem lacunas */
+    uint32_t expectedSeq = queue().front();
+    for (uint16_t round = 0; round <= 3 * capacity; round++)
+    {
+        std::vector<uint32_t> sent = publish();
+        CHECK(sent == range(expectedSeq, expectedSeq + batch - 1));
+        expectedSeq += batch;
+        add(batch);
+    }
+    CHECK(iotDropped == 3);
+    CHECK(queue() == range(expectedSeq, iotSeqNumber - 1));
+
+    /* Reset com a fila no meio da EEPROM: a sequência continua do último registro */
+    while (iotBacklog.count < batch + 2)
+        add(1);
+    std::vector<uint32_t> stored = queue();
+    stored.erase(stored.begin(), stored.begin() + iotBatch.count); /* Perdidos com a RAM */
+    uint32_t nextSeq = iotSeqNumber;
+    uint8_t head = iotBacklog.head;
+    CHECK(head != 0);
+    reboot();
+    CHECK(iotSeqNumber == nextSeq && iotBacklog.head == (head + batch) % capacity);
+    CHECK(queue() == stored);
+    add(1);
+    CHECK(queue().back() == nextSeq);
+
+    /* Registro corrompido: descartado e contado, os seguintes seguem na ordem */
+    add(capacity - iotBacklog.count);
+    uint32_t corrupted = queue()[iotBatch.count];
+    EEPROM.cells[IOT_backlog_address(iotBacklog.head)] ^= 0x01;
+    publish();
+    CHECK(iotDropped == 1 && queue().front() == corrupted + 1);
+
+    /* Outro número de canais: os registros não servem, a fila recomeça */
+    channelCount = 1;
+    reboot();
+    CHECK(iotBacklog.count == 0 && iotBatch.count == 0 && iotSeqNumber == 0);
+
+    return hostResult("test_iot_backlog");
+}
@@ -0,0 +1,68 @@
+/** @file test_iot_batch.cpp
+ *  @brief Batch of the sketch in RAM: intervals per batch with the number of
+ *         channels, sent when full or when the oldest waited the maximum
+ *         latency, released oldest first.
+ */
+#include "host.h"
+#include "Energy_meter.cpp"
+
+static uint32_t next = 1760000000ul; /* Timestamp do próximo intervalo */
+
+static void add(uint8_t count)
+{
+    while (count--)
+    {
+        timestamp = next;
+        IOT_batch_add(next);
+        next += MESSAGE_SAMPLE_RATE;
+    }
+}
+
+int main(void)
+{
+    /* EEPROM apagada: fila vazia, sequência do zero */
+    channelCount = 2;
+    IOT_backlog_init();
+    CHECK(iotBacklog.count == 0 && iotSeqNumber == 0 && iotBatch.count == 0);
+
+    /* Capacidade: IOT_BATCH_POOL_SIZE valores, até IOT_BATCH_INTERVALS intervalos */
+    CHECK(IOT_batch_capacity() == 5);
+    channelCount = 1;
+    CHECK(IOT_batch_capacity() == 5);
+    channelCount = 2;
+    CHECK(!IOT_batch_due());
+
+    /* Latência: o mais antigo aguarda até IOT_BATCH_MAX_LATENCY */
+    uint32_t first = next;
+    add(3);
+    timestamp = first + IOT_BATCH_MAX_LATENCY - 1;
+    CHECK(!IOT_batch_due());
+    timestamp = first + IOT_BATCH_MAX_LATENCY;
+    CHECK(IOT_batch_due());
+
+    /* Cheio: segue sem aguardar */
+    add(2);
+    timestamp = first + 4 * MESSAGE_SAMPLE_RATE;
+    CHECK(iotBatch.count == 5 && IOT_batch_due());
+    for (uint8_t i = 0; i < 5; i++)
+        CHECK(iotBatch.seqNumber[i] == i && iotBatch.timestamp[i] == first + i * MESSAGE_SAMPLE_RATE);
+
+    /* Dois confirmados: os demais avançam, na ordem */
+    iotBatch.sent = 2;
+    IOT_batch_confirm();
+    IOT_finish(true);
+    CHECK(iotBatch.count == 3);
+    CHECK(iotBatch.seqNumber[0] == 2 && iotBatch.seqNumber[2] == 4);
+    CHECK(iotBatch.timestamp[0] == first + 2 * MESSAGE_SAMPLE_RATE);
+
+    /* Com espaço na RAM e sem fila na EEPROM, o novo vai para o fim do lote */
+    add(1);
+    CHECK(iotBatch.count == 4 && iotBatch.seqNumber[3] == 5 && iotBacklog.count == 0);
+
+    /* Falha: tudo permanece para a próxima publicação */
+    iotBatch.sent = iotBatch.count;
+    IOT_finish(false);
+    CHECK(iotBatch.count == 4 && !iotDraining);
+
+    return hostResult("test_iot_batch");
+}
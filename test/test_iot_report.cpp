@@ -0,0 +1,118 @@
+/** @file test_iot_report.cpp
+ *  @brief Report-by-exception of the sketch on currents measured by a
+ *         simulated ADS1115: the edges of the relative and absolute
+ *         deadbands, of the maximum silence and of the minimum spacing, and
+ *         the interval that closes the day.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "Energy_meter.cpp"
+
+extern "C" void PCINT0_vect(void);
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+
+/* Janelas inteiras de todos os canais, a 860 SPS */
+static void windows(uint8_t count)
+{
+    uint8_t done[CHANNEL_MAX] = {0};
+    for (uint32_t pulses = 0; pulses < 100000ul; pulses++)
+    {
+        hostAdvance(1162);
+        adc0.convert();
+        PCINT0_vect();
+
+        bool all = true;
+        for (uint8_t i = 0; i < channelCount; i++)
+        {
+            if (energy[i].measure())
+                done[i]++;
+            all = all && done[i] >= count;
+        }
+        if (all)
+            return;
+    }
+}
+
+/* Intervalo de 'seconds' com as correntes dadas (A RMS), fechado como em loop(): publicado? */
+static bool interval(uint32_t seconds, float current0, float current1)
+{
+    const float lsbAmperes[2] = {acquisition.getLsbMillivolts(0) * ENERGY_DEFAULT_SCALE * 1e-3f,
+                                 acquisition.getLsbMillivolts(1) * ENERGY_DEFAULT_SCALE * 1e-3f};
+    adc0.sources[ADS1115::MUX_0_1 >> 4] = {current0 * sqrtf(2) / lsbAmperes[0], 60.0f, 0};
+    adc0.sources[ADS1115::MUX_2_3 >> 4] = {current1 * sqrtf(2) / lsbAmperes[1], 60.0f, 0};
+
+    /* As janelas com a corrente anterior ficam fora do intervalo */
+    windows(1);
+    for (uint8_t i = 0; i < channelCount; i++)
+        energy[i].calculate(timestamp);
+    windows(2);
+
+    timestamp += seconds;
+    for (uint8_t i = 0; i < channelCount; i++)
+        energy[i].calculate(timestamp);
+    return IOT_report_due();
+}
+
+int main(void)
+{
+    /* O mapa padrão: A0 - A1 e A2 - A3, sem entrada de tensão (potência NAN) */
+    for (uint8_t i = 0; i < channelMap.count; i++)
+        acquisition.addChannel(channelMap.input[i]);
+    channelCount = acquisition.getChannelCount();
+    acquisition.begin();
+    CHECK(channelCount == 2);
+
+    /* Meio-dia local: o fim do dia fica longe */
+    timestamp = 1760022000ul;
+    for (uint8_t i = 0; i < channelCount; i++)
+        energy[i].calculate(timestamp);
+
+    /* Sem referência: o primeiro é publicado */
+    CHECK(interval(60, 5.0f, 0.5f));
+    CHECK(fabsf(iotReportedCurrent[0] - 5.0f) < 0.01f && fabsf(iotReportedCurrent[1] - 0.5f) < 0.01f);
+    printf("measured %.4f A and %.4f A\n", iotReportedCurrent[0], iotReportedCurrent[1]);
+
+    /* Banda relativa (10% de 5 A): dentro e fora */
+    CHECK(!interval(60, 5.0f, 0.5f));
+    CHECK(!interval(60, 5.45f, 0.5f));
+    CHECK(!interval(60, 4.55f, 0.5f));
+    CHECK(interval(60, 5.55f, 0.5f));
+    CHECK(fabsf(iotReportedCurrent[0] - 5.55f) < 0.01f);
+
+    /* Banda absoluta (0,1 A, maior que 10% de 0,5 A): dentro e fora */
+    CHECK(!interval(60, 5.55f, 0.58f));
+    CHECK(interval(60, 5.55f, 0.62f));
+
+    /* Silêncio máximo: publicado exatamente ao atingi-lo */
+    iotReport.maxSilence = 600;
+    uint32_t reported = iotReportTimestamp;
+    CHECK(!interval(540, 5.55f, 0.62f));
+    CHECK(interval(60, 5.55f, 0.62f));
+    CHECK(iotReportTimestamp - reported == 600);
+
+    /* Espaçamento mínimo: a mudança aguarda, e sai exatamente ao completá-lo */
+    iotReport.minSpacing = 120;
+    CHECK(!interval(119, 8.0f, 0.62f));
+    CHECK(interval(1, 8.0f, 0.62f));
+    CHECK(!interval(60, 5.55f, 0.62f));
+    CHECK(interval(60, 5.55f, 0.62f));
+
+    /* Sem banda percentual: apenas a absoluta */
+    iotReport.bandPercent = 0;
+    CHECK(!interval(120, 5.64f, 0.62f));
+    CHECK(interval(120, 5.70f, 0.62f));
+
+    /* O intervalo que fecha o dia local é publicado, mesmo sem mudança */
+    iotReport.maxSilence = 0xFFFF;
+    const int32_t zone = ENERGY_DEFAULT_TIMEZONE * 3600l;
+    uint32_t midnight = ((timestamp + zone) / 86400ul + 1) * 86400ul - zone;
+    CHECK(!interval(midnight - MESSAGE_SAMPLE_RATE - 60 - timestamp, 5.70f, 0.62f));
+    CHECK(interval(60, 5.70f, 0.62f));
+    CHECK(!interval(60, 5.70f, 0.62f));
+
+    printf("%u sent, %u suppressed\n", iotReportsSent, iotReportsSuppressed);
+    CHECK(iotReportsSent == 8 && iotReportsSuppressed == 10);
+
+    return hostResult("test_iot_report");
+}
@@ -0,0 +1,274 @@
+/** @file test_json_reader.cpp
+ *  @brief Streaming JSON reader on the corpus in test/corpus/json: results,
+ *         failing keys and values; deterministic mutations of the corpus
+ *         (built with the address sanitizer); time and memory against the
+ *         former strtok() parse of a 250-byte body buffer.
+ */
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include "host.h"
+#include "JsonReader.h"
+
+/* Destinos e campos como os do sketch (webWifiFields, webEnergyFields) */
+struct Wifi
+{
+    char ssid[33];
+    char password[33];
+};
+
+struct Energy
+{
+    uint16_t dataSize;
+    uint16_t scale;
+    uint8_t windowCycles;
+    float basePrice;
+    float flagPrice;
+    uint8_t channels[1 + 2]; /* Contagem + entradas */
+};
+
+static bool validInput(float value) { return value != 7; }
+
+static const JsonReader::json_field_t wifiFields[] PROGMEM = {
+    {"ssid", JsonReader::JSON_STRING, sizeof(Wifi::ssid), offsetof(Wifi, ssid), 0, 0, NULL},
+    {"password", JsonReader::JSON_STRING, sizeof(Wifi::password), offsetof(Wifi, password), 0, 0, NULL},
+};
+static const JsonReader::json_field_t energyFields[] PROGMEM = {
+    {"dataSize", JsonReader::JSON_UINT, 2, offsetof(Energy, dataSize), 1, 60000, NULL},
+    {"scale", JsonReader::JSON_UINT, 2, offsetof(Energy, scale), 1, 1000, NULL},
+    {"windowCycles", JsonReader::JSON_UINT, 1, offsetof(Energy, windowCycles), 0, 200, NULL},
+    {"basePrice", JsonReader::JSON_FLOAT, 4, offsetof(Energy, basePrice), 0, 100, NULL},
+    {"flagPrice", JsonReader::JSON_FLOAT, 4, offsetof(Energy, flagPrice), 0, 100, NULL},
+    {"channels", JsonReader::JSON_BYTE_ARRAY, 2, offsetof(Energy, channels), 0, 255, validInput},
+};
+
+/* Resultado esperado de cada arquivo; a chave é a que falhou */
+struct Expected
+{
+    const char *file;
+    JsonReader::json_result_t result;
+    const char *errorKey;
+};
+
+static const Expected corpus[] = {
+    {"wifi-basic.json", JsonReader::JSON_DONE, ""},
+    {"wifi-spaces-escapes.json", JsonReader::JSON_DONE, ""},
+    {"wifi-partial.json", JsonReader::JSON_DONE, ""},
+    {"wifi-unknown-nested.json", JsonReader::JSON_DONE, ""},
+    {"wifi-ssid-too-long.json", JsonReader::JSON_ERROR, "ssid"},
+    {"wifi-over-250-bytes.json", JsonReader::JSON_DONE, ""},
+    {"wifi-bad-unicode.json", JsonReader::JSON_ERROR, "ssid"},
+    {"wifi-control-char.json", JsonReader::JSON_ERROR, "ssid"},
+    {"energy-full.json", JsonReader::JSON_DONE, ""},
+    {"energy-scale-zero.json", JsonReader::JSON_ERROR, "scale"},
+    {"energy-datasize-range.json", JsonReader::JSON_ERROR, "dataSize"},
+    {"energy-datasize-fraction.json", JsonReader::JSON_ERROR, "dataSize"},
+    {"energy-bad-number.json", JsonReader::JSON_ERROR, "dataSize"},
+    {"energy-channels-empty.json", JsonReader::JSON_DONE, ""},
+    {"energy-channels-too-many.json", JsonReader::JSON_ERROR, "channels"},
+    {"energy-string-for-number.json", JsonReader::JSON_ERROR, "windowCycles"},
+    {"syntax-trailing-comma.json", JsonReader::JSON_ERROR, "ssid"}, /* Última chave lida */
+    {"syntax-not-object.json", JsonReader::JSON_ERROR, ""},
+    {"syntax-missing-colon.json", JsonReader::JSON_ERROR, "ssid"},
+    {"syntax-truncated.json", JsonReader::JSON_PARTIAL, ""},
+    {"syntax-empty-object.json", JsonReader::JSON_DONE, ""},
+    {"syntax-after-object.json", JsonReader::JSON_DONE, ""},
+};
+#define CORPUS_SIZE (sizeof(corpus) / sizeof(corpus[0]))
+
+static std::string load(const char *file)
+{
+    std::ifstream stream(std::string("corpus/json/") + file, std::ios::binary);
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+static bool isWifi(const char *file) { return file[0] != 'e'; }
+
+/* Lê o corpo inteiro, como os bytes de "+IPD" chegam */
+static JsonReader read(const std::string &body, bool wifi, Wifi *ap, Energy *energy)
+{
+    JsonReader reader = wifi ? JsonReader(wifiFields, 2, ap) : JsonReader(energyFields, 6, energy);
+    for (size_t i = 0; i < body.size() && reader.getResult() == JsonReader::JSON_PARTIAL; i++)
+        reader.feed(body[i]);
+    return reader;
+}
+
+/* Caminho até a versão 1: o corpo em strBuffer[250], "ssid"/"password" por strtok() */
+static void formerParse(const std::string &body, Wifi *ap)
+{
+    char strBuffer[250];
+    strncpy(strBuffer, body.c_str(), sizeof(strBuffer) - 1);
+    strBuffer[sizeof(strBuffer) - 1] = '\0';
+    if (strBuffer[0] != '{')
+        return;
+
+    char *tkn = strBuffer + 1;
+    while ((tkn = strtok(tkn, "\"")) != NULL)
+    {
+        char *field = NULL;
+        if (!strcmp(tkn, "ssid"))
+            field = ap->ssid;
+        else if (!strcmp(tkn, "password"))
+            field = ap->password;
+        if (field != NULL)
+        {
+            strtok(NULL, "\"");
+            tkn = strtok(NULL, "\"");
+            if (tkn != NULL)
+            {
+                strncpy(field, tkn, sizeof(ap->ssid) - 1);
+                field[sizeof(ap->ssid) - 1] = '\0';
+            }
+        }
+        tkn = NULL;
+    }
+}
+
+/* Invariantes de um corpo aceito: strings terminadas, números na faixa */
+static void checkAccepted(bool wifi, const Wifi &ap, const Energy &energy)
+{
+    if (wifi)
+    {
+        CHECK(memchr(ap.ssid, '\0', sizeof(ap.ssid)) != NULL);
+        CHECK(memchr(ap.password, '\0', sizeof(ap.password)) != NULL);
+        return;
+    }
+    CHECK(energy.dataSize >= 1 && energy.dataSize <= 60000);
+    CHECK(energy.scale >= 1 && energy.scale <= 1000);
+    CHECK(energy.windowCycles <= 200);
+    CHECK(energy.basePrice >= 0 && energy.basePrice <= 100);
+    CHECK(energy.flagPrice >= 0 && energy.flagPrice <= 100);
+    CHECK(energy.channels[0] <= 2);
+    for (uint8_t i = 0; i < energy.channels[0]; i++)
+        CHECK(energy.channels[1 + i] != 7);
+}
+
+static uint32_t xorshift(void)
+{
+    static uint32_t state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+int main(void)
+{
+    static const Wifi defaultAp = {"old", "oldpass"};
+    static const Energy defaultEnergy = {500, 50, 0, 0.5f, 0.1f, {0, 0, 0}};
+
+    /* Corpus: resultado e chave que falhou */
+    std::vector<std::string> bodies;
+    for (uint8_t i = 0; i < CORPUS_SIZE; i++)
+    {
+        bodies.push_back(load(corpus[i].file));
+        CHECK(!bodies[i].empty());
+        Wifi ap = defaultAp;
+        Energy energy = defaultEnergy;
+        JsonReader reader = read(bodies[i], isWifi(corpus[i].file), &ap, &energy);
+        if (reader.getResult() != corpus[i].result ||
+            (corpus[i].result == JsonReader::JSON_ERROR && strcmp(reader.getErrorKey(), corpus[i].errorKey)))
+            printf("%s: result %d, key \"%s\"\n", corpus[i].file, reader.getResult(), reader.getErrorKey());
+        CHECK(reader.getResult() == corpus[i].result);
+        if (corpus[i].result == JsonReader::JSON_ERROR)
+            CHECK(!strcmp(reader.getErrorKey(), corpus[i].errorKey));
+        if (reader.getResult() == JsonReader::JSON_DONE)
+            checkAccepted(isWifi(corpus[i].file), ap, energy);
+    }
+
+    /* Valores: escapes, campos ausentes mantidos, arrays e floats */
+    Wifi ap = defaultAp;
+    Energy energy = defaultEnergy;
+    read(load("wifi-spaces-escapes.json"), true, &ap, &energy);
+    CHECK(!strcmp(ap.password, "p\"w\\d/x") && !strcmp(ap.ssid, "café A"));
+    ap = defaultAp;
+    JsonReader partial = read(load("wifi-partial.json"), true, &ap, &energy);
+    CHECK(!strcmp(ap.ssid, "only") && !strcmp(ap.password, "oldpass"));
+    CHECK(partial.isSet(0) && !partial.isSet(1));
+    ap = defaultAp;
+    read(load("wifi-over-250-bytes.json"), true, &ap, &energy);
+    CHECK(!strcmp(ap.ssid, "after-padding") && !strcmp(ap.password, "p"));
+    read(load("energy-full.json"), false, &ap, &energy);
+    CHECK(energy.dataSize == 500 && energy.scale == 50 && energy.windowCycles == 6);
+    CHECK(energy.basePrice == 0.75f && energy.flagPrice == 0.01f);
+    CHECK(energy.channels[0] == 2 && energy.channels[1] == 0 && energy.channels[2] == 9);
+
+    /* O caminho anterior: corpo cortado em 250 bytes, escapes quebram a string */
+    Wifi former = defaultAp;
+    formerParse(load("wifi-over-250-bytes.json"), &former);
+    CHECK(!strcmp(former.ssid, "old"));
+    former = defaultAp;
+    formerParse(load("wifi-spaces-escapes.json"), &former);
+    CHECK(strcmp(former.password, "p\"w\\d/x") != 0);
+
+    /* Mutações do corpus: troca, inserção, remoção e corte de bytes */
+    static const char alphabet[] = "{}[]\":,\\u0123456789.-+eEtrufalsn ";
+    uint32_t accepted = 0, failed = 0, partials = 0;
+    for (uint32_t iteration = 0; iteration < 50000; iteration++)
+    {
+        uint8_t index = xorshift() % CORPUS_SIZE;
+        std::string body = bodies[index];
+        for (uint8_t edits = 1 + xorshift() % 4; edits > 0 && !body.empty(); edits--)
+        {
+            size_t at = xorshift() % body.size();
+            char character = (xorshift() & 1) ? alphabet[xorshift() % (sizeof(alphabet) - 1)] : (char)xorshift();
+            switch (xorshift() % 4)
+            {
+            case 0:
+                body[at] = character;
+                break;
+            case 1:
+                body.insert(body.begin() + at, character);
+                break;
+            case 2:
+                body.erase(at, 1);
+                break;
+            default:
+                body.resize(at);
+                break;
+            }
+        }
+
+        bool wifi = isWifi(corpus[index].file);
+        ap = defaultAp;
+        energy = defaultEnergy;
+        JsonReader reader = read(body, wifi, &ap, &energy);
+        JsonReader::json_result_t result = reader.getResult();
+        if (result == JsonReader::JSON_DONE)
+        {
+            accepted++;
+            checkAccepted(wifi, ap, energy);
+        }
+        else if (result == JsonReader::JSON_ERROR)
+        {
+            failed++;
+            CHECK(memchr(reader.getErrorKey(), '\0', JSON_READER_KEY_SIZE) != NULL);
+            CHECK(reader.feed('}') == JsonReader::JSON_ERROR); /* Erro é final */
+        }
+        else
+            partials++;
+    }
+    printf("mutations: %u accepted, %u rejected, %u incomplete\n", accepted, failed, partials);
+    CHECK(accepted > 0 && failed > 0 && partials > 0);
+
+    /* Tempo no host e memória: o leitor inteiro contra o buffer do corpo */
+    const std::string &body = bodies[0];
+    uint32_t rounds = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rounds; i++)
+        read(body, true, &ap, &energy);
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rounds; i++)
+        formerParse(body, &former);
+    auto end = std::chrono::steady_clock::now();
+    double readerNs = std::chrono::duration<double, std::nano>(middle - start).count() / rounds / body.size();
+    double formerNs = std::chrono::duration<double, std::nano>(end - middle).count() / rounds / body.size();
+    printf("wifi-basic.json (%zu bytes), host: reader %.1f ns/byte, former %.1f ns/byte\n", body.size(), readerNs, formerNs);
+    printf("state: JsonReader %zu bytes (host), former strBuffer 250 bytes\n", sizeof(JsonReader));
+
+    return hostResult("test_json_reader");
+}
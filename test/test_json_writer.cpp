@@ -0,0 +1,129 @@
+/** @file test_json_writer.cpp
+ *  @brief JSON body split in parts of a few hundred bytes, as the sketch
+ *         sends it: the chunks concatenate into the whole body, each part
+ *         stays within its limit, and values that change between parts
+ *         keep the document valid.
+ */
+#include <string>
+
+#include "host.h"
+#include "JsonWriter.h"
+
+class StringPrint : public Print
+{
+public:
+    size_t write(uint8_t data)
+    {
+        this->text += (char)data;
+        return 1;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+static const char *const paths[] = {"current", "energy", "cost"};
+static uint32_t generation = 0; /* Muda os valores a cada parte, como a medição entre dois loop() */
+
+/* Um lote como o de IOT_write_body(): 5 intervalos, 3 medidas, 2 canais */
+static void writeBody(JsonWriter &json, const void *)
+{
+    json.beginObject();
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        for (uint8_t m = 0; m < 3; m++)
+        {
+            json.beginKey();
+            json.raw().print(F("measures/"));
+            json.raw().print(paths[m]);
+            json.raw().print('/');
+            json.raw().print(1760000000ul + 60ul * i);
+            json.endKey();
+            json.beginObject();
+            json.key(F("channels"));
+            json.beginArray();
+            for (uint8_t c = 0; c < 2; c++)
+                json.value(1.5f * (i + m + c) + generation * 1000.0f, 5);
+            json.endArray();
+            json.member(F("seqNumber"), 1000ul + i);
+            json.member(F("device"), F("meter-0001"));
+            json.endObject();
+        }
+    }
+    json.endObject();
+}
+
+/* Conteúdo de um chunk "<tamanho>\r\n<dados>\r\n"; vazio se mal formado */
+static std::string unchunk(const std::string &chunk)
+{
+    size_t line = chunk.find("\r\n");
+    if (line == std::string::npos)
+        return "";
+    size_t size = strtoul(chunk.substr(0, line).c_str(), NULL, 16);
+    if (chunk.size() != line + 2 + size + 2 || chunk.compare(line + 2 + size, 2, "\r\n") != 0)
+        return "";
+    return chunk.substr(line + 2, size);
+}
+
+static std::string withoutDigits(std::string text)
+{
+    std::string result;
+    for (char c : text)
+        if ((c < '0' || c > '9') && c != '.')
+            result += c;
+    return result;
+}
+
+int main(void)
+{
+    StringPrint whole;
+    JsonWriter::writeChunk(whole, writeBody, NULL);
+    std::string body = unchunk(whole.text);
+    CHECK(body.size() > 1000 && body[0] == '{' && body[body.size() - 1] == '}');
+
+    /* Partes de 230 bytes (a folga do anel do ADS1115 a 115200): o mesmo corpo */
+    std::string joined;
+    size_t largest = 0;
+    uint8_t parts = 0;
+    uint16_t unit = 0;
+    bool complete = false;
+    while (!complete && parts < 100)
+    {
+        StringPrint part;
+        complete = JsonWriter::writeChunk(part, writeBody, NULL, &unit, 230);
+        std::string content = unchunk(part.text);
+        CHECK(!content.empty());
+        joined += content;
+        if (content.size() > largest)
+            largest = content.size();
+        parts++;
+    }
+    CHECK(complete && unit == JSON_WRITER_END);
+    CHECK(joined == body);
+    CHECK(parts >= body.size() / 230 && largest <= 230);
+    printf("%u bytes in %u parts, largest %u\n", (unsigned)body.size(), parts, (unsigned)largest);
+
+    /* Valores que mudam entre as partes: cada um inteiro numa parte, a estrutura intacta */
+    joined.clear();
+    unit = 0;
+    complete = false;
+    for (parts = 0; !complete && parts < 100; parts++, generation++)
+    {
+        StringPrint part;
+        complete = JsonWriter::writeChunk(part, writeBody, NULL, &unit, 230);
+        joined += unchunk(part.text);
+    }
+    CHECK(complete && joined != body);
+    CHECK(withoutDigits(joined) == withoutDigits(body));
+
+    /* Unidade maior que o limite: segue sozinha, e o corpo ainda avança */
+    unit = 0;
+    StringPrint first;
+    CHECK(!JsonWriter::writeChunk(first, writeBody, NULL, &unit, 1));
+    CHECK(unchunk(first.text) == "{" && unit != 0);
+    StringPrint second;
+    JsonWriter::writeChunk(second, writeBody, NULL, &unit, 1);
+    CHECK(unchunk(second.text).compare(0, 12, "\"measures/cu") == 0);
+
+    return hostResult("test_json_writer");
+}
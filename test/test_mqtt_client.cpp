@@ -0,0 +1,232 @@
+/** @file test_mqtt_client.cpp
+ *  @brief MQTT packets and reply parser, the binary CIPSEND path through the
+ *         scripted modem, and the bytes of one batch as PUBLISH packets
+ *         against the same batch as the Firebase PATCH.
+ */
+#include "FakeModem.h"
+#include "ESP8266.h"
+#include "JsonWriter.h"
+#include "MqttClient.h"
+
+void serial_flush(void) {}
+bool serial_get(const __FlashStringHelper *, uint32_t, char *, uint16_t) { return false; }
+
+static FakeModem modem;
+static ESP8266 esp(ESP_ENABLE_PIN, modem);
+
+/* Lote do Energy_meter.ino: 5 intervalos x 2 canais, corrente, energia e custo */
+#define INTERVALS (5u)
+#define CHANNELS (2u)
+#define MEASURES (3u)
+static const char *const paths[MEASURES] = {"current", "energy", "cost"};
+static const uint8_t types[MEASURES] = {0x50, 0x70, 0x80};
+static const char device[] = "meter-0001";
+static const char auth[] = "0123456789abcdefghijklmnopqrstuvwxyzABCD"; /* Segredo do Firebase: 40 caracteres */
+
+static float value(uint8_t interval, uint8_t measure, uint8_t channel)
+{
+    return 3.21f * (measure + 1) + 0.1f * interval + channel;
+}
+
+class StringPrint : public Print
+{
+public:
+    size_t write(uint8_t data)
+    {
+        this->text += (char)data;
+        return 1;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+/* Executa a fila até o resultado, com o relógio andando 1ms por passo */
+static ESP8266::esp_status_t run(ESP8266::esp_future_t *future)
+{
+    for (uint16_t i = 0; i < 5000 && future->isPending(); i++)
+    {
+        hostAdvance(1000);
+        esp.poll();
+    }
+    return future->status;
+}
+
+/* Publicação de um canal em um intervalo, como MQTT_write_topic()/MQTT_write_payload() */
+struct Publish
+{
+    uint8_t interval;
+    uint8_t channel;
+};
+
+static void writeTopic(Print &out, const void *context)
+{
+    out.print(F("em/"));
+    out.print(device);
+    out.print('/');
+    out.print(((const Publish *)context)->channel);
+}
+
+static void writePayload(Print &out, const void *context)
+{
+    const Publish *publish = (const Publish *)context;
+    JsonWriter json(out);
+    json.beginObject();
+    json.member(F("seqNumber"), 1000ul + publish->interval);
+    json.member(F("timestamp"), 1760000000ul + 60ul * publish->interval);
+    for (uint8_t m = 0; m < MEASURES; m++)
+    {
+        json.beginKey();
+        json.raw().print(paths[m]);
+        json.endKey();
+        json.value(value(publish->interval, m, publish->channel), 5);
+    }
+    json.endObject();
+}
+
+static void writePackets(Print &out)
+{
+    for (uint8_t i = 0; i < INTERVALS; i++)
+    {
+        for (uint8_t c = 0; c < CHANNELS; c++)
+        {
+            Publish publish = {i, c};
+            MqttClient::writePublish(out, writeTopic, writePayload, &publish, 1, 1 + i * CHANNELS + c);
+        }
+    }
+}
+
+static void writeConnect(Stream &serial, const void *)
+{
+    MqttClient::writeConnect(serial, device, "meter", "secret", 300);
+}
+
+static void writeBatch(Stream &serial, const void *)
+{
+    writePackets(serial);
+}
+
+/* O mesmo lote como o PATCH de vários caminhos (IOT_write_PATCH()/IOT_write_body()) */
+static void writeBody(JsonWriter &json, const void *)
+{
+    json.beginObject();
+    for (uint8_t i = 0; i < INTERVALS; i++)
+    {
+        for (uint8_t m = 0; m < MEASURES; m++)
+        {
+            json.beginKey();
+            json.raw().print(F("measures/"));
+            json.raw().print(paths[m]);
+            json.raw().print('/');
+            json.raw().print(1760000000ul + 60ul * i);
+            json.endKey();
+            json.beginObject();
+            json.member(F("value"), value(i, m, 0) + value(i, m, 1), 5);
+            json.key(F("channels"));
+            json.beginArray();
+            for (uint8_t c = 0; c < CHANNELS; c++)
+                json.value(value(i, m, c), 5);
+            json.endArray();
+            json.member(F("type"), types[m]);
+            json.member(F("seqNumber"), 1000ul + i);
+            json.member(F("timestamp"), 1760000000ul + 60ul * i);
+            json.member(F("device"), device);
+            json.endObject();
+        }
+    }
+    json.endObject();
+}
+
+static void writePatch(Print &serial)
+{
+    serial.print(F("PATCH /users/meter.json?auth="));
+    serial.print(auth);
+    serial.print(F(" HTTP/1.1\r\nHost: example.firebaseio.com\r\nConnection: keep-alive\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    JsonWriter::writeChunk(serial, writeBody, NULL);
+    serial.write("0\r\n\r\n");
+}
+
+int main(void)
+{
+    /* CONNECT: sessão limpa, usuário e senha, keep alive */
+    StringPrint connect;
+    MqttClient::writeConnect(connect, device, "meter", "secret", 300);
+    const std::string header("\x10\x25\x00\x04MQTT\x04\xC2\x01\x2C\x00\x0Ameter-0001", 22);
+    CHECK(connect.text.size() == 39 && connect.text.compare(0, header.size(), header) == 0);
+
+    /* PUBLISH QoS 1: tamanho restante em dois bytes acima de 127 */
+    StringPrint packets;
+    writePackets(packets);
+    CHECK((uint8_t)packets.text[0] == (MQTT_PUBLISH | 0x02));
+    uint32_t length = (uint8_t)packets.text[1];
+    CHECK(length < 128 && packets.text.size() > 2 + length);
+    CHECK(packets.text.compare(2, 2, std::string("\x00\x0F", 2)) == 0 && packets.text.compare(4, 15, "em/meter-0001/0") == 0);
+    CHECK(packets.text.compare(19, 2, std::string("\x00\x01", 2)) == 0 && packets.text[21] == '{');
+    StringPrint large;
+    static const std::string longTopic = "em/" + std::string(150, 'x'); /* 150 + 3 + 2 + 2 = 157 bytes restantes */
+    MqttClient::writePublish(large, [](Print &out, const void *) { out.print(longTopic.c_str()); },
+                             [](Print &out, const void *) { out.print(F("{}")); }, NULL, 0, 0);
+    CHECK(large.text.size() == 3 + 157);
+    CHECK((uint8_t)large.text[1] == ((157 & 0x7F) | 0x80) && large.text[2] == 1);
+
+    /* Respostas em pedaços: CONNACK, PUBACK com o identificador e PINGRESP */
+    MqttClient parser;
+    const uint8_t replies[] = {0x20, 0x02, 0x00, 0x00, 0x40, 0x02, 0x01, 0x2C, 0xD0, 0x00};
+    CHECK(parser.feed(replies[0]) == 0 && parser.feed(replies[1]) == 0 && parser.feed(replies[2]) == 0);
+    CHECK(parser.feed(replies[3]) == MQTT_CONNACK && parser.getReturnCode() == MQTT_CONNACK_ACCEPTED);
+    for (uint8_t i = 4; i < 7; i++)
+        CHECK(parser.feed(replies[i]) == 0);
+    CHECK(parser.feed(replies[7]) == MQTT_PUBACK && parser.getPacketId() == 300);
+    CHECK(parser.feed(replies[8]) == 0 && parser.feed(replies[9]) == MQTT_PINGRESP);
+
+    /* Pela fila do ESP8266: CIPSEND binário com NULs, CONNACK e PUBACKs em "+IPD" */
+    ESP8266::esp_future_t future;
+    static ESP8266::esp_URL_parameter_t url = {"broker.local", "secret", "meter"};
+    modem.expect("AT+CIPSTART=4,\"SSL\",\"broker.local\",8883\r\n", "4,CONNECT\r\n\r\nOK\r\n");
+    CHECK(esp.connect(url, 8883, true, &future) && run(&future) == ESP8266::ESP_DONE);
+
+    modem.expect("AT+CIPSEND=4,39\r\n", "\r\nOK\r\n> ");
+    modem.expect(connect.text, "\r\nRecv 39 bytes\r\n\r\nSEND OK\r\n" + std::string("+IPD,4,4:\x20\x02\x00\x00", 13));
+    CHECK(esp.send(ESP_CLIENT_LINK, connect.text.size(), writeConnect, NULL, &future));
+    CHECK(run(&future) == ESP8266::ESP_DONE);
+    CHECK(modem.all.find(connect.text) != std::string::npos && modem.all.find("\\0") == std::string::npos);
+
+    size_t start = modem.all.size();
+    std::string pubacks;
+    for (uint8_t id = 1; id <= INTERVALS * CHANNELS; id++)
+        pubacks += std::string("\x40\x02\x00", 3) + (char)id;
+    std::string command = "AT+CIPSEND=4," + std::to_string(packets.text.size()) + "\r\n";
+    modem.expect(command, "\r\nOK\r\n> ");
+    modem.expect(packets.text, "\r\nRecv " + std::to_string(packets.text.size()) + " bytes\r\n\r\nSEND OK\r\n+IPD,4," +
+                                   std::to_string(pubacks.size()) + ":" + pubacks, 20000);
+    CHECK(esp.send(ESP_CLIENT_LINK, packets.text.size(), writeBatch, NULL, &future) && run(&future) == ESP8266::ESP_DONE);
+    size_t mqttUart = modem.all.size() - start;
+    uint8_t connacks = 0, acks = 0;
+    for (uint8_t i = 0; i < 100; i++)
+    {
+        hostAdvance(1000);
+        esp.poll();
+        for (int16_t c; (c = esp.receive(ESP_CLIENT_LINK)) >= 0;)
+        {
+            uint8_t type = parser.feed(c);
+            connacks += (type == MQTT_CONNACK);
+            acks += (type == MQTT_PUBACK);
+        }
+    }
+    CHECK(connacks == 1 && acks == INTERVALS * CHANNELS);
+
+    /* Custo do lote: bytes na conexão (antes do TLS) e na UART, com os comandos AT */
+    PrintCounter patch;
+    writePatch(patch);
+    size_t sends = (patch.count + 229) / 230; /* Partes de UART_send_size() a 115200, cada uma com o seu chunk */
+    size_t patchUart = sends * (strlen("AT+CIPSENDEX=4,2047\r\n") + strlen("\\0")) + patch.count;
+    const uint8_t readings = INTERVALS * CHANNELS;
+    printf("batch of %u intervals x %u channels: PATCH %zu B (%.1f B/reading), PUBLISH %zu B (%.1f B/reading)\n",
+           INTERVALS, CHANNELS, patch.count, (double)patch.count / readings, packets.text.size(),
+           (double)packets.text.size() / readings);
+    printf("UART with AT commands: PATCH %zu B in %zu CIPSENDEX = %.1f ms, PUBLISH %zu B = %.1f ms at 115200\n", patchUart,
+           sends, patchUart * 10 / 115.2, mqttUart, mqttUart * 10 / 115.2);
+    CHECK(packets.text.size() < patch.count / 2);
+
+    return hostResult("test_mqtt_client");
+}
@@ -0,0 +1,166 @@
+/** @file test_packed_record.cpp
+ *  @brief Packed record: layout and base64 round trip, and its bytes per
+ *         interval against the JSON entries of the same multi-path PATCH.
+ */
+#include <string>
+
+#include "host.h"
+#include "JsonWriter.h"
+#include "PackedRecord.h"
+
+/* Tipos MEASURE_* de Energy_meter.ino: corrente, energia, custo e THD */
+static const uint8_t types[] = {0x50, 0x70, 0x80, 0x90};
+static const char *const paths[] = {"current", "energy", "cost", "thd"};
+static const float values[] = {3.21f, 12.34567f, 10.2f, 4.5f};
+static const char device[] = "meter-0001";
+
+class StringPrint : public Print
+{
+public:
+    size_t write(uint8_t data)
+    {
+        this->text += (char)data;
+        return 1;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+static std::string decode(const std::string &text)
+{
+    static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string data;
+    uint32_t bits = 0;
+    uint8_t count = 0;
+    for (char character : text)
+    {
+        if (character == '=')
+            break;
+        bits = (bits << 6) | alphabet.find(character);
+        if (++count == 4)
+        {
+            data += (char)(bits >> 16);
+            data += (char)(bits >> 8);
+            data += (char)bits;
+            bits = count = 0;
+        }
+    }
+    if (count == 3)
+    {
+        data += (char)(bits >> 10);
+        data += (char)(bits >> 2);
+    }
+    else if (count == 2)
+        data += (char)(bits >> 4);
+    return data;
+}
+
+static uint32_t get32(const std::string &data, size_t offset)
+{
+    return (uint8_t)data[offset] | (uint8_t)data[offset + 1] << 8 | (uint8_t)data[offset + 2] << 16 | (uint32_t)(uint8_t)data[offset + 3] << 24;
+}
+
+/* Um intervalo como IOT_write_body(): uma entrada por medida, ou um registro */
+static void interval(JsonWriter &json, bool packed, uint8_t measures, uint8_t channels)
+{
+    const uint32_t seqNumber = 1234, timestamp = 1760000000ul;
+    if (packed)
+    {
+        json.beginKey();
+        json.raw().print(F("measures/packed/"));
+        json.raw().print(device);
+        json.raw().print('/');
+        json.raw().print(timestamp);
+        json.endKey();
+        json.beginString();
+        PackedRecord record(json.raw());
+        record.begin(seqNumber, timestamp, measures, channels);
+        for (uint8_t m = 0; m < measures; m++)
+            record.addType(types[m]);
+        for (uint8_t v = 0; v < measures * channels; v++)
+            record.addValue(values[v / channels] + v % channels);
+        record.end();
+        json.endString();
+        return;
+    }
+    for (uint8_t m = 0; m < measures; m++)
+    {
+        json.beginKey();
+        json.raw().print(F("measures/"));
+        json.raw().print(paths[m]);
+        json.raw().print('/');
+        json.raw().print(timestamp);
+        json.endKey();
+        json.beginObject();
+        if (m < 3) /* THD não é aditiva */
+            json.member(F("value"), values[m] * channels, 5);
+        json.key(F("channels"));
+        json.beginArray();
+        for (uint8_t c = 0; c < channels; c++)
+            json.value(values[m] + c, 5);
+        json.endArray();
+        json.member(F("type"), types[m]);
+        json.member(F("seqNumber"), seqNumber);
+        json.member(F("timestamp"), timestamp);
+        json.member(F("device"), device);
+        json.endObject();
+    }
+}
+
+/* Bytes de um intervalo no corpo, com a vírgula que o separa do anterior */
+static size_t intervalBytes(bool packed, uint8_t measures, uint8_t channels)
+{
+    PrintCounter one, two;
+    JsonWriter first(one), second(two);
+    first.beginObject();
+    interval(first, packed, measures, channels);
+    second.beginObject();
+    interval(second, packed, measures, channels);
+    interval(second, packed, measures, channels);
+    return two.count - one.count;
+}
+
+int main(void)
+{
+    /* Registro de 3 medidas x 2 canais: 11 + 3 + 24 = 38 bytes, 52 caracteres */
+    StringPrint out;
+    PackedRecord record(out);
+    record.begin(1234, 1760000000ul, 3, 2);
+    for (uint8_t m = 0; m < 3; m++)
+        record.addType(types[m]);
+    for (uint8_t v = 0; v < 6; v++)
+        record.addValue(values[v / 2] + v % 2);
+    CHECK(record.end() == PACKED_RECORD_BASE64_SIZE(PACKED_RECORD_SIZE(3, 2)));
+    CHECK(out.text.size() == 52);
+
+    std::string data = decode(out.text);
+    CHECK(data.size() == PACKED_RECORD_SIZE(3, 2));
+    CHECK(data[0] == PACKED_RECORD_VERSION && data[1] == 3 && data[2] == 2);
+    CHECK(get32(data, 3) == 1234 && get32(data, 7) == 1760000000ul);
+    CHECK((uint8_t)data[11] == 0x50 && (uint8_t)data[12] == 0x70 && (uint8_t)data[13] == 0x80);
+    for (uint8_t v = 0; v < 6; v++)
+    {
+        uint32_t bits = get32(data, PACKED_RECORD_HEADER_SIZE + 3 + 4 * v);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        CHECK(value == values[v / 2] + v % 2);
+    }
+
+    /* Custo por intervalo no corpo do PATCH, e o tempo na UART (10 bits por byte) */
+    for (uint8_t measures = 3; measures <= 4; measures++)
+    {
+        for (uint8_t channels = 1; channels <= 4; channels++)
+        {
+            size_t json = intervalBytes(false, measures, channels);
+            size_t packed = intervalBytes(true, measures, channels);
+            printf("%u measures x %u channels: json %zu B, packed %zu B (%.0f%%); "
+                   "%.1f -> %.1f ms at 115200, %u -> %u intervals per 2047 B CIPSEND\n",
+                   measures, channels, json, packed, 100.0 * packed / json,
+                   json * 10 / 115.2, packed * 10 / 115.2, (unsigned)(2047 / json), (unsigned)(2047 / packed));
+            CHECK(packed < json / 3);
+        }
+    }
+
+    return hostResult("test_packed_record");
+}
@@ -0,0 +1,140 @@
+/** @file test_response_matcher.cpp
+ *  @brief Multi-pattern matcher: overlapping prefixes, early failures, and
+ *         the time to a result against the former single-pattern serial_get()
+ *         on ESP8266 transcripts.
+ */
+#include "host.h"
+#include "ResponseMatcher.h"
+#include "ESP8266.h"
+
+#define BYTE_MICROS (174ul) /* 10 bits a 57600 baud */
+
+/* Resposta do módulo: latência até o primeiro byte, então bytes contínuos */
+struct Transcript
+{
+    const char *name;
+    const __FlashStringHelper *expect;
+    uint32_t timeoutMillis;
+    uint32_t latencyMillis;
+    const char *bytes;
+    bool closedFails; /* ESP_FAIL_CLOSED: conexão que o servidor pode encerrar */
+};
+
+static const Transcript transcripts[] = {
+    {"CWJAP ok", ESP_OK_RESPONSE, ESP_LONG_DELAY, 4200, "WIFI DISCONNECT\r\nWIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n", false},
+    {"CWJAP wrong password", ESP_OK_RESPONSE, ESP_LONG_DELAY, 5100, "+CWJAP:1\r\n\r\nFAIL\r\n", false},
+    {"CIPSTART ok", F("CONNECT\r\n"), ESP_LONG_DELAY, 850, "4,CONNECT\r\n\r\nOK\r\n", false},
+    {"CIPSTART refused", F("CONNECT\r\n"), ESP_LONG_DELAY, 1020, "ERROR\r\n4,CLOSED\r\n", false},
+    {"CIPSTART busy", F("CONNECT\r\n"), ESP_LONG_DELAY, 8, "busy p...\r\n", false},
+    {"CIPSEND prompt", F(">"), ESP_SHORT_DELAY, 3, "\r\nOK\r\n> ", false},
+    {"SEND OK, repeated prefix", F("SEND OK\r\n"), ESP_MEDIUM_DELAY, 40, "\r\nRecv 20 bytes\r\n\r\nSEND SEND OK\r\n", false},
+    {"CIPCLOSE closed link", F("CLOSED\r\n"), ESP_SHORT_DELAY, 2, "UNLINK\r\n\r\nERROR\r\n", false},
+    {"timestamp, server closed", F("+IPD,3,4:"), ESP_LONG_DELAY, 300, "3,CONNECT\r\n\r\nOK\r\n3,CLOSED\r\n", true},
+};
+
+/* serial_get() até a versão 1: um padrão, recomeça do início a cada divergência */
+static uint32_t formerMillis(const Transcript &t, bool *matched)
+{
+    const char *expect = (const char *)t.expect;
+    uint16_t position = 0;
+    for (uint16_t i = 0; t.bytes[i] != '\0'; i++)
+    {
+        if (t.bytes[i] == expect[position])
+        {
+            if (expect[++position] == '\0')
+            {
+                *matched = true;
+                return t.latencyMillis + (i + 1) * BYTE_MICROS / 1000;
+            }
+        }
+        else
+        {
+            position = 0;
+        }
+    }
+    *matched = false;
+    return t.timeoutMillis;
+}
+
+/* Mesmo conjunto de padrões de um comando da fila do ESP8266 */
+static uint32_t matcherMillis(const Transcript &t, uint8_t *pattern)
+{
+    ResponseMatcher matcher;
+    matcher.add(t.expect);
+    matcher.add(ESP_ERROR_RESPONSE);
+    matcher.add(ESP_FAIL_RESPONSE);
+    matcher.add(ESP_BUSY_RESPONSE);
+    if (t.closedFails)
+        matcher.add(ESP_CLOSED_RESPONSE);
+    for (uint16_t i = 0; t.bytes[i] != '\0'; i++)
+    {
+        *pattern = matcher.feed(t.bytes[i]);
+        if (*pattern != RESPONSE_MATCHER_NONE)
+            return t.latencyMillis + (i + 1) * BYTE_MICROS / 1000;
+    }
+    *pattern = RESPONSE_MATCHER_NONE;
+    return t.timeoutMillis;
+}
+
+static uint8_t feed(ResponseMatcher &matcher, const char *text)
+{
+    uint8_t matched = RESPONSE_MATCHER_NONE;
+    for (; *text != '\0' && matched == RESPONSE_MATCHER_NONE; text++)
+        matched = matcher.feed(*text);
+    return matched;
+}
+
+int main(void)
+{
+    /* Bordas: a divergência recua para o maior prefixo já lido */
+    ResponseMatcher matcher;
+    CHECK(matcher.add(F("SEND OK")) == 0);
+    CHECK(matcher.add(F("OK")) == 1);
+    CHECK(feed(matcher, "SEND SEND OK") == 0);
+    matcher.reset();
+    CHECK(feed(matcher, "OOK") == 1);
+    matcher.clear();
+    CHECK(matcher.add(F("abab")) == 0);
+    CHECK(feed(matcher, "aababab") == 0);
+    CHECK(feed(matcher, "ab") == RESPONSE_MATCHER_NONE); /* Recomeça do zero após a ocorrência */
+    CHECK(feed(matcher, "ab") == 0);
+    matcher.reset();
+    CHECK(feed(matcher, "aba") == RESPONSE_MATCHER_NONE);
+
+    /* Limites do conjunto */
+    matcher.clear();
+    CHECK(matcher.add(F("")) == RESPONSE_MATCHER_NONE);
+    for (uint8_t i = 0; i < RESPONSE_MATCHER_MAX_PATTERNS; i++)
+        CHECK(matcher.add(F("x")) == i);
+    CHECK(matcher.add(F("y")) == RESPONSE_MATCHER_NONE);
+
+    /* Tempo até o resultado, a 57600 baud */
+    uint32_t formerTotal = 0, matcherTotal = 0;
+    printf("%-26s %10s %10s  result\n", "transcript", "former ms", "matcher ms");
+    for (uint8_t i = 0; i < sizeof(transcripts) / sizeof(transcripts[0]); i++)
+    {
+        const Transcript &t = transcripts[i];
+        bool matched;
+        uint8_t pattern;
+        uint32_t former = formerMillis(t, &matched);
+        uint32_t current = matcherMillis(t, &pattern);
+        formerTotal += former;
+        matcherTotal += current;
+        printf("%-26s %10lu %10lu  %s\n", t.name, (unsigned long)former, (unsigned long)current,
+               pattern == 0 ? "expected" : pattern == RESPONSE_MATCHER_NONE ? "timeout" : "failure");
+
+        /* Nunca mais lento; falhas em milissegundos, não no timeout */
+        CHECK(current <= former);
+        CHECK(pattern != RESPONSE_MATCHER_NONE);
+        if (pattern != 0)
+            CHECK(current < t.latencyMillis + 10);
+    }
+    printf("%-26s %10lu %10lu\n", "total", (unsigned long)formerTotal, (unsigned long)matcherTotal);
+
+    /* A sobreposição "SEND SEND OK" passava despercebida */
+    bool matched;
+    formerMillis(transcripts[6], &matched);
+    CHECK(!matched);
+
+    return hostResult("test_response_matcher");
+}
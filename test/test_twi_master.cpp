@@ -0,0 +1,41 @@
+/** @file test_twi_master.cpp
+ *  @brief Polled TWI master on the simulated ADS1115: clock setting, register
+ *         writes and reads, and a NACK from an absent address.
+ */
+#include "host.h"
+#include "SimADS1115.h"
+#include "TwiMaster.h"
+#include "ADS1115.h"
+
+static SimADS1115 adc0(ADS1115::ADDR_GND);
+
+int main(void)
+{
+    /* 400 kHz a 16 MHz: TWBR 12, prescaler 1; pull-ups em SDA e SCL */
+    TwiMaster::begin(ADS1115_I2C_CLOCK);
+    CHECK(TWBR == 12 && (TWSR & 0x03) == 0);
+    CHECK(hostPins[SDA] == HIGH && hostPins[SCL] == HIGH);
+
+    /* Escrita: ponteiro e valor numa só transferência */
+    const uint8_t config[3] = {0x01, 0x44, 0xE3};
+    CHECK(TwiMaster::write(ADS1115::ADDR_GND, config, 3));
+    CHECK(adc0.config == 0x44E3 && adc0.writes == 1);
+
+    /* Leitura a partir do ponteiro atual */
+    uint8_t data[2] = {0, 0};
+    CHECK(TwiMaster::read(ADS1115::ADDR_GND, data, 2) == 2);
+    CHECK(data[0] == 0x44 && data[1] == 0xE3 && adc0.reads == 1);
+
+    const uint8_t pointer = 0x00;
+    adc0.conversion = -1234;
+    CHECK(TwiMaster::write(ADS1115::ADDR_GND, &pointer, 1));
+    CHECK(TwiMaster::read(ADS1115::ADDR_GND, data, 2) == 2);
+    CHECK((int16_t)((data[0] << 8) | data[1]) == -1234);
+
+    /* Endereço sem dispositivo: NACK, nada lido, e o barramento segue utilizável */
+    CHECK(!TwiMaster::write(ADS1115::ADDR_VDD, config, 3));
+    CHECK(TwiMaster::read(ADS1115::ADDR_VDD, data, 2) == 0);
+    CHECK(TwiMaster::read(ADS1115::ADDR_GND, data, 2) == 2 && adc0.reads == 3);
+
+    return hostResult("test_twi_master");
+}
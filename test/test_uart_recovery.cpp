@@ -0,0 +1,189 @@
+/** @file test_uart_recovery.cpp
+ *  @brief Recovery of the ESP serial by the sketch's loop(): the module,
+ *         reset during the operation, answers only at the default rate; the
+ *         sketch falls back to it, configures the module and the local
+ *         server again and returns to the negotiated rate. A module mute at
+ *         both rates keeps the negotiated one.
+ */
+#include <string>
+#include <deque>
+#include "host.h"
+#include "Energy_meter.cpp"
+
+/* Módulo na USART0: só entende e só é entendido na sua taxa; AT+UART_CUR troca após o OK */
+class UartModem
+{
+public:
+    uint32_t rate = ESP_BAUD_RATE;
+    bool mute = false;
+    std::string all; /* Comandos entendidos */
+
+    /* Reset: volta à taxa padrão, o que estava em andamento se perde */
+    void reset(void)
+    {
+        this->rate = ESP_BAUD_RATE;
+        this->line.clear();
+        this->pending.clear();
+    }
+
+    void transmit(uint8_t data)
+    {
+        if (!this->heard() || this->mute)
+            return;
+        this->line += (char)data;
+        if (this->line.size() < 2 || this->line.compare(this->line.size() - 2, 2, "\r\n") != 0)
+            return;
+
+        this->all += this->line;
+        uint32_t next = 0;
+        if (this->line.compare(0, 12, "AT+UART_CUR=") == 0)
+            next = strtoul(this->line.c_str() + 12, NULL, 10);
+        if (this->line == "AT+GMR\r\n")
+            this->respond("AT version:1.7.4.0(May 11 2020 19:13:04)\r\nSDK version:3.0.4(9532ceb)\r\n"
+                          "compile time:May 27 2020 10:12:17\r\nBin version(Wroom 02):1.7.4\r\nOK\r\n");
+        else if (this->line == "AT+CIFSR\r\n")
+            this->respond("+CIFSR:APIP,\"192.168.4.1\"\r\n+CIFSR:STAIP,\"192.168.0.20\"\r\n\r\nOK\r\n");
+        else
+            this->respond("\r\nOK\r\n", next);
+        this->line.clear();
+    }
+
+    /* Bytes que já chegaram, na taxa do módulo; na taxa errada, com erro de quadro */
+    void deliver(void)
+    {
+        while (!this->pending.empty() && this->pending.front().micros <= hostMicros)
+        {
+            Byte byte = this->pending.front();
+            this->pending.pop_front();
+            if (this->heard())
+                hostUartReceive(byte.data);
+            else
+                hostUartReceive(byte.data ^ 0x5A, _BV(FE0));
+            if (byte.rate != 0)
+                this->rate = byte.rate;
+        }
+    }
+
+private:
+    struct Byte
+    {
+        uint32_t micros;
+        uint8_t data;
+        uint32_t rate; /* Nova taxa após este byte */
+    };
+
+    /* A USART0 do Arduino está na taxa do módulo? */
+    bool heard(void)
+    {
+        uint16_t setting = (F_CPU / 4 / this->rate - 1) / 2;
+        return ((UBRR0H << 8) | UBRR0L) == setting;
+    }
+
+    void respond(const std::string &response, uint32_t next = 0)
+    {
+        uint32_t byteMicros = 10000000ul / this->rate;
+        uint32_t at = hostMicros + 2000;
+        for (uint32_t i = 0; i < response.size(); i++)
+            this->pending.push_back({at + i * byteMicros, (uint8_t)response[i], i + 1 == response.size() ? next : 0});
+    }
+
+    std::string line;
+    std::deque<Byte> pending;
+};
+
+static UartModem modem;
+
+static void transmit(uint8_t data) { modem.transmit(data); }
+static void deliver(void) { modem.deliver(); }
+
+/* loop() por 'ms' (cada passada avança 1ms no wdt_reset()) */
+static void run(uint32_t ms)
+{
+    while (ms--)
+        loop();
+}
+
+/* Comandos sem resposta, como as publicações falhas que levam à recuperação */
+static void silence(void)
+{
+    ESP8266::esp_future_t future;
+    for (uint8_t i = 0; i < ESP_BAUD_TIMEOUT_STREAK; i++)
+    {
+        CHECK(esp.probe(&future));
+        while (future.isPending())
+            run(1);
+        CHECK(future.status == ESP8266::ESP_TIMEOUT);
+    }
+}
+
+/* A USART0 está em 'rate'? */
+static bool serialAt(uint32_t rate)
+{
+    return ((UBRR0H << 8) | UBRR0L) == (uint16_t)((F_CPU / 4 / rate - 1) / 2);
+}
+
+int main(void)
+{
+    hostUartTx = transmit;
+    hostYield = deliver;
+
+    /* Como após setup(): taxa negociada acima da padrão */
+    espSerial.begin(ESP_BAUD_RATE);
+    UART_negotiate();
+    CHECK(uartLink.rate == ESP_BAUD_MAX && modem.rate == ESP_BAUD_MAX && uartLink.rejected == 0);
+    iotConnected = true;
+
+    /* Reset do módulo: mudo na taxa negociada */
+    modem.reset();
+    modem.all.clear();
+    silence();
+    CHECK(esp.getTimeoutStreak() >= ESP_BAUD_TIMEOUT_STREAK && !UART_busy());
+
+    /* A sonda na taxa padrão responde: configura, servidor local, e a taxa negociada */
+    uint32_t start = millis();
+    while (!UART_busy() && millis() - start < 2 * ESP_LONG_DELAY)
+        run(1);
+    CHECK(UART_busy());
+    start = millis();
+    while (UART_busy() && millis() - start < ESP_LONG_DELAY)
+        run(1);
+    printf("recovered in %lu ms\n", millis() - start);
+    CHECK(!UART_busy() && uartRecoveries == 1 && !iotConnected);
+    CHECK(modem.all.find("AT+GMR") == 0);
+    CHECK(modem.all.find("ATE0") != std::string::npos && modem.all.find("AT+CIPSERVER=1,80") != std::string::npos);
+    CHECK(modem.all.find("AT+UART_CUR=" + std::to_string(ESP_BAUD_MAX)) > modem.all.find("AT+CIPSERVER=1,80"));
+    CHECK(uartLink.rate == ESP_BAUD_MAX && modem.rate == ESP_BAUD_MAX && serialAt(ESP_BAUD_MAX));
+    CHECK(uartLink.framingErrors == 0 && uartLink.overflowErrors == 0);
+
+    /* O resultado é salvo: a próxima negociação tenta a mesma taxa primeiro */
+    UART_link_t saved;
+    CHECK(EEPROM_read((uint8_t *)&saved, sizeof(saved), EEPROM_UART_OFFSET) && saved.rate == ESP_BAUD_MAX);
+
+    /* O módulo responde de novo: a sequência de timeouts termina */
+    ESP8266::esp_future_t future;
+    CHECK(esp.probe(&future));
+    while (future.isPending())
+        run(1);
+    CHECK(future.isDone() && esp.getTimeoutStreak() == 0);
+
+    /* Mudo também na taxa padrão (ocupado, não reiniciado): mantém a negociada */
+    modem.mute = true;
+    modem.all.clear();
+    silence();
+    start = millis();
+    while (!UART_busy() && millis() - start < 2 * ESP_LONG_DELAY)
+        run(1);
+    CHECK(UART_busy());
+    while (UART_busy() && millis() - start < 3 * ESP_LONG_DELAY)
+        run(1);
+    CHECK(!UART_busy() && uartRecoveries == 1 && modem.all.empty());
+    CHECK(uartLink.rate == ESP_BAUD_MAX && serialAt(ESP_BAUD_MAX));
+
+    modem.mute = false;
+    CHECK(esp.probe(&future));
+    while (future.isPending())
+        run(1);
+    CHECK(future.isDone());
+
+    return hostResult("test_uart_recovery");
+}
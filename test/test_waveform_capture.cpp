@@ -0,0 +1,58 @@
+/** @file test_waveform_capture.cpp
+ *  @brief Waveform capture: segment layout and the end of a segment that
+ *         runs out of room.
+ */
+#include "host.h"
+#include "WaveformCapture.h"
+
+int main(void)
+{
+    WaveformCapture capture;
+
+    /* Um canal: todo o buffer, menos a versão e o cabeçalho do segmento */
+    capture.arm(1);
+    CHECK(capture.getState() == WaveformCapture::WAVEFORM_CAPTURING);
+    uint16_t capacity = WAVEFORM_BUFFER_SIZE - 1 - WAVEFORM_SEGMENT_HEADER_SIZE;
+
+    /* Antes do início da janela nada é copiado */
+    capture.add(0, 100, false);
+
+    /* 0 em 1 byte, depois +-30000 alternados: diferenças de 60000, 3 bytes cada */
+    capture.add(0, 0, true);
+    int16_t last = 0;
+    uint16_t count = 1;
+    for (uint16_t length = 1; length + WAVEFORM_VARINT_MAX_SIZE <= capacity; length += WAVEFORM_VARINT_MAX_SIZE)
+    {
+        last = (count & 1) ? 30000 : -30000;
+        capture.add(0, last, false);
+        count++;
+    }
+
+    /* Não cabe: o segmento termina aqui, mesmo que a próxima diferença seja pequena */
+    capture.add(0, (count & 1) ? 30000 : -30000, false);
+    capture.add(0, last, false);
+    capture.add(1, 0, false);
+    capture.windowEnd(0);
+    CHECK(capture.getState() == WaveformCapture::WAVEFORM_DONE);
+
+    const uint8_t *data = capture.getData();
+    uint16_t samples = data[2] | (data[3] << 8);
+    uint16_t length = data[4] | (data[5] << 8);
+    CHECK(data[0] == WAVEFORM_VERSION && data[1] == 0);
+    CHECK(samples == count);
+    CHECK(length == 1 + (count - 1) * WAVEFORM_VARINT_MAX_SIZE);
+    CHECK(capture.getSize() == 1 + WAVEFORM_SEGMENT_HEADER_SIZE + length);
+
+    /* Nova janela do canal: o segmento recomeça vazio */
+    capture.arm(2);
+    capture.add(0, 5, true);
+    capture.add(0, 4, false);
+    capture.windowEnd(0);
+    capture.add(1, -1, true);
+    capture.windowEnd(1);
+    data = capture.getData();
+    CHECK(data[2] == 2 && data[4] == 2 && data[6] == 10 && data[7] == 1);
+    CHECK(data[1 + WAVEFORM_SEGMENT_HEADER_SIZE + 2] == 1 && data[1 + WAVEFORM_SEGMENT_HEADER_SIZE + 2 + 3] == 1);
+
+    return hostResult("test_waveform_capture");
+}
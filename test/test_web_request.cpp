@@ -0,0 +1,109 @@
+/** @file test_web_request.cpp
+ *  @brief Request line of the sketch's local server, matched byte by byte:
+ *         methods, routes per method, the "wait" flag anywhere in the query,
+ *         paths longer than any route, and the end of the headers; bodies of
+ *         POST read straight into the configuration, restored if not applied.
+ */
+#include <string>
+#include "host.h"
+#include "Energy_meter.cpp"
+
+static WEB_link_t web;
+
+/* Requisição inteira, em pedaços como chegariam em pacotes diferentes */
+static void request(const std::string &text)
+{
+    web.state = WEB_METHOD;
+    web.method = web.route = WEB_ALL_NAMES;
+    web.wait = false;
+    web.length = 0;
+    for (char c : text)
+        WEB_parse(&web, c);
+}
+
+static bool routed(const std::string &line, uint8_t method, uint8_t route, bool wait = false)
+{
+    request(line + "\r\nHost: 192.168.4.1\r\n\r\n");
+    return web.state == WEB_BODY && web.method == method && web.route == route && web.wait == wait;
+}
+
+/* Corpo de um POST na conexão 0, como lido por WEB_serve(); 'closed' encerra antes do fim */
+static uint8_t post(uint8_t route, const std::string &body, bool closed = false)
+{
+    webLinks[0].state = WEB_BODY;
+    webLinks[0].route = route;
+    WEB_process_POST(0);
+    for (char c : body)
+        webReader.feed(c);
+    CHECK(WEB_post_reading(route));
+    if (!closed)
+        WEB_apply_POST(0);
+    uint8_t status = webLinks[0].status;
+    WEB_release(0);
+    CHECK(!WEB_post_reading(route) && webPostLink == ESP_NO_LINK);
+    return status;
+}
+
+int main(void)
+{
+    CHECK(routed("GET /wifi.json HTTP/1.1", WEB_GET, WEB_ROUTE_WIFI));
+    CHECK(routed("POST /wifi.json HTTP/1.1", WEB_POST, WEB_ROUTE_WIFI));
+    CHECK(routed("GET /energy.json HTTP/1.1", WEB_GET, WEB_ROUTE_ENERGY));
+
+    /* Servidores: GET em /server.json, POST em /servers.json */
+    CHECK(routed("GET /server.json HTTP/1.1", WEB_GET, WEB_ROUTE_SERVERS));
+    CHECK(routed("POST /servers.json HTTP/1.1", WEB_POST, WEB_ROUTE_SERVERS));
+    CHECK(routed("GET /servers.json HTTP/1.1", WEB_GET, WEB_ROUTE_NONE));
+    CHECK(routed("POST /server.json HTTP/1.1", WEB_POST, WEB_ROUTE_NONE));
+
+    /* Apenas leitura */
+    CHECK(routed("GET /queue.json HTTP/1.1", WEB_GET, WEB_ROUTE_QUEUE));
+    CHECK(routed("POST /measures.json HTTP/1.1", WEB_POST, WEB_ROUTE_NONE));
+
+    /* Outros métodos, prefixos e rotas mais longas que todas */
+    CHECK(routed("PUT /wifi.json HTTP/1.1", WEB_OTHER, WEB_ROUTE_NONE));
+    CHECK(routed("GETS /wifi.json HTTP/1.1", WEB_OTHER, WEB_ROUTE_NONE));
+    CHECK(routed("GET /wifi HTTP/1.1", WEB_GET, WEB_ROUTE_NONE));
+    CHECK(routed("GET /wifi.jsonx HTTP/1.1", WEB_GET, WEB_ROUTE_NONE));
+    CHECK(routed("GET /" + std::string(300, 'a') + " HTTP/1.1", WEB_GET, WEB_ROUTE_NONE));
+
+    /* Query: "wait" em qualquer ponto, a rota termina no '?' */
+    CHECK(routed("GET /measures.json?wait HTTP/1.1", WEB_GET, WEB_ROUTE_MEASURES, true));
+    CHECK(routed("GET /measures.json?x=1&wwait=1 HTTP/1.1", WEB_GET, WEB_ROUTE_MEASURES, true));
+    CHECK(routed("GET /measures.json?" + std::string(40, 'x') + "wait HTTP/1.1", WEB_GET, WEB_ROUTE_MEASURES, true));
+    CHECK(routed("GET /measures.json?wai HTTP/1.1", WEB_GET, WEB_ROUTE_MEASURES, false));
+    CHECK(routed("GET /measures.json HTTP/1.1", WEB_GET, WEB_ROUTE_MEASURES, false));
+
+    /* Headers incompletos: ainda não há corpo */
+    request("GET /wifi.json HTTP/1.1\r\nHost: x\r\n\r");
+    CHECK(web.state == WEB_HEADERS && web.route == WEB_ROUTE_WIFI);
+    WEB_parse(&web, '\n');
+    CHECK(web.state == WEB_BODY);
+
+    /* EEPROM apagada: os padrões da flash */
+    CHECK(!EEPROM_load(&espAp, sizeof(espAp), EEPROM_ESP_AP_OFFSET, &espApDefault));
+    CHECK(!strcmp(espAp.ssid, ESP_CLIENT_SSID) && !strcmp(espAp.password, ESP_CLIENT_PASSWORD));
+
+    /* Inválido: o que foi lido no lugar é desfeito */
+    CHECK(post(WEB_ROUTE_WIFI, "{\"ssid\":\"home\",\"password\":1}") == WEB_400_BAD_REQUEST);
+    CHECK(!strcmp(espAp.ssid, ESP_CLIENT_SSID));
+
+    /* Válido: aplicado e salvo; os campos ausentes ficam */
+    CHECK(post(WEB_ROUTE_WIFI, "{\"ssid\":\"home\"}") == WEB_204_NO_CONTENT);
+    CHECK(!strcmp(espAp.ssid, "home") && !strcmp(espAp.password, ESP_CLIENT_PASSWORD));
+
+    /* Conexão encerrada no meio do corpo: volta ao salvo */
+    post(WEB_ROUTE_WIFI, "{\"ssid\":\"other\",\"pass", true);
+    CHECK(!strcmp(espAp.ssid, "home"));
+
+    /* Servidores: o mesmo, e nenhuma publicação começa durante a leitura */
+    EEPROM_load(&espUrl, sizeof(espUrl), EEPROM_ESP_URL_OFFSET, &espUrlDefault);
+    CHECK(post(WEB_ROUTE_SERVERS, "{\"host\":\"broker.local\",\"client\":[]}") == WEB_400_BAD_REQUEST);
+    CHECK(!strcmp(espUrl.host, FIREBASE_HOST) && !strcmp(espUrl.client, FIREBASE_CLIENT));
+    CHECK(post(WEB_ROUTE_SERVERS, "{\"host\":\"broker.local\"}") == WEB_204_NO_CONTENT);
+    CHECK(!strcmp(espUrl.host, "broker.local") && !strcmp(espUrl.auth, FIREBASE_AUTH));
+    post(WEB_ROUTE_SERVERS, "{\"host\":\"x", true);
+    CHECK(!strcmp(espUrl.host, "broker.local"));
+
+    return hostResult("test_web_request");
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Local MQTT 3.1.1 broker stand-in for the MQTT uplink (IOT_UPLINK_MQTT).
+
+Usage:
+    mqtt_broker_stub.py [port]
+
+Accepts plain TCP (MQTT_SSL 0) on the given port (default 1883). Answers
+CONNECT with CONNACK, PUBLISH QoS 1 with PUBACK and PINGREQ with PINGRESP,
+and prints one line per packet: the topic, the payload and the bytes it
+took on the wire, so the cost per reading can be compared with the HTTPS
+path (/queue.json, bytesPerInterval). Nothing is retained or forwarded.
+"""
+
+import socket
+import sys
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK, PINGREQ, PINGRESP, DISCONNECT = 1, 2, 3, 4, 12, 13, 14
+
+
+def read_exact(conn, size):
+    data = b""
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+def read_packet(conn):
+    """Returns (header, body, bytes on the wire) of the next packet."""
+    header = read_exact(conn, 1)[0]
+    length, shift, size = 0, 0, 1
+    while True:
+        byte = read_exact(conn, 1)[0]
+        size += 1
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return header, read_exact(conn, length), size + length
+
+
+def serve(conn, address):
+    print("connection from %s:%d" % address)
+    start = time.time()
+    publishes, publish_bytes = 0, 0
+    try:
+        while True:
+            header, body, size = read_packet(conn)
+            kind = header >> 4
+            elapsed = time.time() - start
+
+            if kind == CONNECT:
+                client_length = int.from_bytes(body[10:12], "big")
+                client_id = body[12:12 + client_length].decode(errors="replace")
+                keep_alive = int.from_bytes(body[8:10], "big")
+                print("%8.3f CONNECT client=%s keepAlive=%ds (%d bytes)" % (elapsed, client_id, keep_alive, size))
+                conn.sendall(bytes([CONNACK << 4, 2, 0, 0]))
+
+            elif kind == PUBLISH:
+                qos = (header >> 1) & 0x03
+                topic_length = int.from_bytes(body[0:2], "big")
+                topic = body[2:2 + topic_length].decode(errors="replace")
+                offset = 2 + topic_length
+                if qos:
+                    packet_id = body[offset:offset + 2]
+                    offset += 2
+                    conn.sendall(bytes([PUBACK << 4, 2]) + packet_id)
+                payload = body[offset:].decode(errors="replace")
+                publishes += 1
+                publish_bytes += size
+                print("%8.3f PUBLISH qos=%d %s %s (%d bytes)" % (elapsed, qos, topic, payload, size))
+
+            elif kind == PINGREQ:
+                print("%8.3f PINGREQ" % elapsed)
+                conn.sendall(bytes([PINGRESP << 4, 0]))
+
+            elif kind == DISCONNECT:
+                print("%8.3f DISCONNECT" % elapsed)
+                break
+
+            else:
+                print("%8.3f packet type %d ignored (%d bytes)" % (elapsed, kind, size))
+    except (EOFError, ConnectionError):
+        pass
+    finally:
+        conn.close()
+
+    if publishes:
+        print("closed: %d publications, %.1f bytes each" % (publishes, publish_bytes / publishes))
+    else:
+        print("closed")
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 1883
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("", port))
+    server.listen(1)
+    print("listening on port %d" % port)
+    while True:
+        serve(*server.accept())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Reference decoder of the packed interval record (PackedRecord.h, version 1).
+
+Usage:
+    packed_decode.py <base64> [<base64> ...]
+    packed_decode.py < export.json
+
+With no arguments, reads a Firebase export of /users/<client> (or of its
+'measures/packed' node) from stdin and decodes every record in it. Prints
+one JSON object per record, in the same fields as the JSON format.
+"""
+
+import base64
+import json
+import struct
+import sys
+
+VERSION = 1
+HEADER = struct.Struct("<BBBII")  # versão, medidas, canais, seqNumber, timestamp
+
+TYPES = {
+    0x50: "current",
+    0x70: "energy",
+    0x80: "cost",
+    0x90: "thd",
+}
+
+# Razões por canal: a soma não tem sentido e o JSON não traz "value"
+RATIOS = {0x90}
+
+
+def decode(text):
+    """Decodes one base64 record into a list of measures."""
+    data = base64.b64decode(text)
+    version, measures, channels, seq_number, timestamp = HEADER.unpack_from(data)
+    if version != VERSION:
+        raise ValueError("unsupported record version %d" % version)
+
+    expected = HEADER.size + measures + 4 * measures * channels
+    if len(data) != expected:
+        raise ValueError("record has %d bytes, expected %d" % (len(data), expected))
+
+    types = data[HEADER.size:HEADER.size + measures]
+    values = struct.unpack_from("<%df" % (measures * channels), data, HEADER.size + measures)
+
+    result = []
+    for m, measure_type in enumerate(types):
+        row = list(values[m * channels:(m + 1) * channels])
+        measure = {"measure": TYPES.get(measure_type, hex(measure_type))}
+        if measure_type not in RATIOS:
+            measure["value"] = sum(row)
+        measure.update({
+            "channels": row,
+            "type": measure_type,
+            "seqNumber": seq_number,
+            "timestamp": timestamp,
+        })
+        result.append(measure)
+    return result
+
+
+def records(node, device=None):
+    """Yields (device, base64) from a measures/packed/<device>/<timestamp> tree."""
+    if isinstance(node, str):
+        yield device, node
+    elif isinstance(node, dict):
+        if "measures" in node:
+            node = node["measures"]
+        if "packed" in node:
+            node = node["packed"]
+        for key, child in sorted(node.items()):
+            yield from records(child, device if isinstance(child, str) else key)
+
+
+def main(argv):
+    if len(argv) > 1:
+        items = [(None, text) for text in argv[1:]]
+    else:
+        items = records(json.load(sys.stdin))
+
+    for device, text in items:
+        for measure in decode(text):
+            if device is not None:
+                measure["device"] = device
+            print(json.dumps(measure))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Reference decoder of the waveform capture (WaveformCapture.h, version 1).
+
+Usage:
+    curl http://192.168.4.1/waveform.json?wait | waveform_decode.py
+    waveform_decode.py capture.json
+
+Reads the body of /waveform.json and prints one CSV line per sample:
+channel, index, time in seconds from the start of the window, raw ADC
+counts and amperes (the mean of the window removed, as in the RMS).
+"""
+
+import base64
+import json
+import struct
+import sys
+
+VERSION = 1
+SEGMENT = struct.Struct("<BHH")  # canal, amostras, bytes dos dados
+
+
+def varints(data):
+    """Yields the unsigned LEB128 integers of data."""
+    value = 0
+    shift = 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield value
+            value = 0
+            shift = 0
+    if shift:
+        raise ValueError("truncated varint")
+
+
+def decode(text):
+    """Decodes the base64 buffer into {channel: [counts, ...]}."""
+    data = base64.b64decode(text)
+    if not data or data[0] != VERSION:
+        raise ValueError("unsupported capture version %r" % (data[:1],))
+
+    channels = {}
+    offset = 1
+    while offset < len(data):
+        channel, count, length = SEGMENT.unpack_from(data, offset)
+        offset += SEGMENT.size
+        payload = data[offset:offset + length]
+        if len(payload) != length:
+            raise ValueError("segment of channel %d is truncated" % channel)
+        offset += length
+
+        samples = []
+        previous = 0
+        for zigzag in varints(payload):
+            previous += (zigzag >> 1) ^ -(zigzag & 1)
+            samples.append(previous)
+        if len(samples) != count:
+            raise ValueError("channel %d has %d samples, expected %d" % (channel, len(samples), count))
+        channels[channel] = samples
+    return channels
+
+
+def main(argv):
+    with (open(argv[1]) if len(argv) > 1 else sys.stdin) as source:
+        body = json.load(source)
+    if body.get("state") != "done":
+        print("capture is %s" % body.get("state"), file=sys.stderr)
+        return 1
+
+    scale = body["scale"]
+    print("channel,index,time,counts,amperes")
+    for channel, samples in sorted(decode(body["data"]).items()):
+        rate = body["sampleRate"][channel]
+        lsb = body["lsbMillivolts"][channel]
+        mean = sum(samples) / len(samples) if samples else 0
+        for index, counts in enumerate(samples):
+            time = index / rate if rate else 0
+            amperes = (counts - mean) * lsb * scale * 1e-3
+            print("%d,%d,%.6f,%d,%.4f" % (channel, index, time, counts, amperes))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))